@@ -0,0 +1,6 @@
+#version 450 core
+
+// Depth prepass, only the depth test and write are needed.
+void main()
+{
+}
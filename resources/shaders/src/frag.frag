@@ -2,10 +2,61 @@
 
 layout(location = 0) out vec4 FragColor;
 layout(location = 0) in vec2 uv;
+layout(location = 1) in vec3 worldPos;
+layout(location = 2) in float viewDepth;
 
 layout(set = 2, binding = 0) uniform sampler2D tex;
 
+struct Light {
+    vec4 position_radius; // world space, falloff radius
+    vec4 color;           // rgb, intensity
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer bLights {
+    Light lights[];
+};
+
+// one {offset, count} range into light_indices per cluster
+layout(std430, set = 2, binding = 2) readonly buffer bClusters {
+    uvec2 clusters[];
+};
+
+layout(std430, set = 2, binding = 3) readonly buffer bLightIndices {
+    uint light_indices[];
+};
+
+layout(std140, set = 3, binding = 0) uniform uLighting {
+    vec4 grid;    // tiles x, tiles y, slices, lighting on
+    vec4 depth;   // near, slices / log(far / near), viewport w, viewport h
+    vec4 ambient; // rgb, unused
+};
+
 void main()
 {
-    FragColor = texture(tex, uv);
+    vec4 albedo = texture(tex, uv);
+    if (grid.w == 0.0) {
+        FragColor = albedo;
+        return;
+    }
+
+    // the meshes have no normals, use the face's
+    vec3 n = normalize(cross(dFdx(worldPos), dFdy(worldPos)));
+
+    uvec3 dims = uvec3(grid.xyz);
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / depth.zw * grid.xy), dims.xy - 1u);
+    uint slice = min(uint(max(log(viewDepth / depth.x) * depth.y, 0.0)),
+                     dims.z - 1u);
+    uvec2 range = clusters[(slice * dims.y + tile.y) * dims.x + tile.x];
+
+    vec3 light = ambient.rgb;
+    for (uint i = 0u; i < range.y; ++i) {
+        Light l = lights[light_indices[range.x + i]];
+        vec3 to = l.position_radius.xyz - worldPos;
+        float dist = length(to);
+        float falloff = clamp(1.0 - dist / l.position_radius.w, 0.0, 1.0);
+        // two sided, winding isn't consistent across the meshes
+        float lambert = abs(dot(n, to / max(dist, 1e-4)));
+        light += l.color.rgb * l.color.w * falloff * falloff * lambert;
+    }
+    FragColor = vec4(albedo.rgb * light, albedo.a);
 }
@@ -1,8 +1,55 @@
 #version 450 core
 
 layout(location = 0) in vec3 Pos;
+#ifndef DEPTH_ONLY
 layout(location = 1) in vec2 inUv;
 layout(location = 0) out vec2 uv;
+layout(location = 1) out vec3 worldPos;  // lighting
+layout(location = 2) out float viewDepth; // light cluster slice
+#endif
+
+// the depth prepass and the color pass after it must agree on depth exactly
+invariant gl_Position;
+
+struct Instance {
+    vec3 position;
+    float scale;
+    vec4 rotation; // quaternion, xyzw
+    vec4 params;   // phase, speed, wave, unused
+};
+
+layout(std430, binding = 0, set = 0) readonly buffer bInstances {
+    Instance instances[];
+};
+
+#ifdef GPU_CULLING
+// compacted by cull.comp, drawn indirectly
+layout(std430, binding = 1, set = 0) readonly buffer bVisible {
+    uint visible[];
+};
+#define INSTANCE_ID visible[gl_InstanceIndex]
+#else
+#define INSTANCE_ID gl_InstanceIndex
+#endif
+
+#ifdef SKINNED
+// skin.comp's output: every vertex once per pose, instances pick a pose by
+// their swim phase. gl_VertexIndex counts from the whole vertex buffer's
+// start, draws offset it by their base vertex.
+#ifdef GPU_CULLING
+#define SKINNED_BINDING 2
+#else
+#define SKINNED_BINDING 1
+#endif
+layout(std430, binding = SKINNED_BINDING, set = 0) readonly buffer bSkinned {
+    vec4 skinned[];
+};
+
+layout(std140, binding = 2, set = 1) uniform uSkinning {
+    uint vertex_count;
+    uint poses;
+} skin;
+#endif
 
 layout(std140, binding = 0, set = 1) uniform uMatrices {
     mat4 mat_vp;
@@ -13,24 +60,30 @@ layout(std140, binding = 1, set = 1) uniform uCameraMatrix {
     mat4 mat_cam;
 };
 
-layout(std140, binding = 2, set = 1) uniform uInstanceSettings {
-    float spread;
-    uint dimension;
-};
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
 void main()
 {
+#ifndef DEPTH_ONLY
     uv = inUv;
-    uint instance = gl_InstanceIndex;
-    uint square = dimension * dimension;
-
-    vec4 relative_pos = mvp.mat_m * vec4(Pos, 1.0);
-    relative_pos.x += float(instance % dimension) * spread;
-    relative_pos.y += int(floor(float(instance / dimension))) % dimension * spread;
-    relative_pos.z += floor(float(instance / square)) * spread;
-
-    relative_pos.x -= dimension * 2;
-    relative_pos.y -= dimension * 2;
-    relative_pos.z -= dimension * 2;
-    gl_Position = mvp.mat_vp * relative_pos;
+#endif
+    Instance inst = instances[INSTANCE_ID];
+
+#ifdef SKINNED
+    uint pose = min(uint(inst.params.x * (float(skin.poses) / 6.28318531)),
+                    skin.poses - 1u);
+    vec3 pos = skinned[pose * skin.vertex_count + gl_VertexIndex].xyz;
+#else
+    vec3 pos = Pos;
+#endif
+    vec3 local = (mvp.mat_m * vec4(pos, 1.0)).xyz;
+    vec3 world = inst.position + rotate(inst.rotation, local * inst.scale);
+    gl_Position = mvp.mat_vp * vec4(world, 1.0);
+#ifndef DEPTH_ONLY
+    worldPos = world;
+    viewDepth = gl_Position.w;
+#endif
 }
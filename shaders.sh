@@ -1,7 +1,15 @@
 #!/usr/bin/env bash
+# Only needed without glslang at configure time, CMake's `shaders` target
+# otherwise compiles and embeds these.
 
-glslang resources/shaders/src/frag.frag -V -o resources/shaders/compiled/frag.spv;
-glslang resources/shaders/src/vert.vert -V -o resources/shaders/compiled/vert.spv;
-
-glslang resources/shaders/src/skybox.frag -V -o resources/shaders/compiled/skybox.frag.spv;
-glslang resources/shaders/src/skybox.vert -V -o resources/shaders/compiled/skybox.vert.spv;
+mkdir -p resources/shaders/compiled;
+for src in resources/shaders/src/*; do
+  glslang "$src" -V -e main -o "resources/shaders/compiled/$(basename "$src").spv";
+done
+glslang resources/shaders/src/vert.vert -V -e main -DGPU_CULLING -o resources/shaders/compiled/vert_gpu_cull.vert.spv;
+glslang resources/shaders/src/vert.vert -V -e main -DDEPTH_ONLY -o resources/shaders/compiled/vert_depth.vert.spv;
+glslang resources/shaders/src/vert.vert -V -e main -DDEPTH_ONLY -DGPU_CULLING -o resources/shaders/compiled/vert_depth_gpu_cull.vert.spv;
+glslang resources/shaders/src/vert.vert -V -e main -DSKINNED -o resources/shaders/compiled/vert_skinned.vert.spv;
+glslang resources/shaders/src/vert.vert -V -e main -DGPU_CULLING -DSKINNED -o resources/shaders/compiled/vert_gpu_cull_skinned.vert.spv;
+glslang resources/shaders/src/vert.vert -V -e main -DDEPTH_ONLY -DSKINNED -o resources/shaders/compiled/vert_depth_skinned.vert.spv;
+glslang resources/shaders/src/vert.vert -V -e main -DDEPTH_ONLY -DGPU_CULLING -DSKINNED -o resources/shaders/compiled/vert_depth_gpu_cull_skinned.vert.spv;
@@ -0,0 +1,410 @@
+#include "bench.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+#include "cube.h"
+#include "src/logger.h"
+#include "util.h"
+
+namespace {
+
+// fixed step, so every run animates the same frames
+constexpr float kFrameStep = 1.f / 60.f;
+
+struct FrameSample
+{
+  float cpu_ms;
+  float gpu_ms;
+};
+
+struct Summary
+{
+  float mean{ 0.f };
+  float p50{ 0.f };
+  float p90{ 0.f };
+  float p99{ 0.f };
+  float max{ 0.f };
+};
+
+struct CaseResult
+{
+  BenchCase params;
+  u32 instances;
+  std::vector<FrameSample> frames;
+  Summary cpu;
+  Summary gpu;
+};
+
+// Nearest rank percentiles: the smallest value at least p of them are under
+// or equal to
+Summary
+Summarize(std::vector<float> values)
+{
+  Summary s{};
+  if (values.empty()) {
+    return s;
+  }
+  std::sort(values.begin(), values.end());
+  auto rank = [&](double p) {
+    // p * n lands a hair over the integer it should be for some n
+    const size_t n = values.size();
+    const size_t i = size_t(std::ceil(p * double(n) - 1e-9));
+    return values[std::clamp<size_t>(i, 1, n) - 1];
+  };
+  for (float v : values) {
+    s.mean += v;
+  }
+  s.mean /= float(values.size());
+  s.p50 = rank(.5);
+  s.p90 = rank(.9);
+  s.p99 = rank(.99);
+  s.max = values.back();
+  return s;
+}
+
+template<typename T, typename Parse>
+bool
+ParseList(std::string_view arg, std::vector<T>& out, Parse parse)
+{
+  out.clear();
+  while (!arg.empty()) {
+    const size_t comma = arg.find(',');
+    T value{};
+    if (!parse(arg.substr(0, comma), value)) {
+      return false;
+    }
+    out.push_back(value);
+    arg = comma == std::string_view::npos ? "" : arg.substr(comma + 1);
+  }
+  return !out.empty();
+}
+
+bool
+ParseU32(std::string_view s, u32& out)
+{
+  const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+  return ec == std::errc{} && end == s.data() + s.size();
+}
+
+bool
+ParseSwitch(std::string_view s, bool& out)
+{
+  out = s == "on" || s == "1";
+  return out || s == "off" || s == "0";
+}
+
+constexpr const char* kCullNames[] = { "none", "cpu", "gpu" };
+
+const char*
+CullName(CullMode mode)
+{
+  return kCullNames[u32(mode)];
+}
+
+bool
+ParseCull(std::string_view s, CullMode& out)
+{
+  for (u32 i = 0; i < std::size(kCullNames); ++i) {
+    if (s == kCullNames[i]) {
+      out = CullMode(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+ParseResolution(std::string_view s, std::pair<int, int>& out)
+{
+  const size_t x = s.find('x');
+  u32 w = 0;
+  u32 h = 0;
+  if (x == std::string_view::npos || !ParseU32(s.substr(0, x), w) ||
+      !ParseU32(s.substr(x + 1), h) || w == 0 || h == 0) {
+    return false;
+  }
+  out = { int(w), int(h) };
+  return true;
+}
+
+void
+WriteSummary(std::ofstream& f, const Summary& s)
+{
+  f << "{ \"mean\": " << s.mean << ", \"p50\": " << s.p50
+    << ", \"p90\": " << s.p90 << ", \"p99\": " << s.p99
+    << ", \"max\": " << s.max << " }";
+}
+
+bool
+WriteJson(const std::string& path,
+          const BenchCfg& cfg,
+          const std::vector<CaseResult>& results)
+{
+  std::ofstream f{ path };
+  if (!f) {
+    return false;
+  }
+  f << "{\n  \"warmup_frames\": " << cfg.warmup_frames
+    << ",\n  \"frames\": " << cfg.frames << ",\n  \"cases\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto& r = results[i];
+    f << (i == 0 ? "\n" : ",\n") << "    {\n"
+      << "      \"dimension\": " << r.params.dimension << ",\n"
+      << "      \"instances\": " << r.instances << ",\n"
+      << "      \"wireframe\": " << (r.params.wireframe ? "true" : "false")
+      << ",\n"
+      << "      \"cull\": \"" << CullName(r.params.cull) << "\",\n"
+      << "      \"width\": " << r.params.width << ",\n"
+      << "      \"height\": " << r.params.height << ",\n"
+      << "      \"cpu_ms\": ";
+    WriteSummary(f, r.cpu);
+    f << ",\n      \"gpu_ms\": ";
+    WriteSummary(f, r.gpu);
+    f << ",\n      \"frames\": [";
+    for (size_t j = 0; j < r.frames.size(); ++j) {
+      f << (j == 0 ? "" : ", ") << "[" << r.frames[j].cpu_ms << ", "
+        << r.frames[j].gpu_ms << "]";
+    }
+    f << "]\n    }";
+  }
+  f << "\n  ]\n}\n";
+  return bool(f);
+}
+
+bool
+WriteCsv(const std::string& path, const std::vector<CaseResult>& results)
+{
+  std::ofstream f{ path };
+  std::string summary_path = path;
+  const size_t dot = summary_path.rfind('.');
+  const size_t slash = summary_path.find_last_of("/\\");
+  if (dot != std::string::npos &&
+      (slash == std::string::npos || dot > slash)) {
+    summary_path.resize(dot);
+  }
+  summary_path += "_summary.csv";
+  std::ofstream s{ summary_path };
+  if (!f || !s) {
+    return false;
+  }
+
+  f << "dimension,wireframe,cull,width,height,frame,cpu_ms,gpu_ms\n";
+  s << "dimension,instances,wireframe,cull,width,height,metric,mean,p50,p90,"
+       "p99,max\n";
+  for (const auto& r : results) {
+    const auto& p = r.params;
+    for (size_t i = 0; i < r.frames.size(); ++i) {
+      f << p.dimension << ',' << p.wireframe << ',' << CullName(p.cull) << ','
+        << p.width << ',' << p.height << ',' << i << ','
+        << r.frames[i].cpu_ms << ',' << r.frames[i].gpu_ms << '\n';
+    }
+    for (const auto& [metric, m] :
+         { std::pair{ "cpu_ms", r.cpu }, std::pair{ "gpu_ms", r.gpu } }) {
+      s << p.dimension << ',' << r.instances << ',' << p.wireframe << ','
+        << CullName(p.cull) << ',' << p.width << ',' << p.height << ','
+        << metric << ',' << m.mean << ',' << m.p50 << ',' << m.p90 << ','
+        << m.p99 << ',' << m.max << '\n';
+    }
+  }
+  return bool(f) && bool(s);
+}
+
+} // namespace
+
+bool
+ParseBenchArgs(int argc, char** argv, bool& enabled, BenchCfg& cfg)
+{
+  enabled = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--bench") {
+      enabled = true;
+      continue;
+    }
+    if (arg == "--validate-culling") {
+      cfg.validate_culling = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      LOG_ERROR("Unknown argument or missing value: {}", arg);
+      return false;
+    }
+    const std::string_view value = argv[++i];
+    bool ok = false;
+    if (arg == "--warmup") {
+      ok = ParseU32(value, cfg.warmup_frames);
+    } else if (arg == "--frames") {
+      ok = ParseU32(value, cfg.frames) && cfg.frames != 0;
+    } else if (arg == "--dimensions") {
+      ok = ParseList(value, cfg.dimensions, ParseU32);
+    } else if (arg == "--wireframe") {
+      // vector<bool> has no addressable elements, go through u32
+      std::vector<u32> flags;
+      ok = ParseList(value, flags, [](std::string_view s, u32& out) {
+        bool on = false;
+        const bool parsed = ParseSwitch(s, on);
+        out = on;
+        return parsed;
+      });
+      cfg.wireframe.assign(flags.begin(), flags.end());
+    } else if (arg == "--cull") {
+      ok = ParseList(value, cfg.cull, ParseCull);
+    } else if (arg == "--resolutions") {
+      ok = ParseList(value, cfg.resolutions, ParseResolution);
+    } else if (arg == "--out") {
+      cfg.out = value;
+      ok = !cfg.out.empty();
+    } else if (arg == "--replay") {
+      cfg.replay = value;
+      ok = !cfg.replay.empty();
+    } else if (arg == "--record") {
+      cfg.record = value;
+      ok = !cfg.record.empty();
+    } else if (arg == "--capture") {
+      cfg.capture = value;
+      ok = !cfg.capture.empty();
+    } else {
+      LOG_ERROR("Unknown argument: {}", arg);
+      return false;
+    }
+    if (!ok) {
+      LOG_ERROR("Invalid value for {}: {}", arg, value);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+RunBench(CubeProgram& app, const BenchCfg& cfg)
+{
+  LOG_INFO("Benchmarking on {}", SDL_GetGPUDeviceDriver(app.Device));
+  // a recording brings its own settings, only resolutions are swept
+  const ReplayReader& replay = app.Replay();
+  std::vector<u32> dimensions = cfg.dimensions;
+  std::vector<bool> wireframes = cfg.wireframe;
+  std::vector<CullMode> culls = cfg.cull;
+  if (replay.IsOpen()) {
+    if (replay.Frames() <= cfg.warmup_frames) {
+      LOG_ERROR("The recording has {} frames, {} are warmup",
+                replay.Frames(),
+                cfg.warmup_frames);
+      return false;
+    }
+    dimensions = { replay.First().instancing.dimension };
+    wireframes = { replay.First().wireframe };
+    culls = { CullMode(replay.First().cull_mode) };
+  }
+  const u32 total =
+    replay.IsOpen() ? replay.Frames() : cfg.warmup_frames + cfg.frames;
+
+  std::vector<BenchCase> cases;
+  for (u32 dimension : dimensions) {
+    for (bool wireframe : wireframes) {
+      for (CullMode cull : culls) {
+        for (const auto& [width, height] : cfg.resolutions) {
+          cases.push_back(BenchCase{ dimension,
+                                     wireframe,
+                                     cull,
+                                     width,
+                                     height,
+                                     cfg.validate_culling });
+        }
+      }
+    }
+  }
+
+  std::vector<CaseResult> results;
+  u32 validated = 0;  // frames whose GPU culling was checked
+  u32 mismatched = 0; // and differed from the CPU reference
+  for (const BenchCase& params : cases) {
+    CaseResult r{};
+    r.params = params;
+    r.instances = params.dimension * params.dimension * params.dimension;
+    if (!app.SetBenchCase(r.params)) {
+      LOG_ERROR("Couldn't set up case {}x{}", params.width, params.height);
+      return false;
+    }
+    app.RewindReplay();
+    r.frames.reserve(total - cfg.warmup_frames);
+    for (u32 frame = 0; frame < total; ++frame) {
+      app.DeltaTime = kFrameStep;
+      app.lastTime = double(frame) * kFrameStep;
+
+      const Uint64 start = SDL_GetTicksNS();
+      if (!app.Draw()) {
+        LOG_ERROR("Frame {} failed", frame);
+        return false;
+      }
+      const Uint64 cpu_end = SDL_GetTicksNS();
+      SDL_GPUFence* fence = app.TakeFrameFence();
+      if (fence == nullptr) {
+        LOG_ERROR("Frame {} has no fence", frame);
+        return false;
+      }
+      SDL_WaitForGPUFences(app.Device, true, &fence, 1);
+      const Uint64 gpu_end = SDL_GetTicksNS();
+      SDL_ReleaseGPUFence(app.Device, fence);
+
+      if (frame >= cfg.warmup_frames) {
+        r.frames.push_back({ float(cpu_end - start) / 1e6f,
+                             float(gpu_end - start) / 1e6f });
+      }
+    }
+    validated += app.CullingValidated();
+    mismatched += app.CullingMismatched();
+
+    std::vector<float> cpu(r.frames.size());
+    std::vector<float> gpu(r.frames.size());
+    for (size_t i = 0; i < r.frames.size(); ++i) {
+      cpu[i] = r.frames[i].cpu_ms;
+      gpu[i] = r.frames[i].gpu_ms;
+    }
+    r.cpu = Summarize(std::move(cpu));
+    r.gpu = Summarize(std::move(gpu));
+    LOG_INFO("{} fish{}, {} culling, {}x{}: cpu p50 {:.3f} p99 {:.3f} ms, "
+             "gpu p50 {:.3f} p99 {:.3f} ms",
+             r.instances,
+             params.wireframe ? " wireframe" : "",
+             CullName(params.cull),
+             params.width,
+             params.height,
+             r.cpu.p50,
+             r.cpu.p99,
+             r.gpu.p50,
+             r.gpu.p99);
+    results.push_back(std::move(r));
+  }
+
+  const bool json = cfg.out.size() >= 5 &&
+                    cfg.out.compare(cfg.out.size() - 5, 5, ".json") == 0;
+  if (!(json ? WriteJson(cfg.out, cfg, results)
+             : WriteCsv(cfg.out, results))) {
+    LOG_ERROR("Couldn't write {}", cfg.out);
+    return false;
+  }
+  LOG_INFO("Wrote {}", cfg.out);
+
+  if (!cfg.validate_culling) {
+    return true;
+  }
+  if (validated == 0) {
+    LOG_ERROR("No frame was GPU culled, nothing validated");
+    return false;
+  }
+  if (mismatched != 0) {
+    LOG_ERROR("GPU culling differed from the CPU reference in {} of {} frames",
+              mismatched,
+              validated);
+    return false;
+  }
+  LOG_INFO("GPU culling matched the CPU reference in {} frames", validated);
+  return true;
+}
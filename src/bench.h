@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/culling.h"
+#include "types.h"
+
+class CubeProgram;
+
+// One point of a benchmark sweep
+struct BenchCase
+{
+  u32 dimension{ 10 }; // InstancingCfg::dimension, dimension^3 fish
+  bool wireframe{ false };
+  CullMode cull{ CullMode::Cpu };
+  int width{ 1280 }; // scene targets, in pixels
+  int height{ 720 };
+  // checks every frame's GPU culling against the CPU reference
+  bool validate_culling{ false };
+};
+
+// Every combination of the swept values is run, in the order given.
+struct BenchCfg
+{
+  u32 warmup_frames{ 60 };
+  u32 frames{ 300 };
+  std::vector<u32> dimensions{ 10 };
+  std::vector<bool> wireframe{ false };
+  std::vector<CullMode> cull{ CullMode::Cpu };
+  std::vector<std::pair<int, int>> resolutions{ { 1280, 720 } };
+  // Fails the run when a GPU culled frame differs from the CPU reference,
+  // or when no frame was GPU culled at all
+  bool validate_culling{ false };
+  // Per frame samples. JSON holds the percentiles too when the path ends in
+  // .json, otherwise they go in a `<stem>_summary.csv` next to it.
+  std::string out{ "bench.csv" };
+  // Recording to replay instead of sweeping dimensions and wireframe, or to
+  // play in the window without --bench (see replay.h).
+  std::string replay;
+  std::string record; // windowed runs only
+  // Scene frames, a .y4m video or PNGs (see FrameCapture). Benchmarks
+  // capture every frame, warmup included.
+  std::string capture;
+};
+
+// Sets `enabled` if `--bench` is given and fills `cfg` from the options
+// following it. False on options it doesn't understand.
+//
+//   --bench [--warmup N] [--frames N] [--dimensions 10,50]
+//           [--wireframe off,on] [--cull none,cpu,gpu]
+//           [--validate-culling] [--resolutions 1280x720,1920x1080]
+//           [--out bench.csv] [--replay run.rec] [--capture out.y4m]
+//   [--record run.rec | --replay run.rec] [--capture frame.png]
+bool
+ParseBenchArgs(int argc, char** argv, bool& enabled, BenchCfg& cfg);
+
+// Renders every case of the sweep on a headless CubeProgram with a fixed
+// time step and writes the results. A frame's CPU time is Draw(), its GPU
+// time runs from the start of Draw() to the frame's fence signaling; frames
+// are waited on one by one so they don't overlap. With a replay loaded,
+// every resolution replays the whole recording, its first frames being the
+// warmup.
+bool
+RunBench(CubeProgram& app, const BenchCfg& cfg);
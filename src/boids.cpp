@@ -0,0 +1,513 @@
+#include "boids.h"
+
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "src/logger.h"
+#include "src/profiler.h"
+
+namespace {
+
+constexpr u32 kSortGrain = 8192;   // fish per sort chunk
+constexpr u32 kMaxSortChunks = 16; // each has a histogram over every key
+constexpr u32 kKeyGrain = 8192;    // keys per prefix sum job
+constexpr u32 kSteerGrain = 1024;  // fish per steering job
+constexpr float kWallMargin = 2.f; // fish turn back within it of a wall
+constexpr u32 kRow = 3;            // cells a fish sees along every axis
+constexpr u32 kMaxRanges = 9 * 2;  // its rows, split in two where x wraps
+
+i32
+Cell(float x, float inv_cell)
+{
+  return static_cast<i32>(std::floor(x * inv_cell));
+}
+
+// The cell's coordinates wrapped around a grid of `bits` per axis. Cells
+// along x get consecutive keys, the rows around it are nearby ones.
+u32
+CellKey(i32 x, i32 y, i32 z, const u32 (&bits)[3])
+{
+  return (u32(x) & ((1u << bits[0]) - 1)) |
+         (u32(y) & ((1u << bits[1]) - 1)) << bits[0] |
+         (u32(z) & ((1u << bits[2]) - 1)) << (bits[0] + bits[1]);
+}
+
+// Yaw only, facing along the velocity in the XZ plane like the grid's fish.
+// Half angle formulas, no trigonometry.
+glm::vec4
+Heading(float vx, float vz)
+{
+  const float h = std::sqrt(vx * vx + vz * vz);
+  const float cos_yaw = h > 0.f ? vz / h : 1.f;
+  const float half_sin =
+    std::copysign(std::sqrt(std::max(0.f, (1.f - cos_yaw) * .5f)), vx);
+  const float half_cos = std::sqrt(std::max(0.f, (1.f + cos_yaw) * .5f));
+  return { 0.f, half_sin, 0.f, half_cos };
+}
+
+struct Range
+{
+  u32 begin;
+  u32 end;
+};
+
+// The ranges of the sorted arrays holding the cells around `c`. The cells of
+// every row are consecutive keys, unless x wraps.
+u32
+CellRanges(const std::vector<u32>& cell_start,
+           const u32 (&bits)[3],
+           const i32 (&c)[3],
+           Range (&ranges)[kMaxRanges])
+{
+  u32 count = 0;
+  const u32 row_size = 1u << bits[0];
+  const u32 first = u32(c[0] - 1) & (row_size - 1);
+  for (i32 dz = -1; dz <= 1; ++dz) {
+    for (i32 dy = -1; dy <= 1; ++dy) {
+      const u32* row = &cell_start[CellKey(0, c[1] + dy, c[2] + dz, bits)];
+      if (first + kRow <= row_size) {
+        ranges[count++] = { row[first], row[first + kRow] };
+      } else {
+        ranges[count++] = { row[first], row[row_size] };
+        ranges[count++] = { row[0], row[first + kRow - row_size] };
+      }
+    }
+  }
+  return count;
+}
+
+#if defined(__SSE2__)
+float
+HorizontalSum(__m128 v)
+{
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, v);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+#endif
+
+// Sums the fish of `ranges` in the sorted arrays as seen from `p`. Itself and
+// the ones out of reach count for nothing, there's no branch. The arrays are
+// padded for a whole step of 4 past the end, which the last one masks.
+BoidsNeighborhood
+Gather(const std::vector<float> (&sorted)[6],
+       const Range* ranges,
+       u32 range_count,
+       const float p[3],
+       float radius2,
+       float separation2)
+{
+  const float* x = sorted[0].data();
+  const float* y = sorted[1].data();
+  const float* z = sorted[2].data();
+  const float* vx = sorted[3].data();
+  const float* vy = sorted[4].data();
+  const float* vz = sorted[5].data();
+  BoidsNeighborhood n;
+#if defined(__SSE2__)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 r2 = _mm_set1_ps(radius2);
+  const __m128 s2 = _mm_set1_ps(separation2);
+  const __m128 px = _mm_set1_ps(p[0]);
+  const __m128 py = _mm_set1_ps(p[1]);
+  const __m128 pz = _mm_set1_ps(p[2]);
+  const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+  __m128 count = zero;
+  __m128 ox = zero, oy = zero, oz = zero;
+  __m128 ax = zero, ay = zero, az = zero;
+  __m128 sx = zero, sy = zero, sz = zero;
+  for (u32 r = 0; r < range_count; ++r) {
+    const u32 end = ranges[r].end;
+    for (u32 j = ranges[r].begin; j < end; j += 4) {
+      const __m128 valid = _mm_castsi128_ps(
+        _mm_cmpgt_epi32(_mm_set1_epi32(i32(end - j)), lane));
+      const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), px);
+      const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), py);
+      const __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + j), pz);
+      const __m128 d2 = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+      const __m128 in = _mm_and_ps(
+        valid, _mm_and_ps(_mm_cmpgt_ps(d2, zero), _mm_cmplt_ps(d2, r2)));
+      count = _mm_add_ps(count, _mm_and_ps(in, one));
+      ox = _mm_add_ps(ox, _mm_and_ps(in, dx));
+      oy = _mm_add_ps(oy, _mm_and_ps(in, dy));
+      oz = _mm_add_ps(oz, _mm_and_ps(in, dz));
+      ax = _mm_add_ps(ax, _mm_and_ps(in, _mm_loadu_ps(vx + j)));
+      ay = _mm_add_ps(ay, _mm_and_ps(in, _mm_loadu_ps(vy + j)));
+      az = _mm_add_ps(az, _mm_and_ps(in, _mm_loadu_ps(vz + j)));
+      // 1 / d2 is infinite for itself, masked out like the far ones
+      const __m128 near = _mm_and_ps(in, _mm_cmplt_ps(d2, s2));
+      const __m128 push = _mm_and_ps(near, _mm_div_ps(one, d2));
+      sx = _mm_sub_ps(sx, _mm_mul_ps(dx, push));
+      sy = _mm_sub_ps(sy, _mm_mul_ps(dy, push));
+      sz = _mm_sub_ps(sz, _mm_mul_ps(dz, push));
+    }
+  }
+  n.count = HorizontalSum(count);
+  n.offset[0] = HorizontalSum(ox);
+  n.offset[1] = HorizontalSum(oy);
+  n.offset[2] = HorizontalSum(oz);
+  n.velocity[0] = HorizontalSum(ax);
+  n.velocity[1] = HorizontalSum(ay);
+  n.velocity[2] = HorizontalSum(az);
+  n.separation[0] = HorizontalSum(sx);
+  n.separation[1] = HorizontalSum(sy);
+  n.separation[2] = HorizontalSum(sz);
+#else
+  for (u32 r = 0; r < range_count; ++r) {
+    for (u32 j = ranges[r].begin; j < ranges[r].end; ++j) {
+      const float dx = x[j] - p[0];
+      const float dy = y[j] - p[1];
+      const float dz = z[j] - p[2];
+      const float d2 = dx * dx + dy * dy + dz * dz;
+      if (d2 <= 0.f || d2 >= radius2) {
+        continue;
+      }
+      n.count += 1.f;
+      n.offset[0] += dx;
+      n.offset[1] += dy;
+      n.offset[2] += dz;
+      n.velocity[0] += vx[j];
+      n.velocity[1] += vy[j];
+      n.velocity[2] += vz[j];
+      if (d2 < separation2) {
+        const float push = 1.f / d2;
+        n.separation[0] -= dx * push;
+        n.separation[1] -= dy * push;
+        n.separation[2] -= dz * push;
+      }
+    }
+  }
+#endif
+  return n;
+}
+
+} // namespace
+
+void
+Boids::Resize(u32 count, float origin, float size)
+{
+  origin_ = origin;
+  size_ = size;
+  // the obstacles follow the box, away from its walls
+  for (u32 o = 0; o < kMaxObstacles; ++o) {
+    const u32 seed = 0x0b57ac1eU + o * 4;
+    for (u32 axis = 0; axis < 3; ++axis) {
+      obstacles_[o][axis] = origin + (.25f + .5f * Hash01(seed + axis)) * size;
+    }
+    obstacles_[o][3] = size * (.05f + .05f * Hash01(seed + 3));
+  }
+  if (count == Count()) {
+    return;
+  }
+  const u32 old = Count();
+  for (auto* v : { &pos_x_, &pos_y_, &pos_z_, &vel_x_, &vel_y_, &vel_z_,
+                   &scale_, &phase_, &speed_ }) {
+    v->resize(count);
+  }
+  for (u32 i = old; i < count; ++i) {
+    const u32 seed = spawned_++ * 8;
+    pos_x_[i] = origin + Hash01(seed + 0) * size;
+    pos_y_[i] = origin + Hash01(seed + 1) * size;
+    pos_z_[i] = origin + Hash01(seed + 2) * size;
+    // mostly horizontal, fish don't swim straight up
+    const float angle = Hash01(seed + 3) * kTwoPi;
+    vel_x_[i] = std::cos(angle) * 2.f;
+    vel_y_[i] = (Hash01(seed + 4) - .5f) * .5f;
+    vel_z_[i] = std::sin(angle) * 2.f;
+    scale_[i] = .8f + Hash01(seed + 5) * .4f;
+    phase_[i] = Hash01(seed + 6) * kTwoPi;
+    speed_[i] = 1.f + Hash01(seed + 7) * .5f;
+  }
+  LOG_DEBUG("Boids resized to {}", count);
+}
+
+void
+Boids::Clear()
+{
+  Resize(0, origin_, size_);
+  spawned_ = 0;
+}
+
+void
+Boids::Update(const BoidsCfg& cfg,
+              float time,
+              float dt,
+              JobSystem& jobs,
+              InstanceData* out)
+{
+  PROFILE_ZONE("Boids::Update");
+  const u32 count = Count();
+  if (count == 0) {
+    stats_ = BoidsStats{};
+    return;
+  }
+  const Uint64 start = SDL_GetTicksNS();
+  inv_cell_ = 1.f / std::max(cfg.radius, .1f);
+  BuildGrid(jobs);
+  const Uint64 sorted = SDL_GetTicksNS();
+
+  std::atomic<u64> neighbors{ 0 };
+  jobs.ParallelFor(count, kSteerGrain, [&](u32 begin, u32 end) {
+    neighbors += Steer(cfg, time, dt, begin, end, out);
+  });
+  const Uint64 steered = SDL_GetTicksNS();
+  stats_.sort_ms = float(sorted - start) / 1e6f;
+  stats_.steer_ms = float(steered - sorted) / 1e6f;
+  stats_.neighbors = float(neighbors.load()) / float(count);
+}
+
+// Stable counting sort of the fish by key in four parallel passes: a
+// histogram per chunk of fish, the keys' totals per block of keys, every
+// chunk's offset for every key, then the scatter.
+void
+Boids::BuildGrid(JobSystem& jobs)
+{
+  PROFILE_ZONE("Boids::BuildGrid");
+  const u32 count = Count();
+  // about two fish per key, a handful per occupied cell
+  const u32 keys = std::bit_ceil(std::max(count / 2, 1024u));
+  // at least 16 x 8 x 8 cells, the ones a fish sees never wrap onto each
+  // other and it can't see the same fish twice
+  const u32 bits = std::countr_zero(keys);
+  key_bits_[0] = (bits + 2) / 3;
+  key_bits_[1] = (bits - key_bits_[0] + 1) / 2;
+  key_bits_[2] = bits - key_bits_[0] - key_bits_[1];
+  chunks_ = std::clamp((count + kSortGrain - 1) / kSortGrain,
+                       1u,
+                       kMaxSortChunks);
+  const u32 chunk_size = (count + chunks_ - 1) / chunks_;
+  keys_.resize(count);
+  order_.resize(count);
+  for (auto& v : sorted_) {
+    v.resize(count + 3); // Gather reads whole steps of 4
+  }
+  histograms_.resize(size_t(chunks_) * keys);
+  cell_start_.resize(keys + 1);
+  block_sums_.resize((keys + kKeyGrain - 1) / kKeyGrain);
+
+  jobs.ParallelFor(chunks_, 1, [&](u32 begin, u32 end) {
+    for (u32 c = begin; c < end; ++c) {
+      u32* histogram = &histograms_[size_t(c) * keys];
+      std::fill_n(histogram, keys, 0u);
+      const u32 last = std::min(count, (c + 1) * chunk_size);
+      for (u32 i = c * chunk_size; i < last; ++i) {
+        const u32 key = CellKey(Cell(pos_x_[i], inv_cell_),
+                                Cell(pos_y_[i], inv_cell_),
+                                Cell(pos_z_[i], inv_cell_),
+                                key_bits_);
+        keys_[i] = key;
+        ++histogram[key];
+      }
+    }
+  });
+
+  // every chunk's count becomes its offset among the key's fish
+  jobs.ParallelFor(keys, kKeyGrain, [&](u32 begin, u32 end) {
+    std::fill(&cell_start_[begin], &cell_start_[end], 0u);
+    for (u32 c = 0; c < chunks_; ++c) {
+      u32* histogram = &histograms_[size_t(c) * keys];
+      for (u32 k = begin; k < end; ++k) {
+        const u32 n = histogram[k];
+        histogram[k] = cell_start_[k];
+        cell_start_[k] += n;
+      }
+    }
+    u32 sum = 0;
+    for (u32 k = begin; k < end; ++k) {
+      sum += cell_start_[k];
+    }
+    block_sums_[begin / kKeyGrain] = sum;
+  });
+  u32 base = 0;
+  for (u32& sum : block_sums_) {
+    base += std::exchange(sum, base);
+  }
+  jobs.ParallelFor(keys, kKeyGrain, [&](u32 begin, u32 end) {
+    u32 offset = block_sums_[begin / kKeyGrain];
+    for (u32 k = begin; k < end; ++k) {
+      offset += std::exchange(cell_start_[k], offset);
+    }
+    for (u32 c = 0; c < chunks_; ++c) {
+      u32* histogram = &histograms_[size_t(c) * keys];
+      for (u32 k = begin; k < end; ++k) {
+        histogram[k] += cell_start_[k];
+      }
+    }
+  });
+  cell_start_[keys] = count;
+
+  jobs.ParallelFor(chunks_, 1, [&](u32 begin, u32 end) {
+    for (u32 c = begin; c < end; ++c) {
+      u32* offsets = &histograms_[size_t(c) * keys];
+      const u32 last = std::min(count, (c + 1) * chunk_size);
+      for (u32 i = c * chunk_size; i < last; ++i) {
+        const u32 at = offsets[keys_[i]]++;
+        order_[at] = i;
+        sorted_[0][at] = pos_x_[i];
+        sorted_[1][at] = pos_y_[i];
+        sorted_[2][at] = pos_z_[i];
+        sorted_[3][at] = vel_x_[i];
+        sorted_[4][at] = vel_y_[i];
+        sorted_[5][at] = vel_z_[i];
+      }
+    }
+  });
+}
+
+// Reads the sorted arrays only, writes the fish's own state: no fish sees
+// another one's new state, whatever the order they're steered in.
+u64
+Boids::Steer(const BoidsCfg& cfg,
+             float time,
+             float dt,
+             u32 begin,
+             u32 end,
+             InstanceData* out)
+{
+  const float radius2 = 1.f / (inv_cell_ * inv_cell_);
+  const float separation2 =
+    std::min(cfg.separation_radius * cfg.separation_radius, radius2);
+  const float margin = std::min(kWallMargin, size_ * .25f);
+  const float lo = origin_ + margin;
+  const float hi = origin_ + size_ - margin;
+  const u32 obstacles = std::min(cfg.obstacles, kMaxObstacles);
+
+  // fish of a cell are next to each other, and share their ranges
+  Range ranges[kMaxRanges];
+  u32 range_count = 0;
+  i32 cell[3]{};
+  bool cached = false;
+  u64 neighbors = 0;
+
+  for (u32 s = begin; s < end; ++s) {
+    const float p[3] = { sorted_[0][s], sorted_[1][s], sorted_[2][s] };
+    const float v[3] = { sorted_[3][s], sorted_[4][s], sorted_[5][s] };
+    const i32 c[3] = { Cell(p[0], inv_cell_),
+                       Cell(p[1], inv_cell_),
+                       Cell(p[2], inv_cell_) };
+    if (!cached || c[0] != cell[0] || c[1] != cell[1] || c[2] != cell[2]) {
+      cached = true;
+      std::copy_n(c, 3, cell);
+      range_count = CellRanges(cell_start_, key_bits_, c, ranges);
+    }
+
+    const BoidsNeighborhood n =
+      Gather(sorted_, ranges, range_count, p, radius2, separation2);
+    neighbors += u64(n.count);
+
+    float a[3]{};
+    if (n.count > 0.f) {
+      const float inv_count = 1.f / n.count;
+      for (u32 axis = 0; axis < 3; ++axis) {
+        a[axis] += cfg.separation * n.separation[axis];
+        a[axis] += cfg.alignment * (n.velocity[axis] * inv_count - v[axis]);
+        a[axis] += cfg.cohesion * n.offset[axis] * inv_count;
+      }
+    }
+    for (u32 axis = 0; axis < 3; ++axis) {
+      if (p[axis] < lo) {
+        a[axis] += cfg.avoidance * (lo - p[axis]) / margin;
+      } else if (p[axis] > hi) {
+        a[axis] -= cfg.avoidance * (p[axis] - hi) / margin;
+      }
+    }
+    for (u32 o = 0; o < obstacles; ++o) {
+      const float d[3] = { p[0] - obstacles_[o][0],
+                           p[1] - obstacles_[o][1],
+                           p[2] - obstacles_[o][2] };
+      const float d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+      const float reach = obstacles_[o][3] + margin;
+      if (d2 >= reach * reach || d2 <= 0.f) {
+        continue;
+      }
+      const float dist = std::sqrt(d2);
+      const float push = cfg.avoidance * (reach - dist) / (margin * dist);
+      for (u32 axis = 0; axis < 3; ++axis) {
+        a[axis] += d[axis] * push;
+      }
+    }
+    const float force = std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    if (force > cfg.max_force) {
+      const float scale = cfg.max_force / force;
+      for (float& axis : a) {
+        axis *= scale;
+      }
+    }
+
+    float nv[3] = { v[0] + a[0] * dt, v[1] + a[1] * dt, v[2] + a[2] * dt };
+    const float speed =
+      std::sqrt(nv[0] * nv[0] + nv[1] * nv[1] + nv[2] * nv[2]);
+    if (speed > 0.f) {
+      const float scale =
+        std::min(std::max(speed, cfg.min_speed), cfg.max_speed) / speed;
+      for (float& axis : nv) {
+        axis *= scale;
+      }
+    } else {
+      nv[2] = cfg.min_speed;
+    }
+
+    const u32 i = order_[s];
+    pos_x_[i] = p[0] + nv[0] * dt;
+    pos_y_[i] = p[1] + nv[1] * dt;
+    pos_z_[i] = p[2] + nv[2] * dt;
+    vel_x_[i] = nv[0];
+    vel_y_[i] = nv[1];
+    vel_z_[i] = nv[2];
+    out[i] = ToInstance({ pos_x_[i], pos_y_[i], pos_z_[i] },
+                        Heading(nv[0], nv[2]),
+                        scale_[i],
+                        phase_[i],
+                        speed_[i],
+                        time);
+  }
+  return neighbors;
+}
+
+InstanceData
+Boids::Instance(float time, u32 n) const
+{
+  if (n >= Count()) {
+    return InstanceData{};
+  }
+  return ToInstance({ pos_x_[n], pos_y_[n], pos_z_[n] },
+                    Heading(vel_x_[n], vel_z_[n]),
+                    scale_[n],
+                    phase_[n],
+                    speed_[n],
+                    time);
+}
+
+BoidState
+Boids::State(u32 n) const
+{
+  return BoidState{
+    .position = { pos_x_[n], pos_y_[n], pos_z_[n] },
+    .velocity = { vel_x_[n], vel_y_[n], vel_z_[n] },
+  };
+}
+
+BoidsNeighborhood
+Boids::Neighbors(const BoidsCfg& cfg, u32 s) const
+{
+  const float radius2 = 1.f / (inv_cell_ * inv_cell_);
+  const float separation2 =
+    std::min(cfg.separation_radius * cfg.separation_radius, radius2);
+  const float p[3] = { sorted_[0][s], sorted_[1][s], sorted_[2][s] };
+  const i32 c[3] = { Cell(p[0], inv_cell_),
+                     Cell(p[1], inv_cell_),
+                     Cell(p[2], inv_cell_) };
+  Range ranges[kMaxRanges];
+  const u32 range_count = CellRanges(cell_start_, key_bits_, c, ranges);
+  return Gather(sorted_, ranges, range_count, p, radius2, separation2);
+}
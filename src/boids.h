@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vector>
+
+#include "src/instances.h"
+#include "src/job_system.h"
+#include "types.h"
+
+struct BoidsCfg
+{
+  u32 count{ 0 };      // fish schooling on top of the grid
+  float radius{ 1.f }; // they see their neighbors within it
+  float separation_radius{ .5f };
+  float separation{ 1.5f }; // steering weights
+  float alignment{ 1.f };
+  float cohesion{ .8f };
+  float avoidance{ 4.f }; // walls and obstacles
+  float min_speed{ 1.f }; // units per second
+  float max_speed{ 4.f };
+  float max_force{ 8.f }; // units per second squared
+  u32 obstacles{ 4 };     // spheres inside the box, at most kMaxObstacles
+
+  bool operator==(const BoidsCfg&) const = default;
+};
+
+struct BoidsStats
+{
+  float sort_ms{ 0.f };   // spatial hash rebuild, last Update
+  float steer_ms{ 0.f };  // steering, integration and render data
+  float neighbors{ 0.f }; // average per fish
+};
+
+// A fish as the next Update reads it
+struct BoidState
+{
+  float position[3];
+  float velocity[3];
+};
+
+// What a fish sees of its neighbors: how many, the sum of their offsets and
+// velocities, and the push away from the closest ones.
+struct BoidsNeighborhood
+{
+  float count{ 0.f };
+  float offset[3]{};
+  float velocity[3]{};
+  float separation[3]{};
+};
+
+// Schooling fish: separation, alignment and cohesion with their neighbors,
+// and avoidance of the box [origin, origin + size] and a few spheres in it.
+//
+// Fish live in arrays over their index. Every Update rebuilds a spatial hash
+// of cells as wide as the neighbor radius: a stable counting sort of the fish
+// by cell, done in parallel over fixed chunks, gathers their positions and
+// velocities so every cell's fish are contiguous. Cells hash to their
+// coordinates wrapped around a grid of as many cells as keys: neighbors along
+// x are consecutive keys and the cells a fish sees come down to a few ranges
+// of the sorted arrays, close to each other, scanned four fish at a time.
+// The sort doesn't depend on the thread count, neither does the result.
+class Boids
+{
+public:
+  static constexpr u32 kMaxObstacles = 8;
+
+  // Spawns new fish or drops the newest ones until there are `count`
+  void Resize(u32 count, float origin, float size);
+  u32 Count() const { return static_cast<u32>(pos_x_.size()); }
+  // Drops them all, the next ones spawn like the first ones did
+  void Clear();
+
+  // Moves every fish by `dt` and writes them to `out`, which must hold
+  // Count() elements, animated at `time`. Work is split across `jobs`.
+  void Update(const BoidsCfg& cfg,
+              float time,
+              float dt,
+              JobSystem& jobs,
+              InstanceData* out);
+  // The `n`th fish as of the last Update
+  InstanceData Instance(float time, u32 n) const;
+  BoidState State(u32 n) const;
+
+  // The spatial hash the last Update steered with: the fish's key by index,
+  // the fish index by sorted position, and where every key's fish start in
+  // the sorted arrays, the count last.
+  const std::vector<u32>& Keys() const { return keys_; }
+  const std::vector<u32>& Order() const { return order_; }
+  const std::vector<u32>& CellStart() const { return cell_start_; }
+  // What the fish at sorted position `s` saw in the last Update
+  BoidsNeighborhood Neighbors(const BoidsCfg& cfg, u32 s) const;
+
+  const BoidsStats& Stats() const { return stats_; }
+
+private:
+  void BuildGrid(JobSystem& jobs);
+  // Steers the fish at sorted positions [begin, end), returns how many
+  // neighbors they saw
+  u64 Steer(const BoidsCfg& cfg,
+            float time,
+            float dt,
+            u32 begin,
+            u32 end,
+            InstanceData* out);
+
+private:
+  float origin_{ 0.f };
+  float size_{ 0.f };
+  u32 spawned_{ 0 }; // ever, seeds the next one
+  BoidsStats stats_{};
+
+  // by fish index
+  std::vector<float> pos_x_, pos_y_, pos_z_;
+  std::vector<float> vel_x_, vel_y_, vel_z_;
+  std::vector<float> scale_, phase_, speed_; // render data, see InstanceData
+
+  // spatial hash, rebuilt by every Update
+  float inv_cell_{ 1.f };
+  u32 key_bits_[3]{};            // cell coordinates wrap around them
+  u32 chunks_{ 0 };              // of the sort
+  std::vector<u32> keys_;        // by fish index
+  std::vector<u32> histograms_;  // chunk * keys + key, then scatter offsets
+  std::vector<u32> cell_start_;  // in the sorted arrays, key count + 1
+  std::vector<u32> block_sums_;  // fish per block of keys
+  std::vector<u32> order_;       // fish index by sorted position
+  std::vector<float> sorted_[6]; // positions then velocities, sorted
+
+  float obstacles_[kMaxObstacles][4]{}; // center and radius
+};
@@ -9,14 +9,31 @@ Camera::Camera(float fov, float aspect, float near, float far, glm::vec3 up)
   , near_{ near }
   , far_{ far }
   , up_{ up }
+{
+  setProjection();
+}
+
+void
+Camera::SetAspect(float aspect)
+{
+  if (aspect == aspect_) {
+    return;
+  }
+  aspect_ = aspect;
+  setProjection();
+  Touched = true; // the frustum changed with it
+}
+
+void
+Camera::setProjection()
 {
   const float tanHalfFovy = tan(fov_ / 2.f);
   proj_ = glm::mat4{ 0.0f };
-  proj_[0][0] = 1.f / (aspect * tanHalfFovy);
+  proj_[0][0] = 1.f / (aspect_ * tanHalfFovy);
   proj_[1][1] = 1.f / (tanHalfFovy);
-  proj_[2][2] = far / (far - near);
+  proj_[2][2] = far_ / (far_ - near_);
   proj_[2][3] = 1.f;
-  proj_[3][2] = -(far * near) / (far - near);
+  proj_[3][2] = -(far_ * near_) / (far_ - near_);
 }
 
 void
@@ -40,6 +57,27 @@ Camera::setViewTarget()
   view_[3][1] = -glm::dot(v, Position);
   view_[3][2] = -glm::dot(w, Position);
 }
+
+void
+Camera::extractFrustum()
+{
+  // Gribb/Hartmann on the rows of viewProj, with a [0, 1] clip depth range
+  const glm::mat4 m = proj_ * view_;
+  auto row = [&](int r) {
+    return glm::vec4{ m[0][r], m[1][r], m[2][r], m[3][r] };
+  };
+  auto& p = frustum_.Planes;
+  p[Frustum::Left] = row(3) + row(0);
+  p[Frustum::Right] = row(3) - row(0);
+  p[Frustum::Bottom] = row(3) + row(1);
+  p[Frustum::Top] = row(3) - row(1);
+  p[Frustum::Near] = row(2);
+  p[Frustum::Far] = row(3) - row(2);
+  for (auto& plane : p) {
+    plane = plane / glm::length(glm::vec3{ plane.x, plane.y, plane.z });
+  }
+}
+
 void
 Camera::Update()
 {
@@ -48,5 +86,6 @@ Camera::Update()
   }
   model_ = glm::translate(glm::mat4{ 1.f }, Position);
   setViewTarget();
+  extractFrustum();
   Touched = false;
 }
@@ -2,6 +2,23 @@
 
 #include <glm/glm.hpp>
 
+// Normalized world space planes of the view volume, normals pointing inwards:
+// a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum
+{
+  enum
+  {
+    Left,
+    Right,
+    Bottom,
+    Top,
+    Near,
+    Far,
+    Count
+  };
+  glm::vec4 Planes[Count];
+};
+
 class Camera
 {
 public:
@@ -15,9 +32,15 @@ public:
   );
   // clang-format on
   void Update();
+  // width / height of the target the camera renders to
+  void SetAspect(float aspect);
+  float Aspect() const { return aspect_; }
+  float Near() const { return near_; }
+  float Far() const { return far_; }
   const glm::mat4& Projection() const { return proj_; }
   const glm::mat4& View() const { return view_; }
   const glm::mat4& Model() const { return model_; }
+  const Frustum& ViewFrustum() const { return frustum_; }
 
 public:
   glm::vec3 Position{ 0.f, 0.f, 4.f };
@@ -28,12 +51,15 @@ private:
   glm::mat4 proj_;
   glm::mat4 view_;
   glm::mat4 model_;
+  Frustum frustum_;
   // TODO: storing these for GUI config
   float fov_;
-  [[maybe_unused]] float aspect_;
-  [[maybe_unused]] float near_;
-  [[maybe_unused]] float far_;
+  float aspect_;
+  float near_;
+  float far_;
   glm::vec3 up_;
 
+  void setProjection();
   void setViewTarget();
+  void extractFrustum();
 };
@@ -0,0 +1,384 @@
+#include "clustered_lighting.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "src/instances.h"
+#include "src/logger.h"
+#include "src/render_stats.h"
+#include "util.h"
+
+namespace {
+
+constexpr u32 kLightGrain = 64;
+constexpr u32 kMinCapacity = 64;
+
+// Squared distance from `p` to the box [lo, hi]
+float
+DistanceSq(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& hi)
+{
+  const glm::vec3 d = glm::max(glm::max(lo - p, p - hi), glm::vec3{ 0.f });
+  return glm::dot(d, d);
+}
+
+// Grows `buffer` to hold `count` elements of `stride` bytes, true if it did.
+bool
+Grow(SDL_GPUDevice* device,
+     SDL_GPUBuffer*& buffer,
+     u32& capacity,
+     u32 count,
+     u32 stride)
+{
+  if (count <= capacity && buffer != nullptr) {
+    return false;
+  }
+  auto* Device = device;
+  RELEASE_IF(buffer, SDL_ReleaseGPUBuffer);
+  capacity = std::max(std::bit_ceil(std::max(count, 1u)), kMinCapacity);
+  SDL_GPUBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
+    info.size = capacity * stride;
+  }
+  buffer = SDL_CreateGPUBuffer(device, &info);
+  return true;
+}
+
+} // namespace
+
+ClusteredLighting::ClusteredLighting(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+  RenderStats::Allocated(GpuMemory::Lighting, -tracked_bytes_);
+  RenderStats::Allocated(GpuMemory::Staging, -tracked_bytes_);
+  auto* Device = device_;
+  RELEASE_IF(lights_buffer_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(clusters_buffer_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(indices_buffer_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(transfer_, SDL_ReleaseGPUTransferBuffer);
+}
+
+u32
+ClusteredLighting::Slice(float depth) const
+{
+  if (depth <= cfg_.near) {
+    return 0;
+  }
+  const float scale =
+    static_cast<float>(cfg_.slices) / std::log(cfg_.far / cfg_.near);
+  const auto slice = static_cast<u32>(std::log(depth / cfg_.near) * scale);
+  return std::min(slice, cfg_.slices - 1);
+}
+
+float
+ClusteredLighting::SliceDepth(u32 slice) const
+{
+  return cfg_.near *
+         std::pow(cfg_.far / cfg_.near,
+                  static_cast<float>(slice) / static_cast<float>(cfg_.slices));
+}
+
+void
+ClusteredLighting::BoundLight(u32 index,
+                              const glm::mat4& view,
+                              const glm::mat4& proj)
+{
+  const PointLight& light = lights_[index];
+  LightBounds& b = bounds_[index];
+  b.center = glm::vec3{ view * glm::vec4{ glm::vec3{ light.position_radius },
+                                          1.f } };
+  b.radius = light.position_radius.w;
+  b.visible = b.center.z + b.radius >= cfg_.near &&
+              b.center.z - b.radius <= cfg_.far;
+  if (!b.visible) {
+    return;
+  }
+  b.s0 = Slice(b.center.z - b.radius);
+  b.s1 = Slice(b.center.z + b.radius);
+  b.x0 = 0;
+  b.y0 = 0;
+  b.x1 = cfg_.tiles_x - 1;
+  b.y1 = cfg_.tiles_y - 1;
+  if (b.center.z - b.radius <= cfg_.near) {
+    return; // crosses the near plane, can cover any tile
+  }
+
+  // screen rect of the sphere's box, every corner is in front of the camera
+  glm::vec2 lo{ 1e30f };
+  glm::vec2 hi{ -1e30f };
+  for (u32 c = 0; c < 8; ++c) {
+    const glm::vec3 corner =
+      b.center + b.radius * glm::vec3{ c & 1 ? 1.f : -1.f,
+                                       c & 2 ? 1.f : -1.f,
+                                       c & 4 ? 1.f : -1.f };
+    const glm::vec4 clip = proj * glm::vec4{ corner, 1.f };
+    const glm::vec2 ndc{ clip.x / clip.w, clip.y / clip.w };
+    lo = glm::min(lo, ndc);
+    hi = glm::max(hi, ndc);
+  }
+  if (lo.x > 1.f || hi.x < -1.f || lo.y > 1.f || hi.y < -1.f) {
+    b.visible = false;
+    return;
+  }
+  // tile rows go down the screen, ndc y goes up
+  auto tile = [](float t, u32 tiles) {
+    return static_cast<u32>(
+      std::clamp(t * static_cast<float>(tiles), 0.f, float(tiles - 1)));
+  };
+  b.x0 = tile((lo.x + 1.f) * .5f, cfg_.tiles_x);
+  b.x1 = tile((hi.x + 1.f) * .5f, cfg_.tiles_x);
+  b.y0 = tile((1.f - hi.y) * .5f, cfg_.tiles_y);
+  b.y1 = tile((1.f - lo.y) * .5f, cfg_.tiles_y);
+}
+
+void
+ClusteredLighting::BinSlice(u32 slice, const glm::mat4& proj)
+{
+  auto& out = slice_indices_[slice];
+  out.clear();
+
+  std::vector<u32> candidates;
+  for (u32 i = 0; i < bounds_.size(); ++i) {
+    const auto& b = bounds_[i];
+    if (b.visible && b.s0 <= slice && slice <= b.s1) {
+      candidates.push_back(i);
+    }
+  }
+
+  // View space box of every froxel of the slice. Tile edges are planes
+  // through the eye, so their extent comes from the slice's near and far ends.
+  const float z0 = SliceDepth(slice);
+  const float z1 = SliceDepth(slice + 1);
+  auto extent = [&](float ndc_a, float ndc_b, float focal, float& lo,
+                    float& hi) {
+    const float v[4]{ ndc_a * z0, ndc_a * z1, ndc_b * z0, ndc_b * z1 };
+    lo = *std::min_element(v, v + 4) / focal;
+    hi = *std::max_element(v, v + 4) / focal;
+  };
+
+  const u32 first = slice * cfg_.tiles_x * cfg_.tiles_y;
+  for (u32 y = 0; y < cfg_.tiles_y; ++y) {
+    glm::vec3 lo;
+    glm::vec3 hi;
+    const float ndc_top = 1.f - 2.f * float(y) / float(cfg_.tiles_y);
+    const float ndc_bottom = 1.f - 2.f * float(y + 1) / float(cfg_.tiles_y);
+    extent(ndc_bottom, ndc_top, proj[1][1], lo.y, hi.y);
+    lo.z = z0;
+    hi.z = z1;
+    for (u32 x = 0; x < cfg_.tiles_x; ++x) {
+      const float ndc_left = 2.f * float(x) / float(cfg_.tiles_x) - 1.f;
+      const float ndc_right = 2.f * float(x + 1) / float(cfg_.tiles_x) - 1.f;
+      extent(ndc_left, ndc_right, proj[0][0], lo.x, hi.x);
+
+      ClusterRange& range = clusters_[first + y * cfg_.tiles_x + x];
+      range.offset = static_cast<u32>(out.size()); // relative to the slice
+      for (u32 i : candidates) {
+        const auto& b = bounds_[i];
+        if (x < b.x0 || x > b.x1 || y < b.y0 || y > b.y1) {
+          continue;
+        }
+        if (DistanceSq(b.center, lo, hi) <= b.radius * b.radius) {
+          out.push_back(i);
+        }
+      }
+      range.count = static_cast<u32>(out.size()) - range.offset;
+    }
+  }
+}
+
+void
+ClusteredLighting::Build(const ClusterGridCfg& cfg,
+                         const glm::mat4& view,
+                         const glm::mat4& proj,
+                         std::span<const PointLight> lights,
+                         JobSystem& jobs)
+{
+  cfg_ = cfg;
+  cfg_.tiles_x = std::max(cfg_.tiles_x, 1u);
+  cfg_.tiles_y = std::max(cfg_.tiles_y, 1u);
+  cfg_.slices = std::max(cfg_.slices, 1u);
+  const u32 count = static_cast<u32>(lights.size());
+  lights_.assign(lights.begin(), lights.end());
+  bounds_.resize(count);
+  clusters_.resize(cfg_.tiles_x * cfg_.tiles_y * cfg_.slices);
+  slice_indices_.resize(cfg_.slices);
+
+  jobs.ParallelFor(count, kLightGrain, [&](u32 begin, u32 end) {
+    for (u32 i = begin; i < end; ++i) {
+      BoundLight(i, view, proj);
+    }
+  });
+  jobs.ParallelFor(cfg_.slices, 1, [&](u32 begin, u32 end) {
+    for (u32 s = begin; s < end; ++s) {
+      BinSlice(s, proj);
+    }
+  });
+
+  // stitch the per slice lists together
+  stats_ = ClusterStats{};
+  indices_.clear();
+  const u32 per_slice = cfg_.tiles_x * cfg_.tiles_y;
+  for (u32 s = 0; s < cfg_.slices; ++s) {
+    const u32 base = static_cast<u32>(indices_.size());
+    for (u32 c = s * per_slice; c < (s + 1) * per_slice; ++c) {
+      clusters_[c].offset += base;
+      stats_.max_lights = std::max(stats_.max_lights, clusters_[c].count);
+    }
+    indices_.insert(
+      indices_.end(), slice_indices_[s].begin(), slice_indices_[s].end());
+  }
+  stats_.references = static_cast<u32>(indices_.size());
+  stats_.lights = static_cast<u32>(
+    std::count_if(bounds_.begin(), bounds_.end(), [](const LightBounds& b) {
+      return b.visible;
+    }));
+}
+
+std::span<const u32>
+ClusteredLighting::ClusterLights(u32 x, u32 y, u32 slice) const
+{
+  const auto& range =
+    clusters_[(slice * cfg_.tiles_y + y) * cfg_.tiles_x + x];
+  return { indices_.data() + range.offset, range.count };
+}
+
+ClusterUniforms
+ClusteredLighting::Uniforms(float viewport_w,
+                            float viewport_h,
+                            const LightingCfg& cfg) const
+{
+  ClusterUniforms u{};
+  u.grid[0] = static_cast<float>(cfg_.tiles_x);
+  u.grid[1] = static_cast<float>(cfg_.tiles_y);
+  u.grid[2] = static_cast<float>(cfg_.slices);
+  u.grid[3] = cfg.enabled ? 1.f : 0.f;
+  u.depth[0] = cfg_.near;
+  u.depth[1] =
+    static_cast<float>(cfg_.slices) / std::log(cfg_.far / cfg_.near);
+  u.depth[2] = viewport_w;
+  u.depth[3] = viewport_h;
+  // slightly blue, the scene is underwater
+  u.ambient[0] = cfg.ambient * .7f;
+  u.ambient[1] = cfg.ambient * .9f;
+  u.ambient[2] = cfg.ambient;
+  return u;
+}
+
+bool
+ClusteredLighting::Reserve()
+{
+  const u32 lights = static_cast<u32>(lights_.size());
+  const u32 clusters = static_cast<u32>(clusters_.size());
+  const u32 indices = static_cast<u32>(indices_.size());
+  bool grown = Grow(
+    device_, lights_buffer_, light_capacity_, lights, sizeof(PointLight));
+  grown |= Grow(device_,
+                clusters_buffer_,
+                cluster_capacity_,
+                clusters,
+                sizeof(ClusterRange));
+  grown |=
+    Grow(device_, indices_buffer_, index_capacity_, indices, sizeof(u32));
+  if (grown || transfer_ == nullptr) {
+    auto* Device = device_;
+    RELEASE_IF(transfer_, SDL_ReleaseGPUTransferBuffer);
+    SDL_GPUTransferBufferCreateInfo info{};
+    {
+      info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+      info.size = light_capacity_ * sizeof(PointLight) +
+                  cluster_capacity_ * sizeof(ClusterRange) +
+                  index_capacity_ * sizeof(u32);
+    }
+    transfer_ = SDL_CreateGPUTransferBuffer(device_, &info);
+  }
+  const bool ok =
+    lights_buffer_ && clusters_buffer_ && indices_buffer_ && transfer_;
+  if (!ok) {
+    LOG_ERROR("Couldn't create light cluster buffers: {}", GETERR);
+    light_capacity_ = cluster_capacity_ = index_capacity_ = 0;
+  }
+  // the transfer buffer mirrors the three storage buffers
+  const i64 bytes = i64(light_capacity_) * i64(sizeof(PointLight)) +
+                    i64(cluster_capacity_) * i64(sizeof(ClusterRange)) +
+                    i64(index_capacity_) * i64(sizeof(u32));
+  RenderStats::Allocated(GpuMemory::Lighting, bytes - tracked_bytes_);
+  RenderStats::Allocated(GpuMemory::Staging, bytes - tracked_bytes_);
+  tracked_bytes_ = bytes;
+  return ok;
+}
+
+bool
+ClusteredLighting::Upload(SDL_GPUCopyPass* pass)
+{
+  if (!Reserve()) {
+    return false;
+  }
+  // cycle: the previous frame may still be reading the old lists
+  auto* dst =
+    static_cast<u8*>(SDL_MapGPUTransferBuffer(device_, transfer_, true));
+  if (dst == nullptr) {
+    LOG_ERROR("Couldn't map light transfer buffer: {}", GETERR);
+    return false;
+  }
+  const u32 light_bytes = static_cast<u32>(lights_.size() * sizeof(PointLight));
+  const u32 cluster_bytes =
+    static_cast<u32>(clusters_.size() * sizeof(ClusterRange));
+  const u32 index_bytes = static_cast<u32>(indices_.size() * sizeof(u32));
+  const u32 cluster_offset = light_capacity_ * sizeof(PointLight);
+  const u32 index_offset =
+    cluster_offset + cluster_capacity_ * sizeof(ClusterRange);
+  std::memcpy(dst, lights_.data(), light_bytes);
+  std::memcpy(dst + cluster_offset, clusters_.data(), cluster_bytes);
+  std::memcpy(dst + index_offset, indices_.data(), index_bytes);
+  SDL_UnmapGPUTransferBuffer(device_, transfer_);
+
+  auto upload = [&](SDL_GPUBuffer* buffer, u32 offset, u32 size) {
+    if (size == 0) {
+      return; // nothing reads it, counts are 0
+    }
+    SDL_GPUTransferBufferLocation trLoc{ transfer_, offset };
+    SDL_GPUBufferRegion reg{ buffer, 0, size };
+    SDL_UploadToGPUBuffer(pass, &trLoc, &reg, true);
+  };
+  upload(lights_buffer_, 0, light_bytes);
+  upload(clusters_buffer_, cluster_offset, cluster_bytes);
+  upload(indices_buffer_, index_offset, index_bytes);
+  RenderStats::Add(Counter::UploadBytes,
+                   light_bytes + cluster_bytes + index_bytes);
+  return true;
+}
+
+void
+AnimateLights(const LightingCfg& cfg,
+              float origin,
+              float size,
+              float time,
+              std::vector<PointLight>& out)
+{
+  static const glm::vec3 kPalette[] = {
+    { .2f, .9f, .8f },  // teal
+    { .2f, .5f, 1.f },  // sea blue
+    { 1.f, .85f, .5f }, // sunlit
+    { .4f, 1.f, .5f },  // algae
+  };
+  out.resize(cfg.light_count);
+  const float drift = std::max(size * .08f, 1.f);
+  for (u32 i = 0; i < cfg.light_count; ++i) {
+    const glm::vec3 base{ Hash01(i * 4 + 0), Hash01(i * 4 + 1),
+                          Hash01(i * 4 + 2) };
+    const float phase = Hash01(i * 4 + 3) * kTwoPi;
+    const float speed = .3f + Hash01(i ^ 0x9e3779b9U) * .4f;
+    const glm::vec3 offset{ std::sin(time * speed + phase),
+                            std::sin(time * speed * .7f + phase * 1.7f),
+                            std::cos(time * speed * .9f + phase) };
+    const glm::vec3 pos = glm::vec3{ origin } + base * size + offset * drift;
+    out[i].position_radius = glm::vec4{ pos, cfg.radius };
+    out[i].color = glm::vec4{ kPalette[i % 4], cfg.intensity };
+  }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+#include "src/job_system.h"
+#include "types.h"
+
+// Layout of one light in the storage buffer read by frag.frag (std430).
+struct PointLight
+{
+  glm::vec4 position_radius; // world space position, falloff radius
+  glm::vec4 color;           // rgb, intensity
+};
+static_assert(sizeof(PointLight) == 32, "must match frag.frag");
+
+struct LightingCfg
+{
+  bool enabled{ true };
+  u32 light_count{ 256 };
+  float radius{ 6.f };
+  float intensity{ 2.f };
+  float ambient{ .15f };
+
+  bool operator==(const LightingCfg&) const = default;
+};
+
+// Froxel grid: screen tiles times depth slices, spaced logarithmically
+// between near and far so froxels stay roughly cubic.
+struct ClusterGridCfg
+{
+  u32 tiles_x{ 16 };
+  u32 tiles_y{ 9 };
+  u32 slices{ 24 };
+  float near{ .1f };
+  float far{ 100.f };
+};
+
+// frag.frag's lighting uniform block (std140)
+struct ClusterUniforms
+{
+  float grid[4];    // tiles x, tiles y, slices, lighting on (0 or 1)
+  float depth[4];   // near, slices / log(far / near), viewport w, viewport h
+  float ambient[4]; // rgb, unused
+};
+
+struct ClusterStats
+{
+  u32 lights{ 0 };     // touching the view volume
+  u32 references{ 0 }; // light indices over every cluster
+  u32 max_lights{ 0 }; // in a single cluster
+};
+
+// Clustered forward lighting, CPU side binning.
+//
+// Build() assigns every light to the froxels its sphere touches, a slice per
+// job, and Upload() sends the lights, one {offset, count} range per cluster
+// and the light index lists they point into. frag.frag finds its cluster from
+// gl_FragCoord and view depth and only loops over that cluster's lights, so
+// shading cost follows the local light density rather than the light count.
+class ClusteredLighting
+{
+public:
+  explicit ClusteredLighting(SDL_GPUDevice* device);
+  ~ClusteredLighting();
+
+  ClusteredLighting(const ClusteredLighting&) = delete;
+  ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+  // Like Camera's: `view` looks down +z and `proj` is a symmetric
+  // perspective with clip w = view depth.
+  void Build(const ClusterGridCfg& cfg,
+             const glm::mat4& view,
+             const glm::mat4& proj,
+             std::span<const PointLight> lights,
+             JobSystem& jobs);
+  // Grows the GPU buffers to what Build() produced, Upload() does it too.
+  // Call it first when the buffers are bound while Upload() is recorded.
+  bool Reserve();
+  bool Upload(SDL_GPUCopyPass* pass);
+
+  ClusterUniforms Uniforms(float viewport_w,
+                           float viewport_h,
+                           const LightingCfg& cfg) const;
+  // Indices of the lights binned into a cluster, for debugging.
+  std::span<const u32> ClusterLights(u32 x, u32 y, u32 slice) const;
+
+  SDL_GPUBuffer* Lights() const { return lights_buffer_; }
+  SDL_GPUBuffer* Clusters() const { return clusters_buffer_; }
+  SDL_GPUBuffer* Indices() const { return indices_buffer_; }
+  const ClusterStats& Stats() const { return stats_; }
+
+private:
+  struct ClusterRange
+  {
+    u32 offset;
+    u32 count;
+  };
+
+  // A light in view space, with the froxels it may touch
+  struct LightBounds
+  {
+    glm::vec3 center;
+    float radius;
+    u32 x0, x1, y0, y1, s0, s1; // inclusive
+    bool visible;
+  };
+
+  void BoundLight(u32 index, const glm::mat4& view, const glm::mat4& proj);
+  void BinSlice(u32 slice, const glm::mat4& proj);
+  u32 Slice(float depth) const;
+  float SliceDepth(u32 slice) const;
+
+private:
+  SDL_GPUDevice* device_{};
+  ClusterGridCfg cfg_{};
+  ClusterStats stats_{};
+
+  std::vector<PointLight> lights_;
+  std::vector<LightBounds> bounds_;
+  std::vector<ClusterRange> clusters_;
+  std::vector<u32> indices_;
+  std::vector<std::vector<u32>> slice_indices_; // filled by one job each
+
+  SDL_GPUBuffer* lights_buffer_{ nullptr };
+  SDL_GPUBuffer* clusters_buffer_{ nullptr };
+  SDL_GPUBuffer* indices_buffer_{ nullptr };
+  SDL_GPUTransferBuffer* transfer_{ nullptr };
+  u32 light_capacity_{ 0 };
+  u32 cluster_capacity_{ 0 };
+  u32 index_capacity_{ 0 };
+  i64 tracked_bytes_{ 0 }; // reported to RenderStats
+};
+
+// Lights drifting through the cube [origin, origin + size] on every axis,
+// in underwater colors. Deterministic for a given count and time.
+void
+AnimateLights(const LightingCfg& cfg,
+              float origin,
+              float size,
+              float time,
+              std::vector<PointLight>& out);
@@ -0,0 +1,86 @@
+#include "command_recorder.h"
+
+#include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_timer.h>
+#include <thread>
+
+#include "src/logger.h"
+#include "src/profiler.h"
+#include "util.h"
+
+CommandRecorder::CommandRecorder(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+void
+CommandRecorder::Clear()
+{
+  records_.clear();
+  passes_.clear();
+  serial_ = 0;
+}
+
+void
+CommandRecorder::Add(const char* name, RecordFn record)
+{
+  records_.push_back(std::move(record));
+  passes_.push_back({ name, 0.f });
+}
+
+void
+CommandRecorder::AddSerial(const char* name, RecordFn record)
+{
+  SDL_assert(serial_ == records_.size());
+  Add(name, std::move(record));
+  ++serial_;
+}
+
+void
+CommandRecorder::Record(u32 index)
+{
+  PROFILE_ZONE(passes_[index].name);
+  const Uint64 start = SDL_GetTicksNS();
+  bool ok = true;
+  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
+  if (cmdbuf == nullptr) {
+    LOG_ERROR("Couldn't acquire command buffer for {}: {}",
+              passes_[index].name,
+              GETERR);
+    ok = false;
+  } else {
+    ok = records_[index](cmdbuf);
+  }
+  passes_[index].record_ms = float(SDL_GetTicksNS() - start) / 1e6f;
+
+  // Jobs start in order, the one we wait on is already running
+  while (next_submit_.load(std::memory_order_acquire) != index) {
+    std::this_thread::yield();
+  }
+  if (cmdbuf != nullptr && !SDL_SubmitGPUCommandBuffer(cmdbuf)) {
+    LOG_ERROR("Couldn't submit command buffer for {}: {}",
+              passes_[index].name,
+              GETERR);
+    ok = false;
+  }
+  if (!ok) {
+    failed_.store(true, std::memory_order_relaxed);
+  }
+  next_submit_.store(index + 1, std::memory_order_release);
+}
+
+bool
+CommandRecorder::Run(JobSystem& jobs, const std::function<void()>& local)
+{
+  next_submit_ = 0;
+  failed_ = false;
+  for (u32 i = 0; i < serial_; ++i) {
+    Record(i);
+  }
+  jobs_.resize(records_.size() - serial_);
+  for (u32 i = 0; i < jobs_.size(); ++i) {
+    jobs_[i] = [this, i] { Record(serial_ + i); };
+  }
+  jobs.Run(jobs_, local);
+  return !failed_.load();
+}
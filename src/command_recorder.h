@@ -0,0 +1,64 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <atomic>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "src/job_system.h"
+#include "types.h"
+
+struct RecordedPass
+{
+  const char* name;
+  float record_ms; // acquire and record, not the wait to submit
+};
+
+// Records a frame's command buffers on the job system, one job per command
+// buffer, and submits them in the order they were added whatever order the
+// jobs finish in.
+//
+// SDL wants a command buffer used on the thread that acquired it only, so
+// every job acquires, records and submits its own; a job that finishes early
+// waits for the ones added before it to be submitted.
+//
+// SDL picks which buffer or texture a cycled resource stands for when it's
+// cycled or bound, unsynchronized: command buffers that cycle what the others
+// bind go through AddSerial, recorded on the calling thread before any job.
+class CommandRecorder
+{
+public:
+  // Fills `cmdbuf`, false on errors. The command buffer is submitted anyway.
+  using RecordFn = std::function<bool(SDL_GPUCommandBuffer* cmdbuf)>;
+
+  explicit CommandRecorder(SDL_GPUDevice* device);
+
+  CommandRecorder(const CommandRecorder&) = delete;
+  CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+  void Clear();
+  // `name` must outlive the frame, it's shown in stats
+  void Add(const char* name, RecordFn record);
+  // Recorded and submitted before everything added with Add, in order, on
+  // the calling thread. They must all come before the first Add.
+  void AddSerial(const char* name, RecordFn record);
+
+  // Records and submits everything added since Clear(). `local` runs on the
+  // calling thread meanwhile, for work tied to it. False if any failed.
+  bool Run(JobSystem& jobs, const std::function<void()>& local = {});
+
+  std::span<const RecordedPass> Passes() const { return passes_; }
+
+private:
+  void Record(u32 index);
+
+private:
+  SDL_GPUDevice* device_{};
+  std::vector<RecordFn> records_;
+  std::vector<RecordedPass> passes_;
+  std::vector<std::function<void()>> jobs_;
+  u32 serial_{ 0 }; // the first ones, see AddSerial
+  std::atomic<u32> next_submit_{ 0 };
+  std::atomic<bool> failed_{ false };
+};
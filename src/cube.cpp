@@ -12,13 +12,41 @@
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/ext/matrix_transform.hpp>
+#include <algorithm>
 #include <glm/gtc/constants.hpp>
 #include <vector>
 
 #include "src/camera.h"
 #include "src/logger.h"
+#include "src/math_kernels.h"
+#include "src/profiler.h"
+#include "src/profiler_gui.h"
+#include "src/render_stats.h"
+#include "src/render_stats_gui.h"
 #include "util.h"
 
+namespace {
+
+void
+CountDraws(const RenderQueueStats& stats)
+{
+  RenderStats::Add(Counter::Draws, stats.draws);
+  RenderStats::Add(Counter::IndirectDraws, stats.indirect);
+  RenderStats::Add(Counter::Triangles, stats.triangles);
+  RenderStats::Add(Counter::PipelineBinds, stats.pipelines);
+  RenderStats::Add(Counter::Binds, stats.binds);
+  RenderStats::Add(Counter::ElidedBinds, stats.elided);
+}
+
+// RGBA8 color and D16 depth
+i64
+SceneTargetBytes(int width, int height)
+{
+  return i64(width) * i64(height) * (4 + 2);
+}
+
+} // namespace
+
 CubeProgram::CubeProgram(SDL_GPUDevice* device,
                          SDL_Window* window,
                          const char* vertex_path,
@@ -57,60 +85,84 @@ CubeProgram::CubeProgram(SDL_GPUDevice* device,
   }
 
   {
-    rotations_[0] = Rotation{
-      "X Axis",
-      &cube_transform_.rotation_.x,
-      0.f,
-    };
-    rotations_[1] = Rotation{
-      "Y Axis",
-      &cube_transform_.rotation_.y,
-      1.f,
-    };
-    rotations_[2] = Rotation{
-      "Z Axis",
-      &cube_transform_.rotation_.z,
-      0.f,
-    };
+    rotations_[0] = Rotation{ "X Axis", 0.f };
+    rotations_[1] = Rotation{ "Y Axis", 1.f };
+    rotations_[2] = Rotation{ "Z Axis", 0.f };
   }
 }
 
 CubeProgram::~CubeProgram()
 {
   LOG_TRACE("Destroying app");
+  replay_writer_.Close();
+  capture_.Stop();
 
-  RELEASE_IF(vertex_, SDL_ReleaseGPUShader);
-  RELEASE_IF(fragment_, SDL_ReleaseGPUShader);
-  RELEASE_IF(scene_pipeline_, SDL_ReleaseGPUGraphicsPipeline);
-  RELEASE_IF(scene_wireframe_pipeline_, SDL_ReleaseGPUGraphicsPipeline);
+  if (depth_target_ != nullptr && color_target_ != nullptr) {
+    RenderStats::Allocated(GpuMemory::RenderTargets,
+                           -SceneTargetBytes(target_width_, target_height_));
+  }
+  RenderStats::Allocated(GpuMemory::Geometry, -geometry_bytes_);
   RELEASE_IF(depth_target_, SDL_ReleaseGPUTexture);
   RELEASE_IF(color_target_, SDL_ReleaseGPUTexture);
   RELEASE_IF(vbuffer_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(pbuffer_, SDL_ReleaseGPUBuffer);
   RELEASE_IF(ibuffer_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(frame_fence_, SDL_ReleaseGPUFence);
 
   LOG_DEBUG("Released GPU Resources");
 
   SDL_WaitForGPUIdle(Device);
-  ImGui_ImplSDL3_Shutdown();
-  ImGui_ImplSDLGPU3_Shutdown();
-  ImGui::DestroyContext();
+  if (!Headless()) {
+    ImGui_ImplSDL3_Shutdown();
+    ImGui_ImplSDLGPU3_Shutdown();
+    ImGui::DestroyContext();
+  }
 }
 
 bool
 CubeProgram::Init()
 {
   LOG_TRACE("CubeProgram::Init");
-  if (!InitGui()) {
-    LOG_ERROR("Couldn't init imgui");
-    return false;
+  if (Headless()) {
+    LOG_INFO("No window, running headless");
+  } else {
+    if (!pacer_.Apply(pacing_cfg_)) {
+      LOG_WARN("Using the default present mode and frames in flight");
+    }
+    if (!InitGui()) {
+      LOG_ERROR("Couldn't init imgui");
+      return false;
+    }
+    LOG_DEBUG("Started ImGui");
   }
-  LOG_DEBUG("Started ImGui");
   SDL_GPUShaderFormat backendFormats = SDL_GetGPUShaderFormats(Device);
   if (!(backendFormats & SDL_GPU_SHADERFORMAT_SPIRV)) {
     LOG_ERROR("Backend doesn't support SPRIR-V");
     return false;
   }
 
+  if (!loader.Load()) {
+    LOG_CRITICAL("Couldn't initialize GLTF loader");
+    return false;
+  }
+  LOG_INFO("Loaded {} meshes", loader.Meshes().size());
+  assert(!loader.Meshes().empty());
+
+  if (!skinning_.Init(loader, skin_compute_path_, jobs_)) {
+    LOG_ERROR("Couldn't set up skinning");
+    return false;
+  }
+  if (skinning_.Active()) {
+    // every scene pipeline reads its positions from the skinned poses
+    vertex_path_ = "resources/shaders/compiled/vert_skinned.vert.spv";
+    gpu_cull_vertex_path_ =
+      "resources/shaders/compiled/vert_gpu_cull_skinned.vert.spv";
+    depth_vertex_path_ =
+      "resources/shaders/compiled/vert_depth_skinned.vert.spv";
+    depth_gpu_cull_vertex_path_ =
+      "resources/shaders/compiled/vert_depth_gpu_cull_skinned.vert.spv";
+  }
+
   if (!LoadShaders()) {
     LOG_ERROR("Couldn't load shaders");
     return false;
@@ -118,7 +170,7 @@ CubeProgram::Init()
   LOG_DEBUG("Loaded shaders");
 
   SDL_GPUColorTargetDescription color_descs[1]{};
-  color_descs[0].format = SDL_GetGPUSwapchainTextureFormat(Device, Window);
+  color_descs[0].format = kSceneColorFormat;
 
   SDL_GPUVertexAttribute vertex_attributes[] = {
     { .location = 0,
@@ -167,31 +219,30 @@ CubeProgram::Init()
       auto& info = pipelineCreateInfo.target_info;
       info.color_target_descriptions = color_descs;
       info.num_color_targets = 1;
-      info.depth_stencil_format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
+      info.depth_stencil_format = kSceneDepthFormat;
       info.has_depth_stencil_target = true;
     }
   }
 
-  scene_pipeline_ = SDL_CreateGPUGraphicsPipeline(Device, &pipelineCreateInfo);
-  if (scene_pipeline_ == NULL) {
+  // the only pipeline built up front, it's every scene variant's fallback
+  scene_pipeline_ = pipelines_.Compile(pipelineCreateInfo);
+  if (pipelines_.Get(scene_pipeline_) == NULL) {
     LOG_ERROR("Couldn't create pipeline!");
     return false;
   }
   pipelineCreateInfo.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_LINE;
   scene_wireframe_pipeline_ =
-    SDL_CreateGPUGraphicsPipeline(Device, &pipelineCreateInfo);
-  if (scene_wireframe_pipeline_ == NULL) {
-    LOG_ERROR("Couldn't create wireframe pipeline!");
-    return false;
-  }
+    pipelines_.Request(pipelineCreateInfo, scene_pipeline_);
+  pipelineCreateInfo.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
   LOG_DEBUG("Created pipelines");
 
-  if (!loader.Load()) {
-    LOG_CRITICAL("Couldn't initialize GLTF loader");
-    return false;
+  gpu_culling_available_ = CreateGpuCullingPipelines(pipelineCreateInfo);
+  if (!gpu_culling_available_) {
+    LOG_WARN("GPU culling unavailable, falling back to CPU culling");
+  }
+  if (!CreateDepthPrepassPipelines(pipelineCreateInfo)) {
+    LOG_WARN("Depth prepass unavailable");
   }
-  LOG_INFO("Loaded {} meshes", loader.Meshes().size());
-  assert(!loader.Meshes().empty());
 
   if (!SendVertexData()) {
     LOG_ERROR("Couldn't send vertex data!");
@@ -214,9 +265,15 @@ CubeProgram::Init()
   cube_transform_.translation_ = { 0.f, 0.f, 0.0f };
   cube_transform_.scale_ = { 12.f, 12.f, 12.f };
 
-  camera_.Position = glm::vec3{ 0.f, 1.f, -4.f };
-  camera_.Target = glm::vec3{ 0.f, 0.f, 0.f };
+  camera_.SetAspect(float(vp_width_) / float(vp_height_));
+  sim_input_.camera_position = glm::vec3{ 0.f, 1.f, -4.f };
+  sim_input_.camera_target = glm::vec3{ 0.f, 0.f, 0.f };
+  sim_.Reset(SceneState{ 0.,
+                         cube_transform_.rotation_,
+                         sim_input_.camera_position,
+                         sim_input_.camera_target });
 
+  LOG_INFO("Math kernels use {}", MathKernels::Name(MathKernels::Level()));
   LOG_INFO("Initialized application");
   return true;
 }
@@ -230,10 +287,17 @@ CubeProgram::ShouldQuit()
 bool
 CubeProgram::Poll()
 {
+  PROFILE_ZONE("Poll");
   SDL_Event evt;
 
   while (SDL_PollEvent(&evt)) {
-    ImGui_ImplSDL3_ProcessEvent(&evt);
+    // a replay drives the GUI with the recorded input instead
+    if (!replay_reader_.IsOpen()) {
+      ImGui_ImplSDL3_ProcessEvent(&evt);
+    }
+    if (replay_writer_.IsOpen()) {
+      polled_events_.push_back(evt);
+    }
     if (evt.type == SDL_EVENT_QUIT) {
       quit = true;
     } else if (evt.type == SDL_EVENT_KEY_DOWN) {
@@ -245,109 +309,779 @@ CubeProgram::Poll()
   return true;
 }
 
+// Hands the GUI's settings to the simulation and takes the scene it moved.
+// Threaded, a tick behind the clock so there are two ticks to interpolate.
 void
 CubeProgram::UpdateScene()
 {
-  // static float c = -1.f;
-
-  for (const auto& rot : rotations_) {
-    if (rot.speed != 0.f) {
-      *rot.axis =
-        glm::mod(*rot.axis + DeltaTime * rot.speed, glm::two_pi<float>());
-    }
+  PROFILE_ZONE("UpdateScene");
+  for (u32 i = 0; i < 3; ++i) {
+    sim_input_.rotation_speeds[i] = rotations_[i].speed;
+  }
+  sim_.SetInput(sim_input_);
+  SceneState state;
+  if (sim_.Running()) {
+    state = sim_.Sample(lastTime - 1. / double(sim_.Rate()));
+  } else {
+    sim_.Advance(lastTime, DeltaTime);
+    state = sim_.Sample(lastTime);
   }
+  // instances and lights animate at the same moment as the cube
+  lastTime = state.time;
 
-  // if (camera_.Position.z < -10.f) {
-  //   c = 1.f;
-  // } else if (camera_.Position.z > -1.f) {
-  //   c = -1.f;
-  // }
-  // camera_.Position.z += c * DeltaTime * 2.5f;
-  // camera_.Touched = true;
+  cube_transform_.rotation_ = state.rotation;
   cube_transform_.Touched = true;
+  if (camera_.Position != state.camera_position ||
+      camera_.Target != state.camera_target) {
+    camera_.Position = state.camera_position;
+    camera_.Target = state.camera_target;
+    camera_.Touched = true;
+  }
   camera_.Update();
 }
 
 bool
-CubeProgram::Draw()
+CubeProgram::StartSimulation()
 {
-  static const SDL_GPUViewport scene_vp{
-    0, 0, float(vp_width_), float(vp_height_), 0.1f, 1.0f
-  };
-  static const SDL_GPUBufferBinding vBinding{ vbuffer_, 0 };
-  static const SDL_GPUBufferBinding iBinding{ ibuffer_, 0 };
+  LOG_TRACE("CubeProgram::StartSimulation");
+  return sim_.Start(double(SDL_GetTicksNS()) / 1e9, kSimulationHz);
+}
 
-  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(Device);
-  if (cmdbuf == NULL) {
-    LOG_ERROR("Couldn't acquire command buffer: {}", SDL_GetError());
+bool
+CubeProgram::SetBenchCase(const BenchCase& bench)
+{
+  instance_cfg.dimension = std::clamp(bench.dimension, 1u, 100u);
+  wireframe_ = bench.wireframe;
+  if (bench.cull == CullMode::Gpu && !gpu_culling_available_) {
+    LOG_ERROR("GPU culling isn't available on this device");
     return false;
   }
+  cull_mode_ = bench.cull;
+  validate_every_frame_ = bench.validate_culling;
+  validate_gpu_culling_ = validate_every_frame_;
+  culling_validated_ = 0;
+  culling_mismatched_ = 0;
+  // exactly this size, no waiting for a panel to settle
+  panel_width_ = vp_width_ = bench.width;
+  panel_height_ = vp_height_ = bench.height;
+  camera_.SetAspect(float(vp_width_) / float(vp_height_));
+  if ((target_width_ != vp_width_ || target_height_ != vp_height_) &&
+      !CreateSceneRenderTargets()) {
+    return false;
+  }
+  // nor for pipelines compiling in the background, frames would be timed
+  // with draws skipped or falling back
+  pipelines_.WaitIdle();
+  return true;
+}
+
+bool
+CubeProgram::StartRecording(const char* path)
+{
+  polled_events_.clear();
+  return replay_writer_.Open(path, kReplayStep);
+}
+
+bool
+CubeProgram::StartCapture(const char* path)
+{
+  return capture_.Start(path, Headless());
+}
 
-  SDL_GPUTexture* swapchainTexture;
-  if (!SDL_WaitAndAcquireGPUSwapchainTexture(
-        cmdbuf, Window, &swapchainTexture, NULL, NULL)) {
-    LOG_ERROR("Couldn't acquire swapchain texture: {}", SDL_GetError());
+bool
+CubeProgram::StartReplay(const char* path)
+{
+  if (!replay_reader_.Open(path)) {
     return false;
   }
-  if (swapchainTexture == NULL) {
-    SDL_SubmitGPUCommandBuffer(cmdbuf);
+  RewindReplay();
+  return true;
+}
+
+void
+CubeProgram::RewindReplay()
+{
+  replay_reader_.Rewind();
+  cube_transform_.rotation_ = glm::vec3{ 0.f };
+  cube_transform_.Touched = true;
+  objects_.Clear();
+  boids_.Clear();
+  objects_time_ = 0.;
+  sim_.Reset(SceneState{ 0.,
+                         cube_transform_.rotation_,
+                         sim_input_.camera_position,
+                         sim_input_.camera_target });
+}
+
+// Records the settings and input this frame starts with, or replaces them
+// with the recording's. False once the replay is over.
+bool
+CubeProgram::StepReplay()
+{
+  if (replay_writer_.IsOpen()) {
+    replay_writer_.Frame(CaptureSettings(), polled_events_);
+    polled_events_.clear();
+  }
+  if (!replay_reader_.IsOpen()) {
     return true;
   }
+  const u32 frame = replay_reader_.Position();
+  ReplaySettings settings{};
+  std::span<const SDL_Event> events;
+  if (!replay_reader_.Next(settings, events)) {
+    return false;
+  }
+  ApplySettings(settings);
+  DeltaTime = replay_reader_.Step();
+  lastTime = double(frame) * replay_reader_.Step();
+  if (!Headless()) {
+    for (const auto& evt : events) {
+      ImGui_ImplSDL3_ProcessEvent(&evt);
+    }
+  }
+  return true;
+}
 
-  UpdateScene(); // TODO: move out
-  assert(textures_[0] != nullptr && samplers_[0] != nullptr);
-  static SDL_GPUTextureSamplerBinding sampler_bind{ textures_[0],
-                                                    samplers_[0] };
-  auto vp = camera_.Projection() * camera_.View();
-  MatricesBinding mvp{ vp, cube_transform_.Matrix() };
-  auto cameraModel = camera_.Model();
-  auto draw_data = DrawGui();
-  auto d = instance_cfg.dimension;
-  auto total_instances = d * d * d;
-  auto& mesh = loader.Meshes()[0];
-  auto idx_count = mesh.indices_.size();
-
-  ImGui_ImplSDLGPU3_PrepareDrawData(draw_data, cmdbuf);
-
-  // Scene Pass
-  {
-    scene_color_target_info_.texture = color_target_;
-    scene_depth_target_info_.texture = depth_target_;
-    SDL_PushGPUVertexUniformData(cmdbuf, 0, &mvp, sizeof(mvp));
-    SDL_PushGPUVertexUniformData(cmdbuf, 1, &cameraModel, sizeof(cameraModel));
-    SDL_PushGPUVertexUniformData(
-      cmdbuf, 2, &instance_cfg, sizeof(instance_cfg));
-
-    SDL_GPURenderPass* scenePass = SDL_BeginGPURenderPass(
-      cmdbuf, &scene_color_target_info_, 1, &scene_depth_target_info_);
+ReplaySettings
+CubeProgram::CaptureSettings() const
+{
+  // default member initializers leave the padding alone, it's zeroed so the
+  // recording doesn't carry stack bytes
+  ReplaySettings s;
+  SDL_memset(&s, 0, sizeof(s));
+  s.camera_position = sim_input_.camera_position;
+  s.camera_target = sim_input_.camera_target;
+  for (u32 i = 0; i < 3; ++i) {
+    s.rotation_speeds[i] = rotations_[i].speed;
+  }
+  s.instancing = instance_cfg;
+  s.objects = object_count_;
+  s.boids = boids_cfg_;
+  s.lighting = lighting_cfg_;
+  // the scale dynamic resolution picked, replays don't depend on timings
+  s.render_scale = dynamic_resolution_enabled_ ? dynamic_resolution_.Scale()
+                                               : render_scale_;
+  s.cull_mode = u8(cull_mode_);
+  s.wireframe = wireframe_;
+  s.depth_prepass = depth_prepass_;
+  return s;
+}
 
-    SDL_SetGPUViewport(scenePass, &scene_vp);
+void
+CubeProgram::ApplySettings(const ReplaySettings& s)
+{
+  sim_input_.camera_position = s.camera_position;
+  sim_input_.camera_target = s.camera_target;
+  for (u32 i = 0; i < 3; ++i) {
+    rotations_[i].speed = s.rotation_speeds[i];
+  }
+  instance_cfg = s.instancing;
+  object_count_ = s.objects;
+  boids_cfg_ = s.boids;
+  lighting_cfg_ = s.lighting;
+  dynamic_resolution_enabled_ = false;
+  render_scale_ = s.render_scale;
+  cull_mode_ = CullMode(s.cull_mode);
+  if (cull_mode_ == CullMode::Gpu && !gpu_culling_available_) {
+    cull_mode_ = CullMode::Cpu;
+  }
+  wireframe_ = s.wireframe;
+  depth_prepass_ = s.depth_prepass;
+}
 
-    SDL_BindGPUGraphicsPipeline(
-      scenePass, wireframe_ ? scene_wireframe_pipeline_ : scene_pipeline_);
-    SDL_BindGPUVertexBuffers(scenePass, 0, &vBinding, 1);
-    SDL_BindGPUIndexBuffer(
-      scenePass, &iBinding, SDL_GPU_INDEXELEMENTSIZE_16BIT);
-    SDL_BindGPUFragmentSamplers(scenePass, 0, &sampler_bind, 1);
-    SDL_DrawGPUIndexedPrimitives(
-      scenePass, idx_count, total_instances, 0, 0, 0);
+SDL_GPUFence*
+CubeProgram::TakeFrameFence()
+{
+  SDL_GPUFence* fence = frame_fence_;
+  frame_fence_ = nullptr;
+  return fence;
+}
 
-    skybox_.Draw(scenePass);
+bool
+CubeProgram::Draw()
+{
+  PROFILE_ZONE("Draw");
+  if (!Headless()) {
+    // GUI changes, before a swapchain texture is held
+    pacer_.Apply(pacing_cfg_);
+    pacer_.Limit(pacing_cfg_.fps_limit);
+  }
+  if (!StepReplay()) {
+    LOG_INFO("Replay finished");
+    quit = true;
+    return true;
+  }
 
-    SDL_EndGPURenderPass(scenePass);
+  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(Device);
+  if (cmdbuf == NULL) {
+    LOG_ERROR("Couldn't acquire command buffer: {}", SDL_GetError());
+    return false;
   }
 
-  // GUI Pass
+  if (!ResizeSceneTargets()) {
+    LOG_ERROR("Couldn't resize scene render targets");
+    SDL_SubmitGPUCommandBuffer(cmdbuf);
+    return false;
+  }
+  UpdateScene();
+  // The scene goes in the top left part of the targets: scaled down by
+  // dynamic resolution, and to fit while they're smaller than the panel.
+  const float render_scale =
+    dynamic_resolution_enabled_
+      ? dynamic_resolution_.Update(DeltaTime * 1000.f, dynamic_resolution_cfg_)
+      : render_scale_;
+  const float fit = std::min({ 1.f,
+                               float(target_width_) / float(vp_width_),
+                               float(target_height_) / float(vp_height_) });
+  render_width_ =
+    std::min(DynamicResolution::Scaled(vp_width_, render_scale * fit),
+             u32(target_width_));
+  render_height_ =
+    std::min(DynamicResolution::Scaled(vp_height_, render_scale * fit),
+             u32(target_height_));
+  const SDL_GPUViewport scene_vp{
+    0, 0, float(render_width_), float(render_height_), 0.1f, 1.0f
+  };
+  assert(textures_[0] != nullptr && samplers_[0] != nullptr);
+  ImDrawData* draw_data = Headless() ? nullptr : DrawGui();
+  instances_.Resize(instance_cfg);
+  objects_.Resize(
+    object_count_, instances_.GridOrigin(), instances_.GridSize());
+  boids_.Resize(
+    boids_cfg_.count, instances_.GridOrigin(), instances_.GridSize());
+  cull_radius_ = InstanceCullRadius(skinning_.Bounds(),
+                                    cube_transform_.Matrix());
+
+  // Instance animation and culling don't share anything with light binning,
+  // a job each. Both spread their own loops over the pool too.
+  bool instances_updated = false;
+  bool lights_updated = false;
+  bool skinning_updated = false;
   {
+    const std::function<void()> jobs[] = {
+      [&] { instances_updated = UpdateInstances(); },
+      [&] { lights_updated = UpdateLights(); },
+      [&] {
+        skinning_updated =
+          skinning_.Update(skinning_cfg_, float(lastTime), jobs_);
+      },
+    };
+    jobs_.Run(jobs);
+  }
+  if (!instances_updated) {
+    LOG_ERROR("Couldn't update instance data");
+    SDL_SubmitGPUCommandBuffer(cmdbuf);
+    return false;
+  }
+  if (!lights_updated) {
+    LOG_ERROR("Couldn't update lights");
+    SDL_SubmitGPUCommandBuffer(cmdbuf);
+    return false;
+  }
+  if (!skinning_updated) {
+    LOG_ERROR("Couldn't update skinning");
+    SDL_SubmitGPUCommandBuffer(cmdbuf);
+    return false;
+  }
+  const bool gpu_culling =
+    cull_mode_ == CullMode::Gpu && visible_instances_ != 0;
+  RenderStats::Add(Counter::Instances, InstanceCount());
+  RenderStats::Add(Counter::VisibleInstances, visible_instances_);
+  RenderStats::Add(Counter::CulledInstances,
+                   InstanceCount() - visible_instances_);
+  RenderStats::Add(Counter::Lights, lights_.size());
+  FillRenderQueue(gpu_culling);
+  QueueCommandBuffers(gpu_culling, scene_vp);
+
+  // The GUI goes in the swapchain's command buffer, on this thread while the
+  // workers record the scene. It's submitted last: it samples the scene.
+  // The swapchain wait comes only now, the frame's CPU work above overlapped
+  // the GPU's work on the previous frames.
+  bool acquired = true;
+  const bool recorded = recorder_.Run(jobs_, [&] {
+    if (draw_data == nullptr) {
+      return;
+    }
+    SDL_GPUTexture* swapchainTexture = nullptr;
+    {
+      PROFILE_ZONE("Swapchain wait");
+      acquired = SDL_WaitAndAcquireGPUSwapchainTexture(
+        cmdbuf, Window, &swapchainTexture, NULL, NULL);
+    }
+    if (!acquired) {
+      LOG_ERROR("Couldn't acquire swapchain texture: {}", SDL_GetError());
+      return;
+    }
+    if (swapchainTexture == NULL) {
+      return; // minimized, the scene is drawn but not shown
+    }
+    ImGui_ImplSDLGPU3_PrepareDrawData(draw_data, cmdbuf);
+
     swapchain_target_info_.texture = swapchainTexture;
     SDL_GPURenderPass* guiPass =
       SDL_BeginGPURenderPass(cmdbuf, &swapchain_target_info_, 1, nullptr);
 
     ImGui_ImplSDLGPU3_RenderDrawData(draw_data, cmdbuf, guiPass);
     SDL_EndGPURenderPass(guiPass);
+  });
+  if (Headless()) {
+    // submitted last, signals once the whole frame is done
+    RELEASE_IF(frame_fence_, SDL_ReleaseGPUFence);
+    frame_fence_ = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdbuf);
+    if (frame_fence_ == nullptr) {
+      LOG_ERROR("Couldn't submit frame: {}", GETERR);
+      return false;
+    }
+  } else {
+    SDL_SubmitGPUCommandBuffer(cmdbuf);
+  }
+  if (!recorded) {
+    LOG_ERROR("Couldn't record the scene");
+    return false;
+  }
+  if (!acquired) {
+    return false;
+  }
+  // the scene is submitted, its download goes right after it
+  if (!capture_.Capture(color_target_, render_width_, render_height_)) {
+    LOG_ERROR("Couldn't capture the frame, capture stopped");
+    capture_.Stop();
   }
 
-  SDL_SubmitGPUCommandBuffer(cmdbuf);
+  if (gpu_culling && validate_gpu_culling_) {
+    // instance_buffer_ holds what frame_instances_ held when it was uploaded
+    const GpuCullValidation& validation =
+      gpu_culler_.Validate(instance_buffer_.Buffer(),
+                           frame_instances_.data(),
+                           visible_instances_,
+                           submesh_draws_,
+                           camera_.ViewFrustum(),
+                           cull_radius_);
+    ++culling_validated_;
+    culling_mismatched_ += !validation.passed;
+  }
+  validate_gpu_culling_ = validate_every_frame_;
+  if (skinning_.Active() && validate_skinning_) {
+    // skins this frame's poses again, on their own
+    skinning_.Validate();
+  }
+  validate_skinning_ = false;
+  RenderStats::EndFrame(DeltaTime * 1000.f);
+  return true;
+}
+
+void
+CubeProgram::QueueCommandBuffers(bool gpu_culling,
+                                 const SDL_GPUViewport& viewport)
+{
+  recorder_.Clear();
+  // Cycles the instances, lights, skinned vertices and visible indices the
+  // scene binds: recorded first, on this thread
+  recorder_.AddSerial("Uploads",
+                      [this, gpu_culling](SDL_GPUCommandBuffer* cmdbuf) {
+                        return RecordUploads(cmdbuf, gpu_culling);
+                      });
+
+  const MatricesBinding mvp{ camera_.Projection() * camera_.View(),
+                             cube_transform_.Matrix() };
+  const glm::mat4 cameraModel = camera_.Model();
+  const bool skinned = skinning_.Active();
+  const SkinningUniforms skin = skinning_.Uniforms();
+  const ClusterUniforms lighting = lighting_.Uniforms(
+    float(render_width_), float(render_height_), lighting_cfg_);
+
+  // Scene draws in sorted order, split at the end of the depth prepass and
+  // every kDrawsPerCommandBuffer draws. Every range is a render pass of its
+  // own: the first clears the targets, the next ones load what's there. The
+  // first one cycles the targets, it's recorded before the others too.
+  const u32 size = render_queue_.Size();
+  const u32 opaque = render_queue_.PassBegin(DrawPass::Opaque);
+  u32 begin = 0;
+  do {
+    u32 end = std::min(begin + kDrawsPerCommandBuffer, size);
+    if (begin < opaque && end > opaque) {
+      end = opaque;
+    }
+    const bool first = begin == 0;
+
+    SDL_GPUColorTargetInfo color = scene_color_target_info_;
+    SDL_GPUDepthStencilTargetInfo depth = scene_depth_target_info_;
+    {
+      color.texture = color_target_;
+      depth.texture = depth_target_;
+      if (!first) {
+        // cycling would hand us a fresh texture
+        color.load_op = depth.load_op = depth.stencil_load_op =
+          SDL_GPU_LOADOP_LOAD;
+        color.cycle = depth.cycle = false;
+      }
+    }
+    const char* name = begin < opaque ? "Depth prepass" : "Scene";
+    CommandRecorder::RecordFn record =
+      [=, this](SDL_GPUCommandBuffer* cmdbuf) {
+        // uniforms are per command buffer
+        SDL_PushGPUVertexUniformData(cmdbuf, 0, &mvp, sizeof(mvp));
+        SDL_PushGPUVertexUniformData(
+          cmdbuf, 1, &cameraModel, sizeof(cameraModel));
+        if (skinned) {
+          SDL_PushGPUVertexUniformData(cmdbuf, 2, &skin, sizeof(skin));
+        }
+        SDL_PushGPUFragmentUniformData(cmdbuf, 0, &lighting, sizeof(lighting));
+
+        SDL_GPURenderPass* scenePass =
+          SDL_BeginGPURenderPass(cmdbuf, &color, 1, &depth);
+        SDL_SetGPUViewport(scenePass, &viewport);
+        CountDraws(render_queue_.Submit(scenePass, begin, end));
+        SDL_EndGPURenderPass(scenePass);
+        return true;
+      };
+    if (first) {
+      recorder_.AddSerial(name, std::move(record));
+    } else {
+      recorder_.Add(name, std::move(record));
+    }
+    begin = end;
+  } while (begin < size);
+}
+
+bool
+CubeProgram::RecordUploads(SDL_GPUCommandBuffer* cmdbuf, bool gpu_culling)
+{
+  PROFILE_ZONE("RecordUploads");
+  SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
+  if (visible_instances_ != 0) {
+    instance_buffer_.Upload(copyPass, visible_instances_);
+  }
+  const bool uploaded = lighting_.Upload(copyPass);
+  if (skinning_.Active()) {
+    skinning_.Upload(copyPass);
+  }
+  SDL_EndGPUCopyPass(copyPass);
+  if (!uploaded) {
+    LOG_ERROR("Couldn't upload lights");
+    return false;
+  }
+
+  if (skinning_.Active()) {
+    skinning_.Dispatch(cmdbuf);
+  }
+  if (gpu_culling) {
+    gpu_culler_.Dispatch(cmdbuf,
+                         instance_buffer_.Buffer(),
+                         visible_instances_,
+                         submesh_draws_,
+                         camera_.ViewFrustum(),
+                         cull_radius_);
+  }
+  return true;
+}
+
+void
+CubeProgram::FillRenderQueue(bool gpu_culling)
+{
+  PROFILE_ZONE("FillRenderQueue");
+  render_queue_.Clear();
+
+  // Only once both halves are compiled: an EQUAL test against a cleared depth
+  // buffer draws nothing. Lines can't reuse triangle depth, no wireframe.
+  const PipelineHandle depth_pipeline =
+    gpu_culling ? depth_gpu_cull_pipeline_ : depth_pipeline_;
+  const PipelineHandle equal_pipeline =
+    gpu_culling ? scene_gpu_cull_equal_pipeline_ : scene_equal_pipeline_;
+  const bool prepass = depth_prepass_ && !wireframe_ &&
+                       pipelines_.IsReady(depth_pipeline) &&
+                       pipelines_.IsReady(equal_pipeline);
+
+  DrawCmd cmd{};
+  {
+    if (prepass) {
+      cmd.pipeline = pipelines_.Get(equal_pipeline);
+    } else if (gpu_culling) {
+      cmd.pipeline = pipelines_.Get(wireframe_
+                                      ? scene_gpu_cull_wireframe_pipeline_
+                                      : scene_gpu_cull_pipeline_);
+    } else {
+      cmd.pipeline = pipelines_.Get(wireframe_ ? scene_wireframe_pipeline_
+                                               : scene_pipeline_);
+    }
+    cmd.vertex_buffer = { vbuffer_, 0 };
+    cmd.index_buffer = { ibuffer_, 0 };
+    cmd.index_size = index_size_;
+    // the loader keeps one texture for the whole model, see RenderQueue
+    cmd.sampler = { textures_[0], samplers_[0] };
+    cmd.storage[0] = instance_buffer_.Buffer();
+    cmd.storage[1] = gpu_culler_.VisibleIndices();
+    cmd.num_storage = gpu_culling ? 2 : 1;
+    if (skinning_.Active()) {
+      cmd.storage[cmd.num_storage++] = skinning_.Skinned();
+    }
+    cmd.fragment_storage[0] = lighting_.Lights();
+    cmd.fragment_storage[1] = lighting_.Clusters();
+    cmd.fragment_storage[2] = lighting_.Indices();
+    cmd.num_fragment_storage = 3;
+    cmd.num_instances = visible_instances_;
+  }
+
+  if (cmd.pipeline != nullptr && (gpu_culling || visible_instances_ != 0)) {
+    const glm::mat4 model = cube_transform_.Matrix();
+    const auto& meshes = loader.Meshes();
+    for (u32 s = 0; s < submesh_draws_.size(); ++s) {
+      const auto& draw = submesh_draws_[s];
+      if (gpu_culling) {
+        cmd.indirect = gpu_culler_.DrawCommands();
+        cmd.indirect_offset = GpuCuller::DrawCommandOffset(s);
+      }
+      cmd.num_indices = draw.num_indices;
+      cmd.first_index = draw.first_index;
+      cmd.vertex_offset = draw.vertex_offset;
+
+      const glm::vec3 center{
+        model * glm::vec4{ meshes[submesh_meshes_[s]].Bounds.Center, 1.f }
+      };
+      const float depth = glm::distance(camera_.Position, center);
+      render_queue_.Add(DrawPass::Opaque, cmd, depth);
+      if (prepass) {
+        DrawCmd depth_cmd = cmd;
+        depth_cmd.pipeline = pipelines_.Get(depth_pipeline);
+        depth_cmd.vertex_buffer = { pbuffer_, 0 };
+        depth_cmd.sampler = {};
+        depth_cmd.num_fragment_storage = 0;
+        render_queue_.Add(DrawPass::Depth, depth_cmd, depth);
+      }
+    }
+  }
+
+  skybox_.Enqueue(render_queue_);
+  render_queue_.Sort();
+}
+
+bool
+CubeProgram::UpdateLights()
+{
+  PROFILE_ZONE("UpdateLights");
+  if (lighting_cfg_.enabled) {
+    AnimateLights(lighting_cfg_,
+                  instances_.GridOrigin(),
+                  instances_.GridSize(),
+                  float(lastTime),
+                  lights_);
+  } else {
+    lights_.clear();
+  }
+  cluster_cfg_.near = camera_.Near();
+  cluster_cfg_.far = camera_.Far();
+  lighting_.Build(
+    cluster_cfg_, camera_.View(), camera_.Projection(), lights_, jobs_);
+  // the scene's command buffers bind them while the uploads are recorded
+  return lighting_.Reserve();
+}
+
+bool
+CubeProgram::UpdateInstances()
+{
+  PROFILE_ZONE("UpdateInstances");
+  const u32 grid = instances_.Count();
+  const u32 count = InstanceCount();
+  // objects and boids move by the scene clock, it may step back on a replay
+  // rewind
+  const float time = float(lastTime);
+  const float objects_dt = float(std::clamp(lastTime - objects_time_, 0., .1));
+  objects_time_ = lastTime;
+  visible_instances_ = 0;
+  // every submesh gets a draw command, even with nothing to draw
+  if (cull_mode_ == CullMode::Gpu &&
+      !gpu_culler_.Reserve(count, u32(submesh_draws_.size()))) {
+    return false;
+  }
+  if (count == 0) {
+    return true;
+  }
+  if (!instance_buffer_.Reserve(count)) {
+    return false;
+  }
+
+  InstanceData* dst = instance_buffer_.Map();
+  if (dst == nullptr) {
+    LOG_ERROR("Couldn't map instance transfer buffer: {}", GETERR);
+    return false;
+  }
+  const bool cpu_culling = cull_mode_ == CullMode::Cpu;
+  const bool use_bvh = (cpu_culling && bvh_culling_) || pick_ndc_;
+  const bool cpu_copy = cpu_culling || validate_gpu_culling_ || use_bvh;
+  // animate into a CPU copy if needed, only the survivors reach the upload
+  // buffer then
+  if (cpu_copy) {
+    frame_instances_.resize(count);
+  }
+  InstanceData* frame = cpu_copy ? frame_instances_.data() : dst;
+  instances_.Generate(time, jobs_, frame);
+  objects_.Update(time, objects_dt, cull_radius_, jobs_, frame + grid);
+  boids_.Update(boids_cfg_,
+                time,
+                objects_dt,
+                jobs_,
+                frame + grid + objects_.Count());
+  if (use_bvh) {
+    bvh_.Update(frame_instances_.data(), count, cull_radius_, jobs_);
+  }
+  const glm::mat4 view_proj = camera_.Projection() * camera_.View();
+  if (pick_ndc_) {
+    // the click's ray from the near to the far plane, NDC depth is 0..1
+    const glm::mat4 inv = glm::inverse(view_proj);
+    const glm::vec4 from = inv * glm::vec4{ pick_ndc_->x, pick_ndc_->y, 0, 1 };
+    const glm::vec4 to = inv * glm::vec4{ pick_ndc_->x, pick_ndc_->y, 1, 1 };
+    const glm::vec3 origin = glm::vec3(from) / from.w;
+    glm::vec3 box_min, box_max;
+    const glm::mat4 model = cube_transform_.Matrix();
+    MathKernels::TransformBounds(&model,
+                                 1,
+                                 skinning_.Bounds().Min,
+                                 skinning_.Bounds().Max,
+                                 &box_min,
+                                 &box_max);
+    picked_ = bvh_
+                .Raycast(origin,
+                         glm::vec3(to) / to.w - origin,
+                         frame_instances_.data(),
+                         box_min,
+                         box_max)
+                .instance;
+    pick_ndc_.reset();
+  }
+
+  if (cpu_culling) {
+    InstanceData* frustum_out = dst;
+    if (occlusion_culling_) {
+      frustum_visible_.resize(count);
+      frustum_out = frustum_visible_.data();
+    }
+    const u32 in_frustum =
+      bvh_culling_ ? bvh_.Cull(camera_.ViewFrustum(),
+                               frame_instances_.data(),
+                               jobs_,
+                               frustum_out)
+                   : culler_.Cull(camera_.ViewFrustum(),
+                                  cull_radius_,
+                                  frame_instances_.data(),
+                                  count,
+                                  jobs_,
+                                  frustum_out);
+    if (occlusion_culling_) {
+      occlusion_.Resize(occlusion_width_, vp_width_, vp_height_);
+      visible_instances_ = occlusion_.Cull(occlusion_cfg_,
+                                           view_proj,
+                                           cube_transform_.Matrix(),
+                                           skinning_.Bounds(),
+                                           frustum_visible_.data(),
+                                           in_frustum,
+                                           jobs_,
+                                           dst);
+    } else {
+      visible_instances_ = in_frustum;
+    }
+  } else if (cpu_copy) {
+    // the CPU copy stays around for GPU culling's reference or the pick
+    SDL_memcpy(dst, frame_instances_.data(), count * sizeof(InstanceData));
+    visible_instances_ = count;
+  } else {
+    visible_instances_ = count;
+  }
+  instance_buffer_.Unmap();
+  return true;
+}
+
+bool
+CubeProgram::CreateGpuCullingPipelines(SDL_GPUGraphicsPipelineCreateInfo info)
+{
+  LOG_TRACE("CubeProgram::CreateGpuCullingPipelines");
+  if (!gpu_culler_.Init(cull_compute_path_)) {
+    return false;
+  }
+  SDL_GPUShader* vertex = pipelines_.Shader(gpu_cull_vertex_path_);
+  if (vertex == nullptr) {
+    LOG_ERROR("Couldn't load vertex shader at path {}", gpu_cull_vertex_path_);
+    return false;
+  }
+
+  // Not a fallback for the CPU path's pipelines: their vertex shader doesn't
+  // read the visible index list. GPU culled draws wait for this one instead.
+  info.vertex_shader = vertex;
+  info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
+  scene_gpu_cull_pipeline_ = pipelines_.Request(info);
+  info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_LINE;
+  scene_gpu_cull_wireframe_pipeline_ =
+    pipelines_.Request(info, scene_gpu_cull_pipeline_);
+  return true;
+}
+
+bool
+CubeProgram::CreateDepthPrepassPipelines(SDL_GPUGraphicsPipelineCreateInfo info)
+{
+  LOG_TRACE("CubeProgram::CreateDepthPrepassPipelines");
+  // Requested without fallbacks, the prepass stays off until they're built.
+  info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
+
+  // Shading: depth is final, only the nearest surface passes
+  info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_EQUAL;
+  info.depth_stencil_state.enable_depth_write = false;
+  scene_equal_pipeline_ = pipelines_.Request(info);
+  if (gpu_culling_available_) {
+    info.vertex_shader = pipelines_.Shader(gpu_cull_vertex_path_);
+    scene_gpu_cull_equal_pipeline_ = pipelines_.Request(info);
+  }
+
+  SDL_GPUShader* vertex = pipelines_.Shader(depth_vertex_path_);
+  if (vertex == nullptr) {
+    LOG_ERROR("Couldn't load vertex shader at path {}", depth_vertex_path_);
+    return false;
+  }
+  SDL_GPUShader* fragment = pipelines_.Shader(depth_fragment_path_);
+  if (fragment == nullptr) {
+    LOG_ERROR("Couldn't load fragment shader at path {}",
+              depth_fragment_path_);
+    return false;
+  }
+
+  SDL_GPUVertexAttribute attribute{};
+  {
+    attribute.location = 0;
+    attribute.buffer_slot = 0;
+    attribute.format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
+    attribute.offset = 0;
+  }
+  SDL_GPUVertexBufferDescription buffer{};
+  {
+    buffer.slot = 0;
+    buffer.pitch = sizeof(PosVertex);
+    buffer.input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
+    buffer.instance_step_rate = 0;
+  }
+  // Same render pass as the shading draws, with color writes masked off
+  SDL_GPUColorTargetDescription color =
+    info.target_info.color_target_descriptions[0];
+  color.blend_state.enable_color_write_mask = true;
+  color.blend_state.color_write_mask = 0;
+
+  info.vertex_shader = vertex;
+  info.fragment_shader = fragment;
+  info.vertex_input_state.vertex_buffer_descriptions = &buffer;
+  info.vertex_input_state.num_vertex_buffers = 1;
+  info.vertex_input_state.vertex_attributes = &attribute;
+  info.vertex_input_state.num_vertex_attributes = 1;
+  info.target_info.color_target_descriptions = &color;
+  info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS_OR_EQUAL;
+  info.depth_stencil_state.enable_depth_write = true;
+  depth_pipeline_ = pipelines_.Request(info);
+
+  if (gpu_culling_available_) {
+    info.vertex_shader = pipelines_.Shader(depth_gpu_cull_vertex_path_);
+    if (info.vertex_shader == nullptr) {
+      LOG_ERROR("Couldn't load vertex shader at path {}",
+                depth_gpu_cull_vertex_path_);
+      return false;
+    }
+    depth_gpu_cull_pipeline_ = pipelines_.Request(info);
+  }
   return true;
 }
 
@@ -355,12 +1089,12 @@ bool
 CubeProgram::LoadShaders()
 {
   LOG_TRACE("CubeProgram::LoadShaders");
-  vertex_ = LoadShader(vertex_path_, Device, 0, 3, 0, 0);
+  vertex_ = pipelines_.Shader(vertex_path_);
   if (vertex_ == nullptr) {
     LOG_ERROR("Couldn't load vertex shader at path {}", vertex_path_);
     return false;
   }
-  fragment_ = LoadShader(fragment_path_, Device, 1, 1, 0, 0);
+  fragment_ = pipelines_.Shader(fragment_path_);
   if (fragment_ == nullptr) {
     LOG_ERROR("Couldn't load fragment shader at path {}", fragment_path_);
     return false;
@@ -372,6 +1106,7 @@ bool
 CubeProgram::LoadTextures()
 {
   LOG_TRACE("CubeProgram::LoadTextures");
+  PROFILE_ZONE("LoadTextures");
   // auto img = LoadImage("resources/textures/grass.png");
   auto img = loader.Surfaces()[0];
   if (!img) {
@@ -430,6 +1165,8 @@ CubeProgram::LoadTextures()
     SDL_GPUCommandBuffer* cmdBuf = SDL_AcquireGPUCommandBuffer(Device);
     SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdBuf);
     SDL_UploadToGPUTexture(copyPass, &tex_transfer_info, &tex_reg, false);
+    RenderStats::Add(Counter::UploadBytes, tr_info.size);
+    RenderStats::Allocated(GpuMemory::Textures, tr_info.size);
 
     SDL_EndGPUCopyPass(copyPass);
     SDL_SubmitGPUCommandBuffer(cmdBuf);
@@ -444,10 +1181,28 @@ bool
 CubeProgram::SendVertexData()
 {
   LOG_TRACE("CubeProgram::SendVertexData");
-  auto& mesh = loader.Meshes()[0];
-  auto vert_count = mesh.vertices_.size();
-  auto idx_count = mesh.indices_.size();
-  LOG_DEBUG("Mesh has {} vertices and {} indices", vert_count, idx_count);
+  PROFILE_ZONE("SendVertexData");
+  // Every mesh goes in the same vertex and index buffers, each submesh is
+  // drawn on its own with a base vertex and first index into them.
+  const auto& meshes = loader.Meshes();
+  size_t vert_count = 0;
+  size_t idx_count = 0;
+  size_t max_mesh_verts = 0;
+  for (const auto& mesh : meshes) {
+    vert_count += mesh.vertices_.size();
+    idx_count += mesh.indices_.size();
+    max_mesh_verts = std::max(max_mesh_verts, mesh.vertices_.size());
+  }
+  // indices are relative to their mesh's base vertex
+  index_size_ = max_mesh_verts > 0xFFFF ? SDL_GPU_INDEXELEMENTSIZE_32BIT
+                                        : SDL_GPU_INDEXELEMENTSIZE_16BIT;
+  const size_t idx_stride =
+    index_size_ == SDL_GPU_INDEXELEMENTSIZE_32BIT ? sizeof(Uint32)
+                                                  : sizeof(Uint16);
+  LOG_DEBUG("{} meshes with {} vertices and {} indices",
+            meshes.size(),
+            vert_count,
+            idx_count);
 
   SDL_GPUBufferCreateInfo vertInfo{};
   {
@@ -458,22 +1213,31 @@ CubeProgram::SendVertexData()
   SDL_GPUBufferCreateInfo idxInfo{};
   {
     idxInfo.usage = SDL_GPU_BUFFERUSAGE_INDEX;
-    idxInfo.size = static_cast<Uint32>(sizeof(Uint16) * idx_count);
+    idxInfo.size = static_cast<Uint32>(idx_stride * idx_count);
+  }
+
+  SDL_GPUBufferCreateInfo posInfo{};
+  {
+    posInfo.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
+    posInfo.size = static_cast<Uint32>(sizeof(PosVertex) * vert_count);
   }
 
+  // vertices | positions | indices
   SDL_GPUTransferBufferCreateInfo transferInfo{};
   {
-    Uint32 sz = sizeof(PosUvVertex) * vert_count + sizeof(Uint16) * idx_count;
+    Uint32 sz = (sizeof(PosUvVertex) + sizeof(PosVertex)) * vert_count +
+                idx_stride * idx_count;
     transferInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
     transferInfo.size = sz;
   }
 
   vbuffer_ = SDL_CreateGPUBuffer(Device, &vertInfo);
+  pbuffer_ = SDL_CreateGPUBuffer(Device, &posInfo);
   ibuffer_ = SDL_CreateGPUBuffer(Device, &idxInfo);
   SDL_GPUTransferBuffer* transferBuffer =
     SDL_CreateGPUTransferBuffer(Device, &transferInfo);
 
-  if (!vbuffer_ || !ibuffer_ || !transferBuffer) {
+  if (!vbuffer_ || !pbuffer_ || !ibuffer_ || !transferBuffer) {
     LOG_ERROR("couldn't create buffers");
     return false;
   }
@@ -486,14 +1250,40 @@ CubeProgram::SendVertexData()
     return false;
   }
 
-  for (u32 i = 0; i < vert_count; ++i) {
-    transferData[i] = mesh.vertices_[i];
-  }
-
-  Uint16* indexData = (Uint16*)&transferData[vert_count];
-  for (u32 i = 0; i < idx_count; ++i) {
-    indexData[i] = mesh.indices_[i];
+  PosVertex* positionData = (PosVertex*)&transferData[vert_count];
+  Uint8* indexData = (Uint8*)&positionData[vert_count];
+  submesh_draws_.clear();
+  submesh_meshes_.clear();
+  u32 vert_base = 0;
+  u32 idx_base = 0;
+  for (u32 m = 0; m < meshes.size(); ++m) {
+    const auto& mesh = meshes[m];
+    std::copy(
+      mesh.vertices_.begin(), mesh.vertices_.end(), transferData + vert_base);
+    std::copy(mesh.positions_.begin(),
+              mesh.positions_.end(),
+              positionData + vert_base);
+    for (u32 i = 0; i < mesh.indices_.size(); ++i) {
+      if (index_size_ == SDL_GPU_INDEXELEMENTSIZE_32BIT) {
+        ((Uint32*)indexData)[idx_base + i] = mesh.indices_[i];
+      } else {
+        ((Uint16*)indexData)[idx_base + i] = mesh.indices_[i];
+      }
+    }
+    for (const auto& submesh : mesh.Submeshes) {
+      submesh_draws_.push_back(SDL_GPUIndexedIndirectDrawCommand{
+        .num_indices = static_cast<Uint32>(submesh.VertexCount),
+        .num_instances = 0,
+        .first_index = idx_base + static_cast<Uint32>(submesh.FirstIndex),
+        .vertex_offset = static_cast<Sint32>(vert_base),
+        .first_instance = 0,
+      });
+      submesh_meshes_.push_back(m);
+    }
+    vert_base += static_cast<u32>(mesh.vertices_.size());
+    idx_base += static_cast<u32>(mesh.indices_.size());
   }
+  LOG_DEBUG("{} submeshes to draw", submesh_draws_.size());
 
   SDL_UnmapGPUTransferBuffer(Device, transferBuffer);
 
@@ -514,8 +1304,13 @@ CubeProgram::SendVertexData()
   SDL_UploadToGPUBuffer(copyPass, &trLoc, &reg, false);
 
   trLoc.offset = sizeof(PosUvVertex) * vert_count;
+  reg.buffer = pbuffer_;
+  reg.size = sizeof(PosVertex) * vert_count;
+  SDL_UploadToGPUBuffer(copyPass, &trLoc, &reg, false);
+
+  trLoc.offset += sizeof(PosVertex) * vert_count;
   reg.buffer = ibuffer_;
-  reg.size = sizeof(Uint16) * idx_count;
+  reg.size = idx_stride * idx_count;
 
   SDL_UploadToGPUBuffer(copyPass, &trLoc, &reg, false);
 
@@ -525,18 +1320,65 @@ CubeProgram::SendVertexData()
     return false;
   }
   SDL_ReleaseGPUTransferBuffer(Device, transferBuffer);
+  RenderStats::Add(Counter::UploadBytes, transferInfo.size);
+  RenderStats::Allocated(GpuMemory::Geometry, transferInfo.size);
+  geometry_bytes_ = transferInfo.size;
 
   return true;
 }
 
+bool
+CubeProgram::ResizeSceneTargets()
+{
+  if (panel_width_ <= 0 || panel_height_ <= 0) {
+    return true; // no GUI frame yet, or the panel is collapsed
+  }
+  if (panel_width_ != vp_width_ || panel_height_ != vp_height_) {
+    vp_width_ = panel_width_;
+    vp_height_ = panel_height_;
+    camera_.SetAspect(float(vp_width_) / float(vp_height_));
+    panel_stable_frames_ = 0;
+    return true;
+  }
+  // Recreated once the panel stops changing, and only when they're too small
+  // or hold over twice the pixels needed. In between the scene is stretched.
+  const bool too_small =
+    vp_width_ > target_width_ || vp_height_ > target_height_;
+  const bool too_large =
+    2 * vp_width_ * vp_height_ < target_width_ * target_height_;
+  if ((!too_small && !too_large) ||
+      ++panel_stable_frames_ < kResizeSettleFrames) {
+    return true;
+  }
+  panel_stable_frames_ = 0;
+  LOG_DEBUG("Resizing scene targets from {}x{} to {}x{}",
+            target_width_,
+            target_height_,
+            vp_width_,
+            vp_height_);
+  return CreateSceneRenderTargets();
+}
+
 bool
 CubeProgram::CreateSceneRenderTargets()
 {
   LOG_TRACE("CubeProgram::CreateSceneRenderTargets");
+  if (depth_target_ != nullptr && color_target_ != nullptr) {
+    RenderStats::Allocated(GpuMemory::RenderTargets,
+                           -SceneTargetBytes(target_width_, target_height_));
+  }
+  // released once the GPU is done with them
+  RELEASE_IF(depth_target_, SDL_ReleaseGPUTexture);
+  RELEASE_IF(color_target_, SDL_ReleaseGPUTexture);
+  depth_target_ = nullptr;
+  color_target_ = nullptr;
+  target_width_ = vp_width_;
+  target_height_ = vp_height_;
+
   auto info = SDL_GPUTextureCreateInfo{};
   {
     info.type = SDL_GPU_TEXTURETYPE_2D,
-    info.format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+    info.format = kSceneColorFormat,
     info.width = static_cast<Uint32>(vp_width_),
     info.height = static_cast<Uint32>(vp_height_),
     info.layer_count_or_depth = 1, info.num_levels = 1,
@@ -546,12 +1388,17 @@ CubeProgram::CreateSceneRenderTargets()
   }
   color_target_ = SDL_CreateGPUTexture(Device, &info);
 
-  info.format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
+  info.format = kSceneDepthFormat;
   info.usage =
     SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET;
   depth_target_ = SDL_CreateGPUTexture(Device, &info);
 
-  return depth_target_ != nullptr && color_target_ != nullptr;
+  if (depth_target_ == nullptr || color_target_ == nullptr) {
+    return false;
+  }
+  RenderStats::Allocated(GpuMemory::RenderTargets,
+                         SceneTargetBytes(target_width_, target_height_));
+  return true;
 }
 
 bool
@@ -588,13 +1435,14 @@ CubeProgram::InitGui()
     SDL_GetGPUSwapchainTextureFormat(Device, Window);
   init_info.MSAASamples = SDL_GPU_SAMPLECOUNT_1;
   init_info.SwapchainComposition = SDL_GPU_SWAPCHAINCOMPOSITION_SDR;
-  init_info.PresentMode = SDL_GPU_PRESENTMODE_VSYNC;
+  init_info.PresentMode = pacing_cfg_.present_mode;
   return ImGui_ImplSDLGPU3_Init(&init_info);
 }
 
 ImDrawData*
 CubeProgram::DrawGui()
 {
+  PROFILE_ZONE("DrawGui");
   // Init frame:
   {
     ImGui_ImplSDLGPU3_NewFrame();
@@ -607,20 +1455,69 @@ CubeProgram::DrawGui()
   {
     if (ImGui::Begin("Scene")) {
       ImGui::Text("Hello world");
+      // the targets follow the panel's size next frames, in pixels
+      const ImVec2 size = ImGui::GetContentRegionAvail();
+      const ImVec2 dpi = ImGui::GetIO().DisplayFramebufferScale;
+      panel_width_ = std::max(int(size.x * dpi.x), 8);
+      panel_height_ = std::max(int(size.y * dpi.y), 8);
+      // stretched to the panel by the GUI's bilinear sampler
       ImGui::Image((ImTextureID)(intptr_t)color_target_,
-                   ImVec2((float)vp_width_, (float)vp_height_));
+                   size,
+                   ImVec2(0.f, 0.f),
+                   ImVec2(float(render_width_) / float(target_width_),
+                          float(render_height_) / float(target_height_)));
+      const ImVec2 image_min = ImGui::GetItemRectMin();
+      const ImVec2 image_size = ImGui::GetItemRectSize();
+      if (ImGui::IsItemClicked() && image_size.x > 0.f && image_size.y > 0.f) {
+        // picked from the BVH next UpdateInstances, NDC is y up
+        const ImVec2 mouse = ImGui::GetMousePos();
+        const float u = (mouse.x - image_min.x) / image_size.x;
+        const float v = (mouse.y - image_min.y) / image_size.y;
+        pick_ndc_ = glm::vec2{ 2.f * u - 1.f, 1.f - 2.f * v };
+      }
+      if (picked_ < InstanceCount()) {
+        const u32 grid = instances_.Count();
+        const u32 objects = grid + objects_.Count();
+        const float time = float(lastTime);
+        const InstanceData inst =
+          picked_ < grid      ? instances_.Instance(time, picked_)
+          : picked_ < objects ? objects_.Instance(time, picked_ - grid)
+                              : boids_.Instance(time, picked_ - objects);
+        const glm::vec4 clip = camera_.Projection() * camera_.View() *
+                               glm::vec4{ inst.position[0],
+                                          inst.position[1],
+                                          inst.position[2],
+                                          1.f };
+        if (clip.w > 0.f) {
+          const ImVec2 at{
+            image_min.x + (clip.x / clip.w * .5f + .5f) * image_size.x,
+            image_min.y + (.5f - clip.y / clip.w * .5f) * image_size.y
+          };
+          ImDrawList* draw = ImGui::GetWindowDrawList();
+          draw->AddCircle(at, 8.f, IM_COL32(255, 220, 0, 255), 0, 2.f);
+          char label[32];
+          SDL_snprintf(label, sizeof(label), "#%u", picked_);
+          draw->AddText(
+            ImVec2{ at.x + 10.f, at.y - 10.f }, IM_COL32_WHITE, label);
+        }
+      }
       ImGui::End();
     }
 
     ImGui::ShowMetricsWindow();
 
+    if (ImGui::Begin("Stats")) {
+      RenderStatsPanel();
+    }
+    ImGui::End();
+
     if (ImGui::Begin("Settings")) {
       if (ImGui::TreeNode("Camera")) {
-        if (ImGui::SliderFloat("X", (float*)&camera_.Position.x, -50.f, 50.f) ||
-            ImGui::SliderFloat("Y", (float*)&camera_.Position.y, -50.f, 50.f) ||
-            ImGui::SliderFloat("Z", (float*)&camera_.Position.z, -50.f, 50.f)) {
-          camera_.Touched = true;
-        }
+        // the simulation moves the camera there on its next tick
+        auto& position = sim_input_.camera_position;
+        ImGui::SliderFloat("X", &position.x, -50.f, 50.f);
+        ImGui::SliderFloat("Y", &position.y, -50.f, 50.f);
+        ImGui::SliderFloat("Z", &position.z, -50.f, 50.f);
         ImGui::TreePop();
       }
       if (ImGui::TreeNode("Spin Cube")) {
@@ -631,10 +1528,291 @@ CubeProgram::DrawGui()
       }
       if (ImGui::TreeNode("Instancing")) {
         ImGui::InputFloat("Spread", &instance_cfg.spread);
-        ImGui::InputInt("Dimensions", (int*)&instance_cfg.dimension);
+        if (ImGui::InputInt("Dimensions", (int*)&instance_cfg.dimension)) {
+          // 100^3 is the million fish we're aiming for
+          instance_cfg.dimension =
+            std::clamp(int(instance_cfg.dimension), 1, 100);
+        }
+        ImGui::SliderFloat("Bob", &instance_cfg.bob, 0.f, 2.f);
+        ImGui::SliderFloat("Sway", &instance_cfg.sway, 0.f, 1.5f);
+        if (ImGui::InputInt("Objects", (int*)&object_count_, 1000, 10000)) {
+          object_count_ = std::clamp(int(object_count_), 0, 200000);
+        }
+        const auto entities = objects_.Stats();
+        ImGui::Text("%u instances, %u entities in %u chunks (%u spare)",
+                    InstanceCount(),
+                    entities.entities,
+                    entities.chunks,
+                    entities.spare_chunks);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Boids")) {
+        if (ImGui::InputInt("Fish", (int*)&boids_cfg_.count, 1000, 10000)) {
+          boids_cfg_.count = std::clamp(int(boids_cfg_.count), 0, 200000);
+        }
+        ImGui::SliderFloat("Radius", &boids_cfg_.radius, .25f, 4.f);
+        ImGui::SliderFloat(
+          "Separation radius", &boids_cfg_.separation_radius, 0.f, 2.f);
+        ImGui::SliderFloat("Separation", &boids_cfg_.separation, 0.f, 4.f);
+        ImGui::SliderFloat("Alignment", &boids_cfg_.alignment, 0.f, 4.f);
+        ImGui::SliderFloat("Cohesion", &boids_cfg_.cohesion, 0.f, 4.f);
+        ImGui::SliderFloat("Avoidance", &boids_cfg_.avoidance, 0.f, 10.f);
+        ImGui::SliderFloat(
+          "Min speed", &boids_cfg_.min_speed, 0.f, boids_cfg_.max_speed);
+        ImGui::SliderFloat(
+          "Max speed", &boids_cfg_.max_speed, boids_cfg_.min_speed, 10.f);
+        ImGui::SliderFloat("Max force", &boids_cfg_.max_force, 0.f, 20.f);
+        ImGui::SliderInt("Obstacles",
+                         (int*)&boids_cfg_.obstacles,
+                         0,
+                         int(Boids::kMaxObstacles));
+        const auto& stats = boids_.Stats();
+        ImGui::Text("Hash: %.3f ms, steering: %.3f ms",
+                    stats.sort_ms,
+                    stats.steer_ms);
+        ImGui::Text("%.1f neighbors per fish", stats.neighbors);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Skinning")) {
+        if (skinning_.Active()) {
+          if (skinning_.ClipCount() > 1) {
+            ImGui::SliderInt("Clip",
+                             (int*)&skinning_cfg_.clip,
+                             0,
+                             int(skinning_.ClipCount() - 1));
+          }
+          ImGui::Text("Playing %s",
+                      skinning_.ClipName(std::min(
+                        skinning_cfg_.clip, skinning_.ClipCount() - 1)));
+          ImGui::SliderInt("Poses",
+                           (int*)&skinning_cfg_.poses,
+                           1,
+                           int(Skinning::kMaxPoses));
+          ImGui::SliderFloat("Rate", &skinning_cfg_.rate, 0.f, 4.f);
+          const auto& stats = skinning_.Stats();
+          ImGui::Text("%u joints, %u vertices skinned %u times",
+                      stats.joints,
+                      stats.vertices,
+                      stats.poses);
+          ImGui::Text("Palettes: %.3f ms", stats.cpu_ms);
+          if (ImGui::Button("Validate against CPU")) {
+            validate_skinning_ = true;
+          }
+          const auto& v = skinning_.LastValidation();
+          if (v.ran) {
+            ImGui::Text("%s: error %.1e palettes, %.1e vertices",
+                        v.passed ? "OK" : "FAILED",
+                        v.palette_error,
+                        v.vertex_error);
+          }
+        } else {
+          ImGui::Text("The model has no animated skin");
+        }
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Culling")) {
+        if (ImGui::RadioButton("Off", cull_mode_ == CullMode::None)) {
+          cull_mode_ = CullMode::None;
+        }
+        ImGui::SameLine();
+        if (ImGui::RadioButton("CPU", cull_mode_ == CullMode::Cpu)) {
+          cull_mode_ = CullMode::Cpu;
+        }
+        if (gpu_culling_available_) {
+          ImGui::SameLine();
+          if (ImGui::RadioButton("GPU", cull_mode_ == CullMode::Gpu)) {
+            cull_mode_ = CullMode::Gpu;
+          }
+        }
+        if (cull_mode_ == CullMode::Cpu) {
+          ImGui::Checkbox("BVH", &bvh_culling_);
+          if (bvh_culling_) {
+            const auto& bvh = bvh_.Stats();
+            ImGui::Text("%u nodes, %u leaves, depth %u",
+                        bvh.nodes,
+                        bvh.leaves,
+                        bvh.depth);
+            ImGui::Text("SAH %.1f, %u rebuilds, last %.2f ms",
+                        bvh.sah_cost,
+                        bvh.rebuilds,
+                        bvh.build_ms);
+            ImGui::Text("Update %.2f ms, %u nodes visited",
+                        bvh.update_ms,
+                        bvh.visited);
+          } else {
+            const auto& stats = culler_.Stats();
+            ImGui::Text("Visible: %u", stats.visible);
+            ImGui::Text("Culled: %u", stats.culled);
+          }
+          ImGui::Checkbox("Occlusion", &occlusion_culling_);
+          if (occlusion_culling_) {
+            const auto& occ = occlusion_.Stats();
+            ImGui::SliderInt("Occluders",
+                             (int*)&occlusion_cfg_.occluder_count,
+                             0,
+                             2048);
+            ImGui::SliderFloat(
+              "Occluder size", &occlusion_cfg_.occluder_shrink, .1f, 1.f);
+            ImGui::Text("Occluded: %u of %u (%.1f%%), %u occluders",
+                        occ.occluded,
+                        occ.tested,
+                        occ.Rate() * 100.f,
+                        occ.occluders);
+          }
+        } else if (cull_mode_ == CullMode::Gpu) {
+          // counts stay on the GPU, only a validation run reads them back
+          if (ImGui::Button("Validate against CPU")) {
+            validate_gpu_culling_ = true;
+          }
+          const auto& v = gpu_culler_.LastValidation();
+          if (v.ran) {
+            ImGui::Text("%s: GPU %u / CPU %u visible, %u mismatches",
+                        v.passed ? "OK" : "FAILED",
+                        v.gpu_visible,
+                        v.cpu_visible,
+                        v.mismatches);
+          }
+        }
         ImGui::TreePop();
       }
       ImGui::Checkbox("Wireframe", &wireframe_);
+      ImGui::Checkbox("Depth prepass", &depth_prepass_);
+      if (depth_prepass_ && wireframe_) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(not in wireframe)");
+      }
+      if (ImGui::TreeNode("Lighting")) {
+        auto& cfg = lighting_cfg_;
+        ImGui::Checkbox("Point lights", &cfg.enabled);
+        ImGui::SliderInt("Lights", (int*)&cfg.light_count, 0, 4096);
+        ImGui::SliderFloat("Radius", &cfg.radius, .5f, 30.f);
+        ImGui::SliderFloat("Intensity", &cfg.intensity, 0.f, 10.f);
+        ImGui::SliderFloat("Ambient", &cfg.ambient, 0.f, 1.f);
+        const auto& stats = lighting_.Stats();
+        ImGui::Text("%u lights in view, %u in the busiest cluster",
+                    stats.lights,
+                    stats.max_lights);
+        ImGui::Text("%u light references", stats.references);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Frame pacing")) {
+        for (auto mode : { SDL_GPU_PRESENTMODE_VSYNC,
+                           SDL_GPU_PRESENTMODE_MAILBOX,
+                           SDL_GPU_PRESENTMODE_IMMEDIATE }) {
+          if (mode != SDL_GPU_PRESENTMODE_VSYNC) {
+            ImGui::SameLine();
+          }
+          if (ImGui::RadioButton(FramePacer::PresentModeName(mode),
+                                 pacing_cfg_.present_mode == mode)) {
+            pacing_cfg_.present_mode = mode;
+          }
+        }
+        ImGui::SliderInt(
+          "Frames in flight", (int*)&pacing_cfg_.frames_in_flight, 1, 3);
+        ImGui::SliderFloat("FPS limit",
+                           &pacing_cfg_.fps_limit,
+                           0.f,
+                           480.f,
+                           pacing_cfg_.fps_limit == 0.f ? "Off" : "%.0f");
+        ImGui::Text("Frame: %.3f ms", DeltaTime * 1000.f);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Simulation")) {
+        if (sim_.Running()) {
+          float hz = sim_.Rate();
+          if (ImGui::SliderFloat("Tick rate", &hz, 10.f, 480.f, "%.0f Hz")) {
+            sim_.SetRate(hz);
+          }
+        } else {
+          ImGui::Text("Stepped once per frame");
+        }
+        const auto& snapshot = sim_.Latest();
+        ImGui::Text("Tick %llu, %.3f ms",
+                    (unsigned long long)snapshot.tick,
+                    snapshot.tick_ms);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Capture")) {
+        if (!capture_.Capturing() && ImGui::Button("Record capture.y4m")) {
+          capture_.Start("capture.y4m", false);
+        } else if (capture_.Capturing() && ImGui::Button("Stop")) {
+          capture_.Stop();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Screenshot")) {
+          char path[32];
+          SDL_snprintf(
+            path, sizeof(path), "screenshot_%03u.png", screenshots_++);
+          capture_.Screenshot(path);
+        }
+        const FrameCaptureStats stats = capture_.Stats();
+        ImGui::Text("%llu written, %llu dropped",
+                    (unsigned long long)stats.written,
+                    (unsigned long long)stats.dropped);
+        ImGui::Text("%u in flight, %u queued", stats.in_flight, stats.queued);
+        ImGui::Text("Readback: %.3f ms, encode: %.3f ms",
+                    stats.copy_ms,
+                    stats.encode_ms);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Command buffers")) {
+        ImGui::Text("%u workers", jobs_.WorkerCount());
+        // last frame's, in submission order
+        for (const auto& pass : recorder_.Passes()) {
+          ImGui::Text("%s: %.3f ms", pass.name, pass.record_ms);
+        }
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Profiler")) {
+#ifdef SDLCUBE_PROFILE
+        bool enabled = Profiler::Enabled();
+        if (ImGui::Checkbox("Record zones", &enabled)) {
+          Profiler::SetEnabled(enabled);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Save trace")) {
+          // chrome://tracing or ui.perfetto.dev
+          if (Profiler::WriteTrace("trace.json")) {
+            LOG_INFO("Wrote trace.json");
+          } else {
+            LOG_ERROR("Couldn't write trace.json");
+          }
+        }
+        if (enabled) {
+          ProfilerFlameView();
+        }
+#else
+        ImGui::TextDisabled("Built without SDLCUBE_PROFILE");
+#endif
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Resolution")) {
+        if (ImGui::Checkbox("Dynamic", &dynamic_resolution_enabled_)) {
+          dynamic_resolution_.Reset();
+        }
+        auto& cfg = dynamic_resolution_cfg_;
+        if (dynamic_resolution_enabled_) {
+          ImGui::SliderFloat("Target (ms)", &cfg.target_ms, 4.f, 50.f);
+          ImGui::SliderFloat("Min scale", &cfg.min_scale, .25f, 1.f);
+          // the targets are only full size
+          ImGui::SliderFloat("Max scale", &cfg.max_scale, cfg.min_scale, 1.f);
+          ImGui::Text("Frame: %.2f ms", dynamic_resolution_.SmoothedMs());
+        } else {
+          ImGui::SliderFloat("Scale", &render_scale_, .25f, 1.f);
+        }
+        ImGui::Text("%ux%u (%.0f%%)",
+                    render_width_,
+                    render_height_,
+                    100.f * render_width_ / float(vp_width_));
+        ImGui::TreePop();
+      }
+      ImGui::Text("%llu draws, %llu binds (%llu elided)",
+                  (unsigned long long)RenderStats::Last(Counter::Draws),
+                  (unsigned long long)RenderStats::Last(Counter::Binds),
+                  (unsigned long long)RenderStats::Last(Counter::ElidedBinds));
+      if (pipelines_.PendingCount() != 0) {
+        ImGui::Text("Compiling %u pipelines", pipelines_.PendingCount());
+      }
       ImGui::End();
     }
   }
@@ -3,18 +3,37 @@
 #include <SDL3/SDL_gpu.h>
 #include <SDL3/SDL_stdinc.h>
 #include <imgui/imgui.h>
+#include <optional>
 
 #include "camera.h"
 #include "program.h"
 #include "skybox.h"
+#include "src/bench.h"
+#include "src/boids.h"
+#include "src/clustered_lighting.h"
+#include "src/command_recorder.h"
+#include "src/culling.h"
+#include "src/dynamic_resolution.h"
+#include "src/frame_capture.h"
+#include "src/frame_pacing.h"
 #include "src/gltf_loader.h"
+#include "src/gpu_culling.h"
+#include "src/instance_bvh.h"
+#include "src/instances.h"
+#include "src/job_system.h"
+#include "src/occlusion.h"
+#include "src/pipeline_registry.h"
+#include "src/render_queue.h"
+#include "src/replay.h"
+#include "src/scene_objects.h"
+#include "src/simulation.h"
+#include "src/skinning.h"
 #include "transform.h"
 #include "util.h"
 
 struct Rotation
 {
   const char* name;
-  float* axis;
   float speed;
 };
 
@@ -25,12 +44,6 @@ struct MatricesBinding
   // glm::mat4 cameraModel;
 };
 
-struct InstancingCfg
-{
-  float spread = 5.f;   // gap between each mesh instance
-  Uint32 dimension = 6; // instance count per side
-};
-
 class CubeProgram : public Program
 {
 public:
@@ -46,31 +59,156 @@ public:
   bool ShouldQuit() override;
   ~CubeProgram();
 
+  // Without a window there's no GUI or swapchain, and every frame's last
+  // command buffer comes with a fence.
+  bool Headless() const { return Window == nullptr; }
+  // Settings and scene target size for the next frames
+  bool SetBenchCase(const BenchCase& bench);
+  // Frames whose GPU culling was checked since the last SetBenchCase, and
+  // how many of them differed from the CPU reference
+  u32 CullingValidated() const { return culling_validated_; }
+  u32 CullingMismatched() const { return culling_mismatched_; }
+  // The last headless frame's fence, to wait on and release, or null.
+  SDL_GPUFence* TakeFrameFence();
+  // Writes every drawn frame's settings and input to `path`.
+  bool StartRecording(const char* path);
+  // Writes every drawn frame's scene to `path`, see FrameCapture. Headless
+  // runs never drop frames.
+  bool StartCapture(const char* path);
+  // The next frames take their settings and GUI input from a recording and
+  // run at its fixed time step. Quits after its last frame.
+  bool StartReplay(const char* path);
+  const ReplayReader& Replay() const { return replay_reader_; }
+  // Back to the recording's first frame and the cube's initial rotation.
+  void RewindReplay();
+  // Moves the scene on a thread of its own from now on, instead of once per
+  // drawn frame. Not for benchmarks and replays, they step it themselves.
+  bool StartSimulation();
+
 private:
   bool InitGui();
   bool LoadShaders();
   bool LoadTextures();
   bool SendVertexData();
   bool CreateSceneRenderTargets();
+  bool ResizeSceneTargets();
   ImDrawData* DrawGui();
   void UpdateScene();
+  bool UpdateInstances();
+  // The grid's instances, the scene objects then the boids
+  u32 InstanceCount() const
+  {
+    return instances_.Count() + objects_.Count() + boids_.Count();
+  }
+  bool UpdateLights();
+  void FillRenderQueue(bool gpu_culling);
+  void QueueCommandBuffers(bool gpu_culling, const SDL_GPUViewport& viewport);
+  bool RecordUploads(SDL_GPUCommandBuffer* cmdbuf, bool gpu_culling);
+  bool CreateGpuCullingPipelines(SDL_GPUGraphicsPipelineCreateInfo info);
+  bool CreateDepthPrepassPipelines(SDL_GPUGraphicsPipelineCreateInfo info);
+  bool StepReplay();
+  ReplaySettings CaptureSettings() const;
+  void ApplySettings(const ReplaySettings& settings);
 
 private:
   // Internals:
   bool quit{ false };
   Transform cube_transform_;
   Camera camera_{ glm::radians(60.0f), 640 / 480.f, .1f, 100.f };
-  Skybox skybox_{ "resources/textures/skybox", Window, Device };
+  PipelineRegistry pipelines_{ Device };
+  Skybox skybox_{ "resources/textures/skybox",
+                  kSceneColorFormat,
+                  kSceneDepthFormat,
+                  Device,
+                  pipelines_ };
   GLTFLoader loader{"resources/models/BarramundiFishGLTF/BarramundiFish.gltf"};
   const char* vertex_path_;
   const char* fragment_path_;
-  const int vp_width_{ 640 };
-  const int vp_height_{ 480 };
+  const char* gpu_cull_vertex_path_ =
+    "resources/shaders/compiled/vert_gpu_cull.vert.spv";
+  const char* cull_compute_path_ = "resources/shaders/compiled/cull.comp.spv";
+  const char* depth_vertex_path_ =
+    "resources/shaders/compiled/vert_depth.vert.spv";
+  const char* depth_gpu_cull_vertex_path_ =
+    "resources/shaders/compiled/vert_depth_gpu_cull.vert.spv";
+  const char* depth_fragment_path_ =
+    "resources/shaders/compiled/depth.frag.spv";
+  const char* skin_compute_path_ = "resources/shaders/compiled/skin.comp.spv";
+  // Scene panel size in pixels, what the camera and the viewport follow
+  int vp_width_{ 640 };
+  int vp_height_{ 480 };
+  // Size the scene targets were created at, they lag the panel
+  int target_width_{ 0 };
+  int target_height_{ 0 };
+  int panel_width_{ 0 }; // measured by the last GUI frame
+  int panel_height_{ 0 };
+  u32 panel_stable_frames_{ 0 };
+  static constexpr u32 kResizeSettleFrames = 10;
+  FramePacer pacer_{ Device, Window };
+  JobSystem jobs_;
+  InstanceField instances_;
+  SceneObjects objects_; // drawn after the grid's instances
+  Boids boids_;          // drawn after the scene objects
+  Skinning skinning_{ Device }; // when the model has an animated skin
+  double objects_time_{ 0. }; // of their last move, the boids' too
+  FrustumCuller culler_;
+  GpuCuller gpu_culler_{ Device };
+  OcclusionCuller occlusion_;
+  InstanceBvh bvh_; // CPU culling on request, and picking
+  std::optional<glm::vec2> pick_ndc_; // a click on the scene, next frame
+  u32 picked_{ BvhHit::kNone };
+  std::vector<InstanceData> frame_instances_; // culling input, all instances
+  std::vector<InstanceData> frustum_visible_; // occlusion input
+  const u32 occlusion_width_{ 256 };
+  Uint32 visible_instances_{ 0 };
+  RenderQueue render_queue_;
+  CommandRecorder recorder_{ Device };
+  FrameCapture capture_{ Device }; // after the scene's command buffers
+  u32 screenshots_{ 0 };           // taken from the GUI, names the next one
+  // Scene draws are recorded in command buffers of at most this many draws
+  static constexpr u32 kDrawsPerCommandBuffer = 256;
+  ClusteredLighting lighting_{ Device };
+  std::vector<PointLight> lights_;
+  // One draw per submesh of every mesh, instance counts filled per frame
+  std::vector<SDL_GPUIndexedIndirectDrawCommand> submesh_draws_;
+  std::vector<u32> submesh_meshes_; // mesh of every submesh_draws_ entry
+  float cull_radius_{ 0.f };
+  DynamicResolution dynamic_resolution_;
+  // Part of the scene targets rendered to this frame, shown upscaled
+  u32 render_width_{ 0 };
+  u32 render_height_{ 0 };
+  SDL_GPUFence* frame_fence_{ nullptr }; // headless only
+  ReplayWriter replay_writer_;
+  ReplayReader replay_reader_;
+  std::vector<SDL_Event> polled_events_; // since the last drawn frame
+  Simulation sim_;
+  static constexpr float kSimulationHz = 120.f;
 
   // User controls:
   Rotation rotations_[3]; // spin cube
+  SimulationInput sim_input_{}; // camera and spin the simulation follows
   InstancingCfg instance_cfg{};
+  u32 object_count_{ 0 };
+  BoidsCfg boids_cfg_{};
+  SkinningCfg skinning_cfg_{};
+  bool validate_skinning_{ false };
   bool wireframe_{ false };
+  bool depth_prepass_{ false };
+  bool dynamic_resolution_enabled_{ false };
+  DynamicResolutionCfg dynamic_resolution_cfg_{};
+  float render_scale_{ 1.f }; // with dynamic resolution off
+  FramePacingCfg pacing_cfg_{};
+  LightingCfg lighting_cfg_{};
+  ClusterGridCfg cluster_cfg_{};
+  CullMode cull_mode_{ CullMode::Cpu };
+  bool occlusion_culling_{ true };
+  bool bvh_culling_{ false };
+  OcclusionCfg occlusion_cfg_{};
+  bool gpu_culling_available_{ false };
+  bool validate_gpu_culling_{ false };
+  bool validate_every_frame_{ false }; // benchmarks' --validate-culling
+  u32 culling_validated_{ 0 };
+  u32 culling_mismatched_{ 0 };
 
   // GPU Resources:
   SDL_GPUTexture* depth_target_{ nullptr };
@@ -78,12 +216,23 @@ private:
   // TODO: store scene-related GPU Resources in GLTF scene class
   std::vector<SDL_GPUTexture*> textures_; 
   std::vector<SDL_GPUSampler*> samplers_;
-  SDL_GPUShader* vertex_{ nullptr };
-  SDL_GPUShader* fragment_{ nullptr };
-  SDL_GPUGraphicsPipeline* scene_pipeline_{ nullptr };
-  SDL_GPUGraphicsPipeline* scene_wireframe_pipeline_{ nullptr };
+  SDL_GPUShader* vertex_{ nullptr };   // owned by pipelines_
+  SDL_GPUShader* fragment_{ nullptr }; // owned by pipelines_
+  PipelineHandle scene_pipeline_{ kNoPipeline };
+  PipelineHandle scene_wireframe_pipeline_{ kNoPipeline };
+  PipelineHandle scene_gpu_cull_pipeline_{ kNoPipeline };
+  PipelineHandle scene_gpu_cull_wireframe_pipeline_{ kNoPipeline };
+  // Depth prepass: position only depth writes, then shading with depth EQUAL
+  PipelineHandle depth_pipeline_{ kNoPipeline };
+  PipelineHandle depth_gpu_cull_pipeline_{ kNoPipeline };
+  PipelineHandle scene_equal_pipeline_{ kNoPipeline };
+  PipelineHandle scene_gpu_cull_equal_pipeline_{ kNoPipeline };
   SDL_GPUBuffer* vbuffer_{ nullptr };
+  SDL_GPUBuffer* pbuffer_{ nullptr }; // positions only, same layout as vbuffer_
   SDL_GPUBuffer* ibuffer_{ nullptr };
+  i64 geometry_bytes_{ 0 }; // the three buffers above, for RenderStats
+  SDL_GPUIndexElementSize index_size_{ SDL_GPU_INDEXELEMENTSIZE_16BIT };
+  InstanceBuffer instance_buffer_{ Device };
   SDL_GPUColorTargetInfo scene_color_target_info_{};
   SDL_GPUDepthStencilTargetInfo scene_depth_target_info_{};
   SDL_GPUColorTargetInfo swapchain_target_info_{};
@@ -0,0 +1,221 @@
+#include "culling.h"
+
+#include <SDL3/SDL_stdinc.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr u32 kGrain = 4096; // instances per job, multiple of the SIMD width
+constexpr u32 kStride = sizeof(InstanceData) / sizeof(float);
+
+bool
+SphereVisible(const Frustum& f, const float* p, float r)
+{
+  for (const auto& plane : f.Planes) {
+    if (plane.x * p[0] + plane.y * p[1] + plane.z * p[2] + plane.w < -r) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Compacts the visible instances of [begin, end) to the front of the range,
+// returns how many survived.
+u32
+CullRange(const Frustum& f,
+          float radius,
+          InstanceData* instances,
+          u32 begin,
+          u32 end)
+{
+  u32 write = begin;
+  u32 i = begin;
+  auto keep = [&](u32 idx) {
+    if (write != idx) {
+      instances[write] = instances[idx];
+    }
+    ++write;
+  };
+
+#if defined(__AVX2__) && defined(__FMA__)
+  {
+    __m256 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count],
+      nw[Frustum::Count];
+    for (int p = 0; p < Frustum::Count; ++p) {
+      nx[p] = _mm256_set1_ps(f.Planes[p].x);
+      ny[p] = _mm256_set1_ps(f.Planes[p].y);
+      nz[p] = _mm256_set1_ps(f.Planes[p].z);
+      nw[p] = _mm256_set1_ps(f.Planes[p].w);
+    }
+    const __m256 rad = _mm256_set1_ps(radius);
+
+    for (; i + 8 <= end; i += 8) {
+      // rows hold {x, y, z, scale} of instance k and k + 4
+      const float* src = reinterpret_cast<const float*>(&instances[i]);
+      __m256 r[4];
+      for (int k = 0; k < 4; ++k) {
+        r[k] = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(_mm_loadu_ps(src + k * kStride)),
+          _mm_loadu_ps(src + (k + 4) * kStride),
+          1);
+      }
+      const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+      const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+      const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+      const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+      const __m256 x = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+      const __m256 y = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+      const __m256 z = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+      const __m256 s = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+      const __m256 rs = _mm256_mul_ps(rad, s);
+
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for (int p = 0; p < Frustum::Count; ++p) {
+        __m256 d = _mm256_fmadd_ps(x, nx[p], nw[p]);
+        d = _mm256_fmadd_ps(y, ny[p], d);
+        d = _mm256_fmadd_ps(z, nz[p], d);
+        d = _mm256_add_ps(d, rs);
+        inside = _mm256_and_ps(
+          inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+      }
+
+      // lanes are in instance order: 0-3 from the low half, 4-7 the high one
+      u32 mask = static_cast<u32>(_mm256_movemask_ps(inside));
+      for (; mask != 0; mask &= mask - 1) {
+        keep(i + static_cast<u32>(__builtin_ctz(mask)));
+      }
+    }
+  }
+#endif
+
+#if defined(__SSE2__)
+  {
+    __m128 nx[Frustum::Count], ny[Frustum::Count], nz[Frustum::Count],
+      nw[Frustum::Count];
+    for (int p = 0; p < Frustum::Count; ++p) {
+      nx[p] = _mm_set1_ps(f.Planes[p].x);
+      ny[p] = _mm_set1_ps(f.Planes[p].y);
+      nz[p] = _mm_set1_ps(f.Planes[p].z);
+      nw[p] = _mm_set1_ps(f.Planes[p].w);
+    }
+    const __m128 rad = _mm_set1_ps(radius);
+
+    for (; i + 4 <= end; i += 4) {
+      const float* src = reinterpret_cast<const float*>(&instances[i]);
+      __m128 x = _mm_loadu_ps(src + 0 * kStride);
+      __m128 y = _mm_loadu_ps(src + 1 * kStride);
+      __m128 z = _mm_loadu_ps(src + 2 * kStride);
+      __m128 s = _mm_loadu_ps(src + 3 * kStride);
+      _MM_TRANSPOSE4_PS(x, y, z, s);
+      const __m128 rs = _mm_mul_ps(rad, s);
+
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (int p = 0; p < Frustum::Count; ++p) {
+        __m128 d = _mm_add_ps(_mm_mul_ps(x, nx[p]), nw[p]);
+        d = _mm_add_ps(_mm_mul_ps(y, ny[p]), d);
+        d = _mm_add_ps(_mm_mul_ps(z, nz[p]), d);
+        d = _mm_add_ps(d, rs);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+      }
+
+      u32 mask = static_cast<u32>(_mm_movemask_ps(inside));
+      for (; mask != 0; mask &= mask - 1) {
+        keep(i + static_cast<u32>(__builtin_ctz(mask)));
+      }
+    }
+  }
+#endif
+
+  for (; i < end; ++i) {
+    if (SphereVisible(f, instances[i].position, radius * instances[i].scale)) {
+      keep(i);
+    }
+  }
+  return write - begin;
+}
+
+} // namespace
+
+float
+InstanceCullRadius(const MeshBounds& bounds, const glm::mat4& model)
+{
+  const glm::vec3 offset{ model * glm::vec4{ bounds.Center, 1.f } };
+  const float axis_scale =
+    glm::max(glm::length(glm::vec3{ model[0] }),
+             glm::max(glm::length(glm::vec3{ model[1] }),
+                      glm::length(glm::vec3{ model[2] })));
+  return glm::length(offset) + bounds.Radius * axis_scale;
+}
+
+void
+CullReference(const Frustum& frustum,
+              float radius,
+              const InstanceData* instances,
+              u32 count,
+              float epsilon,
+              std::vector<u32>& visible,
+              std::vector<u32>& borderline)
+{
+  visible.clear();
+  borderline.clear();
+  for (u32 i = 0; i < count; ++i) {
+    const float* p = instances[i].position;
+    const float r = radius * instances[i].scale;
+    float closest = SDL_MAX_FLOAT;
+    for (const auto& plane : frustum.Planes) {
+      const float d = plane.x * p[0] + plane.y * p[1] + plane.z * p[2] +
+                      plane.w + r;
+      closest = std::min(closest, d);
+    }
+    if (closest >= 0.f) {
+      visible.push_back(i);
+    }
+    if (std::abs(closest) <= epsilon) {
+      borderline.push_back(i);
+    }
+  }
+}
+
+u32
+FrustumCuller::Cull(const Frustum& frustum,
+                    float radius,
+                    InstanceData* instances,
+                    u32 count,
+                    JobSystem& jobs,
+                    InstanceData* out)
+{
+  const u32 chunks = (count + kGrain - 1) / kGrain;
+  chunk_counts_.assign(chunks, 0);
+
+  jobs.ParallelFor(count, kGrain, [&](u32 begin, u32 end) {
+    chunk_counts_[begin / kGrain] =
+      CullRange(frustum, radius, instances, begin, end);
+  });
+
+  // chunk_counts_ becomes each chunk's offset in `out`
+  u32 visible = 0;
+  for (auto& c : chunk_counts_) {
+    const u32 n = c;
+    c = visible;
+    visible += n;
+  }
+
+  jobs.ParallelFor(chunks, 1, [&](u32 begin, u32 end) {
+    for (u32 c = begin; c < end; ++c) {
+      const u32 next = c + 1 < chunks ? chunk_counts_[c + 1] : visible;
+      std::memcpy(out + chunk_counts_[c],
+                  instances + c * kGrain,
+                  (next - chunk_counts_[c]) * sizeof(InstanceData));
+    }
+  });
+
+  stats_.visible = visible;
+  stats_.culled = count - visible;
+  return visible;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "src/camera.h"
+#include "src/gltf_loader.h"
+#include "src/instances.h"
+#include "src/job_system.h"
+#include "types.h"
+
+enum class CullMode
+{
+  None,
+  Cpu, // SIMD frustum (+ occlusion) test, only visible instances are uploaded
+  Gpu, // compute pass + indirect draw
+};
+
+struct CullStats
+{
+  u32 visible{ 0 };
+  u32 culled{ 0 };
+};
+
+// Radius of a sphere centered on an instance's position that contains the
+// mesh under `model` and any yaw the instance adds on top of it.
+float
+InstanceCullRadius(const MeshBounds& bounds, const glm::mat4& model);
+
+// Scalar reference for the SIMD and GPU cullers: indices of the visible
+// instances, in order. Instances within `epsilon` of a plane also go to
+// `borderline`, rounding may put them on either side elsewhere.
+void
+CullReference(const Frustum& frustum,
+              float radius,
+              const InstanceData* instances,
+              u32 count,
+              float epsilon,
+              std::vector<u32>& visible,
+              std::vector<u32>& borderline);
+
+// Sphere vs frustum test over every instance, 4 (SSE) or 8 (AVX2) at a time.
+class FrustumCuller
+{
+public:
+  // Writes the instances whose sphere (position, radius * scale) touches
+  // `frustum` to `out`, keeping their order, and returns how many there are.
+  // `instances` is compacted in place chunk by chunk, so its content is
+  // unspecified afterwards.
+  u32 Cull(const Frustum& frustum,
+           float radius,
+           InstanceData* instances,
+           u32 count,
+           JobSystem& jobs,
+           InstanceData* out);
+
+  const CullStats& Stats() const { return stats_; }
+
+private:
+  std::vector<u32> chunk_counts_;
+  CullStats stats_;
+};
@@ -0,0 +1,59 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr float kSmoothing = .15f; // weight of the newest frame
+constexpr float kTolerance = .05f; // over budget by less than this is fine
+constexpr float kMaxStepDown = .85f;
+constexpr float kMaxStepUp = 1.05f;
+constexpr float kProbeStep = 1.02f;
+constexpr u32 kProbeFrames = 30;
+constexpr u32 kGranularity = 8;
+
+} // namespace
+
+float
+DynamicResolution::Update(float frame_ms, const DynamicResolutionCfg& cfg)
+{
+  smoothed_ms_ = smoothed_ms_ == 0.f
+                   ? frame_ms
+                   : smoothed_ms_ + (frame_ms - smoothed_ms_) * kSmoothing;
+
+  const float before = scale_;
+  if (smoothed_ms_ > cfg.target_ms * (1.f + kTolerance)) {
+    scale_ *= std::max(std::sqrt(cfg.target_ms / smoothed_ms_), kMaxStepDown);
+  } else if (smoothed_ms_ < cfg.target_ms * (1.f - kTolerance)) {
+    scale_ *= std::min(std::sqrt(cfg.target_ms / smoothed_ms_), kMaxStepUp);
+  } else if (++frames_in_budget_ >= kProbeFrames) {
+    scale_ *= kProbeStep;
+  }
+  scale_ =
+    std::clamp(scale_, cfg.min_scale, std::max(cfg.min_scale, cfg.max_scale));
+  if (scale_ != before) {
+    // older frames were rendered at the old scale: carry the average over as
+    // what it'd be at the new pixel count, restarting it would leave a single
+    // noisy sample to steer by while the scale is still moving
+    smoothed_ms_ *= (scale_ * scale_) / (before * before);
+    frames_in_budget_ = 0;
+  }
+  return scale_;
+}
+
+void
+DynamicResolution::Reset()
+{
+  scale_ = 1.f;
+  smoothed_ms_ = 0.f;
+  frames_in_budget_ = 0;
+}
+
+u32
+DynamicResolution::Scaled(u32 size, float scale)
+{
+  const u32 steps =
+    static_cast<u32>(std::lround(size * scale / float(kGranularity)));
+  return std::clamp(steps * kGranularity, std::min(kGranularity, size), size);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "types.h"
+
+struct DynamicResolutionCfg
+{
+  float target_ms{ 16.6f };
+  float min_scale{ .5f };
+  float max_scale{ 1.f };
+};
+
+// Picks the fraction of the scene target to render into from frame times.
+//
+// Shading cost goes with the pixel count, so with the frame over budget the
+// scale shrinks by sqrt(target / time), a bounded step at a time. Under a
+// vsynced swapchain frames never come in early, so while the budget is met
+// the scale creeps back up until it isn't.
+class DynamicResolution
+{
+public:
+  // Feeds the last frame's time, returns the scale for the next frame.
+  float Update(float frame_ms, const DynamicResolutionCfg& cfg);
+  void Reset();
+
+  float Scale() const { return scale_; }
+  float SmoothedMs() const { return smoothed_ms_; }
+
+  // `size * scale`, in steps of 8 pixels so small scale changes don't
+  // resize the render area every frame. Never 0 nor over `size`.
+  static u32 Scaled(u32 size, float scale);
+
+private:
+  float scale_{ 1.f };
+  float smoothed_ms_{ 0.f };
+  u32 frames_in_budget_{ 0 };
+};
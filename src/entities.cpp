@@ -0,0 +1,284 @@
+#include "entities.h"
+
+#include <SDL3/SDL_stdinc.h>
+#include <bit>
+#include <cassert>
+#include <iterator>
+#include <new>
+
+#include "src/logger.h"
+
+namespace {
+
+constexpr u32 kArrayAlign = 64; // every array starts on a cache line
+
+constexpr u32 kComponentSize[] = {
+  sizeof(TransformComponent),
+  sizeof(BoundsComponent),
+  sizeof(RenderComponent),
+  sizeof(VelocityComponent),
+};
+static_assert(std::size(kComponentSize) == u32(Component::Count));
+static_assert(std::is_trivially_copyable_v<TransformComponent> &&
+                std::is_trivially_copyable_v<BoundsComponent> &&
+                std::is_trivially_copyable_v<RenderComponent> &&
+                std::is_trivially_copyable_v<VelocityComponent>,
+              "entities move between chunk rows with memcpy");
+
+u32
+AlignUp(u32 offset)
+{
+  return (offset + kArrayAlign - 1) & ~(kArrayAlign - 1);
+}
+
+// Default value of component `c` at `at`
+void
+Construct(Component c, std::byte* at)
+{
+  switch (c) {
+    case Component::Transform:
+      new (at) TransformComponent{};
+      break;
+    case Component::Bounds:
+      new (at) BoundsComponent{};
+      break;
+    case Component::Render:
+      new (at) RenderComponent{};
+      break;
+    case Component::Velocity:
+      new (at) VelocityComponent{};
+      break;
+    case Component::Count:
+      break;
+  }
+}
+
+template<typename Fn>
+void
+ForComponents(ComponentMask mask, const Fn& fn)
+{
+  for (u32 c = 0; c < u32(Component::Count); ++c) {
+    if (mask & MaskOf(Component(c))) {
+      fn(Component(c), kComponentSize[c]);
+    }
+  }
+}
+
+} // namespace
+
+EntityStore::EntityStore() = default;
+
+EntityStore::~EntityStore() = default;
+
+Entity
+EntityStore::Create(ComponentMask mask)
+{
+  const u32 archetype = FindArchetype(mask);
+  Archetype& a = archetypes_[archetype];
+  if (a.chunks.empty() || a.chunks.back().count == a.capacity) {
+    a.chunks.push_back(Chunk{ TakeBlock(), 0 });
+  }
+  Chunk& chunk = a.chunks.back();
+  const u32 row = chunk.count++;
+
+  u32 index;
+  if (!free_.empty()) {
+    index = free_.back();
+    free_.pop_back();
+  } else {
+    index = static_cast<u32>(records_.size());
+    records_.emplace_back();
+  }
+  Record& r = records_[index];
+  r.archetype = archetype;
+  r.chunk = static_cast<u32>(a.chunks.size() - 1);
+  r.row = row;
+  r.alive = true;
+
+  const Entity entity{ index, r.generation };
+  Entities(a, chunk)[row] = entity;
+  ForComponents(mask, [&](Component c, u32 size) {
+    Construct(c, Column(a, chunk, c) + row * size);
+  });
+  ++a.count;
+  ++alive_;
+  return entity;
+}
+
+void
+EntityStore::Destroy(Entity entity)
+{
+  if (!Alive(entity)) {
+    return;
+  }
+  Record& r = records_[entity.index];
+  Archetype& a = archetypes_[r.archetype];
+  const u32 last_chunk = static_cast<u32>(a.chunks.size() - 1);
+  Chunk& last = a.chunks[last_chunk];
+  const u32 last_row = last.count - 1;
+  if (r.chunk != last_chunk || r.row != last_row) {
+    // the archetype's last entity fills the hole, chunks stay packed
+    Chunk& chunk = a.chunks[r.chunk];
+    const Entity moved = Entities(a, last)[last_row];
+    Entities(a, chunk)[r.row] = moved;
+    ForComponents(a.mask, [&](Component c, u32 size) {
+      SDL_memcpy(Column(a, chunk, c) + r.row * size,
+                 Column(a, last, c) + last_row * size,
+                 size);
+    });
+    Record& m = records_[moved.index];
+    m.chunk = r.chunk;
+    m.row = r.row;
+  }
+  if (--last.count == 0) {
+    spare_.push_back(std::move(last.block));
+    a.chunks.pop_back();
+  }
+  --a.count;
+  --alive_;
+
+  r.alive = false;
+  ++r.generation;
+  free_.push_back(entity.index);
+}
+
+bool
+EntityStore::Alive(Entity entity) const
+{
+  return entity.index < records_.size() && records_[entity.index].alive &&
+         records_[entity.index].generation == entity.generation;
+}
+
+void
+EntityStore::Clear()
+{
+  for (auto& a : archetypes_) {
+    for (auto& chunk : a.chunks) {
+      spare_.push_back(std::move(chunk.block));
+    }
+    a.chunks.clear();
+    a.count = 0;
+  }
+  for (u32 i = 0; i < records_.size(); ++i) {
+    if (records_[i].alive) {
+      records_[i].alive = false;
+      ++records_[i].generation;
+      free_.push_back(i);
+    }
+  }
+  alive_ = 0;
+}
+
+u32
+EntityStore::Count(ComponentMask mask) const
+{
+  if (mask == 0) {
+    return alive_;
+  }
+  u32 count = 0;
+  for (const auto& a : archetypes_) {
+    if ((a.mask & mask) == mask) {
+      count += a.count;
+    }
+  }
+  return count;
+}
+
+Entity
+EntityStore::Nth(ComponentMask mask, u32 n) const
+{
+  for (const auto& a : archetypes_) {
+    if ((a.mask & mask) != mask) {
+      continue;
+    }
+    if (n < a.count) {
+      // packed, every chunk before the last one is full
+      return Entities(a, a.chunks[n / a.capacity])[n % a.capacity];
+    }
+    n -= a.count;
+  }
+  return Entity{};
+}
+
+EntityStats
+EntityStore::Stats() const
+{
+  EntityStats stats{};
+  stats.entities = alive_;
+  stats.archetypes = static_cast<u32>(archetypes_.size());
+  for (const auto& a : archetypes_) {
+    stats.chunks += static_cast<u32>(a.chunks.size());
+  }
+  stats.spare_chunks = static_cast<u32>(spare_.size());
+  return stats;
+}
+
+u32
+EntityStore::FindArchetype(ComponentMask mask)
+{
+  for (u32 i = 0; i < archetypes_.size(); ++i) {
+    if (archetypes_[i].mask == mask) {
+      return i;
+    }
+  }
+
+  // As many rows as fit once every array is aligned
+  Archetype a;
+  a.mask = mask;
+  u32 row_bytes = sizeof(Entity);
+  ForComponents(mask, [&](Component, u32 size) { row_bytes += size; });
+  const u32 arrays = 1 + static_cast<u32>(std::popcount(mask));
+  a.capacity = (kChunkBytes - arrays * kArrayAlign) / row_bytes;
+
+  u32 offset = 0;
+  a.entity_offset = offset;
+  offset += a.capacity * u32(sizeof(Entity));
+  ForComponents(mask, [&](Component c, u32 size) {
+    offset = AlignUp(offset);
+    a.offsets[u32(c)] = offset;
+    offset += a.capacity * size;
+  });
+  assert(offset <= kChunkBytes);
+
+  LOG_DEBUG("Entity archetype {:#x}: {} entities per chunk", mask, a.capacity);
+  archetypes_.push_back(std::move(a));
+  return static_cast<u32>(archetypes_.size() - 1);
+}
+
+std::unique_ptr<EntityStore::Block>
+EntityStore::TakeBlock()
+{
+  if (spare_.empty()) {
+    return std::make_unique<Block>();
+  }
+  auto block = std::move(spare_.back());
+  spare_.pop_back();
+  return block;
+}
+
+Entity*
+EntityStore::Entities(const Archetype& a, const Chunk& c)
+{
+  return reinterpret_cast<Entity*>(c.block->bytes + a.entity_offset);
+}
+
+std::byte*
+EntityStore::Column(const Archetype& a, const Chunk& c, Component comp)
+{
+  return c.block->bytes + a.offsets[u32(comp)];
+}
+
+void
+EntityStore::Visits(ComponentMask mask, std::vector<Visit>& out)
+{
+  u32 first = 0;
+  for (auto& a : archetypes_) {
+    if ((a.mask & mask) != mask) {
+      continue;
+    }
+    for (auto& chunk : a.chunks) {
+      out.push_back(Visit{ &a, &chunk, first });
+      first += chunk.count;
+    }
+  }
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "src/job_system.h"
+#include "types.h"
+
+// Handle to an entity, stale once it's destroyed: its index is reused with
+// the next generation.
+struct Entity
+{
+  u32 index{ UINT32_MAX };
+  u32 generation{ 0 };
+
+  bool operator==(const Entity&) const = default;
+};
+
+struct TransformComponent
+{
+  glm::vec3 position{ 0.f };
+  float scale{ 1.f };
+  glm::vec4 rotation{ 0.f, 0.f, 0.f, 1.f }; // quaternion, xyzw
+};
+
+// World space bounding sphere
+struct BoundsComponent
+{
+  glm::vec3 center{ 0.f };
+  float radius{ 0.f };
+};
+
+struct RenderComponent
+{
+  u32 mesh{ 0 };
+  u32 material{ 0 };
+  float phase{ 0.f }; // swim animation, see InstanceData::params
+  float speed{ 1.f };
+};
+
+struct VelocityComponent
+{
+  glm::vec3 linear{ 0.f }; // units per second
+};
+
+enum class Component : u8
+{
+  Transform,
+  Bounds,
+  Render,
+  Velocity,
+  Count
+};
+
+using ComponentMask = u32;
+
+constexpr ComponentMask
+MaskOf(Component c)
+{
+  return 1u << u32(c);
+}
+
+template<typename T>
+struct ComponentOf;
+template<>
+struct ComponentOf<TransformComponent>
+{
+  static constexpr Component value = Component::Transform;
+};
+template<>
+struct ComponentOf<BoundsComponent>
+{
+  static constexpr Component value = Component::Bounds;
+};
+template<>
+struct ComponentOf<RenderComponent>
+{
+  static constexpr Component value = Component::Render;
+};
+template<>
+struct ComponentOf<VelocityComponent>
+{
+  static constexpr Component value = Component::Velocity;
+};
+
+template<typename... Ts>
+constexpr ComponentMask
+MaskOf()
+{
+  return (MaskOf(ComponentOf<std::remove_const_t<Ts>>::value) | ...);
+}
+
+struct EntityStats
+{
+  u32 entities{ 0 };
+  u32 archetypes{ 0 };
+  u32 chunks{ 0 };
+  u32 spare_chunks{ 0 };
+};
+
+// Entities grouped by archetype, the set of components they have. Every
+// archetype stores its entities in fixed-size chunks holding one contiguous
+// array per component, and keeps them packed: every chunk is full but the
+// last one, destroying an entity moves the archetype's last one in its place.
+//
+// Chunks are the only allocations and are recycled, creating and destroying
+// entities doesn't allocate once the store has grown. Iteration walks the
+// arrays chunk by chunk, spread over the job system.
+//
+// Not thread safe: systems may write the components they iterate over, but
+// creating or destroying entities must not overlap any other use.
+class EntityStore
+{
+public:
+  static constexpr u32 kChunkBytes = 16 * 1024;
+
+  EntityStore();
+  ~EntityStore();
+
+  EntityStore(const EntityStore&) = delete;
+  EntityStore& operator=(const EntityStore&) = delete;
+
+  // An entity with default components for every bit of `mask`
+  Entity Create(ComponentMask mask);
+  void Destroy(Entity entity);
+  bool Alive(Entity entity) const;
+  void Clear();
+
+  // Alive entities with at least the components of `mask`
+  u32 Count(ComponentMask mask = 0) const;
+  // The one a ForEach over `mask` visits `n`th, as long as nothing is
+  // created or destroyed in between.
+  Entity Nth(ComponentMask mask, u32 n) const;
+
+  // Null if dead or missing that component
+  template<typename T>
+  T* Get(Entity entity);
+
+  // Calls `fn(first, count, entities, Ts*...)` on every chunk with all of
+  // Ts, `first` being the position of its first entity in the visit order.
+  // Chunks are spread over `jobs`, `fn` must only touch its own rows.
+  template<typename... Ts, typename Fn>
+  void ForEach(JobSystem& jobs, const Fn& fn);
+
+  EntityStats Stats() const;
+
+private:
+  struct alignas(64) Block
+  {
+    std::byte bytes[kChunkBytes];
+  };
+  struct Chunk
+  {
+    std::unique_ptr<Block> block;
+    u32 count{ 0 };
+  };
+  struct Archetype
+  {
+    ComponentMask mask{ 0 };
+    u32 capacity{ 0 }; // entities per chunk
+    u32 entity_offset{ 0 };
+    u32 offsets[u32(Component::Count)]{}; // of every array in a chunk
+    u32 count{ 0 };
+    std::vector<Chunk> chunks;
+  };
+  // Where an entity index lives, its generation counts reuses
+  struct Record
+  {
+    u32 generation{ 0 };
+    u32 archetype{ 0 };
+    u32 chunk{ 0 };
+    u32 row{ 0 };
+    bool alive{ false };
+  };
+  // A chunk a ForEach visits
+  struct Visit
+  {
+    Archetype* archetype;
+    Chunk* chunk;
+    u32 first;
+  };
+
+  u32 FindArchetype(ComponentMask mask);
+  std::unique_ptr<Block> TakeBlock();
+  static Entity* Entities(const Archetype& a, const Chunk& c);
+  static std::byte* Column(const Archetype& a, const Chunk& c, Component comp);
+  void Visits(ComponentMask mask, std::vector<Visit>& out);
+
+private:
+  std::vector<Archetype> archetypes_;
+  std::vector<Record> records_;
+  std::vector<u32> free_; // dead entity indices
+  std::vector<std::unique_ptr<Block>> spare_;
+  u32 alive_{ 0 };
+};
+
+template<typename T>
+T*
+EntityStore::Get(Entity entity)
+{
+  if (!Alive(entity)) {
+    return nullptr;
+  }
+  const Record& r = records_[entity.index];
+  const Archetype& a = archetypes_[r.archetype];
+  constexpr Component comp = ComponentOf<T>::value;
+  if ((a.mask & MaskOf(comp)) == 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<T*>(Column(a, a.chunks[r.chunk], comp)) + r.row;
+}
+
+template<typename... Ts, typename Fn>
+void
+EntityStore::ForEach(JobSystem& jobs, const Fn& fn)
+{
+  std::vector<Visit> visits;
+  Visits(MaskOf<Ts...>(), visits);
+  jobs.ParallelFor(
+    static_cast<u32>(visits.size()), 1, [&](u32 begin, u32 end) {
+      for (u32 v = begin; v < end; ++v) {
+        const Visit& visit = visits[v];
+        fn(visit.first,
+           visit.chunk->count,
+           Entities(*visit.archetype, *visit.chunk),
+           reinterpret_cast<Ts*>(
+             Column(*visit.archetype,
+                    *visit.chunk,
+                    ComponentOf<std::remove_const_t<Ts>>::value))...);
+      }
+    });
+}
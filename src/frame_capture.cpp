@@ -0,0 +1,443 @@
+#include "frame_capture.h"
+
+#include <SDL3/SDL_timer.h>
+#include <SDL3_image/SDL_image.h>
+#include <algorithm>
+#include <filesystem>
+
+#include "src/logger.h"
+#include "src/profiler.h"
+#include "src/render_stats.h"
+#include "util.h"
+
+namespace {
+
+constexpr u32 kBytesPerPixel = 4;
+// Transfer buffers grow by this much, so dynamic resolution creeping up
+// doesn't reallocate them every frame
+constexpr u32 kCapacityStep = 1u << 20;
+
+// BT.601 full range, as JPEG and C420jpeg have it, in 1/256ths
+u8
+Luma(int r, int g, int b)
+{
+  return u8((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+// From the sums of a 2x2 block
+u8
+Chroma(int a, int b, int c)
+{
+  return u8(std::clamp(128 + ((a + b + c + 512) >> 10), 0, 255));
+}
+
+} // namespace
+
+FrameCapture::FrameCapture(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+  Stop();
+  auto* Device = device_;
+  for (Slot& slot : slots_) {
+    RELEASE_IF(slot.buffer, SDL_ReleaseGPUTransferBuffer);
+    RenderStats::Allocated(GpuMemory::Staging, -i64(slot.capacity));
+  }
+}
+
+bool
+FrameCapture::Start(const std::string& path, bool lossless)
+{
+  LOG_TRACE("FrameCapture::Start");
+  Stop();
+  y4m_ = std::filesystem::path(path).extension() == ".y4m";
+  if (y4m_) {
+    video_.open(path, std::ios::binary | std::ios::trunc);
+    if (!video_) {
+      LOG_ERROR("Couldn't open {} for writing", path);
+      return false;
+    }
+  }
+  path_ = path;
+  lossless_ = lossless;
+  StartEncoder();
+  LOG_INFO("Capturing frames to {}", path_);
+  return true;
+}
+
+void
+FrameCapture::Stop()
+{
+  while (tail_ < head_) {
+    Collect(true);
+  }
+  StopEncoder();
+  if (Capturing()) {
+    LOG_INFO("Captured {} frames to {}", frame_, path_);
+  }
+  video_.close();
+  video_width_ = 0;
+  video_height_ = 0;
+  path_.clear();
+  frame_ = 0;
+}
+
+void
+FrameCapture::Screenshot(const std::string& path)
+{
+  screenshot_ = path;
+  StartEncoder();
+}
+
+bool
+FrameCapture::Capture(SDL_GPUTexture* texture, u32 width, u32 height)
+{
+  if (!Capturing() && screenshot_.empty() && tail_ == head_) {
+    return true;
+  }
+  PROFILE_ZONE("FrameCapture::Capture");
+  const Uint64 start = SDL_GetTicksNS();
+  if (!Collect(false)) {
+    return false;
+  }
+  if (!Capturing() && screenshot_.empty()) {
+    return true;
+  }
+  if (head_ - tail_ == kSlots) {
+    if (lossless_) {
+      if (!Collect(true)) {
+        return false;
+      }
+    } else {
+      // a pending screenshot is taken by the next frame instead
+      if (Capturing()) {
+        std::lock_guard lock{ mutex_ };
+        ++dropped_;
+      }
+      return true;
+    }
+  }
+  if (width == 0 || height == 0) {
+    return true;
+  }
+
+  Slot& slot = slots_[head_ % kSlots];
+  if (!Reserve(slot, width * height * kBytesPerPixel)) {
+    return false;
+  }
+  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
+  if (cmdbuf == nullptr) {
+    LOG_ERROR("Couldn't acquire capture command buffer: {}", GETERR);
+    return false;
+  }
+  {
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
+    SDL_GPUTextureRegion region{};
+    {
+      region.texture = texture;
+      region.w = width;
+      region.h = height;
+      region.d = 1;
+    }
+    SDL_GPUTextureTransferInfo transfer{};
+    {
+      transfer.transfer_buffer = slot.buffer;
+      transfer.pixels_per_row = width;
+      transfer.rows_per_layer = height;
+    }
+    SDL_DownloadFromGPUTexture(copyPass, &region, &transfer);
+    SDL_EndGPUCopyPass(copyPass);
+  }
+  slot.fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdbuf);
+  if (slot.fence == nullptr) {
+    LOG_ERROR("Couldn't submit frame capture: {}", GETERR);
+    return false;
+  }
+  slot.width = width;
+  slot.height = height;
+  slot.stream = Capturing();
+  slot.frame = slot.stream ? frame_++ : 0;
+  slot.screenshot = std::move(screenshot_);
+  screenshot_.clear();
+  ++head_;
+  copy_ms_ = float(SDL_GetTicksNS() - start) / 1e6f;
+  return true;
+}
+
+FrameCaptureStats
+FrameCapture::Stats() const
+{
+  std::lock_guard lock{ mutex_ };
+  return FrameCaptureStats{
+    .written = written_,
+    .dropped = dropped_,
+    .in_flight = u32(head_ - tail_),
+    .queued = u32(queue_.size()),
+    .copy_ms = copy_ms_,
+    .encode_ms = encode_ms_,
+  };
+}
+
+bool
+FrameCapture::Collect(bool wait)
+{
+  const bool block = wait;
+  while (tail_ < head_) {
+    Slot& slot = slots_[tail_ % kSlots];
+    if (wait) {
+      SDL_WaitForGPUFences(device_, true, &slot.fence, 1);
+      wait = false;
+    } else if (!SDL_QueryGPUFence(device_, slot.fence)) {
+      break;
+    }
+    // a screenshot stays in its slot until the encoder has room for it, the
+    // render thread doesn't wait on the encoder unless told to
+    if (!block && !slot.screenshot.empty() && QueueFull()) {
+      break;
+    }
+    SDL_ReleaseGPUFence(device_, slot.fence);
+    slot.fence = nullptr;
+    ++tail_;
+
+    // a full queue drops the frame before copying it
+    const bool stream = slot.stream && (lossless_ || !QueueFull());
+    if (slot.stream && !stream) {
+      std::lock_guard lock{ mutex_ };
+      ++dropped_;
+    }
+    if (!stream && slot.screenshot.empty()) {
+      continue;
+    }
+    const u32 bytes = slot.width * slot.height * kBytesPerPixel;
+    const auto* pixels = static_cast<const u8*>(
+      SDL_MapGPUTransferBuffer(device_, slot.buffer, false));
+    if (pixels == nullptr) {
+      LOG_ERROR("Couldn't map captured frame: {}", GETERR);
+      return false;
+    }
+    if (!slot.screenshot.empty()) {
+      Frame frame{ slot.width, slot.height, TakeBuffer(bytes), {} };
+      std::copy_n(pixels, bytes, frame.pixels.data());
+      frame.png = std::move(slot.screenshot);
+      slot.screenshot.clear();
+      Queue(std::move(frame), true);
+    }
+    if (stream) {
+      Frame frame{ slot.width, slot.height, TakeBuffer(bytes), {} };
+      std::copy_n(pixels, bytes, frame.pixels.data());
+      if (!y4m_) {
+        const std::filesystem::path path{ path_ };
+        char name[32];
+        SDL_snprintf(
+          name, sizeof(name), "_%05llu.png", (unsigned long long)slot.frame);
+        frame.png = (path.parent_path() / path.stem()).string() + name;
+      }
+      Queue(std::move(frame), lossless_);
+    }
+    SDL_UnmapGPUTransferBuffer(device_, slot.buffer);
+  }
+  return true;
+}
+
+bool
+FrameCapture::Reserve(Slot& slot, u32 bytes)
+{
+  if (slot.buffer != nullptr && bytes <= slot.capacity) {
+    return true;
+  }
+  auto* Device = device_;
+  RELEASE_IF(slot.buffer, SDL_ReleaseGPUTransferBuffer);
+  RenderStats::Allocated(GpuMemory::Staging, -i64(slot.capacity));
+  slot.buffer = nullptr;
+  slot.capacity = 0;
+
+  const u32 capacity =
+    (bytes + kCapacityStep - 1) / kCapacityStep * kCapacityStep;
+  SDL_GPUTransferBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+    info.size = capacity;
+  }
+  slot.buffer = SDL_CreateGPUTransferBuffer(device_, &info);
+  if (slot.buffer == nullptr) {
+    LOG_ERROR("Couldn't create capture transfer buffer: {}", GETERR);
+    return false;
+  }
+  slot.capacity = capacity;
+  RenderStats::Allocated(GpuMemory::Staging, capacity);
+  return true;
+}
+
+bool
+FrameCapture::QueueFull() const
+{
+  std::lock_guard lock{ mutex_ };
+  return queue_.size() >= kMaxQueued;
+}
+
+void
+FrameCapture::Queue(Frame&& frame, bool wait)
+{
+  {
+    std::unique_lock lock{ mutex_ };
+    if (wait) {
+      space_.wait(lock, [this] { return queue_.size() < kMaxQueued; });
+    } else if (queue_.size() >= kMaxQueued) {
+      ++dropped_;
+      spare_.push_back(std::move(frame.pixels));
+      return;
+    }
+    queue_.push_back(std::move(frame));
+  }
+  wake_.notify_one();
+}
+
+std::vector<u8>
+FrameCapture::TakeBuffer(u32 bytes)
+{
+  std::vector<u8> buffer;
+  {
+    std::lock_guard lock{ mutex_ };
+    if (!spare_.empty()) {
+      buffer = std::move(spare_.back());
+      spare_.pop_back();
+    }
+  }
+  buffer.resize(bytes);
+  return buffer;
+}
+
+void
+FrameCapture::StartEncoder()
+{
+  if (encoder_.joinable()) {
+    return;
+  }
+  stop_ = false;
+  encoder_ = std::thread([this] { EncoderLoop(); });
+}
+
+void
+FrameCapture::StopEncoder()
+{
+  if (!encoder_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard lock{ mutex_ };
+    stop_ = true;
+  }
+  wake_.notify_one();
+  encoder_.join();
+}
+
+// Writes what's queued until stopped, and what's left after that
+void
+FrameCapture::EncoderLoop()
+{
+  Profiler::SetThreadName("Capture");
+  for (;;) {
+    Frame frame;
+    {
+      std::unique_lock lock{ mutex_ };
+      wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      frame = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    space_.notify_one();
+
+    const Uint64 start = SDL_GetTicksNS();
+    const bool written = frame.png.empty() ? WriteY4m(frame) : WritePng(frame);
+    const float ms = float(SDL_GetTicksNS() - start) / 1e6f;
+    std::lock_guard lock{ mutex_ };
+    written_ += written;
+    encode_ms_ = ms;
+    spare_.push_back(std::move(frame.pixels));
+  }
+}
+
+bool
+FrameCapture::WritePng(Frame& frame)
+{
+  PROFILE_ZONE("FrameCapture::WritePng");
+  // blending may leave the target translucent, the picture is what's shown
+  for (size_t i = 3; i < frame.pixels.size(); i += kBytesPerPixel) {
+    frame.pixels[i] = 255;
+  }
+  const int pitch = int(frame.width * kBytesPerPixel);
+  SDL_Surface* surface = SDL_CreateSurfaceFrom(int(frame.width),
+                                               int(frame.height),
+                                               SDL_PIXELFORMAT_RGBA32,
+                                               frame.pixels.data(),
+                                               pitch);
+  if (surface == nullptr) {
+    LOG_ERROR("Couldn't wrap captured frame: {}", GETERR);
+    return false;
+  }
+  const bool saved = IMG_SavePNG(surface, frame.png.c_str());
+  SDL_DestroySurface(surface);
+  if (!saved) {
+    LOG_ERROR("Couldn't write {}: {}", frame.png, GETERR);
+  }
+  return saved;
+}
+
+bool
+FrameCapture::WriteY4m(const Frame& frame)
+{
+  PROFILE_ZONE("FrameCapture::WriteY4m");
+  if (video_width_ == 0) {
+    // 4:2:0 wants even sizes
+    video_width_ = std::max(frame.width & ~1u, 2u);
+    video_height_ = std::max(frame.height & ~1u, 2u);
+    video_ << "YUV4MPEG2 W" << video_width_ << " H" << video_height_
+           << " F60:1 Ip A1:1 C420jpeg\n";
+  }
+  const u32 w = video_width_;
+  const u32 h = video_height_;
+  planes_.resize(size_t(w) * h + 2 * size_t(w / 2) * (h / 2));
+  u8* y_plane = planes_.data();
+  u8* cb_plane = y_plane + size_t(w) * h;
+  u8* cr_plane = cb_plane + size_t(w / 2) * (h / 2);
+
+  // cropped to the video, black past the frame
+  static constexpr u8 kBlack[kBytesPerPixel] = { 0, 0, 0, 255 };
+  const auto pixel = [&](u32 x, u32 y) {
+    return x < frame.width && y < frame.height
+             ? &frame.pixels[(size_t(y) * frame.width + x) * kBytesPerPixel]
+             : kBlack;
+  };
+  for (u32 by = 0; by < h / 2; ++by) {
+    for (u32 bx = 0; bx < w / 2; ++bx) {
+      int r = 0, g = 0, b = 0;
+      for (u32 dy = 0; dy < 2; ++dy) {
+        for (u32 dx = 0; dx < 2; ++dx) {
+          const u32 x = bx * 2 + dx;
+          const u32 y = by * 2 + dy;
+          const u8* p = pixel(x, y);
+          y_plane[size_t(y) * w + x] = Luma(p[0], p[1], p[2]);
+          r += p[0];
+          g += p[1];
+          b += p[2];
+        }
+      }
+      const size_t c = size_t(by) * (w / 2) + bx;
+      cb_plane[c] = Chroma(-43 * r, -85 * g, 128 * b);
+      cr_plane[c] = Chroma(128 * r, -107 * g, -21 * b);
+    }
+  }
+  video_ << "FRAME\n";
+  video_.write(reinterpret_cast<const char*>(planes_.data()),
+               std::streamsize(planes_.size()));
+  if (!video_) {
+    LOG_ERROR("Couldn't write captured frame");
+    return false;
+  }
+  return true;
+}
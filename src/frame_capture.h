@@ -0,0 +1,127 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+struct FrameCaptureStats
+{
+  u64 written{ 0 };       // frames encoded and written
+  u64 dropped{ 0 };       // the ring or the encoder's queue were full
+  u32 in_flight{ 0 };     // downloads the GPU may not have finished
+  u32 queued{ 0 };        // frames waiting for the encoder
+  float copy_ms{ 0.f };   // last Capture: collecting and recording
+  float encode_ms{ 0.f }; // last frame the encoder wrote
+};
+
+// Gets the scene's pixels back without waiting on the GPU. Every captured
+// frame downloads into the next slot of a ring of transfer buffers, in a
+// command buffer of its own with a fence; the next frames poll the fences
+// and hand the finished ones to an encoder thread. When the ring or the
+// encoder's queue is full the frame is dropped, unless capturing losslessly:
+// headless runs wait instead, every frame counts there. A screenshot is never
+// dropped and never waited for, it's taken by a later frame or stays in its
+// slot until the encoder has room.
+//
+// A path ending in .y4m makes one video of every frame, 4:2:0 at 60 FPS and
+// the first frame's size: later frames are cropped or padded to it. Other
+// paths get a PNG per frame, `<stem>_<frame>.png`.
+class FrameCapture
+{
+public:
+  static constexpr u32 kSlots = 4;     // downloads in flight
+  static constexpr u32 kMaxQueued = 8; // frames waiting for the encoder
+
+  explicit FrameCapture(SDL_GPUDevice* device);
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture&) = delete;
+  FrameCapture& operator=(const FrameCapture&) = delete;
+
+  // Writes every frame captured from now on to `path`
+  bool Start(const std::string& path, bool lossless);
+  // Waits for the frames in flight and the encoder, then closes the output
+  void Stop();
+  bool Capturing() const { return !path_.empty(); }
+  // The next captured frame also goes to `path` as a PNG, capturing or not
+  void Screenshot(const std::string& path);
+
+  // Collects the finished downloads, then records the download of the top
+  // left `width` x `height` pixels of `texture`, an R8G8B8A8 target. Call it
+  // once the commands drawing it are submitted. Does nothing when there's
+  // nothing to capture.
+  bool Capture(SDL_GPUTexture* texture, u32 width, u32 height);
+
+  FrameCaptureStats Stats() const;
+
+private:
+  struct Slot
+  {
+    SDL_GPUTransferBuffer* buffer{ nullptr };
+    u32 capacity{ 0 }; // bytes
+    SDL_GPUFence* fence{ nullptr };
+    u32 width{ 0 };
+    u32 height{ 0 };
+    u64 frame{ 0 };
+    bool stream{ false };   // goes to path_
+    std::string screenshot; // PNG path, or empty
+  };
+  struct Frame
+  {
+    u32 width{ 0 };
+    u32 height{ 0 };
+    std::vector<u8> pixels; // RGBA, tightly packed
+    std::string png;        // PNG path, or empty for the video
+  };
+
+  // Hands finished downloads to the encoder, oldest first. Waits for the
+  // oldest one, and for room in the queue, with `wait`.
+  bool Collect(bool wait);
+  bool Reserve(Slot& slot, u32 bytes);
+  bool QueueFull() const;
+  // Waits for room with `wait`, else drops the frame when the queue is full
+  void Queue(Frame&& frame, bool wait);
+  std::vector<u8> TakeBuffer(u32 bytes);
+  void StartEncoder();
+  void StopEncoder();
+  void EncoderLoop();
+  bool WritePng(Frame& frame);
+  bool WriteY4m(const Frame& frame);
+
+private:
+  SDL_GPUDevice* device_{};
+  Slot slots_[kSlots];
+  u64 head_{ 0 };  // next slot to record, modulo kSlots
+  u64 tail_{ 0 };  // oldest slot in flight
+  u64 frame_{ 0 }; // frames captured since Start
+  std::string path_;
+  bool y4m_{ false };
+  bool lossless_{ false };
+  std::string screenshot_; // for the next Capture
+  float copy_ms_{ 0.f };
+
+  // Encoder side, mutex_ guards everything below
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;  // frames queued, or stopping
+  std::condition_variable space_; // a frame left the queue
+  std::deque<Frame> queue_;
+  std::vector<std::vector<u8>> spare_; // pixel buffers to reuse
+  bool stop_{ false };
+  u64 written_{ 0 };
+  u64 dropped_{ 0 };
+  float encode_ms_{ 0.f };
+  std::thread encoder_;
+
+  // Encoder thread only
+  std::ofstream video_;
+  u32 video_width_{ 0 };
+  u32 video_height_{ 0 };
+  std::vector<u8> planes_; // Y, Cb then Cr of a frame
+};
@@ -0,0 +1,102 @@
+#include "frame_pacing.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+
+#include "src/logger.h"
+#include "util.h"
+
+namespace {
+
+// scheduler slack, the last stretch before a deadline is spun
+constexpr Uint64 kSpinNS = 2'000'000;
+
+} // namespace
+
+FramePacer::FramePacer(SDL_GPUDevice* device, SDL_Window* window)
+  : device_{ device }
+  , window_{ window }
+{
+}
+
+bool
+FramePacer::Apply(FramePacingCfg& cfg)
+{
+  cfg.frames_in_flight = std::clamp(cfg.frames_in_flight, 1u, 3u);
+  bool ok = true;
+
+  if (first_apply_ || cfg.present_mode != applied_.present_mode) {
+    if (!SDL_WindowSupportsGPUPresentMode(device_, window_, cfg.present_mode)) {
+      LOG_WARN("Present mode {} isn't supported",
+               PresentModeName(cfg.present_mode));
+      cfg.present_mode = applied_.present_mode;
+      ok = false;
+    } else if (!SDL_SetGPUSwapchainParameters(device_,
+                                              window_,
+                                              SDL_GPU_SWAPCHAINCOMPOSITION_SDR,
+                                              cfg.present_mode)) {
+      LOG_ERROR("Couldn't set present mode {}: {}",
+                PresentModeName(cfg.present_mode),
+                GETERR);
+      cfg.present_mode = applied_.present_mode;
+      ok = false;
+    } else {
+      LOG_INFO("Present mode: {}", PresentModeName(cfg.present_mode));
+    }
+  }
+
+  if (first_apply_ || cfg.frames_in_flight != applied_.frames_in_flight) {
+    if (!SDL_SetGPUAllowedFramesInFlight(device_, cfg.frames_in_flight)) {
+      LOG_ERROR("Couldn't allow {} frames in flight: {}",
+                cfg.frames_in_flight,
+                GETERR);
+      cfg.frames_in_flight = applied_.frames_in_flight;
+      ok = false;
+    } else {
+      LOG_INFO("Frames in flight: {}", cfg.frames_in_flight);
+    }
+  }
+
+  applied_ = cfg;
+  first_apply_ = false;
+  return ok;
+}
+
+void
+FramePacer::Limit(float fps)
+{
+  if (fps <= 0.f) {
+    deadline_ = 0;
+    return;
+  }
+  const auto period = static_cast<Uint64>(1e9 / fps);
+  Uint64 now = SDL_GetTicksNS();
+  if (deadline_ == 0 || now >= deadline_ + period) {
+    deadline_ = now + period;
+    return;
+  }
+
+  if (deadline_ > now + kSpinNS) {
+    SDL_DelayNS(deadline_ - now - kSpinNS);
+  }
+  while (SDL_GetTicksNS() < deadline_) {
+    SDL_CPUPauseInstruction();
+  }
+  // from the deadline, not from now, so oversleeping doesn't add up
+  deadline_ += period;
+}
+
+const char*
+FramePacer::PresentModeName(SDL_GPUPresentMode mode)
+{
+  switch (mode) {
+    case SDL_GPU_PRESENTMODE_VSYNC:
+      return "VSync";
+    case SDL_GPU_PRESENTMODE_MAILBOX:
+      return "Mailbox";
+    case SDL_GPU_PRESENTMODE_IMMEDIATE:
+      return "Immediate";
+  }
+  return "Unknown";
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_video.h>
+
+#include "types.h"
+
+struct FramePacingCfg
+{
+  SDL_GPUPresentMode present_mode{ SDL_GPU_PRESENTMODE_VSYNC };
+  u32 frames_in_flight{ 2 }; // 1 to 3, fewer is less latency
+  float fps_limit{ 0.f };    // 0 is unlimited
+};
+
+// Applies present mode and frames in flight changes, and caps the frame rate.
+class FramePacer
+{
+public:
+  FramePacer(SDL_GPUDevice* device, SDL_Window* window);
+
+  // Sets what changed since the last call. Settings the device or window
+  // don't support are logged and reverted in `cfg`.
+  bool Apply(FramePacingCfg& cfg);
+
+  // Blocks until the frame limit lets the next frame start: sleeps while the
+  // deadline is far, then spins since sleeps can overshoot by a millisecond
+  // or more. Doesn't try to catch up after a frame a whole period late.
+  void Limit(float fps);
+
+  static const char* PresentModeName(SDL_GPUPresentMode mode);
+
+private:
+  SDL_GPUDevice* device_{};
+  SDL_Window* window_{};
+  FramePacingCfg applied_{};
+  bool first_apply_{ true };
+  Uint64 deadline_{ 0 };
+};
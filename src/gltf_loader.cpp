@@ -3,6 +3,7 @@
 
 #include "fastgltf/glm_element_traits.hpp"
 #include "fastgltf/types.hpp"
+#include "src/profiler.h"
 #include "src/util.h"
 #include <SDL3/SDL_surface.h>
 #include <cassert>
@@ -12,6 +13,41 @@
 #include <string>
 #include <variant>
 
+namespace {
+
+NodeTransform
+LocalTransform(const fastgltf::Node& node)
+{
+  NodeTransform t;
+  std::visit(
+    fastgltf::visitor{
+      [&](const fastgltf::TRS& trs) {
+        t.Translation = glm::vec3{ trs.translation[0],
+                                   trs.translation[1],
+                                   trs.translation[2] };
+        t.Rotation = glm::vec4{
+          trs.rotation[0], trs.rotation[1], trs.rotation[2], trs.rotation[3]
+        };
+        t.Scale = glm::vec3{ trs.scale[0], trs.scale[1], trs.scale[2] };
+      },
+      [&](const fastgltf::math::fmat4x4& matrix) {
+        fastgltf::math::fvec3 scale;
+        fastgltf::math::fquat rotation;
+        fastgltf::math::fvec3 translation;
+        fastgltf::math::decomposeTransformMatrix(
+          matrix, scale, rotation, translation);
+        t.Translation =
+          glm::vec3{ translation[0], translation[1], translation[2] };
+        t.Rotation =
+          glm::vec4{ rotation[0], rotation[1], rotation[2], rotation[3] };
+        t.Scale = glm::vec3{ scale[0], scale[1], scale[2] };
+      } },
+    node.transform);
+  return t;
+}
+
+} // namespace
+
 GLTFLoader::GLTFLoader(std::filesystem::path path)
   : path_{ path }
 {
@@ -40,6 +76,7 @@ bool
 GLTFLoader::Load()
 {
   LOG_TRACE("GLTFLoader::Load");
+  PROFILE_ZONE("GLTFLoader::Load");
   if (!std::filesystem::exists(path_)) {
     LOG_ERROR("path {} is invalid", path_.c_str());
     return false;
@@ -77,6 +114,11 @@ GLTFLoader::Load()
     return false;
   }
   LOG_DEBUG("Loaded GLTF meshes");
+  loaded_ = LoadSkeleton();
+  if (!loaded_) {
+    LOG_ERROR("Couldn't load skin from GLTF");
+    return false;
+  }
   loaded_ = LoadImageData();
   if (!loaded_) {
     LOG_ERROR("Couldn't load images from GLTF");
@@ -105,6 +147,8 @@ GLTFLoader::LoadVertexData()
     newMesh.Name = mesh.name.c_str();
     auto& indices = newMesh.indices_;
     auto& vertices = newMesh.vertices_;
+    auto& positions = newMesh.positions_;
+    auto& skin = newMesh.skin_;
 
     for (auto&& p : mesh.primitives) {
       Geometry newGeometry{
@@ -129,6 +173,7 @@ GLTFLoader::LoadVertexData()
         fastgltf::Accessor& posAccessor =
           asset_.accessors[p.findAttribute("POSITION")->accessorIndex];
         vertices.resize(vertices.size() + posAccessor.count);
+        positions.resize(vertices.size());
 
         fastgltf::iterateAccessorWithIndex<glm::vec3>(
           asset_, posAccessor, [&](glm::vec3 v, size_t index) {
@@ -139,6 +184,7 @@ GLTFLoader::LoadVertexData()
             newvtx.uv[0] = 0;
             newvtx.uv[1] = 0;
             vertices[initial_vtx + index] = newvtx;
+            positions[initial_vtx + index] = PosVertex{ { v.x, v.y, v.z } };
           });
       }
 
@@ -155,6 +201,31 @@ GLTFLoader::LoadVertexData()
         }
       }
 
+      { // load joint influences
+        auto joints = p.findAttribute("JOINTS_0");
+        auto weights = p.findAttribute("WEIGHTS_0");
+        if (joints != p.attributes.end() && weights != p.attributes.end()) {
+          // unskinned primitives before this one get no weights
+          skin.resize(vertices.size());
+          fastgltf::iterateAccessorWithIndex<glm::uvec4>(
+            asset_,
+            asset_.accessors[(*joints).accessorIndex],
+            [&](glm::uvec4 j, size_t index) {
+              for (int i = 0; i < 4; ++i) {
+                skin[initial_vtx + index].Joints[i] = j[i];
+              }
+            });
+          fastgltf::iterateAccessorWithIndex<glm::vec4>(
+            asset_,
+            asset_.accessors[(*weights).accessorIndex],
+            [&](glm::vec4 w, size_t index) {
+              for (int i = 0; i < 4; ++i) {
+                skin[initial_vtx + index].Weights[i] = w[i];
+              }
+            });
+        }
+      }
+
       newMesh.Submeshes.push_back(newGeometry);
       LOG_DEBUG("New geometry. Total Verts: {}, Total Indices: {} || {}, {}",
                 vertices.size(),
@@ -162,10 +233,197 @@ GLTFLoader::LoadVertexData()
                 newMesh.Submeshes[0].FirstIndex,
                 newMesh.Submeshes[0].VertexCount);
     }
+    if (!skin.empty()) {
+      skin.resize(vertices.size());
+    }
+    ComputeBounds(newMesh);
+    LOG_DEBUG("Mesh bounds: center ({}, {}, {}), radius {}",
+              newMesh.Bounds.Center.x,
+              newMesh.Bounds.Center.y,
+              newMesh.Bounds.Center.z,
+              newMesh.Bounds.Radius);
     meshes_.emplace_back(newMesh);
     assert(newMesh.indices_.size() != 0);
   }
   assert(meshes_[0].indices_.size() != 0);
+
+  bounds_ = meshes_[0].Bounds;
+  for (const auto& mesh : meshes_) {
+    bounds_.Min = glm::min(bounds_.Min, mesh.Bounds.Min);
+    bounds_.Max = glm::max(bounds_.Max, mesh.Bounds.Max);
+  }
+  bounds_.Center = (bounds_.Min + bounds_.Max) * .5f;
+  bounds_.Radius = 0.f;
+  for (const auto& mesh : meshes_) {
+    bounds_.Radius =
+      glm::max(bounds_.Radius,
+               glm::distance(mesh.Bounds.Center, bounds_.Center) +
+                 mesh.Bounds.Radius);
+  }
+  return true;
+}
+
+void
+GLTFLoader::ComputeBounds(MeshAsset& mesh)
+{
+  if (mesh.vertices_.empty()) {
+    return;
+  }
+  auto& b = mesh.Bounds;
+  b.Min = glm::vec3{ mesh.vertices_[0].pos[0],
+                     mesh.vertices_[0].pos[1],
+                     mesh.vertices_[0].pos[2] };
+  b.Max = b.Min;
+  for (const auto& v : mesh.vertices_) {
+    const glm::vec3 p{ v.pos[0], v.pos[1], v.pos[2] };
+    b.Min = glm::min(b.Min, p);
+    b.Max = glm::max(b.Max, p);
+  }
+  b.Center = (b.Min + b.Max) * .5f;
+  b.Radius = 0.f;
+  for (const auto& v : mesh.vertices_) {
+    const glm::vec3 p{ v.pos[0], v.pos[1], v.pos[2] };
+    b.Radius = glm::max(b.Radius, glm::distance(p, b.Center));
+  }
+}
+
+bool
+GLTFLoader::LoadSkeleton()
+{
+  LOG_TRACE("GLTFLoader::LoadSkeleton");
+  skeleton_ = Skeleton{};
+  if (asset_.skins.empty()) {
+    return true;
+  }
+  if (asset_.skins.size() > 1) {
+    LOG_WARN("Only the first of {} skins is used", asset_.skins.size());
+  }
+
+  // Parents before their children, so world transforms build in one pass
+  const size_t count = asset_.nodes.size();
+  std::vector<u32> parents(count, Skeleton::kNoParent);
+  for (size_t n = 0; n < count; ++n) {
+    for (size_t child : asset_.nodes[n].children) {
+      parents[child] = static_cast<u32>(n);
+    }
+  }
+  std::vector<u32> order;
+  order.reserve(count);
+  for (size_t n = 0; n < count; ++n) {
+    if (parents[n] == Skeleton::kNoParent) {
+      order.push_back(static_cast<u32>(n));
+    }
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    for (size_t child : asset_.nodes[order[i]].children) {
+      order.push_back(static_cast<u32>(child));
+    }
+  }
+  if (order.size() != count) {
+    LOG_ERROR("GLTF node hierarchy isn't a tree");
+    return false;
+  }
+  std::vector<u32> remap(count);
+  for (u32 i = 0; i < count; ++i) {
+    remap[order[i]] = i;
+  }
+  for (u32 n : order) {
+    skeleton_.Parents.push_back(parents[n] == Skeleton::kNoParent
+                                  ? Skeleton::kNoParent
+                                  : remap[parents[n]]);
+    skeleton_.Rest.push_back(LocalTransform(asset_.nodes[n]));
+  }
+
+  const auto& skin = asset_.skins[0];
+  for (size_t joint : skin.joints) {
+    skeleton_.Joints.push_back(remap[joint]);
+  }
+  const size_t joints = skeleton_.Joints.size();
+  skeleton_.InverseBinds.assign(joints, glm::mat4{ 1.f });
+  if (skin.inverseBindMatrices.has_value()) {
+    fastgltf::iterateAccessorWithIndex<glm::mat4>(
+      asset_,
+      asset_.accessors[skin.inverseBindMatrices.value()],
+      [&](glm::mat4 m, size_t index) {
+        if (index < joints) {
+          skeleton_.InverseBinds[index] = m;
+        }
+      });
+  }
+  for (auto& mesh : meshes_) {
+    for (auto& vertex : mesh.skin_) {
+      for (int i = 0; i < 4; ++i) {
+        if (vertex.Joints[i] >= joints) {
+          vertex.Joints[i] = 0;
+          vertex.Weights[i] = 0.f;
+        }
+      }
+    }
+  }
+
+  for (const auto& animation : asset_.animations) {
+    AnimationClip clip;
+    clip.Name = animation.name.c_str();
+    for (const auto& channel : animation.channels) {
+      if (!channel.nodeIndex.has_value()) {
+        continue;
+      }
+      AnimationChannel out;
+      out.Node = remap[channel.nodeIndex.value()];
+      switch (channel.path) {
+        case fastgltf::AnimationPath::Translation:
+          out.Target = AnimationTarget::Translation;
+          break;
+        case fastgltf::AnimationPath::Rotation:
+          out.Target = AnimationTarget::Rotation;
+          break;
+        case fastgltf::AnimationPath::Scale:
+          out.Target = AnimationTarget::Scale;
+          break;
+        default:
+          continue; // morph target weights
+      }
+      const auto& sampler = animation.samplers[channel.samplerIndex];
+      out.Step =
+        sampler.interpolation == fastgltf::AnimationInterpolation::Step;
+      fastgltf::iterateAccessor<float>(
+        asset_, asset_.accessors[sampler.inputAccessor], [&](float t) {
+          out.Times.push_back(t);
+        });
+      const auto& values = asset_.accessors[sampler.outputAccessor];
+      if (out.Target == AnimationTarget::Rotation) {
+        fastgltf::iterateAccessor<glm::vec4>(
+          asset_, values, [&](glm::vec4 v) { out.Values.push_back(v); });
+      } else {
+        fastgltf::iterateAccessor<glm::vec3>(
+          asset_, values, [&](glm::vec3 v) {
+            out.Values.push_back(glm::vec4{ v, 0.f });
+          });
+      }
+      if (sampler.interpolation ==
+          fastgltf::AnimationInterpolation::CubicSpline) {
+        // in tangent, value, out tangent: keep the values
+        for (size_t k = 0; 3 * k + 1 < out.Values.size(); ++k) {
+          out.Values[k] = out.Values[3 * k + 1];
+        }
+        out.Values.resize(out.Values.size() / 3);
+      }
+      if (out.Times.empty() || out.Values.size() != out.Times.size()) {
+        LOG_WARN("Skipping malformed channel of animation {}", clip.Name);
+        continue;
+      }
+      clip.Duration = glm::max(clip.Duration, out.Times.back());
+      clip.Channels.push_back(std::move(out));
+    }
+    if (!clip.Channels.empty()) {
+      skeleton_.Clips.push_back(std::move(clip));
+    }
+  }
+
+  LOG_DEBUG("Skin with {} joints over {} nodes, {} animations",
+            joints,
+            count,
+            skeleton_.Clips.size());
   return true;
 }
 
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "src/skeleton.h"
 #include "src/util.h"
 #include "types.h"
 #include <fastgltf/core.hpp>
+#include <glm/glm.hpp>
+#include <string>
 #include <vector>
 
 struct Geometry {
@@ -10,13 +13,31 @@ struct Geometry {
   const std::size_t VertexCount;
 };
 
+// Object space bounds, the sphere is centered on the AABB center.
+struct MeshBounds {
+  glm::vec3 Min{ 0.f };
+  glm::vec3 Max{ 0.f };
+  glm::vec3 Center{ 0.f };
+  float Radius{ 0.f };
+};
+
+// Up to four joints moving a vertex, indices into Skeleton::Joints. No
+// weight at all leaves the vertex where it is.
+struct SkinWeights {
+  u32 Joints[4]{};
+  float Weights[4]{};
+};
+
 struct MeshAsset{
   const char* Name;
   std::vector<Geometry> Submeshes;
+  MeshBounds Bounds;
 
   // TODO: don't duplicate these, send them to GPU directly when loading
   std::vector<PosUvVertex> vertices_{};
+  std::vector<PosVertex> positions_{}; // same vertices, for depth only passes
   std::vector<u32> indices_{};
+  std::vector<SkinWeights> skin_{}; // one per vertex, empty when not skinned
 };
 
 class GLTFLoader {
@@ -27,10 +48,16 @@ public:
   bool Load();
   const std::vector<MeshAsset>& Meshes() const;
   const std::vector<SDL_Surface*>& Surfaces() const;
+  // Bounds of every mesh together
+  const MeshBounds& Bounds() const { return bounds_; }
+  // Empty without skins
+  const Skeleton& Skin() const { return skeleton_; }
 
 private:
   bool LoadVertexData();
+  bool LoadSkeleton();
   bool LoadImageData();
+  static void ComputeBounds(MeshAsset& mesh);
 
 private:
   fastgltf::Asset asset_;
@@ -38,5 +65,7 @@ private:
   bool loaded_{false};
 
   std::vector<MeshAsset> meshes_;
+  MeshBounds bounds_;
+  Skeleton skeleton_;
   std::vector<SDL_Surface*> images_;
 };
@@ -0,0 +1,282 @@
+#include "gpu_culling.h"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <vector>
+
+#include "src/culling.h"
+#include "src/logger.h"
+#include "src/render_stats.h"
+#include "util.h"
+
+GpuCuller::GpuCuller(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+GpuCuller::~GpuCuller()
+{
+  RenderStats::Allocated(GpuMemory::Culling, -i64(capacity_ * sizeof(Uint32)));
+  const i64 bytes = DrawCommandOffset(draw_capacity_);
+  RenderStats::Allocated(GpuMemory::Culling, -bytes);
+  RenderStats::Allocated(GpuMemory::Staging, -bytes);
+  auto* Device = device_;
+  RELEASE_IF(pipeline_, SDL_ReleaseGPUComputePipeline);
+  RELEASE_IF(visible_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(draw_commands_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(reset_, SDL_ReleaseGPUTransferBuffer);
+}
+
+bool
+GpuCuller::Init(const char* shader_path)
+{
+  LOG_TRACE("GpuCuller::Init");
+  pipeline_ = LoadComputePipeline(shader_path, device_);
+  if (pipeline_ == nullptr) {
+    LOG_ERROR("Couldn't load culling compute shader at path {}", shader_path);
+    return false;
+  }
+  if (!ReserveDraws(kMinDraws)) {
+    return false;
+  }
+  LOG_DEBUG("Initialized GPU culling");
+  return true;
+}
+
+bool
+GpuCuller::ReserveDraws(u32 draws)
+{
+  if (draws <= draw_capacity_) {
+    return true;
+  }
+  const u32 capacity = std::max(std::bit_ceil(draws), kMinDraws);
+
+  auto* Device = device_;
+  RELEASE_IF(draw_commands_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(reset_, SDL_ReleaseGPUTransferBuffer);
+  const i64 bytes = DrawCommandOffset(draw_capacity_);
+  RenderStats::Allocated(GpuMemory::Culling, -bytes);
+  RenderStats::Allocated(GpuMemory::Staging, -bytes);
+  draw_capacity_ = 0;
+
+  SDL_GPUBufferCreateInfo cmdInfo{};
+  {
+    cmdInfo.usage =
+      SDL_GPU_BUFFERUSAGE_INDIRECT | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+    cmdInfo.size = DrawCommandOffset(capacity);
+  }
+  draw_commands_ = SDL_CreateGPUBuffer(device_, &cmdInfo);
+
+  SDL_GPUTransferBufferCreateInfo trInfo{};
+  {
+    trInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    trInfo.size = DrawCommandOffset(capacity);
+  }
+  reset_ = SDL_CreateGPUTransferBuffer(device_, &trInfo);
+
+  if (draw_commands_ == nullptr || reset_ == nullptr) {
+    LOG_ERROR("Couldn't create GPU culling draw buffers: {}", GETERR);
+    RELEASE_IF(draw_commands_, SDL_ReleaseGPUBuffer);
+    RELEASE_IF(reset_, SDL_ReleaseGPUTransferBuffer);
+    draw_commands_ = nullptr;
+    reset_ = nullptr;
+    return false;
+  }
+  draw_capacity_ = capacity;
+  RenderStats::Allocated(GpuMemory::Culling, cmdInfo.size);
+  RenderStats::Allocated(GpuMemory::Staging, trInfo.size);
+  return true;
+}
+
+bool
+GpuCuller::Reserve(u32 count, u32 draws)
+{
+  if (!ReserveDraws(draws)) {
+    return false;
+  }
+  if (count <= capacity_ && visible_ != nullptr) {
+    return true;
+  }
+  const u32 capacity = std::max(std::bit_ceil(std::max(count, 1u)), 64u);
+
+  auto* Device = device_;
+  RELEASE_IF(visible_, SDL_ReleaseGPUBuffer);
+  RenderStats::Allocated(GpuMemory::Culling, -i64(capacity_ * sizeof(Uint32)));
+  capacity_ = 0;
+
+  SDL_GPUBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+                 SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+    info.size = capacity * static_cast<Uint32>(sizeof(Uint32));
+  }
+  visible_ = SDL_CreateGPUBuffer(device_, &info);
+  if (visible_ == nullptr) {
+    LOG_ERROR("Couldn't create visible index buffer: {}", GETERR);
+    return false;
+  }
+  capacity_ = capacity;
+  RenderStats::Allocated(GpuMemory::Culling, info.size);
+  return true;
+}
+
+void
+GpuCuller::Dispatch(SDL_GPUCommandBuffer* cmdbuf,
+                    SDL_GPUBuffer* instances,
+                    u32 count,
+                    std::span<const SDL_GPUIndexedIndirectDrawCommand> draws,
+                    const Frustum& frustum,
+                    float radius)
+{
+  // Reserve() made room for every one of them
+  const Uint32 drawCount = static_cast<Uint32>(draws.size());
+
+  { // Reset the draw commands, the compute pass only adds instances to them
+    auto* cmds = static_cast<SDL_GPUIndexedIndirectDrawCommand*>(
+      SDL_MapGPUTransferBuffer(device_, reset_, true));
+    for (Uint32 d = 0; d < drawCount; ++d) {
+      cmds[d] = draws[d];
+      cmds[d].num_instances = 0;
+      cmds[d].first_instance = 0;
+    }
+    SDL_UnmapGPUTransferBuffer(device_, reset_);
+
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
+    SDL_GPUTransferBufferLocation trLoc{ reset_, 0 };
+    SDL_GPUBufferRegion reg{ draw_commands_,
+                             0,
+                             DrawCommandOffset(drawCount) };
+    SDL_UploadToGPUBuffer(copyPass, &trLoc, &reg, true);
+    SDL_EndGPUCopyPass(copyPass);
+    RenderStats::Add(Counter::UploadBytes, reg.size);
+  }
+
+  GpuCullParams params{};
+  for (int p = 0; p < Frustum::Count; ++p) {
+    params.planes[p] = frustum.Planes[p];
+  }
+  params.radius = radius;
+  params.count = count;
+  params.draw_count = drawCount;
+
+  // the draw commands must not cycle again, it would lose the reset above
+  SDL_GPUStorageBufferReadWriteBinding rw[2]{};
+  rw[0].buffer = visible_;
+  rw[0].cycle = true;
+  rw[1].buffer = draw_commands_;
+  rw[1].cycle = false;
+
+  SDL_GPUComputePass* pass =
+    SDL_BeginGPUComputePass(cmdbuf, nullptr, 0, rw, 2);
+  SDL_BindGPUComputePipeline(pass, pipeline_);
+  SDL_BindGPUComputeStorageBuffers(pass, 0, &instances, 1);
+  SDL_PushGPUComputeUniformData(cmdbuf, 0, &params, sizeof(params));
+  SDL_DispatchGPUCompute(pass, (count + kThreads - 1) / kThreads, 1, 1);
+  SDL_EndGPUComputePass(pass);
+}
+
+const GpuCullValidation&
+GpuCuller::Validate(SDL_GPUBuffer* instances,
+                    const InstanceData* cpu_instances,
+                    u32 count,
+                    std::span<const SDL_GPUIndexedIndirectDrawCommand> draws,
+                    const Frustum& frustum,
+                    float radius)
+{
+  LOG_TRACE("GpuCuller::Validate");
+  validation_ = GpuCullValidation{};
+  const Uint32 cmdSize = sizeof(SDL_GPUIndexedIndirectDrawCommand);
+  const Uint32 listSize = count * static_cast<Uint32>(sizeof(Uint32));
+
+  SDL_GPUTransferBufferCreateInfo trInfo{};
+  {
+    trInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+    trInfo.size = cmdSize + listSize;
+  }
+  SDL_GPUTransferBuffer* download =
+    SDL_CreateGPUTransferBuffer(device_, &trInfo);
+  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
+  if (download == nullptr || cmdbuf == nullptr) {
+    LOG_ERROR("Couldn't set up culling validation: {}", GETERR);
+    if (cmdbuf != nullptr) {
+      SDL_CancelGPUCommandBuffer(cmdbuf);
+    }
+    if (download != nullptr) {
+      SDL_ReleaseGPUTransferBuffer(device_, download);
+    }
+    return validation_;
+  }
+
+  Dispatch(cmdbuf, instances, count, draws, frustum, radius);
+  {
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
+    SDL_GPUBufferRegion cmdReg{ draw_commands_, 0, cmdSize };
+    SDL_GPUTransferBufferLocation cmdLoc{ download, 0 };
+    SDL_DownloadFromGPUBuffer(copyPass, &cmdReg, &cmdLoc);
+    SDL_GPUBufferRegion listReg{ visible_, 0, listSize };
+    SDL_GPUTransferBufferLocation listLoc{ download, cmdSize };
+    SDL_DownloadFromGPUBuffer(copyPass, &listReg, &listLoc);
+    SDL_EndGPUCopyPass(copyPass);
+  }
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdbuf);
+  if (fence == nullptr) {
+    LOG_ERROR("Couldn't submit culling validation: {}", GETERR);
+    SDL_ReleaseGPUTransferBuffer(device_, download);
+    return validation_;
+  }
+  SDL_WaitForGPUFences(device_, true, &fence, 1);
+  SDL_ReleaseGPUFence(device_, fence);
+
+  std::vector<u32> gpu;
+  {
+    auto* data = static_cast<const Uint8*>(
+      SDL_MapGPUTransferBuffer(device_, download, false));
+    SDL_GPUIndexedIndirectDrawCommand cmd;
+    SDL_memcpy(&cmd, data, cmdSize);
+    gpu.resize(std::min<u32>(cmd.num_instances, count));
+    SDL_memcpy(gpu.data(), data + cmdSize, gpu.size() * sizeof(u32));
+    SDL_UnmapGPUTransferBuffer(device_, download);
+  }
+  SDL_ReleaseGPUTransferBuffer(device_, download);
+  std::sort(gpu.begin(), gpu.end()); // append order depends on scheduling
+
+  std::vector<u32> cpu;
+  std::vector<u32> borderline;
+  CullReference(frustum,
+                radius,
+                cpu_instances,
+                count,
+                1e-4f * (1.f + radius),
+                cpu,
+                borderline);
+
+  // symmetric difference, minus instances sitting right on a plane
+  std::vector<u32> diff;
+  std::set_symmetric_difference(
+    gpu.begin(), gpu.end(), cpu.begin(), cpu.end(), std::back_inserter(diff));
+  u32 mismatches = 0;
+  for (u32 idx : diff) {
+    if (!std::binary_search(borderline.begin(), borderline.end(), idx)) {
+      ++mismatches;
+    }
+  }
+
+  validation_.ran = true;
+  validation_.gpu_visible = static_cast<u32>(gpu.size());
+  validation_.cpu_visible = static_cast<u32>(cpu.size());
+  validation_.mismatches = mismatches;
+  validation_.passed = mismatches == 0;
+  if (validation_.passed) {
+    LOG_INFO("GPU culling matches CPU reference: {} of {} visible",
+             validation_.gpu_visible,
+             count);
+  } else {
+    LOG_ERROR("GPU culling differs from CPU reference: {} mismatches "
+              "(gpu {}, cpu {})",
+              mismatches,
+              validation_.gpu_visible,
+              validation_.cpu_visible);
+  }
+  return validation_;
+}
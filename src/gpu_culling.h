@@ -0,0 +1,87 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <glm/glm.hpp>
+#include <span>
+
+#include "src/camera.h"
+#include "src/instances.h"
+#include "types.h"
+
+// Matches uCull in cull.comp (std140)
+struct GpuCullParams
+{
+  glm::vec4 planes[Frustum::Count];
+  float radius;
+  Uint32 count;
+  Uint32 draw_count;
+  Uint32 pad;
+};
+
+struct GpuCullValidation
+{
+  bool ran{ false };
+  bool passed{ false };
+  u32 gpu_visible{ 0 };
+  u32 cpu_visible{ 0 };
+  u32 mismatches{ 0 };
+};
+
+// Frustum culling in a compute pass: every visible instance appends its index
+// to a storage buffer and bumps the instance count of the indexed indirect
+// draw commands (one per submesh), so the scene pass draws without reading
+// anything back.
+class GpuCuller
+{
+public:
+  explicit GpuCuller(SDL_GPUDevice* device);
+  ~GpuCuller();
+
+  bool Init(const char* shader_path);
+  // Room for `count` visible instances and `draws` draw commands
+  bool Reserve(u32 count, u32 draws);
+
+  // Records the draw command reset (copy pass) and the culling (compute pass)
+  // of the first `count` instances of `instances`. `draws` are the commands
+  // to fill, their instance counts are ignored.
+  void Dispatch(SDL_GPUCommandBuffer* cmdbuf,
+                SDL_GPUBuffer* instances,
+                u32 count,
+                std::span<const SDL_GPUIndexedIndirectDrawCommand> draws,
+                const Frustum& frustum,
+                float radius);
+
+  // Culls `cpu_instances` (already uploaded to `instances`) on the GPU in its
+  // own submission, waits for it and compares the indices with CullReference.
+  // Blocks, only meant for debugging and headless checks.
+  const GpuCullValidation& Validate(
+    SDL_GPUBuffer* instances,
+    const InstanceData* cpu_instances,
+    u32 count,
+    std::span<const SDL_GPUIndexedIndirectDrawCommand> draws,
+    const Frustum& frustum,
+    float radius);
+
+  const GpuCullValidation& LastValidation() const { return validation_; }
+  SDL_GPUBuffer* VisibleIndices() const { return visible_; }
+  SDL_GPUBuffer* DrawCommands() const { return draw_commands_; }
+  static Uint32 DrawCommandOffset(u32 draw)
+  {
+    return draw * Uint32{ sizeof(SDL_GPUIndexedIndirectDrawCommand) };
+  }
+
+private:
+  static constexpr Uint32 kThreads = 64;
+  static constexpr u32 kMinDraws = 64;
+
+  bool ReserveDraws(u32 draws);
+
+  SDL_GPUDevice* device_{};
+  SDL_GPUComputePipeline* pipeline_{ nullptr };
+  SDL_GPUBuffer* visible_{ nullptr };
+  SDL_GPUBuffer* draw_commands_{ nullptr };
+  SDL_GPUTransferBuffer* reset_{ nullptr };
+  u32 capacity_{ 0 };      // visible indices
+  u32 draw_capacity_{ 0 }; // draw commands, in draw_commands_ and reset_
+  GpuCullValidation validation_{};
+};
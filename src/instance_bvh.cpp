@@ -0,0 +1,612 @@
+#include "instance_bvh.h"
+
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace {
+
+constexpr u32 kBins = 16;
+constexpr u32 kMinLeaf = 2;           // never split below this
+constexpr u32 kMaxLeaf = 8;           // never keep a leaf above this
+constexpr float kTraversalCost = 1.f; // relative to one sphere test
+constexpr u32 kGrain = 4096;          // instances per job
+constexpr u32 kParallelBuild = 4096;  // subtrees at least this big fork
+constexpr u32 kCullTasks = 64;        // subtrees a Cull spreads over the jobs
+constexpr u32 kAllPlanes = (1u << Frustum::Count) - 1;
+constexpr u32 kOutside = UINT32_MAX;
+// refits keep the topology, rebuild once it costs this much more than built
+constexpr float kRebuildRatio = 1.3f;
+
+struct Box
+{
+  glm::vec3 min{ SDL_MAX_FLOAT };
+  glm::vec3 max{ -SDL_MAX_FLOAT };
+
+  void Grow(const glm::vec3& lo, const glm::vec3& hi)
+  {
+    min = glm::min(min, lo);
+    max = glm::max(max, hi);
+  }
+  float Area() const
+  {
+    const glm::vec3 d = glm::max(max - min, glm::vec3{ 0.f });
+    return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+};
+
+// Bounds of a range of instances and of their centers
+struct RangeBounds
+{
+  Box bounds;
+  Box centers;
+
+  void Merge(const RangeBounds& other)
+  {
+    bounds.Grow(other.bounds.min, other.bounds.max);
+    centers.Grow(other.centers.min, other.centers.max);
+  }
+};
+
+struct Bins
+{
+  RangeBounds range[kBins];
+  u32 count[kBins]{};
+
+  void Merge(const Bins& other)
+  {
+    for (u32 b = 0; b < kBins; ++b) {
+      range[b].Merge(other.range[b]);
+      count[b] += other.count[b];
+    }
+  }
+};
+
+// Folds items [begin, end) into a T with `add`, in parallel chunks merged
+// afterwards for large ranges.
+template<typename T, typename Add>
+T
+Fold(JobSystem& jobs, u32 begin, u32 end, const Add& add)
+{
+  const u32 count = end - begin;
+  if (count < 4 * kGrain) {
+    T acc;
+    for (u32 i = begin; i < end; ++i) {
+      add(acc, i);
+    }
+    return acc;
+  }
+  std::vector<T> partial((count + kGrain - 1) / kGrain);
+  jobs.ParallelFor(count, kGrain, [&](u32 b, u32 e) {
+    T& acc = partial[b / kGrain];
+    for (u32 i = begin + b; i < begin + e; ++i) {
+      add(acc, i);
+    }
+  });
+  T acc;
+  for (const auto& p : partial) {
+    acc.Merge(p);
+  }
+  return acc;
+}
+
+// Planes of `mask` the box isn't fully inside of, kOutside when it's fully
+// outside of one.
+u32
+TestBox(const Frustum& f, const glm::vec3& min, const glm::vec3& max, u32 mask)
+{
+  for (u32 p = 0; p < Frustum::Count; ++p) {
+    if ((mask & (1u << p)) == 0) {
+      continue;
+    }
+    const glm::vec4& plane = f.Planes[p];
+    const glm::vec3 n{ plane };
+    // the corners farthest along and against the normal
+    const glm::vec3 far{ n.x > 0.f ? max.x : min.x,
+                         n.y > 0.f ? max.y : min.y,
+                         n.z > 0.f ? max.z : min.z };
+    const glm::vec3 near{ n.x > 0.f ? min.x : max.x,
+                          n.y > 0.f ? min.y : max.y,
+                          n.z > 0.f ? min.z : max.z };
+    if (glm::dot(n, far) + plane.w < 0.f) {
+      return kOutside;
+    }
+    if (glm::dot(n, near) + plane.w >= 0.f) {
+      mask &= ~(1u << p);
+    }
+  }
+  return mask;
+}
+
+// Entry distance of the ray into the box, or a negative value on a miss
+float
+RayBox(const glm::vec3& origin,
+       const glm::vec3& inv_dir,
+       const glm::vec3& min,
+       const glm::vec3& max,
+       float limit)
+{
+  const glm::vec3 t0 = (min - origin) * inv_dir;
+  const glm::vec3 t1 = (max - origin) * inv_dir;
+  const glm::vec3 lo = glm::min(t0, t1);
+  const glm::vec3 hi = glm::max(t0, t1);
+  const float enter = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.f));
+  const float exit = std::min(std::min(hi.x, hi.y), std::min(hi.z, limit));
+  return enter <= exit ? enter : -1.f;
+}
+
+// v rotated by the conjugate of q, undoing vert.vert's rotate()
+glm::vec3
+InverseRotate(const float* q, const glm::vec3& v)
+{
+  const glm::vec3 u{ -q[0], -q[1], -q[2] };
+  return v + 2.f * glm::cross(u, glm::cross(u, v) + q[3] * v);
+}
+
+} // namespace
+
+void
+InstanceBvh::Update(const InstanceData* instances,
+                    u32 count,
+                    float radius,
+                    JobSystem& jobs)
+{
+  if (count == 0) {
+    Clear();
+    return;
+  }
+  const Uint64 start = SDL_GetTicksNS();
+  if (count != Count() || radius != radius_) {
+    radius_ = radius;
+    Build(instances, count, jobs);
+  } else {
+    Refit(instances, jobs);
+    stats_.sah_cost = SahCost();
+    if (stats_.sah_cost > built_cost_ * kRebuildRatio) {
+      Build(instances, count, jobs);
+    }
+  }
+  stats_.update_ms = float(SDL_GetTicksNS() - start) / 1e6f;
+}
+
+void
+InstanceBvh::Clear()
+{
+  nodes_.clear();
+  prims_.clear();
+  leaves_.clear();
+  stats_ = {};
+}
+
+void
+InstanceBvh::PrimBounds(const InstanceData* instances, Prim& prim) const
+{
+  const InstanceData& inst = instances[prim.instance];
+  const glm::vec3 p{ inst.position[0], inst.position[1], inst.position[2] };
+  const glm::vec3 r{ radius_ * inst.scale };
+  prim.min = p - r;
+  prim.max = p + r;
+}
+
+void
+InstanceBvh::Build(const InstanceData* instances, u32 count, JobSystem& jobs)
+{
+  const Uint64 start = SDL_GetTicksNS();
+  prims_.resize(count);
+  jobs.ParallelFor(count, kGrain, [&](u32 begin, u32 end) {
+    for (u32 i = begin; i < end; ++i) {
+      prims_[i].instance = i;
+      PrimBounds(instances, prims_[i]);
+    }
+  });
+  // a binary tree over `count` leaves of at least one instance
+  nodes_.resize(2 * count - 1);
+  node_count_ = 1;
+  depth_ = 0;
+  BuildNode(0, 0, count, 1, Bounds(0, count, jobs), jobs);
+  nodes_.resize(node_count_);
+
+  leaves_.clear();
+  for (u32 n = 0; n < nodes_.size(); ++n) {
+    if (nodes_[n].count != 0) {
+      leaves_.push_back(n);
+    }
+  }
+  built_cost_ = SahCost();
+  stats_.nodes = static_cast<u32>(nodes_.size());
+  stats_.leaves = static_cast<u32>(leaves_.size());
+  stats_.depth = depth_;
+  stats_.sah_cost = built_cost_;
+  stats_.build_ms = float(SDL_GetTicksNS() - start) / 1e6f;
+  ++stats_.rebuilds;
+}
+
+InstanceBvh::Range
+InstanceBvh::Bounds(u32 begin, u32 end, JobSystem& jobs) const
+{
+  const auto range =
+    Fold<RangeBounds>(jobs, begin, end, [&](RangeBounds& acc, u32 k) {
+      const Prim& prim = prims_[k];
+      acc.bounds.Grow(prim.min, prim.max);
+      const glm::vec3 c = (prim.min + prim.max) * .5f;
+      acc.centers.Grow(c, c);
+    });
+  return { range.bounds.min,
+           range.bounds.max,
+           range.centers.min,
+           range.centers.max };
+}
+
+void
+InstanceBvh::BuildNode(u32 node,
+                       u32 begin,
+                       u32 end,
+                       u32 depth,
+                       const Range& range,
+                       JobSystem& jobs)
+{
+  u32 deepest = depth_;
+  while (depth > deepest && !depth_.compare_exchange_weak(deepest, depth)) {
+  }
+
+  Node& n = nodes_[node];
+  n.min = range.min;
+  n.max = range.max;
+  const u32 count = end - begin;
+  auto make_leaf = [&] {
+    n.first = begin;
+    n.count = count;
+  };
+  if (count <= kMinLeaf) {
+    make_leaf();
+    return;
+  }
+
+  // bin the centers along their widest axis, sweep for the cheapest split
+  const glm::vec3 extent = range.center_max - range.center_min;
+  int axis = 0;
+  if (extent.y > extent[axis]) {
+    axis = 1;
+  }
+  if (extent.z > extent[axis]) {
+    axis = 2;
+  }
+  if (!(extent[axis] > 0.f)) {
+    // every center on top of each other, no split tells them apart
+    if (count <= kMaxLeaf) {
+      make_leaf();
+      return;
+    }
+    const u32 mid = begin + count / 2;
+    Split(node, begin, mid, end, depth, Bounds(begin, mid, jobs),
+          Bounds(mid, end, jobs), jobs);
+    return;
+  }
+
+  const float origin = range.center_min[axis];
+  const float scale = float(kBins) / extent[axis];
+  auto bin_of = [&](const Prim& prim) {
+    const float c = (prim.min[axis] + prim.max[axis]) * .5f;
+    return std::min(u32((c - origin) * scale), kBins - 1);
+  };
+  const auto bins = Fold<Bins>(jobs, begin, end, [&](Bins& acc, u32 k) {
+    const Prim& prim = prims_[k];
+    const u32 b = bin_of(prim);
+    acc.range[b].bounds.Grow(prim.min, prim.max);
+    const glm::vec3 c = (prim.min + prim.max) * .5f;
+    acc.range[b].centers.Grow(c, c);
+    ++acc.count[b];
+  });
+
+  RangeBounds right[kBins];
+  u32 right_count[kBins];
+  for (u32 b = kBins - 1, total = 0; b > 0; --b) {
+    right[b] = bins.range[b];
+    if (b + 1 < kBins) {
+      right[b].Merge(right[b + 1]);
+    }
+    total += bins.count[b];
+    right_count[b] = total;
+  }
+  RangeBounds left;
+  RangeBounds best_left;
+  float best_cost = SDL_MAX_FLOAT;
+  u32 best_split = 0;
+  for (u32 s = 1, total = 0; s < kBins; ++s) {
+    left.Merge(bins.range[s - 1]);
+    total += bins.count[s - 1];
+    if (total == 0 || right_count[s] == 0) {
+      continue;
+    }
+    const float cost = left.bounds.Area() * float(total) +
+                       right[s].bounds.Area() * float(right_count[s]);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_split = s;
+      best_left = left;
+    }
+  }
+
+  const float area = Box{ range.min, range.max }.Area();
+  const float split_cost =
+    kTraversalCost + (area > 0.f ? best_cost / area : float(count));
+  if (best_split == 0 || (split_cost >= float(count) && count <= kMaxLeaf)) {
+    make_leaf();
+    return;
+  }
+  const auto split =
+    std::partition(prims_.begin() + begin,
+                   prims_.begin() + end,
+                   [&](const Prim& prim) { return bin_of(prim) < best_split; });
+  const u32 mid = static_cast<u32>(split - prims_.begin());
+  const auto& r = right[best_split];
+  Split(node,
+        begin,
+        mid,
+        end,
+        depth,
+        { best_left.bounds.min,
+          best_left.bounds.max,
+          best_left.centers.min,
+          best_left.centers.max },
+        { r.bounds.min, r.bounds.max, r.centers.min, r.centers.max },
+        jobs);
+}
+
+void
+InstanceBvh::Split(u32 node,
+                   u32 begin,
+                   u32 mid,
+                   u32 end,
+                   u32 depth,
+                   const Range& left,
+                   const Range& right,
+                   JobSystem& jobs)
+{
+  const u32 children = node_count_.fetch_add(2);
+  nodes_[node].first = children;
+  nodes_[node].count = 0;
+  if (end - begin >= kParallelBuild) {
+    const std::function<void()> left_job[] = { [&] {
+      BuildNode(children, begin, mid, depth + 1, left, jobs);
+    } };
+    jobs.Run(left_job, [&] {
+      BuildNode(children + 1, mid, end, depth + 1, right, jobs);
+    });
+  } else {
+    BuildNode(children, begin, mid, depth + 1, left, jobs);
+    BuildNode(children + 1, mid, end, depth + 1, right, jobs);
+  }
+}
+
+void
+InstanceBvh::Refit(const InstanceData* instances, JobSystem& jobs)
+{
+  jobs.ParallelFor(
+    static_cast<u32>(leaves_.size()), kGrain / 4, [&](u32 begin, u32 end) {
+      for (u32 l = begin; l < end; ++l) {
+        Node& n = nodes_[leaves_[l]];
+        Box box;
+        for (u32 k = n.first; k < n.first + n.count; ++k) {
+          PrimBounds(instances, prims_[k]);
+          box.Grow(prims_[k].min, prims_[k].max);
+        }
+        n.min = box.min;
+        n.max = box.max;
+      }
+    });
+  // children come after their parent, so backwards is bottom up
+  for (u32 i = static_cast<u32>(nodes_.size()); i-- > 0;) {
+    Node& n = nodes_[i];
+    if (n.count == 0) {
+      n.min = glm::min(nodes_[n.first].min, nodes_[n.first + 1].min);
+      n.max = glm::max(nodes_[n.first].max, nodes_[n.first + 1].max);
+    }
+  }
+}
+
+float
+InstanceBvh::SahCost() const
+{
+  float cost = 0.f;
+  for (const auto& n : nodes_) {
+    const float area = Box{ n.min, n.max }.Area();
+    cost += area * (n.count == 0 ? kTraversalCost : float(n.count));
+  }
+  const float root = Box{ nodes_[0].min, nodes_[0].max }.Area();
+  return root > 0.f ? cost / root : 0.f;
+}
+
+u32
+InstanceBvh::Cull(const Frustum& frustum,
+                  const InstanceData* instances,
+                  JobSystem& jobs,
+                  InstanceData* out)
+{
+  stats_.visited = 0;
+  tasks_.clear();
+  if (nodes_.empty()) {
+    return 0;
+  }
+  const u32 root = TestBox(frustum, nodes_[0].min, nodes_[0].max, kAllPlanes);
+  stats_.visited = 1;
+  if (root != kOutside) {
+    tasks_.push_back({ 0, root });
+  }
+
+  // breadth first until there are enough subtrees to spread over the jobs
+  std::vector<CullTask> next;
+  bool expanded = true;
+  while (expanded && !tasks_.empty() && tasks_.size() < kCullTasks) {
+    expanded = false;
+    next.clear();
+    for (const auto& task : tasks_) {
+      const Node& n = nodes_[task.node];
+      if (n.count != 0 || task.planes == 0) {
+        next.push_back(task);
+        continue;
+      }
+      for (u32 child = n.first; child < n.first + 2; ++child) {
+        const Node& c = nodes_[child];
+        const u32 planes = TestBox(frustum, c.min, c.max, task.planes);
+        if (planes != kOutside) {
+          next.push_back({ child, planes });
+        }
+      }
+      stats_.visited += 2;
+      expanded = true;
+    }
+    std::swap(tasks_, next);
+  }
+
+  const u32 task_count = static_cast<u32>(tasks_.size());
+  task_hits_.resize(task_count);
+  std::vector<u32> visited(task_count, 0);
+  jobs.ParallelFor(task_count, 1, [&](u32 begin, u32 end) {
+    for (u32 t = begin; t < end; ++t) {
+      task_hits_[t].clear();
+      visited[t] = CullSubtree(frustum, instances, tasks_[t], task_hits_[t]);
+    }
+  });
+
+  task_offsets_.resize(task_count + 1);
+  task_offsets_[0] = 0;
+  for (u32 t = 0; t < task_count; ++t) {
+    task_offsets_[t + 1] =
+      task_offsets_[t] + static_cast<u32>(task_hits_[t].size());
+    stats_.visited += visited[t];
+  }
+  jobs.ParallelFor(task_count, 1, [&](u32 begin, u32 end) {
+    for (u32 t = begin; t < end; ++t) {
+      InstanceData* dst = out + task_offsets_[t];
+      for (u32 idx : task_hits_[t]) {
+        *dst++ = instances[idx];
+      }
+    }
+  });
+  return task_offsets_[task_count];
+}
+
+u32
+InstanceBvh::CullSubtree(const Frustum& frustum,
+                         const InstanceData* instances,
+                         CullTask task,
+                         std::vector<u32>& out) const
+{
+  u32 visited = 0;
+  std::vector<CullTask> stack{ task };
+  while (!stack.empty()) {
+    const CullTask top = stack.back();
+    stack.pop_back();
+    const Node& n = nodes_[top.node];
+    if (n.count == 0) {
+      for (u32 child = n.first; child < n.first + 2; ++child) {
+        const Node& c = nodes_[child];
+        const u32 planes =
+          top.planes == 0 ? 0 : TestBox(frustum, c.min, c.max, top.planes);
+        if (planes != kOutside) {
+          stack.push_back({ child, planes });
+        }
+      }
+      visited += 2;
+      continue;
+    }
+    // the leaf's spheres against the planes its box straddles
+    for (u32 k = n.first; k < n.first + n.count; ++k) {
+      const u32 idx = prims_[k].instance;
+      const float* p = instances[idx].position;
+      const float r = radius_ * instances[idx].scale;
+      bool inside = true;
+      for (u32 pl = 0; pl < Frustum::Count && inside; ++pl) {
+        if ((top.planes & (1u << pl)) != 0) {
+          const glm::vec4& plane = frustum.Planes[pl];
+          inside = plane.x * p[0] + plane.y * p[1] + plane.z * p[2] +
+                     plane.w >=
+                   -r;
+        }
+      }
+      if (inside) {
+        out.push_back(idx);
+      }
+    }
+  }
+  return visited;
+}
+
+BvhHit
+InstanceBvh::Raycast(const glm::vec3& origin,
+                     const glm::vec3& dir,
+                     const InstanceData* instances,
+                     const glm::vec3& box_min,
+                     const glm::vec3& box_max)
+{
+  BvhHit hit;
+  stats_.visited = 0;
+  if (nodes_.empty()) {
+    return hit;
+  }
+  const glm::vec3 inv_dir = 1.f / dir;
+  float best = SDL_MAX_FLOAT;
+  std::vector<std::pair<u32, float>> stack;
+  const float root_t =
+    RayBox(origin, inv_dir, nodes_[0].min, nodes_[0].max, best);
+  if (root_t >= 0.f) {
+    stack.push_back({ 0, root_t });
+  }
+  while (!stack.empty()) {
+    const auto [node, enter] = stack.back();
+    stack.pop_back();
+    ++stats_.visited;
+    if (enter > best) {
+      continue; // a nearer hit was found since it was pushed
+    }
+    const Node& n = nodes_[node];
+    if (n.count == 0) {
+      const Node& a = nodes_[n.first];
+      const Node& b = nodes_[n.first + 1];
+      const float ta = RayBox(origin, inv_dir, a.min, a.max, best);
+      const float tb = RayBox(origin, inv_dir, b.min, b.max, best);
+      // the nearer child on top
+      const bool a_first = ta >= 0.f && (tb < 0.f || ta <= tb);
+      if (a_first) {
+        if (tb >= 0.f) {
+          stack.push_back({ n.first + 1, tb });
+        }
+        stack.push_back({ n.first, ta });
+      } else {
+        if (ta >= 0.f) {
+          stack.push_back({ n.first, ta });
+        }
+        if (tb >= 0.f) {
+          stack.push_back({ n.first + 1, tb });
+        }
+      }
+      continue;
+    }
+    // the mesh box in each instance's space, as vert.vert places it
+    for (u32 k = n.first; k < n.first + n.count; ++k) {
+      const Prim& prim = prims_[k];
+      if (RayBox(origin, inv_dir, prim.min, prim.max, best) < 0.f) {
+        continue;
+      }
+      const u32 idx = prim.instance;
+      const InstanceData& inst = instances[idx];
+      const glm::vec3 p{ inst.position[0],
+                         inst.position[1],
+                         inst.position[2] };
+      const glm::vec3 local_origin =
+        InverseRotate(inst.rotation, origin - p) / inst.scale;
+      const glm::vec3 local_dir =
+        InverseRotate(inst.rotation, dir) / inst.scale;
+      const float t =
+        RayBox(local_origin, 1.f / local_dir, box_min, box_max, best);
+      if (t >= 0.f && t < best) {
+        best = t;
+        hit = { idx, t };
+      }
+    }
+  }
+  return hit;
+}
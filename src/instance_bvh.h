@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "src/camera.h"
+#include "src/instances.h"
+#include "src/job_system.h"
+#include "types.h"
+
+struct BvhStats
+{
+  u32 nodes{ 0 };
+  u32 leaves{ 0 };
+  u32 depth{ 0 };
+  u32 rebuilds{ 0 };
+  float sah_cost{ 0.f }; // of the current tree, relative to its root
+  float build_ms{ 0.f }; // the last rebuild
+  float update_ms{ 0.f }; // the last Update, rebuild or refit
+  u32 visited{ 0 };      // nodes the last query touched
+};
+
+struct BvhHit
+{
+  static constexpr u32 kNone = UINT32_MAX;
+  u32 instance{ kNone };
+  float t{ 0.f }; // along the ray, in units of its direction
+};
+
+// Bounding volume hierarchy over the instances' culling spheres (position,
+// radius * scale, see FrustumCuller).
+//
+// Built top down with binned SAH, subtrees and the binning of large ranges
+// spread over the job system. Moving instances only refit the bounds bottom
+// up; the tree is rebuilt when the instance count changes or refits made
+// its SAH cost drift too far from the built one. Queries only descend into
+// the nodes they touch, O(log n) plus the size of the result.
+class InstanceBvh
+{
+public:
+  // Refits to `instances`, or rebuilds when needed.
+  void Update(const InstanceData* instances,
+              u32 count,
+              float radius,
+              JobSystem& jobs);
+  void Clear();
+  u32 Count() const { return static_cast<u32>(prims_.size()); }
+
+  // Same result as FrustumCuller::Cull, in tree order, without touching
+  // `instances`. Nodes fully inside skip their remaining plane tests.
+  u32 Cull(const Frustum& frustum,
+           const InstanceData* instances,
+           JobSystem& jobs,
+           InstanceData* out);
+
+  // Nearest instance along the ray whose box is hit. `box_min`, `box_max`
+  // bound the mesh in the space vert.vert scales and rotates, i.e. under the
+  // shared model matrix.
+  BvhHit Raycast(const glm::vec3& origin,
+                 const glm::vec3& dir,
+                 const InstanceData* instances,
+                 const glm::vec3& box_min,
+                 const glm::vec3& box_max);
+
+  const BvhStats& Stats() const { return stats_; }
+
+private:
+  // Internal nodes have count 0 and their children at first, first + 1.
+  // Children always come after their parent.
+  struct Node
+  {
+    glm::vec3 min;
+    u32 first;
+    glm::vec3 max;
+    u32 count;
+  };
+  static_assert(sizeof(Node) == 32);
+
+  // An instance's culling sphere bounds, stored in leaf order
+  struct Prim
+  {
+    glm::vec3 min;
+    u32 instance;
+    glm::vec3 max;
+    u32 unused;
+  };
+
+  // Bounds of a range of prims and of their centers
+  struct Range
+  {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center_min;
+    glm::vec3 center_max;
+  };
+
+  // A subtree a Cull job walks, with the planes it still has to test
+  struct CullTask
+  {
+    u32 node;
+    u32 planes;
+  };
+
+  void Build(const InstanceData* instances, u32 count, JobSystem& jobs);
+  Range Bounds(u32 begin, u32 end, JobSystem& jobs) const;
+  void BuildNode(u32 node,
+                 u32 begin,
+                 u32 end,
+                 u32 depth,
+                 const Range& range,
+                 JobSystem& jobs);
+  // Makes `node` internal over [begin, mid) and [mid, end), builds both
+  void Split(u32 node,
+             u32 begin,
+             u32 mid,
+             u32 end,
+             u32 depth,
+             const Range& left,
+             const Range& right,
+             JobSystem& jobs);
+  void Refit(const InstanceData* instances, JobSystem& jobs);
+  void PrimBounds(const InstanceData* instances, Prim& prim) const;
+  // Appends the visible instances under the task's node, returns the nodes
+  // it visited.
+  u32 CullSubtree(const Frustum& frustum,
+                  const InstanceData* instances,
+                  CullTask task,
+                  std::vector<u32>& out) const;
+  float SahCost() const;
+
+private:
+  std::vector<Node> nodes_;
+  std::atomic<u32> node_count_{ 0 };
+  std::atomic<u32> depth_{ 0 };
+  std::vector<Prim> prims_;
+  std::vector<u32> leaves_; // node index of every leaf
+  float radius_{ 0.f };
+  float built_cost_{ 0.f };
+  std::vector<CullTask> tasks_;
+  std::vector<std::vector<u32>> task_hits_;
+  std::vector<u32> task_offsets_;
+  BvhStats stats_;
+};
@@ -0,0 +1,284 @@
+#include "instances.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "src/logger.h"
+#include "src/render_stats.h"
+#include "util.h"
+
+namespace {
+
+constexpr float kPi = 3.14159265f;
+constexpr u32 kGrain = 4096; // instances per job, multiple of the SIMD width
+
+// The buffer and its transfer buffer are both `capacity` instances
+void
+TrackInstanceMemory(u32 capacity, i64 sign)
+{
+  const i64 bytes = sign * i64(capacity) * i64(sizeof(InstanceData));
+  RenderStats::Allocated(GpuMemory::Instances, bytes);
+  RenderStats::Allocated(GpuMemory::Staging, bytes);
+}
+
+// Range-reduced odd polynomial, ~1e-5 abs error. The SIMD version below must
+// stay identical so the tail of a batch animates like the rest of it.
+float
+FastSin(float x)
+{
+  x -= kTwoPi * static_cast<float>(static_cast<int>(
+                  x * (1.f / kTwoPi) + (x >= 0.f ? .5f : -.5f)));
+  if (x > kPi * .5f) {
+    x = kPi - x;
+  } else if (x < -kPi * .5f) {
+    x = -kPi - x;
+  }
+  const float x2 = x * x;
+  return x * (1.f + x2 * (-1.f / 6 + x2 * (1.f / 120 + x2 * (-1.f / 5040 +
+                                                           x2 / 362880))));
+}
+
+#if defined(__SSE2__)
+__m128
+SinPs(__m128 x)
+{
+  const __m128 half_pi = _mm_set1_ps(kPi * .5f);
+  const __m128 pi = _mm_set1_ps(kPi);
+  const __m128 sign = _mm_set1_ps(-0.f);
+
+  // round to nearest, away from zero, like the scalar version
+  __m128 q = _mm_mul_ps(x, _mm_set1_ps(1.f / kTwoPi));
+  q = _mm_add_ps(q, _mm_or_ps(_mm_and_ps(q, sign), _mm_set1_ps(.5f)));
+  q = _mm_cvtepi32_ps(_mm_cvttps_epi32(q));
+  x = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(kTwoPi)));
+
+  // fold into [-pi/2, pi/2]: x' = copysign(pi, x) - x where |x| > pi/2
+  __m128 abs = _mm_andnot_ps(sign, x);
+  __m128 fold = _mm_cmpgt_ps(abs, half_pi);
+  __m128 mirrored = _mm_sub_ps(_mm_or_ps(pi, _mm_and_ps(x, sign)), x);
+  x = _mm_or_ps(_mm_and_ps(fold, mirrored), _mm_andnot_ps(fold, x));
+
+  const __m128 x2 = _mm_mul_ps(x, x);
+  __m128 p = _mm_set1_ps(1.f / 362880);
+  p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.f / 5040));
+  p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.f / 120));
+  p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.f / 6));
+  p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.f));
+  return _mm_mul_ps(p, x);
+}
+#endif
+
+} // namespace
+
+void
+InstanceField::Resize(const InstancingCfg& cfg)
+{
+  const bool layout_changed =
+    cfg.dimension != cfg_.dimension || cfg.spread != cfg_.spread;
+  cfg_ = cfg;
+  if (!layout_changed) {
+    return;
+  }
+
+  const u32 d = cfg.dimension;
+  const u32 count = d * d * d;
+  const float origin = GridOrigin();
+  pos_x_.resize(count);
+  pos_y_.resize(count);
+  pos_z_.resize(count);
+  scale_.resize(count);
+  phase_.resize(count);
+  speed_.resize(count);
+
+  for (u32 i = 0; i < count; ++i) {
+    pos_x_[i] = origin + static_cast<float>(i % d) * cfg.spread;
+    pos_y_[i] = origin + static_cast<float>((i / d) % d) * cfg.spread;
+    pos_z_[i] = origin + static_cast<float>(i / (d * d)) * cfg.spread;
+    scale_[i] = 1.f;
+    phase_[i] = Hash01(i) * kTwoPi;
+    speed_[i] = 1.f + Hash01(i ^ 0x9e3779b9U) * .5f;
+  }
+  LOG_DEBUG("Instance field resized to {} instances", count);
+}
+
+void
+InstanceField::SetPosition(u32 idx, float x, float y, float z)
+{
+  pos_x_[idx] = x;
+  pos_y_[idx] = y;
+  pos_z_[idx] = z;
+}
+
+void
+InstanceField::SetScale(u32 idx, float scale)
+{
+  scale_[idx] = scale;
+}
+
+void
+InstanceField::Generate(float time, JobSystem& jobs, InstanceData* out) const
+{
+  jobs.ParallelFor(Count(), kGrain, [&](u32 begin, u32 end) {
+    GenerateRange(time, begin, end, out);
+  });
+}
+
+void
+InstanceField::GenerateRange(float time,
+                             u32 begin,
+                             u32 end,
+                             InstanceData* out) const
+{
+  u32 i = begin;
+#if defined(__SSE2__)
+  const __m128 t = _mm_set1_ps(time);
+  const __m128 bob = _mm_set1_ps(cfg_.bob);
+  const __m128 half_sway = _mm_set1_ps(cfg_.sway * .5f);
+  const __m128 half_pi = _mm_set1_ps(kPi * .5f);
+  const __m128 zero = _mm_setzero_ps();
+
+  for (; i + 4 <= end; i += 4) {
+    const __m128 phase = _mm_loadu_ps(&phase_[i]);
+    const __m128 speed = _mm_loadu_ps(&speed_[i]);
+    const __m128 wave = SinPs(_mm_add_ps(_mm_mul_ps(t, speed), phase));
+
+    __m128 px = _mm_loadu_ps(&pos_x_[i]);
+    __m128 py = _mm_add_ps(_mm_loadu_ps(&pos_y_[i]), _mm_mul_ps(wave, bob));
+    __m128 pz = _mm_loadu_ps(&pos_z_[i]);
+    __m128 ps = _mm_loadu_ps(&scale_[i]);
+
+    // yaw-only quaternion: (0, sin(a/2), 0, cos(a/2))
+    const __m128 half_yaw = _mm_mul_ps(wave, half_sway);
+    __m128 qx = zero;
+    __m128 qy = SinPs(half_yaw);
+    __m128 qz = zero;
+    __m128 qw = SinPs(_mm_add_ps(half_yaw, half_pi));
+
+    __m128 p0 = phase, p1 = speed, p2 = wave, p3 = zero;
+
+    _MM_TRANSPOSE4_PS(px, py, pz, ps);
+    _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+    float* dst = reinterpret_cast<float*>(&out[i]);
+    constexpr u32 stride = sizeof(InstanceData) / sizeof(float);
+    _mm_storeu_ps(dst + 0 * stride + 0, px);
+    _mm_storeu_ps(dst + 0 * stride + 4, qx);
+    _mm_storeu_ps(dst + 0 * stride + 8, p0);
+    _mm_storeu_ps(dst + 1 * stride + 0, py);
+    _mm_storeu_ps(dst + 1 * stride + 4, qy);
+    _mm_storeu_ps(dst + 1 * stride + 8, p1);
+    _mm_storeu_ps(dst + 2 * stride + 0, pz);
+    _mm_storeu_ps(dst + 2 * stride + 4, qz);
+    _mm_storeu_ps(dst + 2 * stride + 8, p2);
+    _mm_storeu_ps(dst + 3 * stride + 0, ps);
+    _mm_storeu_ps(dst + 3 * stride + 4, qw);
+    _mm_storeu_ps(dst + 3 * stride + 8, p3);
+  }
+#endif
+
+  for (; i < end; ++i) {
+    out[i] = Instance(time, i);
+  }
+}
+
+InstanceData
+InstanceField::Instance(float time, u32 idx) const
+{
+  const float wave = FastSin(time * speed_[idx] + phase_[idx]);
+  const float half_yaw = wave * (cfg_.sway * .5f);
+  return InstanceData{
+    .position = { pos_x_[idx], pos_y_[idx] + wave * cfg_.bob, pos_z_[idx] },
+    .scale = scale_[idx],
+    .rotation = { 0.f,
+                  FastSin(half_yaw),
+                  0.f,
+                  FastSin(half_yaw + kPi * .5f) },
+    .params = { phase_[idx], speed_[idx], wave, 0.f },
+  };
+}
+
+InstanceBuffer::InstanceBuffer(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+  TrackInstanceMemory(capacity_, -1);
+  auto* Device = device_;
+  RELEASE_IF(buffer_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(transfer_, SDL_ReleaseGPUTransferBuffer);
+}
+
+bool
+InstanceBuffer::Reserve(u32 count)
+{
+  if (count <= capacity_ && buffer_ != nullptr) {
+    return true;
+  }
+  // Round up so dragging the dimension slider doesn't reallocate every step.
+  const u32 capacity = std::max(std::bit_ceil(std::max(count, 1u)), 64u);
+  const u32 size = capacity * static_cast<u32>(sizeof(InstanceData));
+
+  TrackInstanceMemory(capacity_, -1);
+  auto* Device = device_;
+  RELEASE_IF(buffer_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(transfer_, SDL_ReleaseGPUTransferBuffer);
+  buffer_ = nullptr;
+  transfer_ = nullptr;
+  capacity_ = 0;
+
+  SDL_GPUBufferCreateInfo bufInfo{};
+  {
+    bufInfo.usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+                    SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    bufInfo.size = size;
+  }
+  buffer_ = SDL_CreateGPUBuffer(device_, &bufInfo);
+
+  SDL_GPUTransferBufferCreateInfo trInfo{};
+  {
+    trInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    trInfo.size = size;
+  }
+  transfer_ = SDL_CreateGPUTransferBuffer(device_, &trInfo);
+
+  if (buffer_ == nullptr || transfer_ == nullptr) {
+    LOG_ERROR("Couldn't create instance buffers: {}", GETERR);
+    return false;
+  }
+  capacity_ = capacity;
+  TrackInstanceMemory(capacity_, 1);
+  LOG_DEBUG("Instance buffer grown to {} instances", capacity_);
+  return true;
+}
+
+InstanceData*
+InstanceBuffer::Map()
+{
+  // cycle: the previous frame may still be reading the old contents
+  return static_cast<InstanceData*>(
+    SDL_MapGPUTransferBuffer(device_, transfer_, true));
+}
+
+void
+InstanceBuffer::Unmap()
+{
+  SDL_UnmapGPUTransferBuffer(device_, transfer_);
+}
+
+void
+InstanceBuffer::Upload(SDL_GPUCopyPass* pass, u32 count)
+{
+  SDL_GPUTransferBufferLocation trLoc{ transfer_, 0 };
+  SDL_GPUBufferRegion reg{ buffer_,
+                           0,
+                           count * static_cast<u32>(sizeof(InstanceData)) };
+  SDL_UploadToGPUBuffer(pass, &trLoc, &reg, true);
+  RenderStats::Add(Counter::UploadBytes, reg.size);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "src/job_system.h"
+#include "types.h"
+
+struct InstancingCfg
+{
+  float spread = 5.f;   // gap between each mesh instance
+  Uint32 dimension = 6; // instance count per side
+  float bob = .3f;      // vertical swim amplitude
+  float sway = .25f;    // yaw swing amplitude, in radians
+
+  bool operator==(const InstancingCfg&) const = default;
+};
+
+// Layout of one instance in the storage buffer read by vert.vert (std430).
+struct InstanceData
+{
+  float position[3];
+  float scale;
+  float rotation[4]; // quaternion, xyzw
+  float params[4];   // phase, speed, wave, unused
+};
+static_assert(sizeof(InstanceData) == 48, "must match vert.vert");
+
+inline constexpr float kTwoPi = 6.28318531f;
+
+// Cheap deterministic [0, 1) noise, so whatever it scatters comes out the
+// same every run.
+inline float
+Hash01(u32 x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return static_cast<float>(x >> 8) * (1.f / 16777216.f);
+}
+
+// One swimming instance, `rotation` being a quaternion (xyzw) and `phase` and
+// `speed` driving the wave vert.vert bends the mesh with.
+inline InstanceData
+ToInstance(const glm::vec3& position,
+           const glm::vec4& rotation,
+           float scale,
+           float phase,
+           float speed,
+           float time)
+{
+  return InstanceData{
+    .position = { position.x, position.y, position.z },
+    .scale = scale,
+    .rotation = { rotation.x, rotation.y, rotation.z, rotation.w },
+    .params = { phase, speed, std::sin(time * speed + phase), 0.f },
+  };
+}
+
+// CPU side per-instance state. Kept as SoA so Generate can animate 4
+// instances per SSE instruction; the AoS InstanceData is only produced when
+// writing to the upload buffer.
+class InstanceField
+{
+public:
+  // Rebuilds the grid layout when the config changed, keeps it otherwise.
+  void Resize(const InstancingCfg& cfg);
+  u32 Count() const { return static_cast<u32>(pos_x_.size()); }
+  // The grid fills the cube [origin, origin + size] on every axis.
+  float GridOrigin() const { return -2.f * static_cast<float>(cfg_.dimension); }
+  float GridSize() const { return cfg_.spread * float(cfg_.dimension); }
+
+  void SetPosition(u32 idx, float x, float y, float z);
+  void SetScale(u32 idx, float scale);
+
+  // Animates every instance at `time` and writes them to `out`, which must
+  // hold Count() elements. Work is split across `jobs`.
+  void Generate(float time, JobSystem& jobs, InstanceData* out) const;
+  // One instance at `time`, as Generate writes it.
+  InstanceData Instance(float time, u32 idx) const;
+
+private:
+  void GenerateRange(float time, u32 begin, u32 end, InstanceData* out) const;
+
+private:
+  InstancingCfg cfg_{ .spread = 0.f, .dimension = 0 };
+  std::vector<float> pos_x_;
+  std::vector<float> pos_y_;
+  std::vector<float> pos_z_;
+  std::vector<float> scale_;
+  std::vector<float> phase_;
+  std::vector<float> speed_;
+};
+
+// GPU storage buffer holding the per-instance data, plus the transfer buffer
+// it's refreshed from every frame. Both are cycled so the CPU never waits on
+// a frame still in flight.
+class InstanceBuffer
+{
+public:
+  explicit InstanceBuffer(SDL_GPUDevice* device);
+  ~InstanceBuffer();
+
+  // Grows the buffers so they can hold at least `count` instances.
+  bool Reserve(u32 count);
+  InstanceData* Map();
+  void Unmap();
+  void Upload(SDL_GPUCopyPass* pass, u32 count);
+
+  SDL_GPUBuffer* Buffer() const { return buffer_; }
+  u32 Capacity() const { return capacity_; }
+
+private:
+  SDL_GPUDevice* device_{};
+  SDL_GPUBuffer* buffer_{ nullptr };
+  SDL_GPUTransferBuffer* transfer_{ nullptr };
+  u32 capacity_{ 0 };
+};
@@ -0,0 +1,143 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "src/logger.h"
+#include "src/profiler.h"
+
+JobSystem::JobSystem(u32 workers)
+{
+  if (workers == 0) {
+    u32 hw = std::thread::hardware_concurrency();
+    workers = hw > 1 ? hw - 1 : 0;
+  }
+  workers_.reserve(workers);
+  for (u32 i = 0; i < workers; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+  LOG_DEBUG("Started job system with {} workers", workers);
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard lock{ mutex_ };
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& w : workers_) {
+    w.join();
+  }
+}
+
+void
+JobSystem::WorkerLoop()
+{
+  Profiler::SetThreadName("Worker");
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock lock{ mutex_ };
+      wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_ && queue_.empty()) {
+        return;
+      }
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    job();
+  }
+}
+
+void
+JobSystem::Push(std::function<void()> job)
+{
+  {
+    std::lock_guard lock{ mutex_ };
+    queue_.push_back(std::move(job));
+  }
+  wake_.notify_one();
+}
+
+void
+JobSystem::Distribute(u32 count,
+                      const std::function<void(u32)>& item,
+                      const std::function<void()>& local)
+{
+  // We wait for the items to be done, not for the helpers to check out: a
+  // helper may sit in the queue behind jobs of busy workers for a while. One
+  // that starts after we returned finds no item left, the state it looks at
+  // is shared for that.
+  struct State
+  {
+    std::atomic<u32> next{ 0 };
+    std::atomic<u32> done{ 0 };
+  };
+  auto state = std::make_shared<State>();
+
+  auto run = [state, count, &item] {
+    for (u32 i = state->next.fetch_add(1); i < count;
+         i = state->next.fetch_add(1)) {
+      item(i);
+      state->done.fetch_add(1, std::memory_order_release);
+    }
+  };
+
+  // this thread takes one item unless it's busy with `local` first
+  const u32 own = (local || count == 0) ? 0 : 1;
+  const u32 helpers = std::min(count - own, WorkerCount());
+  for (u32 i = 0; i < helpers; ++i) {
+    Push(run);
+  }
+
+  if (local) {
+    local();
+  }
+  run();
+  // whatever is left is being run by threads that are already on it
+  while (state->done.load(std::memory_order_acquire) != count) {
+    std::this_thread::yield();
+  }
+}
+
+void
+JobSystem::ParallelFor(u32 count,
+                       u32 grain,
+                       const std::function<void(u32 begin, u32 end)>& fn)
+{
+  if (count == 0) {
+    return;
+  }
+  grain = std::max(grain, 1u);
+  const u32 chunks = (count + grain - 1) / grain;
+  if (chunks == 1 || workers_.empty()) {
+    fn(0, count);
+    return;
+  }
+  Distribute(
+    chunks,
+    [&](u32 c) {
+      const u32 begin = c * grain;
+      fn(begin, std::min(begin + grain, count));
+    },
+    {});
+}
+
+void
+JobSystem::Run(std::span<const std::function<void()>> jobs,
+               const std::function<void()>& local)
+{
+  if (workers_.empty()) {
+    if (local) {
+      local();
+    }
+    for (const auto& job : jobs) {
+      job();
+    }
+    return;
+  }
+  Distribute(
+    static_cast<u32>(jobs.size()), [&](u32 i) { jobs[i](); }, local);
+}
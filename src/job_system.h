@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+// Small fixed-size worker pool. The calling thread always takes part in the
+// work it submits, so nested ParallelFor calls can't deadlock.
+class JobSystem
+{
+public:
+  // 0 workers means "one per hardware thread, minus the calling one"
+  explicit JobSystem(u32 workers = 0);
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  u32 WorkerCount() const { return static_cast<u32>(workers_.size()); }
+
+  // Splits [0, count) in chunks of `grain` items and runs `fn(begin, end)` on
+  // every chunk. Chunk starts are multiples of `grain`. Blocks until done.
+  void ParallelFor(u32 count,
+                   u32 grain,
+                   const std::function<void(u32 begin, u32 end)>& fn);
+
+  // Runs unrelated jobs side by side while the calling thread runs `local`,
+  // then helps with the rest. Jobs start in order, so a job may wait on one
+  // listed before it. Blocks until done.
+  void Run(std::span<const std::function<void()>> jobs,
+           const std::function<void()>& local = {});
+
+private:
+  void WorkerLoop();
+  void Push(std::function<void()> job);
+  // Runs `item(i)` for every i in [0, count) on up to `count` threads, the
+  // calling one included after `local`.
+  void Distribute(u32 count,
+                  const std::function<void(u32)>& item,
+                  const std::function<void()>& local);
+
+private:
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> queue_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_{ false };
+};
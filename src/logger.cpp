@@ -1,13 +1,111 @@
 #include "logger.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string_view>
+
+#include "spdlog/async.h"
 #include "spdlog/common.h"
+#include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/null_sink.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+constexpr const char* kName = "LOG";
+constexpr const char* kPattern = "[%H:%M:%S:%e][%^%l%$]: %v";
+
+// Falls back to stdout when the file can't be opened
+spdlog::sink_ptr
+MakeSink(const LoggerCfg& cfg, bool& fell_back)
+{
+  fell_back = false;
+  if (cfg.sink == LogSink::None) {
+    return std::make_shared<spdlog::sinks::null_sink_mt>();
+  }
+  if (cfg.sink == LogSink::File) {
+    try {
+      return std::make_shared<spdlog::sinks::basic_file_sink_mt>(cfg.path,
+                                                                 true);
+    } catch (const spdlog::spdlog_ex&) {
+      fell_back = true;
+    }
+  }
+  return std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+}
+
+// Matches the compiled in minimum so stripped levels stay consistent
+spdlog::level::level_enum
+Level(const LoggerCfg& cfg)
+{
+  if (cfg.sink == LogSink::None) {
+    return spdlog::level::off; // skip formatting too
+  }
+  return static_cast<spdlog::level::level_enum>(SDLCUBE_LOG_LEVEL);
+}
+
+} // namespace
 
 void
 Logger::Init()
 {
-  logger_ = spdlog::stdout_color_mt("LOG");
-  logger_->set_level(spdlog::level::trace);
-  logger_->set_pattern("[%H:%M:%S:%e][%^%l%$]: %v");
+  LoggerCfg cfg{};
+  if (const char* env = std::getenv("SDLCUBE_LOG")) {
+    const std::string_view value = env;
+    if (value == "none") {
+      cfg.sink = LogSink::None;
+    } else if (!value.empty() && value != "stdout") {
+      cfg.sink = LogSink::File;
+      cfg.path = value;
+    }
+  }
+  Init(cfg);
+}
+
+void
+Logger::Init(const LoggerCfg& cfg)
+{
+  Shutdown();
+  spdlog::drop(kName);
+  pool_ = std::make_shared<spdlog::details::thread_pool>(cfg.queue_size, 1);
+  bool fell_back = false;
+  logger_ = std::make_shared<spdlog::async_logger>(
+    kName,
+    MakeSink(cfg, fell_back),
+    pool_, spdlog::async_overflow_policy::overrun_oldest);
+  logger_->set_level(Level(cfg));
+  logger_->set_pattern(kPattern);
+  logger_->flush_on(spdlog::level::err);
+  // the registry's flusher thread only sees registered loggers
+  spdlog::register_logger(logger_);
+  spdlog::flush_every(std::chrono::seconds(cfg.flush_seconds));
+
+  if (fell_back) {
+    logger_->error("Couldn't open log file {}, logging to stdout", cfg.path);
+  }
+}
+
+void
+Logger::Shutdown()
+{
+  if (pool_ == nullptr) {
+    return;
+  }
+  // the pool's thread writes what's queued before it exits
+  auto sinks = logger_->sinks();
+  const auto level = logger_->level();
+  const size_t dropped = pool_->overrun_counter();
+  spdlog::drop(kName);
+  logger_.reset();
+  pool_.reset();
+
+  logger_ = std::make_shared<spdlog::logger>(kName, sinks.begin(), sinks.end());
+  logger_->set_level(level);
+  logger_->set_pattern(kPattern);
+  if (dropped != 0) {
+    logger_->warn("{} log messages dropped, the queue was full", dropped);
+  }
 }
 
 spdlog::logger& Logger::Get() { return *logger_; }
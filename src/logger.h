@@ -2,20 +2,86 @@
 
 #include "spdlog/logger.h"
 #include <memory>
+#include <string>
 
+#include "types.h"
+
+// Minimum level compiled in, spdlog's numbering: 0 trace, 1 debug, 2 info,
+// 3 warn, 4 error, 5 critical, 6 off. Calls below it compile to nothing,
+// their arguments aren't evaluated.
+#ifndef SDLCUBE_LOG_LEVEL
+#define SDLCUBE_LOG_LEVEL 0
+#endif
+
+namespace spdlog::details {
+class thread_pool;
+}
+
+enum class LogSink : u8
+{
+  Stdout,
+  File,
+  None,
+};
+
+struct LoggerCfg
+{
+  LogSink sink{ LogSink::Stdout };
+  std::string path{ "sdlcube.log" }; // LogSink::File
+  size_t queue_size{ 8192 };         // messages, the oldest are dropped
+  u32 flush_seconds{ 1 };
+};
+
+// Messages are formatted on the calling thread and written by a background
+// one, through a bounded queue that drops the oldest message rather than
+// block when it's full, so logging in a frame costs a format and a push.
 struct Logger
 {
 public:
+  // SDLCUBE_LOG picks the sink: "stdout" (default), "none" or a file path.
   static void Init();
+  static void Init(const LoggerCfg& cfg);
+  // Drains the queue once the other threads are done logging, later
+  // messages are written synchronously.
+  static void Shutdown();
   static spdlog::logger& Get();
 
 private:
   static inline std::shared_ptr<spdlog::logger> logger_;
+  static inline std::shared_ptr<spdlog::details::thread_pool> pool_;
 };
 
+// type checks a stripped call without evaluating it
+#define LOG_STRIPPED(level, ...)                                             \
+  (void)sizeof(Logger::Get().level(__VA_ARGS__), 0);
+
+#if SDLCUBE_LOG_LEVEL <= 0
 #define LOG_TRACE(...) Logger::Get().trace(__VA_ARGS__);
+#else
+#define LOG_TRACE(...) LOG_STRIPPED(trace, __VA_ARGS__)
+#endif
+#if SDLCUBE_LOG_LEVEL <= 1
 #define LOG_DEBUG(...) Logger::Get().debug(__VA_ARGS__);
+#else
+#define LOG_DEBUG(...) LOG_STRIPPED(debug, __VA_ARGS__)
+#endif
+#if SDLCUBE_LOG_LEVEL <= 2
 #define LOG_INFO(...) Logger::Get().info(__VA_ARGS__);
+#else
+#define LOG_INFO(...) LOG_STRIPPED(info, __VA_ARGS__)
+#endif
+#if SDLCUBE_LOG_LEVEL <= 3
 #define LOG_WARN(...) Logger::Get().warn(__VA_ARGS__);
+#else
+#define LOG_WARN(...) LOG_STRIPPED(warn, __VA_ARGS__)
+#endif
+#if SDLCUBE_LOG_LEVEL <= 4
 #define LOG_ERROR(...) Logger::Get().error(__VA_ARGS__);
+#else
+#define LOG_ERROR(...) LOG_STRIPPED(error, __VA_ARGS__)
+#endif
+#if SDLCUBE_LOG_LEVEL <= 5
 #define LOG_CRITICAL(...) Logger::Get().critical(__VA_ARGS__);
+#else
+#define LOG_CRITICAL(...) LOG_STRIPPED(critical, __VA_ARGS__)
+#endif
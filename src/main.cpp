@@ -4,12 +4,68 @@
 #include <SDL3/SDL_video.h>
 
 #include "cube.h"
+#include "src/bench.h"
 #include "src/logger.h"
+#include "src/profiler.h"
 
+namespace {
+
+// No window or swapchain: SDL's offscreen video driver is enough to load
+// Vulkan, a software one like lavapipe included.
 int
-main()
+Bench(const BenchCfg& cfg)
+{
+  SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen"); // the environment wins
+  if (!SDL_Init(SDL_INIT_VIDEO)) {
+    LOG_ERROR("Couldn't initialize SDL: {}", SDL_GetError());
+    return 1;
+  }
+  auto Device =
+    SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, false, NULL);
+  if (Device == NULL) {
+    LOG_ERROR("Couldn't create GPU device: {}", SDL_GetError());
+    return 1;
+  }
+
+  bool ok = false;
+  {
+    CubeProgram app{ Device,
+                     nullptr,
+                     "resources/shaders/compiled/vert.vert.spv",
+                     "resources/shaders/compiled/frag.frag.spv",
+                     cfg.resolutions.front().first,
+                     cfg.resolutions.front().second };
+    if (!app.Init()) {
+      LOG_CRITICAL("Couldn't init app.");
+    } else if (!cfg.capture.empty() && !app.StartCapture(cfg.capture.c_str())) {
+      LOG_CRITICAL("Couldn't start capture");
+    } else if (cfg.replay.empty() || app.StartReplay(cfg.replay.c_str())) {
+      ok = RunBench(app, cfg);
+    }
+  }
+  SDL_DestroyGPUDevice(Device);
+  SDL_Quit();
+  return ok ? 0 : 1;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
 {
   Logger::Init();
+  Profiler::SetThreadName("Main");
+  bool bench = false;
+  BenchCfg bench_cfg{};
+  if (!ParseBenchArgs(argc, argv, bench, bench_cfg)) {
+    return 1;
+  }
+  if (bench) {
+    const int ret = Bench(bench_cfg);
+    Logger::Shutdown();
+    return ret;
+  }
+
   LOG_INFO("Starting..");
   if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD)) {
     LOG_ERROR("Couldn't initialize SDL: {}", SDL_GetError());
@@ -46,16 +102,28 @@ main()
   { // app lifecycle
     CubeProgram app{ Device,
                      Window,
-                     "resources/shaders/compiled/vert.spv",
-                     "resources/shaders/compiled/frag.spv",
+                     "resources/shaders/compiled/vert.vert.spv",
+                     "resources/shaders/compiled/frag.frag.spv",
                      1200,
                      900 };
 
     if (!app.Init()) {
       LOG_CRITICAL("Couldn't init app.");
+    } else if (!bench_cfg.record.empty() &&
+               !app.StartRecording(bench_cfg.record.c_str())) {
+      LOG_CRITICAL("Couldn't start recording");
+    } else if (!bench_cfg.replay.empty() &&
+               !app.StartReplay(bench_cfg.replay.c_str())) {
+      LOG_CRITICAL("Couldn't load replay");
+    } else if (!bench_cfg.capture.empty() &&
+               !app.StartCapture(bench_cfg.capture.c_str())) {
+      LOG_CRITICAL("Couldn't start capture");
+    } else if (bench_cfg.replay.empty() && !app.StartSimulation()) {
+      LOG_CRITICAL("Couldn't start simulation");
     } else {
 
       while (!app.ShouldQuit()) {
+        Profiler::MarkFrame();
         if (!app.Poll()) {
           LOG_CRITICAL("App failed to Poll");
           break;
@@ -79,5 +147,6 @@ main()
   SDL_DestroyWindow(Window);
 
   LOG_INFO("Cleanup done");
+  Logger::Shutdown();
   return 0;
 }
@@ -0,0 +1,216 @@
+#include "math_kernels.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+#include "src/logger.h"
+
+namespace {
+
+const char* const kLevelNames[] = { "scalar", "sse4.1", "avx2", "avx512" };
+
+void
+ComposeScalar(const TrsArrays& trs, u32 count, float* out)
+{
+  for (u32 i = 0; i < count; ++i, out += 16) {
+    const float sx = std::sin(trs.rotation[0][i]);
+    const float cx = std::cos(trs.rotation[0][i]);
+    const float sy = std::sin(trs.rotation[1][i]);
+    const float cy = std::cos(trs.rotation[1][i]);
+    const float sz = std::sin(trs.rotation[2][i]);
+    const float cz = std::cos(trs.rotation[2][i]);
+    // rotate y * rotate x, then its first two columns turned by z
+    const float a0[3] = { cy, 0.f, -sy };
+    const float a1[3] = { sx * sy, cx, sx * cy };
+    const float a2[3] = { cx * sy, -sx, cx * cy };
+    for (int row = 0; row < 3; ++row) {
+      out[row] = (cz * a0[row] + sz * a1[row]) * trs.scale[0][i];
+      out[4 + row] = (cz * a1[row] - sz * a0[row]) * trs.scale[1][i];
+      out[8 + row] = a2[row] * trs.scale[2][i];
+      out[12 + row] = trs.translation[row][i];
+    }
+    out[3] = out[7] = out[11] = 0.f;
+    out[15] = 1.f;
+  }
+}
+
+void
+MultiplyScalar(const float* a,
+               u32 a_stride,
+               const float* b,
+               u32 count,
+               float* out)
+{
+  for (u32 i = 0; i < count; ++i, a += a_stride * 16, b += 16, out += 16) {
+    // computed whole before the store, out may alias a or b
+    *reinterpret_cast<glm::mat4*>(out) =
+      *reinterpret_cast<const glm::mat4*>(a) *
+      *reinterpret_cast<const glm::mat4*>(b);
+  }
+}
+
+void
+TransformBoundsScalar(const float* m,
+                      u32 count,
+                      const float* min,
+                      const float* max,
+                      float* out_min,
+                      float* out_max)
+{
+  const glm::vec3 center = (glm::vec3{ min[0], min[1], min[2] } +
+                            glm::vec3{ max[0], max[1], max[2] }) *
+                           0.5f;
+  const glm::vec3 extent = (glm::vec3{ max[0], max[1], max[2] } -
+                            glm::vec3{ min[0], min[1], min[2] }) *
+                           0.5f;
+  for (u32 i = 0; i < count; ++i, m += 16) {
+    const auto& model = *reinterpret_cast<const glm::mat4*>(m);
+    const glm::vec3 mid{ model * glm::vec4{ center, 1.f } };
+    const glm::vec3 ext = glm::abs(glm::vec3{ model[0] }) * extent.x +
+                          glm::abs(glm::vec3{ model[1] }) * extent.y +
+                          glm::abs(glm::vec3{ model[2] }) * extent.z;
+    for (int k = 0; k < 3; ++k) {
+      out_min[i * 3 + k] = mid[k] - ext[k];
+      out_max[i * 3 + k] = mid[k] + ext[k];
+    }
+  }
+}
+
+bool
+CpuSupports(SimdLevel level)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  switch (level) {
+    case SimdLevel::Scalar:
+      return true;
+    case SimdLevel::Sse4:
+      return __builtin_cpu_supports("sse4.1");
+    case SimdLevel::Avx2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case SimdLevel::Avx512:
+      return __builtin_cpu_supports("avx512f");
+  }
+  return false;
+#else
+  return level == SimdLevel::Scalar;
+#endif
+}
+
+struct Dispatch
+{
+  MathKernelTable table{};
+  SimdLevel level{ SimdLevel::Scalar };
+};
+
+// The widest path up to `max` that was built and the CPU runs
+Dispatch
+Select(SimdLevel max)
+{
+  using Fill = bool (*)(MathKernelTable&);
+  const Fill fill[] = { nullptr, MathKernelsSse4, MathKernelsAvx2,
+                        MathKernelsAvx512 };
+  Dispatch d;
+  for (int level = int(max); level > 0; --level) {
+    if (CpuSupports(SimdLevel(level)) && fill[level](d.table)) {
+      d.level = SimdLevel(level);
+      return d;
+    }
+  }
+  d.table = { ComposeScalar, MultiplyScalar, TransformBoundsScalar };
+  return d;
+}
+
+// SDLCUBE_SIMD caps the level by name, to compare paths
+SimdLevel
+EnvLimit()
+{
+  if (const char* env = std::getenv("SDLCUBE_SIMD")) {
+    for (u32 level = 0; level < std::size(kLevelNames); ++level) {
+      if (std::strcmp(env, kLevelNames[level]) == 0) {
+        return SimdLevel(level);
+      }
+    }
+    LOG_WARN("Unknown SDLCUBE_SIMD {}, expected scalar, sse4.1, avx2 or "
+             "avx512",
+             env);
+  }
+  return SimdLevel::Avx512;
+}
+
+Dispatch&
+Current()
+{
+  static Dispatch dispatch = Select(EnvLimit());
+  return dispatch;
+}
+
+} // namespace
+
+SimdLevel
+MathKernels::Level()
+{
+  return Current().level;
+}
+
+const char*
+MathKernels::Name(SimdLevel level)
+{
+  return kLevelNames[u32(level)];
+}
+
+SimdLevel
+MathKernels::Limit(SimdLevel max)
+{
+  Current() = Select(max);
+  return Current().level;
+}
+
+void
+MathKernels::ComposeTrs(const TrsArrays& trs, u32 count, glm::mat4* out)
+{
+  Current().table.compose_trs(trs, count, reinterpret_cast<float*>(out));
+}
+
+void
+MathKernels::Multiply(const glm::mat4* a,
+                      const glm::mat4* b,
+                      u32 count,
+                      glm::mat4* out)
+{
+  Current().table.multiply(reinterpret_cast<const float*>(a),
+                           1,
+                           reinterpret_cast<const float*>(b),
+                           count,
+                           reinterpret_cast<float*>(out));
+}
+
+void
+MathKernels::Multiply(const glm::mat4& a,
+                      const glm::mat4* b,
+                      u32 count,
+                      glm::mat4* out)
+{
+  Current().table.multiply(&a[0][0],
+                           0,
+                           reinterpret_cast<const float*>(b),
+                           count,
+                           reinterpret_cast<float*>(out));
+}
+
+void
+MathKernels::TransformBounds(const glm::mat4* m,
+                             u32 count,
+                             const glm::vec3& min,
+                             const glm::vec3& max,
+                             glm::vec3* out_min,
+                             glm::vec3* out_max)
+{
+  Current().table.transform_bounds(reinterpret_cast<const float*>(m),
+                                   count,
+                                   &min[0],
+                                   &max[0],
+                                   reinterpret_cast<float*>(out_min),
+                                   reinterpret_cast<float*>(out_max));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "src/math_kernels_isa.h"
+#include "types.h"
+
+enum class SimdLevel : u8
+{
+  Scalar,
+  Sse4,
+  Avx2, // with FMA
+  Avx512,
+};
+
+// Batched transform math. Calls run the widest path both the build and the
+// CPU support, picked on first use, and match glm to float rounding: the
+// vector sin/cos are within 1e-7 of std::sin/std::cos over [-2pi, 2pi].
+class MathKernels
+{
+public:
+  static SimdLevel Level();
+  static const char* Name(SimdLevel level);
+  // Caps the level, to compare paths. Returns the one now in use.
+  static SimdLevel Limit(SimdLevel max);
+
+  // translate * rotate y * rotate x * rotate z * scale, as Transform does
+  static void ComposeTrs(const TrsArrays& trs, u32 count, glm::mat4* out);
+  // out[i] = a[i] * b[i]
+  static void Multiply(const glm::mat4* a,
+                       const glm::mat4* b,
+                       u32 count,
+                       glm::mat4* out);
+  // out[i] = a * b[i], e.g. a view projection times model matrices
+  static void Multiply(const glm::mat4& a,
+                       const glm::mat4* b,
+                       u32 count,
+                       glm::mat4* out);
+  // Axis aligned box around the local box [min, max] under every matrix
+  static void TransformBounds(const glm::mat4* m,
+                              u32 count,
+                              const glm::vec3& min,
+                              const glm::vec3& max,
+                              glm::vec3* out_min,
+                              glm::vec3* out_max);
+};
@@ -0,0 +1,87 @@
+// Built with -mavx2 -mfma, only called once the CPU is known to support them
+#include "src/math_kernels_isa.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+
+namespace {
+
+struct Lanes
+{
+  static constexpr u32 kWidth = 8;
+  using V = __m256;
+  using I = __m256i;
+
+  static V Set1(float v) { return _mm256_set1_ps(v); }
+  static V Load(const float* p) { return _mm256_loadu_ps(p); }
+  static void Store(float* p, V v) { _mm256_storeu_ps(p, v); }
+  static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V Fma(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+  static I Round(V v) { return _mm256_cvtps_epi32(v); }
+  static V ToFloat(I j) { return _mm256_cvtepi32_ps(j); }
+  static I AddOne(I j) { return _mm256_add_epi32(j, _mm256_set1_epi32(1)); }
+  static V FlipSign(V v, I j)
+  {
+    const I sign =
+      _mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), 30);
+    return _mm256_xor_ps(v, _mm256_castsi256_ps(sign));
+  }
+  static V SelectOdd(I j, V odd, V even)
+  {
+    const I one = _mm256_set1_epi32(1);
+    const I mask = _mm256_cmpeq_epi32(_mm256_and_si256(j, one), one);
+    return _mm256_blendv_ps(even, odd, _mm256_castsi256_ps(mask));
+  }
+};
+
+} // namespace
+
+#include "src/math_kernels_impl.h"
+
+namespace {
+
+// Two result columns per register, a's columns broadcast to both halves
+void
+Multiply(const float* a, u32 a_stride, const float* b, u32 count, float* out)
+{
+  for (u32 i = 0; i < count; ++i, a += a_stride * 16, b += 16, out += 16) {
+    const __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+    const __m256 a1 =
+      _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+    const __m256 a2 =
+      _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+    const __m256 a3 =
+      _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+    for (int half = 0; half < 2; ++half) {
+      const __m256 bc = _mm256_loadu_ps(b + half * 8);
+      __m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(bc, 0x00));
+      r = _mm256_fmadd_ps(a1, _mm256_permute_ps(bc, 0x55), r);
+      r = _mm256_fmadd_ps(a2, _mm256_permute_ps(bc, 0xaa), r);
+      r = _mm256_fmadd_ps(a3, _mm256_permute_ps(bc, 0xff), r);
+      _mm256_storeu_ps(out + half * 8, r);
+    }
+  }
+}
+
+} // namespace
+
+bool
+MathKernelsAvx2(MathKernelTable& table)
+{
+  table.compose_trs = ComposeTrs<Lanes>;
+  table.multiply = Multiply;
+  table.transform_bounds = TransformBounds;
+  return true;
+}
+
+#else
+
+bool
+MathKernelsAvx2(MathKernelTable&)
+{
+  return false;
+}
+
+#endif
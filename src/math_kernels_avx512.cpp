@@ -0,0 +1,82 @@
+// Built with -mavx512f, only called once the CPU is known to support it
+#include "src/math_kernels_isa.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace {
+
+struct Lanes
+{
+  static constexpr u32 kWidth = 16;
+  using V = __m512;
+  using I = __m512i;
+
+  static V Set1(float v) { return _mm512_set1_ps(v); }
+  static V Load(const float* p) { return _mm512_loadu_ps(p); }
+  static void Store(float* p, V v) { _mm512_storeu_ps(p, v); }
+  static V Add(V a, V b) { return _mm512_add_ps(a, b); }
+  static V Sub(V a, V b) { return _mm512_sub_ps(a, b); }
+  static V Mul(V a, V b) { return _mm512_mul_ps(a, b); }
+  static V Fma(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+  static I Round(V v) { return _mm512_cvtps_epi32(v); }
+  static V ToFloat(I j) { return _mm512_cvtepi32_ps(j); }
+  static I AddOne(I j) { return _mm512_add_epi32(j, _mm512_set1_epi32(1)); }
+  // float xor is AVX-512DQ, done on the integer side
+  static V FlipSign(V v, I j)
+  {
+    const I sign =
+      _mm512_slli_epi32(_mm512_and_si512(j, _mm512_set1_epi32(2)), 30);
+    return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), sign));
+  }
+  static V SelectOdd(I j, V odd, V even)
+  {
+    const __mmask16 mask = _mm512_test_epi32_mask(j, _mm512_set1_epi32(1));
+    return _mm512_mask_blend_ps(mask, even, odd);
+  }
+};
+
+} // namespace
+
+#include "src/math_kernels_impl.h"
+
+namespace {
+
+// A whole matrix per register, a's columns broadcast to all four quarters
+void
+Multiply(const float* a, u32 a_stride, const float* b, u32 count, float* out)
+{
+  for (u32 i = 0; i < count; ++i, a += a_stride * 16, b += 16, out += 16) {
+    const __m512 a0 = _mm512_broadcast_f32x4(_mm_loadu_ps(a));
+    const __m512 a1 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 4));
+    const __m512 a2 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 8));
+    const __m512 a3 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 12));
+    const __m512 bm = _mm512_loadu_ps(b);
+    __m512 r = _mm512_mul_ps(a0, _mm512_permute_ps(bm, 0x00));
+    r = _mm512_fmadd_ps(a1, _mm512_permute_ps(bm, 0x55), r);
+    r = _mm512_fmadd_ps(a2, _mm512_permute_ps(bm, 0xaa), r);
+    r = _mm512_fmadd_ps(a3, _mm512_permute_ps(bm, 0xff), r);
+    _mm512_storeu_ps(out, r);
+  }
+}
+
+} // namespace
+
+bool
+MathKernelsAvx512(MathKernelTable& table)
+{
+  table.compose_trs = ComposeTrs<Lanes>;
+  table.multiply = Multiply;
+  table.transform_bounds = TransformBounds;
+  return true;
+}
+
+#else
+
+bool
+MathKernelsAvx512(MathKernelTable&)
+{
+  return false;
+}
+
+#endif
@@ -0,0 +1,161 @@
+#pragma once
+
+// Kernels written once over a lanes type, included by every instruction set
+// file after it defines its own `Lanes`:
+//
+//   kWidth, V (floats), I (ints), Set1, Load, Store, Add, Sub, Mul,
+//   Fma (a * b + c), Round (to nearest int), ToFloat, AddOne,
+//   FlipSign (v negated where j & 2), SelectOdd (odd where j & 1, else even)
+//
+// Only intrinsics and the standard library's types are used, see
+// math_kernels_isa.h for why.
+
+#include <immintrin.h>
+
+#include "src/math_kernels_isa.h"
+
+namespace {
+
+// sin and cos together, cephes' single precision reduction and polynomials.
+// x = j * pi / 2 + r with r in [-pi / 4, pi / 4], pi / 2 split in three
+// so the reduction stays exact for the angles transforms use.
+template<typename L>
+void
+SinCos(typename L::V x, typename L::V& s, typename L::V& c)
+{
+  using V = typename L::V;
+  const auto j = L::Round(L::Mul(x, L::Set1(0.636619772367581343f)));
+  const V q = L::ToFloat(j);
+  V r = L::Fma(q, L::Set1(-1.5703125f), x);
+  r = L::Fma(q, L::Set1(-4.837512969970703125e-4f), r);
+  r = L::Fma(q, L::Set1(-7.54978995489188216e-8f), r);
+  const V z = L::Mul(r, r);
+
+  V sp = L::Fma(L::Set1(-1.9515295891e-4f), z, L::Set1(8.3321608736e-3f));
+  sp = L::Fma(sp, z, L::Set1(-1.6666654611e-1f));
+  sp = L::Fma(L::Mul(sp, z), r, r);
+
+  V cp = L::Fma(
+    L::Set1(2.443315711809948e-5f), z, L::Set1(-1.388731625493765e-3f));
+  cp = L::Fma(cp, z, L::Set1(4.166664568298827e-2f));
+  cp = L::Fma(L::Mul(cp, z), z, L::Fma(z, L::Set1(-0.5f), L::Set1(1.f)));
+
+  // sin(x): sin r, cos r, -sin r, -cos r by j mod 4, cos(x) one step ahead
+  s = L::FlipSign(L::SelectOdd(j, cp, sp), j);
+  c = L::FlipSign(L::SelectOdd(j, sp, cp), L::AddOne(j));
+}
+
+// One batch of L::kWidth transforms into tmp, a row per matrix element
+template<typename L>
+void
+ComposeLanes(const float* const in[9], float tmp[16][L::kWidth])
+{
+  using V = typename L::V;
+  V sx, cx, sy, cy, sz, cz;
+  SinCos<L>(L::Load(in[3]), sx, cx);
+  SinCos<L>(L::Load(in[4]), sy, cy);
+  SinCos<L>(L::Load(in[5]), sz, cz);
+
+  // rotate y * rotate x, then its first two columns turned by z
+  const V zero = L::Set1(0.f);
+  const V a0[3] = { cy, zero, L::Sub(zero, sy) };
+  const V a1[3] = { L::Mul(sx, sy), cx, L::Mul(sx, cy) };
+  const V a2[3] = { L::Mul(cx, sy), L::Sub(zero, sx), L::Mul(cx, cy) };
+  const V scale[3] = { L::Load(in[6]), L::Load(in[7]), L::Load(in[8]) };
+  for (int row = 0; row < 3; ++row) {
+    const V r0 = L::Fma(cz, a0[row], L::Mul(sz, a1[row]));
+    const V r1 = L::Sub(L::Mul(cz, a1[row]), L::Mul(sz, a0[row]));
+    L::Store(tmp[row], L::Mul(r0, scale[0]));
+    L::Store(tmp[4 + row], L::Mul(r1, scale[1]));
+    L::Store(tmp[8 + row], L::Mul(a2[row], scale[2]));
+    L::Store(tmp[12 + row], L::Load(in[row]));
+  }
+  for (int col = 0; col < 3; ++col) {
+    L::Store(tmp[col * 4 + 3], zero);
+  }
+  L::Store(tmp[15], L::Set1(1.f));
+}
+
+template<typename L>
+void
+ComposeTrs(const TrsArrays& trs, u32 count, float* out)
+{
+  constexpr u32 W = L::kWidth;
+  alignas(64) float tmp[16][W];
+  const float* in[9];
+  auto emit = [&](u32 base, u32 lanes) {
+    ComposeLanes<L>(in, tmp);
+    for (u32 l = 0; l < lanes; ++l) {
+      float* m = out + (base + l) * 16;
+      for (int e = 0; e < 16; ++e) {
+        m[e] = tmp[e][l];
+      }
+    }
+  };
+
+  u32 i = 0;
+  for (; i + W <= count; i += W) {
+    for (int k = 0; k < 3; ++k) {
+      in[k] = trs.translation[k] + i;
+      in[3 + k] = trs.rotation[k] + i;
+      in[6 + k] = trs.scale[k] + i;
+    }
+    emit(i, W);
+  }
+  if (i < count) {
+    // the tail from zero padded copies
+    alignas(64) float pad[9][W] = {};
+    for (int k = 0; k < 3; ++k) {
+      for (u32 l = 0; i + l < count; ++l) {
+        pad[k][l] = trs.translation[k][i + l];
+        pad[3 + k][l] = trs.rotation[k][i + l];
+        pad[6 + k][l] = trs.scale[k][i + l];
+      }
+    }
+    for (int k = 0; k < 9; ++k) {
+      in[k] = pad[k];
+    }
+    emit(i, count - i);
+  }
+}
+
+// Arvo's method: the box center through the matrix, the half extent through
+// its absolute value. Four wide in every file, a box is three floats.
+void
+TransformBounds(const float* m,
+                u32 count,
+                const float* min,
+                const float* max,
+                float* out_min,
+                float* out_max)
+{
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 c[3], e[3];
+  for (int k = 0; k < 3; ++k) {
+    c[k] = _mm_set1_ps((min[k] + max[k]) * 0.5f);
+    e[k] = _mm_set1_ps((max[k] - min[k]) * 0.5f);
+  }
+
+  for (u32 i = 0; i < count; ++i, m += 16) {
+    const __m128 col0 = _mm_loadu_ps(m);
+    const __m128 col1 = _mm_loadu_ps(m + 4);
+    const __m128 col2 = _mm_loadu_ps(m + 8);
+    __m128 mid = _mm_loadu_ps(m + 12);
+    mid = _mm_add_ps(mid, _mm_mul_ps(col0, c[0]));
+    mid = _mm_add_ps(mid, _mm_mul_ps(col1, c[1]));
+    mid = _mm_add_ps(mid, _mm_mul_ps(col2, c[2]));
+    __m128 ext = _mm_mul_ps(_mm_and_ps(col0, abs_mask), e[0]);
+    ext = _mm_add_ps(ext, _mm_mul_ps(_mm_and_ps(col1, abs_mask), e[1]));
+    ext = _mm_add_ps(ext, _mm_mul_ps(_mm_and_ps(col2, abs_mask), e[2]));
+
+    alignas(16) float lo_out[4], hi_out[4];
+    _mm_store_ps(lo_out, _mm_sub_ps(mid, ext));
+    _mm_store_ps(hi_out, _mm_add_ps(mid, ext));
+    for (int k = 0; k < 3; ++k) {
+      out_min[i * 3 + k] = lo_out[k];
+      out_max[i * 3 + k] = hi_out[k];
+    }
+  }
+}
+
+} // namespace
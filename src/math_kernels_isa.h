@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.h"
+
+// Shared by math_kernels.cpp and the per instruction set files. Those are
+// built with their own -m flags, so nothing here may pull in inline code
+// (glm included) that the rest of the program would link against.
+
+// Transforms as a struct of arrays, `count` floats behind every pointer.
+// Euler angles in radians, applied like Transform: y, then x, then z.
+struct TrsArrays
+{
+  const float* translation[3];
+  const float* rotation[3];
+  const float* scale[3];
+};
+
+// Entry points on column major float matrices, 16 floats each
+struct MathKernelTable
+{
+  void (*compose_trs)(const TrsArrays& trs, u32 count, float* out);
+  // out[i] = a[i * a_stride] * b[i], a_stride 0 or 1
+  void (*multiply)(const float* a,
+                   u32 a_stride,
+                   const float* b,
+                   u32 count,
+                   float* out);
+  // min and max are 3 floats, out_min and out_max 3 per matrix
+  void (*transform_bounds)(const float* m,
+                           u32 count,
+                           const float* min,
+                           const float* max,
+                           float* out_min,
+                           float* out_max);
+};
+
+// Fill `table` and return true when the file was built for its instruction
+// set, the caller checks the CPU supports it.
+bool
+MathKernelsSse4(MathKernelTable& table);
+bool
+MathKernelsAvx2(MathKernelTable& table);
+bool
+MathKernelsAvx512(MathKernelTable& table);
@@ -0,0 +1,82 @@
+// Built with -msse4.1, only called once the CPU is known to support it
+#include "src/math_kernels_isa.h"
+
+#if defined(__SSE4_1__)
+#include <immintrin.h>
+
+namespace {
+
+struct Lanes
+{
+  static constexpr u32 kWidth = 4;
+  using V = __m128;
+  using I = __m128i;
+
+  static V Set1(float v) { return _mm_set1_ps(v); }
+  static V Load(const float* p) { return _mm_loadu_ps(p); }
+  static void Store(float* p, V v) { _mm_storeu_ps(p, v); }
+  static V Add(V a, V b) { return _mm_add_ps(a, b); }
+  static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V Fma(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+  static I Round(V v) { return _mm_cvtps_epi32(v); }
+  static V ToFloat(I j) { return _mm_cvtepi32_ps(j); }
+  static I AddOne(I j) { return _mm_add_epi32(j, _mm_set1_epi32(1)); }
+  static V FlipSign(V v, I j)
+  {
+    const I sign = _mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), 30);
+    return _mm_xor_ps(v, _mm_castsi128_ps(sign));
+  }
+  static V SelectOdd(I j, V odd, V even)
+  {
+    const I one = _mm_set1_epi32(1);
+    const I mask = _mm_cmpeq_epi32(_mm_and_si128(j, one), one);
+    return _mm_blendv_ps(even, odd, _mm_castsi128_ps(mask));
+  }
+};
+
+} // namespace
+
+#include "src/math_kernels_impl.h"
+
+namespace {
+
+void
+Multiply(const float* a, u32 a_stride, const float* b, u32 count, float* out)
+{
+  for (u32 i = 0; i < count; ++i, a += a_stride * 16, b += 16, out += 16) {
+    const __m128 a0 = _mm_loadu_ps(a);
+    const __m128 a1 = _mm_loadu_ps(a + 4);
+    const __m128 a2 = _mm_loadu_ps(a + 8);
+    const __m128 a3 = _mm_loadu_ps(a + 12);
+    for (int col = 0; col < 4; ++col) {
+      const __m128 bc = _mm_loadu_ps(b + col * 4);
+      __m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, 0x00));
+      r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, 0x55)));
+      r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, 0xaa)));
+      r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, 0xff)));
+      _mm_storeu_ps(out + col * 4, r);
+    }
+  }
+}
+
+} // namespace
+
+bool
+MathKernelsSse4(MathKernelTable& table)
+{
+  table.compose_trs = ComposeTrs<Lanes>;
+  table.multiply = Multiply;
+  table.transform_bounds = TransformBounds;
+  return true;
+}
+
+#else
+
+bool
+MathKernelsSse4(MathKernelTable&)
+{
+  return false;
+}
+
+#endif
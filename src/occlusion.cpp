@@ -0,0 +1,449 @@
+#include "occlusion.h"
+
+#include <SDL3/SDL_stdinc.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "src/logger.h"
+
+namespace {
+
+constexpr u32 kGrain = 4096; // instances per job
+constexpr u32 kOccluderGrain = 32;
+constexpr u32 kBandRows = 2; // tile rows per raster job
+constexpr float kMinW = 1e-3f;
+
+// Box corners: bit 0 picks max x, bit 1 max y, bit 2 max z.
+constexpr u8 kBoxTris[12][3] = {
+  { 0, 2, 6 }, { 0, 6, 4 }, { 1, 3, 7 }, { 1, 7, 5 }, // -x, +x
+  { 0, 1, 5 }, { 0, 5, 4 }, { 2, 3, 7 }, { 2, 7, 6 }, // -y, +y
+  { 0, 1, 3 }, { 0, 3, 2 }, { 4, 5, 7 }, { 4, 7, 6 }, // -z, +z
+};
+
+void
+BoxCorners(glm::vec3 min, glm::vec3 max, glm::vec3 (&out)[8])
+{
+  for (int k = 0; k < 8; ++k) {
+    out[k] = { k & 1 ? max.x : min.x,
+               k & 2 ? max.y : min.y,
+               k & 4 ? max.z : min.z };
+  }
+}
+
+// Same transform as vert.vert, `local` already went through the model matrix.
+glm::vec3
+InstanceToWorld(const InstanceData& inst, glm::vec3 local)
+{
+  const glm::vec3 q{ inst.rotation[0], inst.rotation[1], inst.rotation[2] };
+  const glm::vec3 v = local * inst.scale;
+  const glm::vec3 t = glm::cross(q, v) + inst.rotation[3] * v;
+  return glm::vec3{ inst.position[0], inst.position[1], inst.position[2] } +
+         v + 2.f * glm::cross(q, t);
+}
+
+// Projects the box to buffer pixels, false if a corner is behind the camera.
+bool
+ProjectBox(const glm::vec3 (&corners)[8],
+           const glm::mat4& view_proj,
+           const InstanceData& inst,
+           float width,
+           float height,
+           glm::vec3 (&out)[8])
+{
+  for (int k = 0; k < 8; ++k) {
+    const glm::vec4 clip =
+      view_proj * glm::vec4{ InstanceToWorld(inst, corners[k]), 1.f };
+    if (clip.w < kMinW) {
+      return false;
+    }
+    const float inv_w = 1.f / clip.w;
+    out[k] = { (clip.x * inv_w * .5f + .5f) * width,
+               (.5f - clip.y * inv_w * .5f) * height,
+               clip.w };
+  }
+  return true;
+}
+
+// Writes min(depth, row) for the 8 pixels of a tile row where all edges are
+// positive. `e` are the edge values of the first pixel.
+inline void
+RasterRow(float* row, const float (&a)[3], const float (&e)[3], float depth)
+{
+#if defined(__AVX2__)
+  const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256 outside = _mm256_setzero_ps();
+  for (int k = 0; k < 3; ++k) {
+    const __m256 ek = _mm256_add_ps(_mm256_set1_ps(e[k]),
+                                    _mm256_mul_ps(_mm256_set1_ps(a[k]), lane));
+    outside = _mm256_or_ps(outside, ek); // sign bit set if any edge < 0
+  }
+  const __m256 d = _mm256_loadu_ps(row);
+  _mm256_storeu_ps(
+    row,
+    _mm256_blendv_ps(_mm256_min_ps(d, _mm256_set1_ps(depth)), d, outside));
+#elif defined(__SSE2__)
+  const __m128 z = _mm_set1_ps(depth);
+  for (int half = 0; half < 2; ++half) {
+    const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    __m128 outside = _mm_setzero_ps();
+    for (int k = 0; k < 3; ++k) {
+      const __m128 ek =
+        _mm_add_ps(_mm_set1_ps(e[k] + a[k] * static_cast<float>(half * 4)),
+                   _mm_mul_ps(_mm_set1_ps(a[k]), lane));
+      outside = _mm_or_ps(outside, ek);
+    }
+    const __m128 mask =
+      _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(outside), 31));
+    const __m128 d = _mm_loadu_ps(row + half * 4);
+    _mm_storeu_ps(row + half * 4,
+                  _mm_or_ps(_mm_and_ps(mask, d),
+                            _mm_andnot_ps(mask, _mm_min_ps(d, z))));
+  }
+#else
+  for (u32 x = 0; x < OcclusionCuller::kTileW; ++x) {
+    const float fx = static_cast<float>(x);
+    if (e[0] + a[0] * fx >= 0.f && e[1] + a[1] * fx >= 0.f &&
+        e[2] + a[2] * fx >= 0.f) {
+      row[x] = std::min(row[x], depth);
+    }
+  }
+#endif
+}
+
+// Bit x is set when row[x] is at or behind `depth`.
+inline u32
+RowNotCloser(const float* row, float depth)
+{
+#if defined(__AVX2__)
+  return static_cast<u32>(_mm256_movemask_ps(_mm256_cmp_ps(
+    _mm256_loadu_ps(row), _mm256_set1_ps(depth), _CMP_GE_OQ)));
+#elif defined(__SSE2__)
+  const __m128 z = _mm_set1_ps(depth);
+  return static_cast<u32>(
+    _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row), z)) |
+    _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + 4), z)) << 4);
+#else
+  u32 bits = 0;
+  for (u32 x = 0; x < OcclusionCuller::kTileW; ++x) {
+    bits |= static_cast<u32>(row[x] >= depth) << x;
+  }
+  return bits;
+#endif
+}
+
+} // namespace
+
+void
+OcclusionCuller::Resize(u32 width, u32 viewport_w, u32 viewport_h)
+{
+  width = std::max((width + kTileW - 1) / kTileW * kTileW, kTileW);
+  const u32 height = std::max(
+    (width * viewport_h / std::max(viewport_w, 1u) + kTileH / 2) / kTileH *
+      kTileH,
+    kTileH);
+  if (width == width_ && height == height_) {
+    return;
+  }
+  width_ = width;
+  height_ = height;
+  tiles_x_ = width / kTileW;
+  tiles_y_ = height / kTileH;
+  depth_.assign(width_ * height_, SDL_MAX_FLOAT);
+  tile_max_.assign(tiles_x_ * tiles_y_, SDL_MAX_FLOAT);
+  LOG_DEBUG("Occlusion buffer resized to {}x{}", width_, height_);
+}
+
+void
+OcclusionCuller::SelectOccluders(u32 wanted,
+                                 const glm::mat4& view_proj,
+                                 const InstanceData* in,
+                                 u32 count,
+                                 JobSystem& jobs)
+{
+  occluders_.clear();
+  if (wanted == 0) {
+    return;
+  }
+  const u32 chunks = (count + kGrain - 1) / kGrain;
+  const u32 per_chunk = std::min(wanted, kGrain);
+  candidates_.resize(chunks * per_chunk);
+  chunk_counts_.assign(chunks, 0);
+
+  // Nearest `wanted` of every chunk, then of those. w is positive so its bits
+  // sort like the float, and the index keeps equal depths deterministic.
+  jobs.ParallelFor(count, kGrain, [&](u32 begin, u32 end) {
+    const u32 chunk = begin / kGrain;
+    u64 keys[kGrain];
+    u32 n = 0;
+    for (u32 i = begin; i < end; ++i) {
+      const float* p = in[i].position;
+      const float w = view_proj[0][3] * p[0] + view_proj[1][3] * p[1] +
+                      view_proj[2][3] * p[2] + view_proj[3][3];
+      if (w > kMinW) {
+        keys[n++] = static_cast<u64>(std::bit_cast<u32>(w)) << 32 | i;
+      }
+    }
+    const u32 keep = std::min(n, per_chunk);
+    std::nth_element(keys, keys + keep, keys + n);
+    std::copy(keys, keys + keep, candidates_.begin() + chunk * per_chunk);
+    chunk_counts_[chunk] = keep;
+  });
+
+  u32 n = 0;
+  for (u32 c = 0; c < chunks; ++c) {
+    std::copy_n(candidates_.begin() + c * per_chunk,
+                chunk_counts_[c],
+                candidates_.begin() + n);
+    n += chunk_counts_[c];
+  }
+  const u32 keep = std::min(n, wanted);
+  std::nth_element(
+    candidates_.begin(), candidates_.begin() + keep, candidates_.begin() + n);
+  occluders_.resize(keep);
+  for (u32 k = 0; k < keep; ++k) {
+    occluders_[k] = static_cast<u32>(candidates_[k]);
+  }
+}
+
+bool
+OcclusionCuller::SetupOccluder(u32 occluder,
+                               const glm::vec3 (&corners)[8],
+                               const glm::mat4& view_proj,
+                               const InstanceData& inst)
+{
+  ScreenTri* tris = &tris_[occluder * 12];
+  glm::vec3 s[8];
+  if (!ProjectBox(corners,
+                  view_proj,
+                  inst,
+                  static_cast<float>(width_),
+                  static_cast<float>(height_),
+                  s)) {
+    for (int t = 0; t < 12; ++t) {
+      tris[t].min_y = 1;
+      tris[t].max_y = 0;
+    }
+    return false;
+  }
+
+  const float max_x = static_cast<float>(width_ - 1);
+  const float max_y = static_cast<float>(height_ - 1);
+  for (int t = 0; t < 12; ++t) {
+    ScreenTri& tri = tris[t];
+    const glm::vec3 v[3] = { s[kBoxTris[t][0]],
+                             s[kBoxTris[t][1]],
+                             s[kBoxTris[t][2]] };
+    for (int k = 0; k < 3; ++k) {
+      const glm::vec3& p0 = v[k];
+      const glm::vec3& p1 = v[(k + 1) % 3];
+      tri.a[k] = p0.y - p1.y;
+      tri.b[k] = p1.x - p0.x;
+      // evaluated at pixel centers
+      tri.c[k] = p0.x * p1.y - p0.y * p1.x + .5f * (tri.a[k] + tri.b[k]);
+    }
+    const float area = tri.a[0] * v[2].x + tri.b[0] * v[2].y +
+           (v[0].x * v[1].y - v[0].y * v[1].x);
+    if (std::abs(area) < 1e-6f) {
+      tri.min_y = 1;
+      tri.max_y = 0;
+      continue;
+    }
+    if (area < 0.f) {
+      for (int k = 0; k < 3; ++k) {
+        tri.a[k] = -tri.a[k];
+        tri.b[k] = -tri.b[k];
+        tri.c[k] = -tri.c[k];
+      }
+    }
+    // conservative: the whole triangle sits at its farthest vertex
+    tri.depth = std::max(v[0].z, std::max(v[1].z, v[2].z));
+    // clamp before converting, vertices near the camera project very far
+    tri.min_x = static_cast<int>(std::floor(
+      std::clamp(std::min(v[0].x, std::min(v[1].x, v[2].x)), 0.f, max_x)));
+    tri.max_x = static_cast<int>(std::ceil(
+      std::clamp(std::max(v[0].x, std::max(v[1].x, v[2].x)), 0.f, max_x)));
+    tri.min_y = static_cast<int>(std::floor(
+      std::clamp(std::min(v[0].y, std::min(v[1].y, v[2].y)), 0.f, max_y)));
+    tri.max_y = static_cast<int>(std::ceil(
+      std::clamp(std::max(v[0].y, std::max(v[1].y, v[2].y)), 0.f, max_y)));
+  }
+  return true;
+}
+
+void
+OcclusionCuller::RasterizeBand(u32 tile_row_begin, u32 tile_row_end)
+{
+  const u32 tile_size = kTileW * kTileH;
+  std::fill(depth_.begin() + tile_row_begin * tiles_x_ * tile_size,
+            depth_.begin() + tile_row_end * tiles_x_ * tile_size,
+            SDL_MAX_FLOAT);
+
+  const int band_min = static_cast<int>(tile_row_begin * kTileH);
+  const int band_max = static_cast<int>(tile_row_end * kTileH) - 1;
+  for (const ScreenTri& tri : tris_) {
+    const int y0 = std::max(tri.min_y, band_min);
+    const int y1 = std::min(tri.max_y, band_max);
+    if (y0 > y1) {
+      continue;
+    }
+    const u32 tx0 = static_cast<u32>(tri.min_x) / kTileW;
+    const u32 tx1 = static_cast<u32>(tri.max_x) / kTileW;
+    for (int y = y0; y <= y1; ++y) {
+      const float fy = static_cast<float>(y);
+      for (u32 tx = tx0; tx <= tx1; ++tx) {
+        const float fx = static_cast<float>(tx * kTileW);
+        const float e[3] = { tri.a[0] * fx + tri.b[0] * fy + tri.c[0],
+                             tri.a[1] * fx + tri.b[1] * fy + tri.c[1],
+                             tri.a[2] * fx + tri.b[2] * fy + tri.c[2] };
+        RasterRow(Row(tx, static_cast<u32>(y)), tri.a, e, tri.depth);
+      }
+    }
+  }
+
+  for (u32 t = tile_row_begin * tiles_x_; t < tile_row_end * tiles_x_; ++t) {
+    const float* tile = &depth_[t * tile_size];
+    tile_max_[t] = *std::max_element(tile, tile + tile_size);
+  }
+}
+
+bool
+OcclusionCuller::IsVisible(const glm::vec3 (&corners)[8],
+                           const glm::mat4& view_proj,
+                           const InstanceData& inst) const
+{
+  glm::vec3 s[8];
+  if (!ProjectBox(corners,
+                  view_proj,
+                  inst,
+                  static_cast<float>(width_),
+                  static_cast<float>(height_),
+                  s)) {
+    return true; // crosses the camera plane, can't tell
+  }
+  glm::vec3 lo = s[0];
+  glm::vec3 hi = s[0];
+  for (int k = 1; k < 8; ++k) {
+    lo = glm::min(lo, s[k]);
+    hi = glm::max(hi, s[k]);
+  }
+  // every pixel the screen rect touches
+  const float max_x = static_cast<float>(width_ - 1);
+  const float max_y = static_cast<float>(height_ - 1);
+  if (hi.x < 0.f || hi.y < 0.f || lo.x > max_x + 1.f || lo.y > max_y + 1.f) {
+    return false;
+  }
+  const u32 x0 = static_cast<u32>(std::floor(std::clamp(lo.x, 0.f, max_x)));
+  const u32 x1 = static_cast<u32>(std::floor(std::clamp(hi.x, 0.f, max_x)));
+  const u32 y0 = static_cast<u32>(std::floor(std::clamp(lo.y, 0.f, max_y)));
+  const u32 y1 = static_cast<u32>(std::floor(std::clamp(hi.y, 0.f, max_y)));
+  const float nearest = lo.z;
+
+  for (u32 ty = y0 / kTileH; ty <= y1 / kTileH; ++ty) {
+    const u32 row0 = std::max(y0, ty * kTileH);
+    const u32 row1 = std::min(y1, ty * kTileH + kTileH - 1);
+    for (u32 tx = x0 / kTileW; tx <= x1 / kTileW; ++tx) {
+      if (tile_max_[ty * tiles_x_ + tx] < nearest) {
+        continue; // the whole tile is in front
+      }
+      const u32 lane0 = std::max(x0, tx * kTileW) - tx * kTileW;
+      const u32 lane1 = std::min(x1, tx * kTileW + kTileW - 1) - tx * kTileW;
+      const u32 lanes = ((1u << (lane1 + 1)) - 1) & ~((1u << lane0) - 1);
+      for (u32 y = row0; y <= row1; ++y) {
+        if (RowNotCloser(Row(tx, y), nearest) & lanes) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+u32
+OcclusionCuller::Cull(const OcclusionCfg& cfg,
+                      const glm::mat4& view_proj,
+                      const glm::mat4& model,
+                      const MeshBounds& bounds,
+                      const InstanceData* in,
+                      u32 count,
+                      JobSystem& jobs,
+                      InstanceData* out)
+{
+  stats_ = OcclusionStats{};
+  stats_.tested = count;
+  if (count == 0 || width_ == 0) {
+    std::memcpy(out, in, count * sizeof(InstanceData));
+    return count;
+  }
+
+  // Boxes after the shared model matrix, the per instance part is applied
+  // when projecting. The occluder box is shrunk around the AABB's center.
+  glm::vec3 full[8];
+  glm::vec3 core[8];
+  {
+    const glm::vec3 half = (bounds.Max - bounds.Min) * .5f;
+    const glm::vec3 core_half = half * cfg.occluder_shrink;
+    BoxCorners(bounds.Min, bounds.Max, full);
+    BoxCorners(bounds.Center - core_half, bounds.Center + core_half, core);
+    for (int k = 0; k < 8; ++k) {
+      full[k] = glm::vec3{ model * glm::vec4{ full[k], 1.f } };
+      core[k] = glm::vec3{ model * glm::vec4{ core[k], 1.f } };
+    }
+  }
+
+  SelectOccluders(cfg.occluder_count, view_proj, in, count, jobs);
+  const u32 occluders = static_cast<u32>(occluders_.size());
+  tris_.resize(occluders * 12);
+  std::atomic<u32> used{ 0 };
+  jobs.ParallelFor(occluders, kOccluderGrain, [&](u32 begin, u32 end) {
+    u32 n = 0;
+    for (u32 o = begin; o < end; ++o) {
+      n += SetupOccluder(o, core, view_proj, in[occluders_[o]]);
+    }
+    used += n;
+  });
+  stats_.occluders = used;
+
+  // every job owns a band of tile rows, so no two write the same pixel
+  jobs.ParallelFor(tiles_y_, kBandRows, [&](u32 begin, u32 end) {
+    RasterizeBand(begin, end);
+  });
+
+  const u32 chunks = (count + kGrain - 1) / kGrain;
+  visible_.resize(count);
+  chunk_counts_.assign(chunks, 0);
+  jobs.ParallelFor(count, kGrain, [&](u32 begin, u32 end) {
+    u32 n = 0;
+    for (u32 i = begin; i < end; ++i) {
+      visible_[i] = IsVisible(full, view_proj, in[i]);
+      n += visible_[i];
+    }
+    chunk_counts_[begin / kGrain] = n;
+  });
+
+  // chunk_counts_ becomes each chunk's offset in `out`
+  u32 visible = 0;
+  for (auto& c : chunk_counts_) {
+    const u32 n = c;
+    c = visible;
+    visible += n;
+  }
+
+  jobs.ParallelFor(count, kGrain, [&](u32 begin, u32 end) {
+    InstanceData* dst = out + chunk_counts_[begin / kGrain];
+    for (u32 i = begin; i < end; ++i) {
+      if (visible_[i]) {
+        *dst++ = in[i];
+      }
+    }
+  });
+
+  stats_.occluded = count - visible;
+  return visible;
+}
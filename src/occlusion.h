@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "src/gltf_loader.h"
+#include "src/instances.h"
+#include "src/job_system.h"
+#include "types.h"
+
+struct OcclusionStats
+{
+  u32 occluders{ 0 };
+  u32 tested{ 0 };
+  u32 occluded{ 0 };
+
+  float Rate() const { return tested ? float(occluded) / float(tested) : 0.f; }
+};
+
+struct OcclusionCfg
+{
+  u32 occluder_count = 256; // nearest instances rasterized as occluders
+  float occluder_shrink = .4f; // occluder box size, relative to the mesh AABB
+};
+
+// Software occlusion culling on a low resolution depth buffer.
+//
+// The nearest instances are rasterized as occluder boxes, shrunk so they stay
+// inside the mesh, with each triangle's farthest depth so the buffer never
+// claims more than the real geometry hides. Every instance's box is then
+// projected and kept only if some pixel of its screen rect is farther than
+// its nearest point. Depth is view space w, and the buffer is stored as 8x4
+// pixel tiles with a per-tile max so most tests never touch pixels.
+class OcclusionCuller
+{
+public:
+  static constexpr u32 kTileW = 8;
+  static constexpr u32 kTileH = 4;
+
+  // Buffer is `width` pixels wide and follows the viewport's aspect.
+  void Resize(u32 width, u32 viewport_w, u32 viewport_h);
+
+  // Writes the instances of `in` that aren't hidden to `out`, keeping their
+  // order, and returns how many there are. `model` is the transform shared by
+  // every instance (see vert.vert).
+  u32 Cull(const OcclusionCfg& cfg,
+           const glm::mat4& view_proj,
+           const glm::mat4& model,
+           const MeshBounds& bounds,
+           const InstanceData* in,
+           u32 count,
+           JobSystem& jobs,
+           InstanceData* out);
+
+  const OcclusionStats& Stats() const { return stats_; }
+  u32 Width() const { return width_; }
+  u32 Height() const { return height_; }
+
+private:
+  // Edge functions are set up for pixel centers, inside is all three >= 0.
+  // Rejected occluders leave an empty box (min_y > max_y).
+  struct ScreenTri
+  {
+    float a[3], b[3], c[3]; // e = a * x + b * y + c
+    float depth;            // farthest vertex
+    int min_x, max_x, min_y, max_y;
+  };
+
+
+  void SelectOccluders(u32 wanted,
+                       const glm::mat4& view_proj,
+                       const InstanceData* in,
+                       u32 count,
+                       JobSystem& jobs);
+  bool SetupOccluder(u32 occluder,
+                     const glm::vec3 (&corners)[8],
+                     const glm::mat4& view_proj,
+                     const InstanceData& inst);
+  void RasterizeBand(u32 tile_row_begin, u32 tile_row_end);
+  bool IsVisible(const glm::vec3 (&corners)[8],
+                 const glm::mat4& view_proj,
+                 const InstanceData& inst) const;
+  float* Row(u32 tile_x, u32 y)
+  {
+    return &depth_[((y / kTileH * tiles_x_ + tile_x) * kTileH + y % kTileH) *
+                   kTileW];
+  }
+  const float* Row(u32 tile_x, u32 y) const
+  {
+    return &depth_[((y / kTileH * tiles_x_ + tile_x) * kTileH + y % kTileH) *
+                   kTileW];
+  }
+
+private:
+  u32 width_{ 0 };
+  u32 height_{ 0 };
+  u32 tiles_x_{ 0 };
+  u32 tiles_y_{ 0 };
+  std::vector<float> depth_;    // tile major, kTileW * kTileH per tile
+  std::vector<float> tile_max_; // farthest depth of every tile
+  std::vector<u64> candidates_; // view depth bits << 32 | instance index
+  std::vector<u32> occluders_;
+  std::vector<ScreenTri> tris_;
+  std::vector<u8> visible_;
+  std::vector<u32> chunk_counts_;
+  OcclusionStats stats_;
+};
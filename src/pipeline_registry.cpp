@@ -0,0 +1,346 @@
+#include "pipeline_registry.h"
+
+#include <SDL3/SDL_timer.h>
+#include <type_traits>
+
+#include "src/logger.h"
+#include "util.h"
+
+namespace {
+
+template<typename T>
+void
+Put(std::string& key, const T& value)
+{
+  static_assert(std::is_scalar_v<T>);
+  key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Field by field, struct padding must not end up in the key.
+void
+Put(std::string& key, const SDL_GPUStencilOpState& s)
+{
+  Put(key, s.fail_op);
+  Put(key, s.pass_op);
+  Put(key, s.depth_fail_op);
+  Put(key, s.compare_op);
+}
+
+} // namespace
+
+PipelineDesc
+PipelineDesc::From(const SDL_GPUGraphicsPipelineCreateInfo& info)
+{
+  PipelineDesc desc;
+  desc.vertex_shader = info.vertex_shader;
+  desc.fragment_shader = info.fragment_shader;
+  const auto& input = info.vertex_input_state;
+  desc.vertex_buffers.assign(
+    input.vertex_buffer_descriptions,
+    input.vertex_buffer_descriptions + input.num_vertex_buffers);
+  desc.vertex_attributes.assign(
+    input.vertex_attributes,
+    input.vertex_attributes + input.num_vertex_attributes);
+  desc.primitive_type = info.primitive_type;
+  desc.rasterizer_state = info.rasterizer_state;
+  desc.multisample_state = info.multisample_state;
+  desc.depth_stencil_state = info.depth_stencil_state;
+  const auto& targets = info.target_info;
+  desc.color_targets.assign(
+    targets.color_target_descriptions,
+    targets.color_target_descriptions + targets.num_color_targets);
+  desc.depth_stencil_format = targets.depth_stencil_format;
+  desc.has_depth_stencil_target = targets.has_depth_stencil_target;
+  return desc;
+}
+
+SDL_GPUGraphicsPipelineCreateInfo
+PipelineDesc::CreateInfo() const
+{
+  SDL_GPUGraphicsPipelineCreateInfo info{};
+  {
+    info.vertex_shader = vertex_shader;
+    info.fragment_shader = fragment_shader;
+    info.vertex_input_state.vertex_buffer_descriptions = vertex_buffers.data();
+    info.vertex_input_state.num_vertex_buffers =
+      static_cast<Uint32>(vertex_buffers.size());
+    info.vertex_input_state.vertex_attributes = vertex_attributes.data();
+    info.vertex_input_state.num_vertex_attributes =
+      static_cast<Uint32>(vertex_attributes.size());
+    info.primitive_type = primitive_type;
+    info.rasterizer_state = rasterizer_state;
+    info.multisample_state = multisample_state;
+    info.depth_stencil_state = depth_stencil_state;
+    info.target_info.color_target_descriptions = color_targets.data();
+    info.target_info.num_color_targets =
+      static_cast<Uint32>(color_targets.size());
+    info.target_info.depth_stencil_format = depth_stencil_format;
+    info.target_info.has_depth_stencil_target = has_depth_stencil_target;
+  }
+  return info;
+}
+
+std::string
+PipelineDesc::Key() const
+{
+  std::string key;
+  key.reserve(256);
+  Put(key, vertex_shader);
+  Put(key, fragment_shader);
+  Put(key, vertex_buffers.size());
+  for (const auto& b : vertex_buffers) {
+    Put(key, b.slot);
+    Put(key, b.pitch);
+    Put(key, b.input_rate);
+    Put(key, b.instance_step_rate);
+  }
+  Put(key, vertex_attributes.size());
+  for (const auto& a : vertex_attributes) {
+    Put(key, a.location);
+    Put(key, a.buffer_slot);
+    Put(key, a.format);
+    Put(key, a.offset);
+  }
+  Put(key, primitive_type);
+  {
+    const auto& r = rasterizer_state;
+    Put(key, r.fill_mode);
+    Put(key, r.cull_mode);
+    Put(key, r.front_face);
+    Put(key, r.depth_bias_constant_factor);
+    Put(key, r.depth_bias_clamp);
+    Put(key, r.depth_bias_slope_factor);
+    Put(key, r.enable_depth_bias);
+    Put(key, r.enable_depth_clip);
+  }
+  {
+    const auto& m = multisample_state;
+    Put(key, m.sample_count);
+    Put(key, m.sample_mask);
+    Put(key, m.enable_mask);
+  }
+  {
+    const auto& d = depth_stencil_state;
+    Put(key, d.compare_op);
+    Put(key, d.back_stencil_state);
+    Put(key, d.front_stencil_state);
+    Put(key, d.compare_mask);
+    Put(key, d.write_mask);
+    Put(key, d.enable_depth_test);
+    Put(key, d.enable_depth_write);
+    Put(key, d.enable_stencil_test);
+  }
+  Put(key, color_targets.size());
+  for (const auto& t : color_targets) {
+    const auto& b = t.blend_state;
+    Put(key, t.format);
+    Put(key, b.src_color_blendfactor);
+    Put(key, b.dst_color_blendfactor);
+    Put(key, b.color_blend_op);
+    Put(key, b.src_alpha_blendfactor);
+    Put(key, b.dst_alpha_blendfactor);
+    Put(key, b.alpha_blend_op);
+    Put(key, b.color_write_mask);
+    Put(key, b.enable_blend);
+    Put(key, b.enable_color_write_mask);
+  }
+  Put(key, depth_stencil_format);
+  Put(key, has_depth_stencil_target);
+  return key;
+}
+
+size_t
+PipelineRegistry::KeyHash::operator()(const std::string& key) const
+{
+  // FNV-1a
+  u64 h = 0xcbf29ce484222325ull;
+  for (unsigned char c : key) {
+    h = (h ^ c) * 0x100000001b3ull;
+  }
+  return static_cast<size_t>(h);
+}
+
+PipelineRegistry::PipelineRegistry(SDL_GPUDevice* device)
+  : device_{ device }
+{
+  worker_ = std::thread(&PipelineRegistry::WorkerLoop, this);
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+  LOG_TRACE("Destroying PipelineRegistry");
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  worker_.join();
+
+  auto* Device = device_;
+  for (auto& entry : entries_) {
+    RELEASE_IF(entry.pipeline.load(), SDL_ReleaseGPUGraphicsPipeline);
+  }
+  for (auto& [path, shader] : shaders_) {
+    RELEASE_IF(shader, SDL_ReleaseGPUShader);
+  }
+}
+
+SDL_GPUShader*
+PipelineRegistry::Shader(const char* path)
+{
+  std::lock_guard lock(mutex_);
+  if (auto it = shaders_.find(path); it != shaders_.end()) {
+    return it->second;
+  }
+  SDL_GPUShader* shader = LoadShader(path, device_);
+  if (shader == nullptr) {
+    LOG_ERROR("Couldn't load shader at path {}", path);
+    return nullptr;
+  }
+  shaders_.emplace(path, shader);
+  return shader;
+}
+
+PipelineHandle
+PipelineRegistry::Find(const std::string& key) const
+{
+  auto it = by_key_.find(key);
+  return it != by_key_.end() ? it->second : kNoPipeline;
+}
+
+PipelineHandle
+PipelineRegistry::Add(std::string key,
+                      PipelineDesc desc,
+                      PipelineHandle fallback)
+{
+  const auto handle = static_cast<PipelineHandle>(entries_.size());
+  // only older entries, so fallback chains can't loop
+  if (fallback != kNoPipeline && fallback >= handle) {
+    LOG_WARN("Ignoring invalid fallback pipeline {}", fallback);
+    fallback = kNoPipeline;
+  }
+  auto& entry = entries_.emplace_back();
+  entry.desc = std::move(desc);
+  entry.fallback = fallback;
+  by_key_.emplace(std::move(key), handle);
+  return handle;
+}
+
+PipelineHandle
+PipelineRegistry::Request(const SDL_GPUGraphicsPipelineCreateInfo& info,
+                          PipelineHandle fallback)
+{
+  auto desc = PipelineDesc::From(info);
+  auto key = desc.Key();
+  PipelineHandle handle;
+  {
+    std::lock_guard lock(mutex_);
+    handle = Find(key);
+    if (handle != kNoPipeline) {
+      return handle;
+    }
+    handle = Add(std::move(key), std::move(desc), fallback);
+    queue_.push_back(handle);
+    ++pending_;
+  }
+  wake_.notify_one();
+  return handle;
+}
+
+PipelineHandle
+PipelineRegistry::Compile(const SDL_GPUGraphicsPipelineCreateInfo& info)
+{
+  auto desc = PipelineDesc::From(info);
+  auto key = desc.Key();
+  Entry* entry;
+  PipelineHandle handle;
+  {
+    std::unique_lock lock(mutex_);
+    handle = Find(key);
+    if (handle != kNoPipeline) {
+      // already requested, wait for the worker instead of building it twice
+      built_.wait(lock, [&] {
+        return entries_[handle].state.load() != State::Pending;
+      });
+      return handle;
+    }
+    handle = Add(std::move(key), std::move(desc), kNoPipeline);
+    entry = &entries_[handle];
+  }
+  Build(*entry);
+  NotifyBuilt();
+  return handle;
+}
+
+void
+PipelineRegistry::WaitIdle()
+{
+  std::unique_lock lock(mutex_);
+  built_.wait(lock, [this] { return pending_.load() == 0; });
+}
+
+SDL_GPUGraphicsPipeline*
+PipelineRegistry::Get(PipelineHandle handle) const
+{
+  std::lock_guard lock(mutex_);
+  for (; handle != kNoPipeline; handle = entries_[handle].fallback) {
+    if (auto* pipeline = entries_[handle].pipeline.load()) {
+      return pipeline;
+    }
+  }
+  return nullptr;
+}
+
+bool
+PipelineRegistry::IsReady(PipelineHandle handle) const
+{
+  std::lock_guard lock(mutex_);
+  return handle != kNoPipeline &&
+         entries_[handle].state.load() == State::Ready;
+}
+
+void
+PipelineRegistry::Build(Entry& entry)
+{
+  const auto info = entry.desc.CreateInfo();
+  const Uint64 start = SDL_GetTicksNS();
+  SDL_GPUGraphicsPipeline* pipeline =
+    SDL_CreateGPUGraphicsPipeline(device_, &info);
+  if (pipeline == nullptr) {
+    LOG_ERROR("Couldn't create pipeline: {}", GETERR);
+    entry.state = State::Failed;
+    return;
+  }
+  entry.pipeline = pipeline;
+  entry.state = State::Ready;
+  LOG_DEBUG("Built pipeline in {:.2f} ms",
+            static_cast<double>(SDL_GetTicksNS() - start) / 1e6);
+}
+
+void
+PipelineRegistry::NotifyBuilt()
+{
+  // states change outside the lock, take it so a waiter can't miss this
+  { std::lock_guard lock(mutex_); }
+  built_.notify_all();
+}
+
+void
+PipelineRegistry::WorkerLoop()
+{
+  for (;;) {
+    Entry* entry;
+    {
+      std::unique_lock lock(mutex_);
+      wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      entry = &entries_[queue_.front()];
+      queue_.pop_front();
+    }
+    Build(*entry);
+    --pending_;
+    NotifyBuilt();
+  }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+using PipelineHandle = u32;
+inline constexpr PipelineHandle kNoPipeline = ~0u;
+
+// Owned copy of everything SDL_GPUGraphicsPipelineCreateInfo points to, so a
+// pipeline can be built after the caller's arrays are gone.
+struct PipelineDesc
+{
+  SDL_GPUShader* vertex_shader{ nullptr };
+  SDL_GPUShader* fragment_shader{ nullptr };
+  std::vector<SDL_GPUVertexBufferDescription> vertex_buffers;
+  std::vector<SDL_GPUVertexAttribute> vertex_attributes;
+  SDL_GPUPrimitiveType primitive_type{ SDL_GPU_PRIMITIVETYPE_TRIANGLELIST };
+  SDL_GPURasterizerState rasterizer_state{};
+  SDL_GPUMultisampleState multisample_state{};
+  SDL_GPUDepthStencilState depth_stencil_state{};
+  std::vector<SDL_GPUColorTargetDescription> color_targets;
+  SDL_GPUTextureFormat depth_stencil_format{ SDL_GPU_TEXTUREFORMAT_INVALID };
+  bool has_depth_stencil_target{ false };
+
+  static PipelineDesc From(const SDL_GPUGraphicsPipelineCreateInfo& info);
+  // Points into this desc, which must outlive the returned struct.
+  SDL_GPUGraphicsPipelineCreateInfo CreateInfo() const;
+  // Every field that affects the pipeline, packed. Equal keys, same pipeline.
+  std::string Key() const;
+};
+
+// Creates graphics pipelines once per distinct description and shares them.
+//
+// Request() returns right away and compiles on a background thread; until the
+// pipeline exists Get() returns the fallback's pipeline, or nullptr when
+// there's no fallback (skip the draw). Compile() is the blocking version,
+// meant for the handful of pipelines used as fallbacks.
+//
+// Shaders loaded through Shader() are cached by path and owned by the
+// registry, so they stay alive while their pipelines compile.
+class PipelineRegistry
+{
+public:
+  explicit PipelineRegistry(SDL_GPUDevice* device);
+  ~PipelineRegistry();
+
+  PipelineRegistry(const PipelineRegistry&) = delete;
+  PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+  SDL_GPUShader* Shader(const char* path);
+
+  PipelineHandle Request(const SDL_GPUGraphicsPipelineCreateInfo& info,
+                         PipelineHandle fallback = kNoPipeline);
+  PipelineHandle Compile(const SDL_GPUGraphicsPipelineCreateInfo& info);
+
+  SDL_GPUGraphicsPipeline* Get(PipelineHandle handle) const;
+  bool IsReady(PipelineHandle handle) const;
+  u32 PendingCount() const { return pending_; }
+  // Blocks until every requested pipeline is built or failed
+  void WaitIdle();
+
+private:
+  enum class State
+  {
+    Pending,
+    Ready,
+    Failed,
+  };
+
+  struct Entry
+  {
+    PipelineDesc desc;
+    PipelineHandle fallback{ kNoPipeline };
+    std::atomic<SDL_GPUGraphicsPipeline*> pipeline{ nullptr };
+    std::atomic<State> state{ State::Pending };
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const std::string& key) const;
+  };
+
+  PipelineHandle Find(const std::string& key) const;
+  PipelineHandle Add(std::string key,
+                     PipelineDesc desc,
+                     PipelineHandle fallback);
+  void Build(Entry& entry);
+  void NotifyBuilt();
+  void WorkerLoop();
+
+private:
+  SDL_GPUDevice* device_{};
+  std::deque<Entry> entries_; // stable addresses, handles index into it
+  std::unordered_map<std::string, PipelineHandle, KeyHash> by_key_;
+  std::unordered_map<std::string, SDL_GPUShader*> shaders_;
+  std::deque<PipelineHandle> queue_;
+  std::atomic<u32> pending_{ 0 };
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable built_;
+  bool stop_{ false };
+  std::thread worker_;
+};
@@ -0,0 +1,290 @@
+#include "pose_palettes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "src/math_kernels.h"
+
+namespace {
+
+// `channel` at `time`, looking its keys up one by one for Reference
+glm::vec4
+SampleChannel(const AnimationChannel& channel, float time)
+{
+  const auto& times = channel.Times;
+  size_t next = 0;
+  while (next < times.size() && times[next] <= time) {
+    ++next;
+  }
+  const size_t key = next == 0 ? 0 : next - 1;
+  const size_t key_b = std::min(next, times.size() - 1);
+  const float span = times[key_b] - times[key];
+  const float alpha = channel.Step || next == 0 || span <= 0.f
+                        ? 0.f
+                        : std::min((time - times[key]) / span, 1.f);
+  const glm::vec4 a = channel.Values[key];
+  glm::vec4 b = channel.Values[key_b];
+  if (channel.Target != AnimationTarget::Rotation) {
+    return glm::mix(a, b, alpha);
+  }
+  if (glm::dot(a, b) < 0.f) {
+    b = -b;
+  }
+  return glm::normalize(glm::mix(a, b, alpha));
+}
+
+} // namespace
+
+void
+PosePalettes::Build(const Skeleton& skeleton,
+                    u32 clip_index,
+                    u32 poses,
+                    float time,
+                    float rate,
+                    JobSystem& jobs)
+{
+  Resize(skeleton, std::clamp(poses, 1u, kMaxPoses), clip_index);
+  poses = poses_;
+  const AnimationClip& clip = skeleton.Clips[clip_index];
+  const float duration = clip.Duration;
+  for (u32 k = 0; k < poses; ++k) {
+    const float t = time * rate + duration * float(k) / float(poses);
+    times_[k] = duration > 0.f ? t - duration * std::floor(t / duration) : 0.f;
+  }
+
+  jobs.ParallelFor(
+    static_cast<u32>(clip.Channels.size()), 1, [&](u32 begin, u32 end) {
+      for (u32 c = begin; c < end; ++c) {
+        Sample(clip.Channels[c]);
+      }
+    });
+  const auto& parents = skeleton.Parents;
+  const u32 nodes = static_cast<u32>(parents.size());
+  jobs.ParallelFor(
+    nodes, 16, [&](u32 begin, u32 end) { Compose(begin, end); });
+
+  // parents come first, their world matrices are ready
+  for (u32 n = 0; n < nodes; ++n) {
+    glm::mat4* world = &world_[size_t(n) * poses];
+    const glm::mat4* local = &local_[size_t(n) * poses];
+    if (parents[n] == Skeleton::kNoParent) {
+      std::copy_n(local, poses, world);
+    } else {
+      MathKernels::Multiply(
+        &world_[size_t(parents[n]) * poses], local, poses, world);
+    }
+  }
+
+  const auto& joints = skeleton.Joints;
+  jobs.ParallelFor(
+    static_cast<u32>(joints.size()), 8, [&](u32 begin, u32 end) {
+      for (u32 j = begin; j < end; ++j) {
+        MathKernels::Multiply(&world_[size_t(joints[j]) * poses],
+                              &inverse_binds_[size_t(j) * poses],
+                              poses,
+                              &palettes_[size_t(j) * poses]);
+      }
+    });
+}
+
+void
+PosePalettes::Resize(const Skeleton& skeleton, u32 poses, u32 clip)
+{
+  if (&skeleton == skeleton_ && poses == poses_ && clip == clip_) {
+    return;
+  }
+  // Nodes the clip doesn't animate keep their rest pose
+  skeleton_ = &skeleton;
+  poses_ = poses;
+  clip_ = clip;
+  const auto& rest = skeleton.Rest;
+  const u32 nodes = static_cast<u32>(rest.size());
+  const u32 joints = static_cast<u32>(skeleton.Joints.size());
+  times_.resize(poses);
+  for (auto& array : trs_) {
+    array.resize(size_t(nodes) * poses);
+  }
+  for (u32 n = 0; n < nodes; ++n) {
+    const NodeTransform& t = rest[n];
+    for (u32 k = 0; k < poses; ++k) {
+      const size_t i = size_t(n) * poses + k;
+      for (int c = 0; c < 3; ++c) {
+        trs_[kTranslation + c][i] = t.Translation[c];
+        trs_[kScale + c][i] = t.Scale[c];
+      }
+      for (int c = 0; c < 4; ++c) {
+        trs_[kRotation + c][i] = t.Rotation[c];
+      }
+    }
+  }
+  local_.resize(size_t(nodes) * poses);
+  world_.resize(size_t(nodes) * poses);
+  inverse_binds_.resize(size_t(joints) * poses);
+  for (u32 j = 0; j < joints; ++j) {
+    std::fill_n(inverse_binds_.begin() + size_t(j) * poses,
+                poses,
+                skeleton.InverseBinds[j]);
+  }
+  palettes_.resize(size_t(joints) * poses);
+}
+
+void
+PosePalettes::Sample(const AnimationChannel& channel)
+{
+  // Keys on either side of every pose's time first, then blends that run
+  // over the poses
+  const u32 poses = poses_;
+  const auto& times = channel.Times;
+  const u32 last = static_cast<u32>(times.size() - 1);
+  u32 key[kMaxPoses];
+  float alpha[kMaxPoses];
+  for (u32 k = 0; k < poses; ++k) {
+    const u32 next = static_cast<u32>(
+      std::upper_bound(times.begin(), times.end(), times_[k]) -
+      times.begin());
+    if (next == 0 || next > last) {
+      key[k] = next == 0 ? 0 : last;
+      alpha[k] = 0.f;
+    } else {
+      key[k] = next - 1;
+      const float span = times[next] - times[next - 1];
+      alpha[k] = channel.Step || span <= 0.f
+                   ? 0.f
+                   : (times_[k] - times[next - 1]) / span;
+    }
+  }
+
+  const bool rotation = channel.Target == AnimationTarget::Rotation;
+  const u32 comps = rotation ? 4 : 3;
+  const u32 first = rotation ? kRotation
+                    : channel.Target == AnimationTarget::Translation
+                      ? kTranslation
+                      : kScale;
+  float a[4][kMaxPoses];
+  float b[4][kMaxPoses];
+  for (u32 k = 0; k < poses; ++k) {
+    const glm::vec4& va = channel.Values[key[k]];
+    const glm::vec4& vb = channel.Values[std::min(key[k] + 1, last)];
+    for (u32 c = 0; c < 4; ++c) {
+      a[c][k] = va[c];
+      b[c][k] = vb[c];
+    }
+  }
+  if (rotation) {
+    // the shortest way round
+    for (u32 k = 0; k < poses; ++k) {
+      const float d =
+        a[0][k] * b[0][k] + a[1][k] * b[1][k] + a[2][k] * b[2][k] +
+        a[3][k] * b[3][k];
+      const float sign = d < 0.f ? -1.f : 1.f;
+      for (u32 c = 0; c < 4; ++c) {
+        b[c][k] *= sign;
+      }
+    }
+  }
+
+  float* out[4];
+  for (u32 c = 0; c < comps; ++c) {
+    out[c] = trs_[first + c].data() + size_t(channel.Node) * poses;
+    for (u32 k = 0; k < poses; ++k) {
+      out[c][k] = a[c][k] + (b[c][k] - a[c][k]) * alpha[k];
+    }
+  }
+  if (rotation) {
+    // normalized lerp, close enough to slerp between nearby keys
+    for (u32 k = 0; k < poses; ++k) {
+      const float len =
+        std::sqrt(out[0][k] * out[0][k] + out[1][k] * out[1][k] +
+                  out[2][k] * out[2][k] + out[3][k] * out[3][k]);
+      const float inv = len > 0.f ? 1.f / len : 0.f;
+      for (u32 c = 0; c < 4; ++c) {
+        out[c][k] *= inv;
+      }
+    }
+  }
+}
+
+// Local matrices of nodes [begin, end) for every pose
+void
+PosePalettes::Compose(u32 begin, u32 end)
+{
+  const size_t from = size_t(begin) * poses_;
+  const size_t to = size_t(end) * poses_;
+  const float* tx = trs_[kTranslation].data();
+  const float* ty = trs_[kTranslation + 1].data();
+  const float* tz = trs_[kTranslation + 2].data();
+  const float* qx = trs_[kRotation].data();
+  const float* qy = trs_[kRotation + 1].data();
+  const float* qz = trs_[kRotation + 2].data();
+  const float* qw = trs_[kRotation + 3].data();
+  const float* sx = trs_[kScale].data();
+  const float* sy = trs_[kScale + 1].data();
+  const float* sz = trs_[kScale + 2].data();
+  for (size_t i = from; i < to; ++i) {
+    const float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+    glm::mat4& m = local_[i];
+    m[0] = glm::vec4{ (1.f - 2.f * (y * y + z * z)) * sx[i],
+                      2.f * (x * y + w * z) * sx[i],
+                      2.f * (x * z - w * y) * sx[i],
+                      0.f };
+    m[1] = glm::vec4{ 2.f * (x * y - w * z) * sy[i],
+                      (1.f - 2.f * (x * x + z * z)) * sy[i],
+                      2.f * (y * z + w * x) * sy[i],
+                      0.f };
+    m[2] = glm::vec4{ 2.f * (x * z + w * y) * sz[i],
+                      2.f * (y * z - w * x) * sz[i],
+                      (1.f - 2.f * (x * x + y * y)) * sz[i],
+                      0.f };
+    m[3] = glm::vec4{ tx[i], ty[i], tz[i], 1.f };
+  }
+}
+
+void
+PosePalettes::Reference(std::vector<glm::mat4>& out) const
+{
+  out.clear();
+  if (skeleton_ == nullptr) {
+    return;
+  }
+  const AnimationClip& clip = skeleton_->Clips[clip_];
+  const auto& parents = skeleton_->Parents;
+  const auto& joints = skeleton_->Joints;
+  const u32 nodes = static_cast<u32>(parents.size());
+  std::vector<NodeTransform> pose;
+  std::vector<glm::mat4> world(nodes);
+  out.resize(joints.size() * poses_);
+  for (u32 k = 0; k < poses_; ++k) {
+    pose = skeleton_->Rest;
+    for (const auto& channel : clip.Channels) {
+      const glm::vec4 value = SampleChannel(channel, times_[k]);
+      NodeTransform& t = pose[channel.Node];
+      switch (channel.Target) {
+        case AnimationTarget::Translation:
+          t.Translation = glm::vec3{ value };
+          break;
+        case AnimationTarget::Rotation:
+          t.Rotation = value;
+          break;
+        case AnimationTarget::Scale:
+          t.Scale = glm::vec3{ value };
+          break;
+      }
+    }
+    for (u32 n = 0; n < nodes; ++n) {
+      const NodeTransform& t = pose[n];
+      const glm::quat q{
+        t.Rotation.w, t.Rotation.x, t.Rotation.y, t.Rotation.z
+      };
+      const glm::mat4 local =
+        glm::translate(glm::mat4{ 1.f }, t.Translation) * glm::mat4_cast(q) *
+        glm::scale(glm::mat4{ 1.f }, t.Scale);
+      world[n] = parents[n] == Skeleton::kNoParent ? local
+                                                   : world[parents[n]] * local;
+    }
+    for (size_t j = 0; j < joints.size(); ++j) {
+      out[j * poses_ + k] = world[joints[j]] * skeleton_->InverseBinds[j];
+    }
+  }
+}
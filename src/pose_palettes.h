@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "src/job_system.h"
+#include "src/skeleton.h"
+#include "types.h"
+
+// Joint palettes of a skeleton playing a clip, for a few poses at once. Every
+// step runs as arrays over the poses: sampling the channels, composing the
+// local matrices and walking the hierarchy. CPU only, Skinning uploads the
+// palettes.
+class PosePalettes
+{
+public:
+  static constexpr u32 kMaxPoses = 128;
+
+  // Pose k is `clip` of `skeleton` played at `time * rate`, plus k / `poses`
+  // of its length. The skeleton must outlive the palettes.
+  void Build(const Skeleton& skeleton,
+             u32 clip,
+             u32 poses,
+             float time,
+             float rate,
+             JobSystem& jobs);
+
+  u32 Poses() const { return poses_; }
+  // Clip time of every pose, wrapped to its length
+  const std::vector<float>& Times() const { return times_; }
+  // Mesh space to posed mesh space, joint * poses + pose
+  const std::vector<glm::mat4>& Palettes() const { return palettes_; }
+
+  // The same palettes, pose by pose through plain glm: no arrays over the
+  // poses, batched kernels or precomposed matrices. Laid out as Palettes().
+  void Reference(std::vector<glm::mat4>& out) const;
+
+private:
+  // Node transforms as arrays over the poses, `node * poses + pose`
+  enum Trs : u32
+  {
+    kTranslation = 0, // x, y, z
+    kRotation = 3,    // x, y, z, w
+    kScale = 7,       // x, y, z
+    kTrsCount = 10,
+  };
+
+  void Resize(const Skeleton& skeleton, u32 poses, u32 clip);
+  void Sample(const AnimationChannel& channel);
+  void Compose(u32 begin, u32 end);
+
+private:
+  const Skeleton* skeleton_{ nullptr };
+  u32 poses_{ 0 };
+  u32 clip_{ UINT32_MAX };
+  std::vector<float> times_;
+  std::vector<float> trs_[kTrsCount];
+  std::vector<glm::mat4> local_;         // node * poses + pose
+  std::vector<glm::mat4> world_;         // node * poses + pose
+  std::vector<glm::mat4> inverse_binds_; // joint * poses + pose, repeated
+  std::vector<glm::mat4> palettes_;      // joint * poses + pose
+};
@@ -0,0 +1,216 @@
+#include "profiler.h"
+
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+constexpr u64 kRingSize = 1 << 14; // events kept per thread
+
+// Relaxed atomics: a reader may copy a slot while its thread overwrites it,
+// it finds out from the head afterwards and drops it.
+struct Slot
+{
+  std::atomic<const char*> name;
+  std::atomic<u64> start;
+  std::atomic<u64> end;
+  std::atomic<u32> depth;
+};
+
+struct Ring
+{
+  u32 id{ 0 };
+  std::atomic<const char*> name{ "Thread" };
+  std::atomic<u64> head{ 0 }; // events ever recorded
+  Slot slots[kRingSize];
+};
+
+struct Registry
+{
+  std::mutex mutex; // registration and readers, never recording
+  std::vector<std::unique_ptr<Ring>> rings;
+};
+
+Registry&
+Rings()
+{
+  static Registry registry;
+  return registry;
+}
+
+thread_local Ring* t_ring = nullptr;
+thread_local const char* t_name = nullptr;
+thread_local u32 t_depth = 0;
+
+// main thread only
+u64 g_frames[2]{};
+
+Ring*
+LocalRing()
+{
+  if (t_ring == nullptr) {
+    auto ring = std::make_unique<Ring>();
+    if (t_name != nullptr) {
+      ring->name = t_name;
+    }
+    auto& registry = Rings();
+    std::lock_guard lock{ registry.mutex };
+    ring->id = static_cast<u32>(registry.rings.size());
+    t_ring = ring.get();
+    registry.rings.push_back(std::move(ring));
+  }
+  return t_ring;
+}
+
+} // namespace
+
+void
+Profiler::SetEnabled(bool enabled)
+{
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void
+Profiler::SetThreadName(const char* name)
+{
+  t_name = name;
+  if (t_ring != nullptr) {
+    t_ring->name = name;
+  }
+}
+
+void
+Profiler::MarkFrame()
+{
+  g_frames[0] = g_frames[1];
+  g_frames[1] = SDL_GetTicksNS();
+}
+
+bool
+Profiler::LastFrame(u64& start_ns, u64& end_ns)
+{
+  start_ns = g_frames[0];
+  end_ns = g_frames[1];
+  return start_ns != 0 && end_ns > start_ns;
+}
+
+u32&
+Profiler::Depth()
+{
+  return t_depth;
+}
+
+void
+Profiler::Record(const char* name, u64 start_ns, u64 end_ns, u32 depth)
+{
+  Ring* ring = LocalRing();
+  const u64 head = ring->head.load(std::memory_order_relaxed);
+  // a reader that sees the new slot contents sees the head that says it's
+  // being reused
+  std::atomic_thread_fence(std::memory_order_release);
+  Slot& slot = ring->slots[head & (kRingSize - 1)];
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.start.store(start_ns, std::memory_order_relaxed);
+  slot.end.store(end_ns, std::memory_order_relaxed);
+  slot.depth.store(depth, std::memory_order_relaxed);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void
+Profiler::Collect(u64 since_ns, std::vector<ProfileThread>& out)
+{
+  out.clear();
+  auto& registry = Rings();
+  std::lock_guard lock{ registry.mutex };
+  for (const auto& ring : registry.rings) {
+    ProfileThread thread{ ring->id, ring->name.load(), {} };
+    const u64 head = ring->head.load(std::memory_order_acquire);
+    u64 first = head > kRingSize ? head - kRingSize : 0;
+    // newest first, zones end in order so we can stop at the first old one
+    u64 i = head;
+    while (i > first) {
+      const Slot& slot = ring->slots[(i - 1) & (kRingSize - 1)];
+      const u64 end = slot.end.load(std::memory_order_relaxed);
+      if (end < since_ns) {
+        break;
+      }
+      thread.events.push_back({ slot.name.load(std::memory_order_relaxed),
+                                slot.start.load(std::memory_order_relaxed),
+                                end,
+                                slot.depth.load(std::memory_order_relaxed) });
+      --i;
+    }
+    std::reverse(thread.events.begin(), thread.events.end());
+
+    // Drop what the thread overwrote meanwhile, including the slot it may be
+    // writing right now.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const u64 after = ring->head.load(std::memory_order_relaxed);
+    first = std::max(i, after >= kRingSize ? after - kRingSize + 1 : 0);
+    const u64 stale = std::min<u64>(first - i, thread.events.size());
+    thread.events.erase(thread.events.begin(),
+                        thread.events.begin() + static_cast<long>(stale));
+    if (!thread.events.empty()) {
+      out.push_back(std::move(thread));
+    }
+  }
+}
+
+bool
+Profiler::WriteTrace(const char* path)
+{
+  std::vector<ProfileThread> threads;
+  Collect(0, threads);
+  u64 origin = ~0ull;
+  for (const auto& thread : threads) {
+    for (const auto& e : thread.events) {
+      origin = std::min(origin, e.start_ns);
+    }
+  }
+
+  std::ofstream f{ path };
+  if (!f) {
+    return false;
+  }
+  f.setf(std::ios::fixed);
+  f.precision(3);
+  f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  auto separator = [&] {
+    f << (first ? "\n" : ",\n");
+    first = false;
+  };
+  for (const auto& thread : threads) {
+    separator();
+    f << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+      << thread.id << ",\"args\":{\"name\":\"" << thread.name << "\"}}";
+    for (const auto& e : thread.events) {
+      // microseconds
+      separator();
+      f << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+        << thread.id << ",\"ts\":" << double(e.start_ns - origin) / 1e3
+        << ",\"dur\":" << double(e.end_ns - e.start_ns) / 1e3 << "}";
+    }
+  }
+  f << "\n]}\n";
+  return bool(f);
+}
+
+void
+ProfileZone::Begin(const char* name)
+{
+  name_ = name;
+  depth_ = Profiler::Depth()++;
+  start_ = SDL_GetTicksNS();
+}
+
+void
+ProfileZone::End()
+{
+  const u64 end = SDL_GetTicksNS();
+  --Profiler::Depth();
+  Profiler::Record(name_, start_, end, depth_);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "types.h"
+
+struct ProfileEvent
+{
+  const char* name;
+  u64 start_ns;
+  u64 end_ns;
+  u32 depth; // zones open on the thread when it started
+};
+
+struct ProfileThread
+{
+  u32 id; // registration order
+  const char* name;
+  std::vector<ProfileEvent> events; // in the order they ended
+};
+
+// Scoped CPU zones, see PROFILE_ZONE.
+//
+// Every thread records finished zones into a ring of its own: the thread is
+// its only writer, so recording takes no lock, and readers drop the slots
+// that got overwritten while they copied. A disabled profiler costs a relaxed
+// load per zone.
+class Profiler
+{
+public:
+  static void SetEnabled(bool enabled);
+  static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // Name of the calling thread in traces, must outlive it
+  static void SetThreadName(const char* name);
+
+  // Start of a frame, from the main loop. The flame view shows the last
+  // whole frame.
+  static void MarkFrame();
+  static bool LastFrame(u64& start_ns, u64& end_ns);
+
+  // Copies the events still in the rings that ended at `since_ns` or later.
+  static void Collect(u64 since_ns, std::vector<ProfileThread>& out);
+  // Chrome trace event JSON, also read by Perfetto
+  static bool WriteTrace(const char* path);
+
+  // ProfileZone's
+  static void Record(const char* name, u64 start_ns, u64 end_ns, u32 depth);
+  static u32& Depth();
+
+private:
+  static inline std::atomic<bool> enabled_{ false };
+};
+
+class ProfileZone
+{
+public:
+  explicit ProfileZone(const char* name)
+  {
+    if (Profiler::Enabled()) {
+      Begin(name);
+    }
+  }
+  ~ProfileZone()
+  {
+    if (name_ != nullptr) {
+      End();
+    }
+  }
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+  void Begin(const char* name);
+  void End();
+
+private:
+  const char* name_{ nullptr };
+  u64 start_{ 0 };
+  u32 depth_{ 0 };
+};
+
+// Times the rest of the scope. `name` must have static storage, only the
+// pointer is kept.
+#ifdef SDLCUBE_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)                                                     \
+  ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)                          \
+  {                                                                            \
+    name                                                                       \
+  }
+#else
+#define PROFILE_ZONE(name)
+#endif
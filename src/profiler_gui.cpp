@@ -0,0 +1,81 @@
+#include "profiler_gui.h"
+
+#include <algorithm>
+#include <imgui/imgui.h>
+
+#include "src/profiler.h"
+
+namespace {
+
+ImU32
+ZoneColor(const char* name)
+{
+  // by name, so a zone keeps its color from frame to frame
+  const auto h = static_cast<u32>(reinterpret_cast<uintptr_t>(name) >> 3);
+  const float hue = float((h * 2654435761u) >> 8 & 0xff) / 255.f;
+  float r = 0.f;
+  float g = 0.f;
+  float b = 0.f;
+  ImGui::ColorConvertHSVtoRGB(hue, .5f, .8f, r, g, b);
+  return ImGui::GetColorU32(ImVec4{ r, g, b, 1.f });
+}
+
+} // namespace
+
+void
+ProfilerFlameView()
+{
+  static std::vector<ProfileThread> threads;
+  u64 start = 0;
+  u64 end = 0;
+  if (!Profiler::LastFrame(start, end)) {
+    ImGui::TextDisabled("No frame recorded yet");
+    return;
+  }
+  Profiler::Collect(start, threads);
+  const float span = float(end - start);
+  ImGui::Text("Frame: %.3f ms", span / 1e6f);
+
+  const float row = ImGui::GetTextLineHeightWithSpacing();
+  const float width = std::max(ImGui::GetContentRegionAvail().x, 100.f);
+  ImDrawList* draw = ImGui::GetWindowDrawList();
+  for (const auto& thread : threads) {
+    u32 depth = 0;
+    for (const auto& e : thread.events) {
+      if (e.end_ns > start && e.start_ns < end) {
+        depth = std::max(depth, e.depth + 1);
+      }
+    }
+    if (depth == 0) {
+      continue; // nothing this frame
+    }
+    ImGui::TextUnformatted(thread.name);
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::Dummy(ImVec2{ width, row * float(depth) });
+    draw->PushClipRect(
+      origin, ImVec2{ origin.x + width, origin.y + row * float(depth) }, true);
+    for (const auto& e : thread.events) {
+      if (e.end_ns <= start || e.start_ns >= end) {
+        continue;
+      }
+      const u64 s = std::max(e.start_ns, start);
+      const u64 t = std::min(e.end_ns, end);
+      const ImVec2 a{ origin.x + width * float(s - start) / span,
+                      origin.y + row * float(e.depth) };
+      const ImVec2 b{ std::max(origin.x + width * float(t - start) / span,
+                               a.x + 1.f),
+                      a.y + row - 1.f };
+      draw->AddRectFilled(a, b, ZoneColor(e.name));
+      if (ImGui::CalcTextSize(e.name).x < b.x - a.x - 4.f) {
+        draw->AddText(ImVec2{ a.x + 2.f, a.y },
+                      ImGui::GetColorU32(ImVec4{ 0.f, 0.f, 0.f, 1.f }),
+                      e.name);
+      }
+      if (ImGui::IsMouseHoveringRect(a, b)) {
+        ImGui::SetTooltip(
+          "%s: %.3f ms", e.name, float(e.end_ns - e.start_ns) / 1e6f);
+      }
+    }
+    draw->PopClipRect();
+  }
+}
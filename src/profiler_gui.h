@@ -0,0 +1,6 @@
+#pragma once
+
+// Flame view of the last whole frame in the current ImGui window: a band
+// per thread, zones nested below their parents, hover for times.
+void
+ProfilerFlameView();
@@ -12,7 +12,8 @@ public:
   SDL_GPUDevice* Device;
   SDL_Window* Window;
   float DeltaTime{ 0.0f };
-  float lastTime{ 0.0f };
+  // seconds, a float would step by a quarter millisecond after an hour
+  double lastTime{ 0. };
   // static inline std::shared_ptr<spdlog::logger> s_app_logger{};
 
 public:
@@ -27,8 +28,13 @@ public:
   virtual bool ShouldQuit() = 0;
   void UpdateTime()
   {
-    float newTime = SDL_GetTicks() / 1000.0f;
-    DeltaTime = newTime - lastTime;
-    lastTime = newTime;
+    // nanosecond ticks, millisecond ones round short frames off
+    const Uint64 now = SDL_GetTicksNS();
+    DeltaTime = lastTicks_ == 0 ? 0.f : float(double(now - lastTicks_) / 1e9);
+    lastTime = double(now) / 1e9;
+    lastTicks_ = now;
   }
+
+private:
+  Uint64 lastTicks_{ 0 };
 };
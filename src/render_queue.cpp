@@ -0,0 +1,177 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+constexpr u32 kPassShift = 60;
+constexpr u32 kPipelineShift = 52;
+constexpr u32 kPipelineBits = 8;
+constexpr u32 kMaterialShift = 40;
+constexpr u32 kMaterialBits = 12;
+constexpr u32 kMeshShift = 28;
+constexpr u32 kMeshBits = 12;
+
+// Non-negative floats compare like their bits, keep the top 28 of 31.
+u64
+DepthBits(float depth)
+{
+  return std::bit_cast<u32>(std::max(depth, 0.f)) >> 3;
+}
+
+} // namespace
+
+u64
+RenderQueue::Intern(std::vector<const void*>& table, const void* ptr, u32 bits)
+{
+  const auto it = std::find(table.begin(), table.end(), ptr);
+  if (it != table.end()) {
+    return static_cast<u64>(it - table.begin());
+  }
+  // out of ids: still correct, those draws just share a bucket
+  const u64 max = (1ull << bits) - 1;
+  if (table.size() > max) {
+    return max;
+  }
+  table.push_back(ptr);
+  return table.size() - 1;
+}
+
+void
+RenderQueue::Clear()
+{
+  items_.clear();
+  cmds_.clear();
+  pipelines_.clear();
+  materials_.clear();
+  meshes_.clear();
+}
+
+void
+RenderQueue::Add(DrawPass pass, const DrawCmd& cmd, float depth)
+{
+  const u64 key =
+    static_cast<u64>(pass) << kPassShift |
+    Intern(pipelines_, cmd.pipeline, kPipelineBits) << kPipelineShift |
+    Intern(materials_, cmd.sampler.texture, kMaterialBits) << kMaterialShift |
+    Intern(meshes_, cmd.vertex_buffer.buffer, kMeshBits) << kMeshShift |
+    DepthBits(depth);
+  items_.push_back({ key, static_cast<u32>(cmds_.size()) });
+  cmds_.push_back(cmd);
+}
+
+void
+RenderQueue::Sort()
+{
+  // LSD radix sort, a byte at a time. Stable, so equal keys keep the order
+  // they were added in. Bytes every key agrees on are skipped.
+  const u32 n = static_cast<u32>(items_.size());
+  if (n < 2) {
+    return;
+  }
+  scratch_.resize(n);
+  for (u32 shift = 0; shift < 64; shift += 8) {
+    u32 counts[256]{};
+    for (const Item& item : items_) {
+      ++counts[(item.key >> shift) & 0xff];
+    }
+    if (counts[(items_[0].key >> shift) & 0xff] == n) {
+      continue;
+    }
+    u32 offset = 0;
+    for (u32& c : counts) {
+      const u32 count = c;
+      c = offset;
+      offset += count;
+    }
+    for (const Item& item : items_) {
+      scratch_[counts[(item.key >> shift) & 0xff]++] = item;
+    }
+    items_.swap(scratch_);
+  }
+}
+
+u32
+RenderQueue::PassBegin(DrawPass pass) const
+{
+  const u64 key = static_cast<u64>(pass) << kPassShift;
+  const auto it = std::lower_bound(
+    items_.begin(), items_.end(), key, [](const Item& item, u64 k) {
+      return item.key < k;
+    });
+  return static_cast<u32>(it - items_.begin());
+}
+
+RenderQueueStats
+RenderQueue::Submit(SDL_GPURenderPass* pass, u32 begin, u32 end) const
+{
+  RenderQueueStats stats{};
+  const DrawCmd* last = nullptr;
+  auto bind = [&](bool changed) {
+    if (changed) {
+      ++stats.binds;
+    } else {
+      ++stats.elided;
+    }
+    return changed;
+  };
+
+  end = std::min(end, Size());
+  for (u32 i = begin; i < end; ++i) {
+    const DrawCmd& cmd = cmds_[items_[i].cmd];
+    if (bind(!last || last->pipeline != cmd.pipeline)) {
+      SDL_BindGPUGraphicsPipeline(pass, cmd.pipeline);
+      ++stats.pipelines;
+    }
+    if (bind(!last ||
+             last->vertex_buffer.buffer != cmd.vertex_buffer.buffer ||
+             last->vertex_buffer.offset != cmd.vertex_buffer.offset)) {
+      SDL_BindGPUVertexBuffers(pass, 0, &cmd.vertex_buffer, 1);
+    }
+    if (bind(!last || last->index_buffer.buffer != cmd.index_buffer.buffer ||
+             last->index_buffer.offset != cmd.index_buffer.offset ||
+             last->index_size != cmd.index_size)) {
+      SDL_BindGPUIndexBuffer(pass, &cmd.index_buffer, cmd.index_size);
+    }
+    if (cmd.num_storage != 0 &&
+        bind(!last || last->num_storage != cmd.num_storage ||
+             std::memcmp(last->storage,
+                         cmd.storage,
+                         cmd.num_storage * sizeof(SDL_GPUBuffer*)) != 0)) {
+      SDL_BindGPUVertexStorageBuffers(pass, 0, cmd.storage, cmd.num_storage);
+    }
+    if (cmd.num_fragment_storage != 0 &&
+        bind(!last || last->num_fragment_storage != cmd.num_fragment_storage ||
+             std::memcmp(last->fragment_storage,
+                         cmd.fragment_storage,
+                         cmd.num_fragment_storage * sizeof(SDL_GPUBuffer*)) !=
+               0)) {
+      SDL_BindGPUFragmentStorageBuffers(
+        pass, 0, cmd.fragment_storage, cmd.num_fragment_storage);
+    }
+    if (cmd.sampler.texture != nullptr &&
+        bind(!last || last->sampler.texture != cmd.sampler.texture ||
+             last->sampler.sampler != cmd.sampler.sampler)) {
+      SDL_BindGPUFragmentSamplers(pass, 0, &cmd.sampler, 1);
+    }
+
+    if (cmd.indirect != nullptr) {
+      SDL_DrawGPUIndexedPrimitivesIndirect(
+        pass, cmd.indirect, cmd.indirect_offset, 1);
+      ++stats.indirect;
+    } else {
+      SDL_DrawGPUIndexedPrimitives(pass,
+                                   cmd.num_indices,
+                                   cmd.num_instances,
+                                   cmd.first_index,
+                                   cmd.vertex_offset,
+                                   0);
+      stats.triangles += u64(cmd.num_indices / 3) * cmd.num_instances;
+    }
+    ++stats.draws;
+    last = &cmd;
+  }
+  return stats;
+}
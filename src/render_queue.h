@@ -0,0 +1,91 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <vector>
+
+#include "types.h"
+
+// Submission order of the scene pass, most significant part of a sort key.
+enum class DrawPass : u8
+{
+  Depth = 0, // optional depth prepass, lays down depth for an EQUAL test
+  Opaque = 1,
+  Sky = 2, // after opaque geometry, its depth test rejects what they cover
+};
+
+// Everything needed to record one indexed draw. Draws from `indirect` when
+// it's set, num_instances/first_index/vertex_offset are ignored then. No
+// sampler is bound when sampler.texture is null (depth only draws).
+struct DrawCmd
+{
+  SDL_GPUGraphicsPipeline* pipeline{ nullptr };
+  SDL_GPUBufferBinding vertex_buffer{};
+  SDL_GPUBufferBinding index_buffer{};
+  SDL_GPUIndexElementSize index_size{ SDL_GPU_INDEXELEMENTSIZE_16BIT };
+  SDL_GPUTextureSamplerBinding sampler{};
+  SDL_GPUBuffer* storage[3]{};
+  Uint32 num_storage{ 0 };
+  SDL_GPUBuffer* fragment_storage[3]{};
+  Uint32 num_fragment_storage{ 0 };
+  SDL_GPUBuffer* indirect{ nullptr };
+  Uint32 indirect_offset{ 0 };
+  Uint32 num_indices{ 0 };
+  Uint32 num_instances{ 0 };
+  Uint32 first_index{ 0 };
+  Sint32 vertex_offset{ 0 };
+};
+
+struct RenderQueueStats
+{
+  u32 draws{ 0 };
+  u32 indirect{ 0 }; // of the draws
+  u64 triangles{ 0 }; // direct draws only, instance counts are on the GPU
+  u32 pipelines{ 0 }; // pipeline binds
+  u32 binds{ 0 };  // pipeline, buffer and sampler binds recorded
+  u32 elided{ 0 }; // binds skipped because the state was already set
+};
+
+// Per frame list of draws, sorted by a 64-bit key before being recorded:
+//
+//   63..60 pass | 59..52 pipeline | 51..40 material | 39..28 mesh | 27..0 depth
+//
+// Pipelines, materials (texture) and meshes (vertex buffer) get small ids in
+// the order they're first added, so draws sharing state end up next to each
+// other. Depth is the view distance, nearest first, so opaque geometry goes
+// front to back within a state bucket.
+//
+// The material bits are reserved for per primitive materials: the loader
+// keeps a single texture for the model, so every scene draw has the same one.
+class RenderQueue
+{
+public:
+  void Clear();
+  void Add(DrawPass pass, const DrawCmd& cmd, float depth);
+  void Sort();
+
+  // Position of the first sorted draw of `pass` or a later one.
+  u32 PassBegin(DrawPass pass) const;
+
+  // Records sorted draws [begin, end), skipping binds of state that's already
+  // bound. Disjoint ranges can be recorded from several threads at once.
+  RenderQueueStats Submit(SDL_GPURenderPass* pass, u32 begin, u32 end) const;
+
+  u32 Size() const { return static_cast<u32>(items_.size()); }
+
+private:
+  struct Item
+  {
+    u64 key;
+    u32 cmd;
+  };
+
+  static u64 Intern(std::vector<const void*>& table, const void* ptr, u32 bits);
+
+private:
+  std::vector<Item> items_;
+  std::vector<Item> scratch_;
+  std::vector<DrawCmd> cmds_;
+  std::vector<const void*> pipelines_;
+  std::vector<const void*> materials_;
+  std::vector<const void*> meshes_;
+};
@@ -0,0 +1,121 @@
+#include "render_stats.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "src/logger.h"
+
+namespace {
+
+struct CsvStream
+{
+  std::ofstream file;
+  u32 every{ 1 };
+};
+
+CsvStream g_csv;
+
+const char* const kCounterNames[] = {
+  "draws",     "indirect_draws", "triangles",         "pipeline_binds",
+  "binds",     "elided_binds",   "instances",         "visible_instances",
+  "culled_instances", "lights",  "upload_bytes",
+};
+static_assert(std::size(kCounterNames) == u32(Counter::Count));
+
+const char* const kMemoryNames[] = {
+  "geometry", "textures", "render_targets", "instances",
+  "lighting", "culling",  "staging",
+};
+static_assert(std::size(kMemoryNames) == u32(GpuMemory::Count));
+
+} // namespace
+
+const char*
+RenderStats::Name(Counter counter)
+{
+  return kCounterNames[u32(counter)];
+}
+
+const char*
+RenderStats::Name(GpuMemory category)
+{
+  return kMemoryNames[u32(category)];
+}
+
+void
+RenderStats::EndFrame(float frame_ms)
+{
+  for (u32 i = 0; i < u32(Counter::Count); ++i) {
+    last_[i] = current_[i].exchange(0, std::memory_order_relaxed);
+  }
+  frame_ms_[frames_ % kHistory] = frame_ms;
+  ++frames_;
+
+  // nearest rank over the window, 240 floats don't need anything smarter
+  float sorted[kHistory];
+  const u32 n = std::min(frames_, kHistory);
+  std::copy_n(frame_ms_, n, sorted);
+  std::sort(sorted, sorted + n);
+  auto rank = [&](float p) { return sorted[u32(p * float(n - 1) + .5f)]; };
+  percentiles_ = { rank(.5f), rank(.95f), rank(.99f) };
+
+  if (!g_csv.file.is_open() || frames_ % g_csv.every != 0) {
+    return;
+  }
+  auto& f = g_csv.file;
+  f << frames_ << ',' << frame_ms << ',' << percentiles_.p50 << ','
+    << percentiles_.p95 << ',' << percentiles_.p99;
+  for (u64 value : last_) {
+    f << ',' << value;
+  }
+  for (const auto& bytes : memory_) {
+    f << ',' << bytes.load(std::memory_order_relaxed);
+  }
+  f << '\n';
+  f.flush(); // soak runs get killed rather than closed
+}
+
+std::span<const float>
+RenderStats::FrameTimes(u32& offset)
+{
+  const u32 n = std::min(frames_, kHistory);
+  offset = frames_ < kHistory ? 0 : frames_ % kHistory;
+  return { frame_ms_, n };
+}
+
+bool
+RenderStats::StartCsv(const char* path, u32 every_n_frames)
+{
+  StopCsv();
+  g_csv.file.open(path, std::ios::out | std::ios::trunc);
+  if (!g_csv.file) {
+    LOG_ERROR("Couldn't open {} for stats", path);
+    return false;
+  }
+  g_csv.every = std::max(every_n_frames, 1u);
+  auto& f = g_csv.file;
+  f << "frame,frame_ms,p50_ms,p95_ms,p99_ms";
+  for (const char* name : kCounterNames) {
+    f << ',' << name;
+  }
+  for (const char* name : kMemoryNames) {
+    f << ",mem_" << name;
+  }
+  f << '\n';
+  LOG_INFO("Streaming stats to {} every {} frames", path, g_csv.every);
+  return true;
+}
+
+void
+RenderStats::StopCsv()
+{
+  if (g_csv.file.is_open()) {
+    g_csv.file.close();
+  }
+}
+
+bool
+RenderStats::Streaming()
+{
+  return g_csv.file.is_open();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <span>
+
+#include "types.h"
+
+// Per frame counters, restarted by RenderStats::EndFrame()
+enum class Counter : u8
+{
+  Draws,
+  IndirectDraws, // their triangles aren't known on the CPU
+  Triangles,
+  PipelineBinds,
+  Binds, // every bind, pipelines included
+  ElidedBinds,
+  Instances,
+  VisibleInstances, // uploaded, everything when culling on the GPU
+  CulledInstances,
+  Lights,
+  UploadBytes,
+  Count,
+};
+
+// Bytes currently allocated on the GPU
+enum class GpuMemory : u8
+{
+  Geometry,
+  Textures,
+  RenderTargets,
+  Instances,
+  Lighting,
+  Culling,
+  Staging, // transfer buffers that are kept around
+  Count,
+};
+
+struct FrameTimePercentiles
+{
+  float p50{ 0.f };
+  float p95{ 0.f };
+  float p99{ 0.f };
+};
+
+// What a frame costs. Counters and memory are atomics so the draw and upload
+// paths can feed them from any thread; the rest belongs to the main thread.
+//
+// With streaming on, every Nth EndFrame() appends a CSV row: the frame time
+// percentiles of the rolling window, last frame's counters and the memory.
+class RenderStats
+{
+public:
+  static constexpr u32 kHistory = 240; // frames in the rolling window
+
+  static void Add(Counter counter, u64 n)
+  {
+    current_[u32(counter)].fetch_add(n, std::memory_order_relaxed);
+  }
+  // Negative when freed
+  static void Allocated(GpuMemory category, i64 bytes)
+  {
+    memory_[u32(category)].fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  static void EndFrame(float frame_ms);
+
+  static u64 Last(Counter counter) { return last_[u32(counter)]; }
+  static i64 Memory(GpuMemory category)
+  {
+    return memory_[u32(category)].load(std::memory_order_relaxed);
+  }
+  static const char* Name(Counter counter);
+  static const char* Name(GpuMemory category);
+
+  // Oldest first from `offset`, as ImGui::PlotLines takes it
+  static std::span<const float> FrameTimes(u32& offset);
+  static FrameTimePercentiles Percentiles() { return percentiles_; }
+
+  static bool StartCsv(const char* path, u32 every_n_frames);
+  static void StopCsv();
+  static bool Streaming();
+
+private:
+  static inline std::atomic<u64> current_[u32(Counter::Count)]{};
+  static inline std::atomic<i64> memory_[u32(GpuMemory::Count)]{};
+  static inline u64 last_[u32(Counter::Count)]{};
+  static inline float frame_ms_[kHistory]{};
+  static inline u32 frames_{ 0 }; // ever ended
+  static inline FrameTimePercentiles percentiles_{};
+};
@@ -0,0 +1,98 @@
+#include "render_stats_gui.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <imgui/imgui.h>
+
+#include "src/render_stats.h"
+
+namespace {
+
+constexpr u32 kBuckets = 32;
+constexpr const char* kCsvPath = "stats.csv";
+
+} // namespace
+
+void
+RenderStatsPanel()
+{
+  u32 offset = 0;
+  const auto times = RenderStats::FrameTimes(offset);
+  if (times.empty()) {
+    ImGui::TextDisabled("No frame yet");
+    return;
+  }
+  const auto [lo, hi] = std::minmax_element(times.begin(), times.end());
+  const FrameTimePercentiles p = RenderStats::Percentiles();
+  ImGui::Text("p50 %.2f ms  p95 %.2f ms  p99 %.2f ms", p.p50, p.p95, p.p99);
+  ImGui::PlotLines("Frame (ms)",
+                   times.data(),
+                   int(times.size()),
+                   int(offset),
+                   nullptr,
+                   0.f,
+                   *hi * 1.1f,
+                   ImVec2(0.f, 60.f));
+
+  // distribution over [min, max] of the window
+  float buckets[kBuckets]{};
+  const float range = std::max(*hi - *lo, 1e-3f);
+  for (float ms : times) {
+    const u32 b = std::min(u32((ms - *lo) / range * kBuckets), kBuckets - 1);
+    buckets[b] += 1.f;
+  }
+  char label[64];
+  snprintf(label, sizeof(label), "%.2f - %.2f ms", *lo, *hi);
+  ImGui::PlotHistogram("##distribution",
+                       buckets,
+                       int(kBuckets),
+                       0,
+                       label,
+                       0.f,
+                       FLT_MAX,
+                       ImVec2(0.f, 60.f));
+
+  if (ImGui::TreeNodeEx("Counters", ImGuiTreeNodeFlags_DefaultOpen)) {
+    for (u32 i = 0; i < u32(Counter::Count); ++i) {
+      const auto counter = Counter(i);
+      ImGui::Text("%s: %llu",
+                  RenderStats::Name(counter),
+                  (unsigned long long)RenderStats::Last(counter));
+    }
+    ImGui::TreePop();
+  }
+  if (ImGui::TreeNodeEx("GPU memory", ImGuiTreeNodeFlags_DefaultOpen)) {
+    i64 total = 0;
+    for (u32 i = 0; i < u32(GpuMemory::Count); ++i) {
+      const auto category = GpuMemory(i);
+      const i64 bytes = RenderStats::Memory(category);
+      total += bytes;
+      ImGui::Text("%s: %.2f MiB",
+                  RenderStats::Name(category),
+                  double(bytes) / (1024. * 1024.));
+    }
+    ImGui::Text("total: %.2f MiB", double(total) / (1024. * 1024.));
+    ImGui::TreePop();
+  }
+
+  static int every = 60;
+  bool streaming = RenderStats::Streaming();
+  if (ImGui::Checkbox("Stream CSV", &streaming)) {
+    if (streaming) {
+      RenderStats::StartCsv(kCsvPath, u32(every));
+    } else {
+      RenderStats::StopCsv();
+    }
+  }
+  ImGui::SameLine();
+  ImGui::BeginDisabled(streaming);
+  ImGui::SetNextItemWidth(100.f);
+  if (ImGui::InputInt("Every N frames", &every)) {
+    every = std::max(every, 1);
+  }
+  ImGui::EndDisabled();
+  if (streaming) {
+    ImGui::TextDisabled("Writing %s", kCsvPath);
+  }
+}
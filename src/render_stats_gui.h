@@ -0,0 +1,7 @@
+#pragma once
+
+// RenderStats in the current ImGui window: frame time plot, histogram and
+// percentiles over the rolling window, last frame's counters, GPU memory and
+// the CSV streaming toggle.
+void
+RenderStatsPanel();
@@ -0,0 +1,235 @@
+#include "replay.h"
+
+#include <cstring>
+#include <iterator>
+
+#include "src/logger.h"
+
+namespace {
+
+constexpr char kMagic[4] = { 'S', 'C', 'R', 'P' };
+constexpr u32 kVersion = 1;
+constexpr u8 kSettingsChanged = 1;
+
+struct Header
+{
+  char magic[4];
+  u32 version;
+  u32 settings_size;
+  float step;
+};
+
+// Bytes of `evt` worth keeping, 0 for the ones that aren't replayed
+u16
+EventSize(const SDL_Event& evt)
+{
+  switch (evt.type) {
+    case SDL_EVENT_QUIT:
+      return sizeof(SDL_QuitEvent);
+    case SDL_EVENT_KEY_DOWN:
+    case SDL_EVENT_KEY_UP:
+      return sizeof(SDL_KeyboardEvent);
+    case SDL_EVENT_MOUSE_MOTION:
+      return sizeof(SDL_MouseMotionEvent);
+    case SDL_EVENT_MOUSE_BUTTON_DOWN:
+    case SDL_EVENT_MOUSE_BUTTON_UP:
+      return sizeof(SDL_MouseButtonEvent);
+    case SDL_EVENT_MOUSE_WHEEL:
+      return sizeof(SDL_MouseWheelEvent);
+    default:
+      if (evt.type >= SDL_EVENT_WINDOW_FIRST &&
+          evt.type <= SDL_EVENT_WINDOW_LAST) {
+        return sizeof(SDL_WindowEvent);
+      }
+      return 0;
+  }
+}
+
+template<typename T>
+void
+Write(std::ofstream& file, const T& value)
+{
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Reads from a whole file in memory, false once it runs out
+struct Cursor
+{
+  const std::vector<char>& data;
+  size_t offset{ 0 };
+
+  bool Read(void* out, size_t size)
+  {
+    if (data.size() - offset < size) {
+      return false;
+    }
+    std::memcpy(out, data.data() + offset, size);
+    offset += size;
+    return true;
+  }
+  template<typename T>
+  bool Read(T& out)
+  {
+    return Read(&out, sizeof(T));
+  }
+  bool AtEnd() const { return offset == data.size(); }
+};
+
+// One frame into `settings`, kept from the previous frame when unchanged,
+// and `events`. The first frame must carry its settings.
+bool
+ReadFrame(Cursor& in,
+          bool first,
+          ReplaySettings& settings,
+          std::vector<SDL_Event>& events)
+{
+  u8 flags = 0;
+  if (!in.Read(flags)) {
+    return false;
+  }
+  if ((flags & kSettingsChanged) != 0) {
+    if (!in.Read(settings)) {
+      return false;
+    }
+  } else if (first) {
+    return false;
+  }
+  u16 count = 0;
+  if (!in.Read(count)) {
+    return false;
+  }
+  for (u16 e = 0; e < count; ++e) {
+    u16 size = 0;
+    SDL_Event evt{};
+    if (!in.Read(size) || size > sizeof(SDL_Event) || !in.Read(&evt, size)) {
+      return false;
+    }
+    events.push_back(evt);
+  }
+  return true;
+}
+
+} // namespace
+
+bool
+ReplayWriter::Open(const char* path, float step)
+{
+  Close();
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_) {
+    LOG_ERROR("Couldn't open {} for recording", path);
+    return false;
+  }
+  Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.settings_size = sizeof(ReplaySettings);
+  header.step = step;
+  Write(file_, header);
+  frames_ = 0;
+  LOG_INFO("Recording to {}", path);
+  return true;
+}
+
+bool
+ReplayWriter::Close()
+{
+  if (!file_.is_open()) {
+    return true;
+  }
+  file_.close();
+  if (!file_) {
+    LOG_ERROR("Couldn't write the recording");
+    return false;
+  }
+  LOG_INFO("Recorded {} frames", frames_);
+  return true;
+}
+
+void
+ReplayWriter::Frame(const ReplaySettings& settings,
+                    std::span<const SDL_Event> events)
+{
+  const bool changed = frames_ == 0 || !(settings == last_);
+  Write(file_, changed ? kSettingsChanged : u8(0));
+  if (changed) {
+    Write(file_, settings);
+    last_ = settings;
+  }
+
+  u16 count = 0;
+  for (const auto& evt : events) {
+    count += EventSize(evt) != 0 && count != UINT16_MAX;
+  }
+  Write(file_, count);
+  for (const auto& evt : events) {
+    const u16 size = EventSize(evt);
+    if (size == 0 || count-- == 0) {
+      continue;
+    }
+    Write(file_, size);
+    file_.write(reinterpret_cast<const char*>(&evt), size);
+  }
+  ++frames_;
+}
+
+bool
+ReplayReader::Open(const char* path)
+{
+  settings_.clear();
+  events_.clear();
+  event_begin_.clear();
+  position_ = 0;
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    LOG_ERROR("Couldn't open recording {}", path);
+    return false;
+  }
+  const std::vector<char> data{ std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>() };
+  Cursor in{ data };
+  Header header{};
+  if (!in.Read(header) ||
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion ||
+      header.settings_size != sizeof(ReplaySettings) || !(header.step > 0.f)) {
+    LOG_ERROR("{} isn't a recording of this build", path);
+    return false;
+  }
+
+  // a killed recording ends in a partial frame, keep the whole ones
+  ReplaySettings current{};
+  while (!in.AtEnd()) {
+    const u32 begin = static_cast<u32>(events_.size());
+    if (!ReadFrame(in, settings_.empty(), current, events_)) {
+      events_.resize(begin);
+      LOG_WARN("{} ends in a partial frame after {}", path, Frames());
+      break;
+    }
+    settings_.push_back(current);
+    event_begin_.push_back(begin);
+  }
+  if (settings_.empty()) {
+    LOG_ERROR("No frames in recording {}", path);
+    return false;
+  }
+  event_begin_.push_back(static_cast<u32>(events_.size()));
+  step_ = header.step;
+  LOG_INFO("Replaying {} frames from {}", Frames(), path);
+  return true;
+}
+
+bool
+ReplayReader::Next(ReplaySettings& settings, std::span<const SDL_Event>& events)
+{
+  if (position_ >= Frames()) {
+    return false;
+  }
+  settings = settings_[position_];
+  events = std::span<const SDL_Event>(events_).subspan(
+    event_begin_[position_],
+    event_begin_[position_ + 1] - event_begin_[position_]);
+  ++position_;
+  return true;
+}
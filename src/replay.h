@@ -0,0 +1,84 @@
+#pragma once
+
+#include <SDL3/SDL_events.h>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+#include "src/boids.h"
+#include "src/clustered_lighting.h"
+#include "src/instances.h"
+#include "types.h"
+
+// Time step recordings are replayed at
+constexpr float kReplayStep = 1.f / 60.f;
+
+// What a frame renders with that the GUI can change. Written as raw bytes,
+// the header's size check rejects recordings of another layout. Compared
+// field by field: padding is whatever copies left there, see
+// CubeProgram::CaptureSettings.
+struct ReplaySettings
+{
+  glm::vec3 camera_position{};
+  glm::vec3 camera_target{};
+  float rotation_speeds[3]{};
+  InstancingCfg instancing{};
+  u32 objects{ 0 }; // scene objects on top of the grid
+  BoidsCfg boids{};
+  LightingCfg lighting{};
+  float render_scale{ 1.f }; // dynamic resolution is off while replaying
+  u8 cull_mode{ 0 };         // CullMode
+  bool wireframe{ false };
+  bool depth_prepass{ false };
+
+  bool operator==(const ReplaySettings&) const = default;
+};
+static_assert(std::is_trivially_copyable_v<ReplaySettings>);
+
+// Records a run, one Frame() per drawn frame.
+//
+// File: a header with the time step replays run at, then per frame a flags
+// byte, the settings when they changed since the previous frame and the SDL
+// events polled before it. Events holding pointers (text input, drops) are
+// left out.
+class ReplayWriter
+{
+public:
+  bool Open(const char* path, float step);
+  bool Close();
+  bool IsOpen() const { return file_.is_open(); }
+
+  void Frame(const ReplaySettings& settings, std::span<const SDL_Event> events);
+  u32 Frames() const { return frames_; }
+
+private:
+  std::ofstream file_;
+  ReplaySettings last_{};
+  u32 frames_{ 0 };
+};
+
+// A recording, parsed whole when opened.
+class ReplayReader
+{
+public:
+  bool Open(const char* path);
+  bool IsOpen() const { return !settings_.empty(); }
+
+  float Step() const { return step_; }
+  u32 Frames() const { return static_cast<u32>(settings_.size()); }
+  const ReplaySettings& First() const { return settings_.front(); }
+  // Frames read by Next() so far
+  u32 Position() const { return position_; }
+  void Rewind() { position_ = 0; }
+
+  // False past the last frame
+  bool Next(ReplaySettings& settings, std::span<const SDL_Event>& events);
+
+private:
+  float step_{ 0.f };
+  u32 position_{ 0 };
+  std::vector<ReplaySettings> settings_;
+  std::vector<SDL_Event> events_;
+  std::vector<u32> event_begin_; // per frame, plus the end
+};
@@ -0,0 +1,129 @@
+#include "scene_objects.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "src/logger.h"
+#include "src/profiler.h"
+
+namespace {
+
+constexpr float kMinSpeed = 1.f; // units per second
+constexpr float kMaxSpeed = 4.f;
+
+// Yaw only, facing along `v` in the XZ plane like the grid's fish
+glm::vec4
+Heading(const glm::vec3& v)
+{
+  const float half_yaw = std::atan2(v.x, v.z) * .5f;
+  return { 0.f, std::sin(half_yaw), 0.f, std::cos(half_yaw) };
+}
+
+} // namespace
+
+void
+SceneObjects::Resize(u32 count, float origin, float size)
+{
+  origin_ = origin;
+  size_ = size;
+  if (count == Count()) {
+    return;
+  }
+  while (Count() > count) {
+    store_.Destroy(objects_.back());
+    objects_.pop_back();
+  }
+  objects_.reserve(count);
+  while (Count() < count) {
+    const u32 seed = spawned_++ * 8;
+    const Entity e = store_.Create(kMask);
+    auto* transform = store_.Get<TransformComponent>(e);
+    transform->position = glm::vec3{ origin + Hash01(seed + 0) * size,
+                                     origin + Hash01(seed + 1) * size,
+                                     origin + Hash01(seed + 2) * size };
+    // mostly horizontal, fish don't swim straight up
+    const float angle = Hash01(seed + 3) * kTwoPi;
+    const glm::vec3 dir = glm::normalize(glm::vec3{
+      std::cos(angle), Hash01(seed + 4) - .5f, std::sin(angle) });
+    const float speed = kMinSpeed + Hash01(seed + 5) * (kMaxSpeed - kMinSpeed);
+    store_.Get<VelocityComponent>(e)->linear = dir * speed;
+    transform->rotation = Heading(dir);
+
+    auto* render = store_.Get<RenderComponent>(e);
+    render->phase = Hash01(seed + 6) * kTwoPi;
+    render->speed = 1.f + Hash01(seed + 7) * .5f;
+    objects_.push_back(e);
+  }
+  LOG_DEBUG("Scene objects resized to {}", count);
+}
+
+void
+SceneObjects::Clear()
+{
+  store_.Clear();
+  objects_.clear();
+  spawned_ = 0;
+}
+
+void
+SceneObjects::Update(float time,
+                     float dt,
+                     float radius,
+                     JobSystem& jobs,
+                     InstanceData* out)
+{
+  PROFILE_ZONE("SceneObjects::Update");
+  const glm::vec3 lo{ origin_ };
+  const glm::vec3 hi{ origin_ + size_ };
+  // movement and the render data in one pass over each chunk
+  store_.ForEach<TransformComponent,
+                 VelocityComponent,
+                 BoundsComponent,
+                 const RenderComponent>(
+    jobs,
+    [&](u32 first,
+        u32 count,
+        const Entity*,
+        TransformComponent* transforms,
+        VelocityComponent* velocities,
+        BoundsComponent* bounds,
+        const RenderComponent* renders) {
+      for (u32 i = 0; i < count; ++i) {
+        TransformComponent& t = transforms[i];
+        glm::vec3& v = velocities[i].linear;
+        t.position += v * dt;
+        bool turned = false;
+        for (int axis = 0; axis < 3; ++axis) {
+          if ((t.position[axis] < lo[axis] && v[axis] < 0.f) ||
+              (t.position[axis] > hi[axis] && v[axis] > 0.f)) {
+            v[axis] = -v[axis];
+            turned = true;
+          }
+        }
+        if (turned) {
+          t.rotation = Heading(v);
+        }
+        bounds[i] = BoundsComponent{ t.position, radius * t.scale };
+        const RenderComponent& r = renders[i];
+        out[first + i] =
+          ToInstance(t.position, t.rotation, t.scale, r.phase, r.speed, time);
+      }
+    });
+}
+
+InstanceData
+SceneObjects::Instance(float time, u32 n)
+{
+  const Entity e = store_.Nth(kMask, n);
+  const auto* transform = store_.Get<TransformComponent>(e);
+  const auto* render = store_.Get<RenderComponent>(e);
+  if (transform == nullptr || render == nullptr) {
+    return InstanceData{};
+  }
+  return ToInstance(transform->position,
+                    transform->rotation,
+                    transform->scale,
+                    render->phase,
+                    render->speed,
+                    time);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include "src/entities.h"
+#include "src/instances.h"
+#include "src/job_system.h"
+#include "types.h"
+
+// Free moving fish on top of the instance grid, one entity each. They swim in
+// a straight line and bounce off the grid's box.
+class SceneObjects
+{
+public:
+  static constexpr ComponentMask kMask =
+    MaskOf<TransformComponent,
+           BoundsComponent,
+           RenderComponent,
+           VelocityComponent>();
+
+  // Spawns new objects or destroys the newest ones until there are `count`,
+  // inside the box [origin, origin + size] on every axis.
+  void Resize(u32 count, float origin, float size);
+  u32 Count() const { return static_cast<u32>(objects_.size()); }
+  // Destroys them all, the next ones spawn like the first ones did
+  void Clear();
+
+  // Moves every object by `dt` and writes them to `out`, which must hold
+  // Count() elements, animated at `time`. `radius` is an unscaled object's
+  // bounding sphere. Work is split across `jobs` by chunk.
+  void Update(float time,
+              float dt,
+              float radius,
+              JobSystem& jobs,
+              InstanceData* out);
+  // The one Update wrote `n`th, as of the last Update
+  InstanceData Instance(float time, u32 n);
+
+  EntityStats Stats() const { return store_.Stats(); }
+
+private:
+  EntityStore store_;
+  std::vector<Entity> objects_; // oldest first
+  u32 spawned_{ 0 };            // ever, seeds the next one
+  float origin_{ 0.f };
+  float size_{ 0.f };
+};
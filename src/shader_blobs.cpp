@@ -0,0 +1,26 @@
+#include "shader_blobs.h"
+
+#include <cstring>
+
+#if defined(SDLCUBE_EMBEDDED_SHADERS)
+// generated by tools/shader_embed.cpp
+extern const ShaderBlob kShaderBlobs[];
+extern const size_t kShaderBlobCount;
+#endif
+
+const ShaderBlob*
+FindShaderBlob(const char* path)
+{
+#if defined(SDLCUBE_EMBEDDED_SHADERS)
+  const char* name = std::strrchr(path, '/');
+  name = name != nullptr ? name + 1 : path;
+  for (size_t i = 0; i < kShaderBlobCount; ++i) {
+    if (std::strcmp(kShaderBlobs[i].name, name) == 0) {
+      return &kShaderBlobs[i];
+    }
+  }
+#else
+  (void)path;
+#endif
+  return nullptr;
+}
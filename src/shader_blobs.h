@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+#include "src/spirv_reflect.h"
+#include "types.h"
+
+// A SPIR-V module compiled and reflected at build time.
+struct ShaderBlob
+{
+  const char* name; // file name, e.g. "vert.vert.spv"
+  const u8* code;
+  size_t size;
+  ShaderReflection reflection;
+};
+
+// Looks up the blob for `path` by its file name. nullptr when the build has
+// no embedded shaders or none with that name.
+const ShaderBlob*
+FindShaderBlob(const char* path);
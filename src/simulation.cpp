@@ -0,0 +1,158 @@
+#include "simulation.h"
+
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <glm/common.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "src/logger.h"
+#include "src/profiler.h"
+
+namespace {
+
+// ticks the thread may fall behind before it skips ahead instead
+constexpr double kMaxLagTicks = 8.;
+
+// Shortest way from `a` to `b` on the circle
+float
+LerpAngle(float a, float b, float t)
+{
+  const float pi = glm::pi<float>();
+  float d = b - a;
+  if (d > pi) {
+    d -= glm::two_pi<float>();
+  } else if (d < -pi) {
+    d += glm::two_pi<float>();
+  }
+  return a + d * t;
+}
+
+} // namespace
+
+Simulation::~Simulation()
+{
+  Stop();
+}
+
+void
+Simulation::Reset(const SceneState& state)
+{
+  state_ = state;
+  ticks_ = 0;
+  empty_ = SceneSnapshot{ state, state, 0, 0.f };
+  snapshots_.Reset(empty_);
+  latest_ = &empty_;
+}
+
+bool
+Simulation::Start(double time, float hz)
+{
+  LOG_TRACE("Simulation::Start");
+  if (Running()) {
+    return true;
+  }
+  if (!(hz > 0.f)) {
+    LOG_ERROR("Invalid simulation rate {} Hz", hz);
+    return false;
+  }
+  hz_ = hz;
+  // renders the current state until the first tick
+  state_.time = time;
+  Reset(state_);
+  running_ = true;
+  thread_ = std::thread([this, time] { Run(time); });
+  LOG_DEBUG("Simulation ticks at {} Hz", hz);
+  return true;
+}
+
+void
+Simulation::Stop()
+{
+  if (!Running()) {
+    return;
+  }
+  running_ = false;
+  thread_.join();
+}
+
+void
+Simulation::Run(double time)
+{
+  Profiler::SetThreadName("Simulation");
+  Uint64 next = SDL_GetTicksNS();
+  while (running_.load(std::memory_order_acquire)) {
+    const float dt = 1.f / hz_.load(std::memory_order_relaxed);
+    time += dt;
+    next += Uint64(double(dt) * 1e9);
+    Tick(time, dt);
+
+    const Uint64 now = SDL_GetTicksNS();
+    if (next > now) {
+      SDL_DelayNS(next - now);
+    } else if (double(now - next) > kMaxLagTicks * double(dt) * 1e9) {
+      // stalled, e.g. a debugger: skip ahead instead of ticking to catch up
+      time += double(now - next) / 1e9;
+      next = now;
+    }
+  }
+}
+
+void
+Simulation::Advance(double time, float dt)
+{
+  Tick(time, dt);
+}
+
+void
+Simulation::Tick(double time, float dt)
+{
+  PROFILE_ZONE("Simulation tick");
+  const Uint64 start = SDL_GetTicksNS();
+  const SimulationInput& input = inputs_.Read();
+  SceneSnapshot& snapshot = snapshots_.Back();
+  snapshot.previous = state_;
+
+  state_.time = time;
+  for (int i = 0; i < 3; ++i) {
+    if (input.rotation_speeds[i] != 0.f) {
+      state_.rotation[i] = glm::mod(state_.rotation[i] +
+                                      dt * input.rotation_speeds[i],
+                                    glm::two_pi<float>());
+    }
+  }
+  state_.camera_position = input.camera_position;
+  state_.camera_target = input.camera_target;
+
+  snapshot.current = state_;
+  snapshot.tick = ++ticks_;
+  snapshot.tick_ms = float(SDL_GetTicksNS() - start) / 1e6f;
+  snapshots_.Publish();
+}
+
+void
+Simulation::SetInput(const SimulationInput& input)
+{
+  inputs_.Back() = input;
+  inputs_.Publish();
+}
+
+SceneState
+Simulation::Sample(double time)
+{
+  latest_ = &snapshots_.Read();
+  const SceneState& a = latest_->previous;
+  const SceneState& b = latest_->current;
+  if (b.time <= a.time) {
+    return b;
+  }
+  const float t =
+    float(std::clamp((time - a.time) / (b.time - a.time), 0., 1.));
+  SceneState s;
+  s.time = a.time + (b.time - a.time) * double(t);
+  for (int i = 0; i < 3; ++i) {
+    s.rotation[i] = LerpAngle(a.rotation[i], b.rotation[i], t);
+  }
+  s.camera_position = glm::mix(a.camera_position, b.camera_position, t);
+  s.camera_target = glm::mix(a.camera_target, b.camera_target, t);
+  return s;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <glm/glm.hpp>
+#include <thread>
+
+#include "src/triple_buffer.h"
+#include "types.h"
+
+// Everything a tick moves, as of its end
+struct SceneState
+{
+  double time{ 0. };         // seconds, in the render loop's clock
+  glm::vec3 rotation{ 0.f }; // cube angles around X, Y, Z, radians
+  glm::vec3 camera_position{ 0.f, 1.f, -4.f };
+  glm::vec3 camera_target{ 0.f };
+};
+
+// What the render thread's GUI steers the simulation with
+struct SimulationInput
+{
+  glm::vec3 rotation_speeds{ 0.f, 1.f, 0.f }; // radians per second
+  glm::vec3 camera_position{ 0.f, 1.f, -4.f };
+  glm::vec3 camera_target{ 0.f };
+};
+
+// The two latest ticks, rendering interpolates between them
+struct SceneSnapshot
+{
+  SceneState previous;
+  SceneState current;
+  u64 tick{ 0 };
+  float tick_ms{ 0.f }; // CPU time of the current tick
+};
+
+// Moves the scene at a fixed tick rate, on a thread of its own or stepped by
+// the caller, and publishes immutable snapshots the render thread samples.
+// Neither side ever waits on the other: inputs and snapshots both go through
+// triple buffers, a slow frame or a swapchain wait only means some snapshots
+// are never rendered.
+class Simulation
+{
+public:
+  ~Simulation();
+
+  // Starts over from `state`, the thread must be stopped.
+  void Reset(const SceneState& state);
+
+  // Ticks `hz` times per second until Stop(), the first tick at `time`.
+  bool Start(double time, float hz);
+  void Stop();
+  bool Running() const { return thread_.joinable(); }
+  void SetRate(float hz) { hz_ = hz; }
+  float Rate() const { return hz_; }
+
+  // One tick of `dt` ending at `time` on the calling thread, for runs that
+  // must be reproducible. The thread must be stopped.
+  void Advance(double time, float dt);
+
+  // Render thread:
+  void SetInput(const SimulationInput& input);
+  // The latest ticks interpolated at `time`, clamped to them. Render one
+  // tick behind the clock to land between them.
+  SceneState Sample(double time);
+  // As of the last Sample
+  const SceneSnapshot& Latest() const { return *latest_; }
+
+private:
+  void Run(double time);
+  void Tick(double time, float dt);
+
+private:
+  TripleBuffer<SceneSnapshot> snapshots_;
+  TripleBuffer<SimulationInput> inputs_;
+  const SceneSnapshot* latest_{ &empty_ };
+  SceneSnapshot empty_;
+  SceneState state_; // simulation side only
+  u64 ticks_{ 0 };
+  std::thread thread_;
+  std::atomic<bool> running_{ false };
+  std::atomic<float> hz_{ 120.f };
+};
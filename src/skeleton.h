@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// A node's transform relative to its parent
+struct NodeTransform {
+  glm::vec3 Translation{ 0.f };
+  glm::vec4 Rotation{ 0.f, 0.f, 0.f, 1.f }; // quaternion, xyzw
+  glm::vec3 Scale{ 1.f };
+};
+
+enum class AnimationTarget : u8 { Translation, Rotation, Scale };
+
+// Keyframes of one property of one node, linear unless Step. Cubic spline
+// channels keep their values and lose their tangents.
+struct AnimationChannel {
+  u32 Node;
+  AnimationTarget Target;
+  bool Step{ false };
+  std::vector<float> Times;       // seconds, ascending
+  std::vector<glm::vec4> Values;  // xyz for translations and scales
+};
+
+struct AnimationClip {
+  std::string Name;
+  float Duration{ 0.f };
+  std::vector<AnimationChannel> Channels;
+};
+
+// Every node of the file, parents before their children, and the first skin's
+// joints among them.
+struct Skeleton {
+  static constexpr u32 kNoParent = UINT32_MAX;
+
+  std::vector<u32> Parents;
+  std::vector<NodeTransform> Rest;
+  std::vector<u32> Joints; // node of every joint
+  std::vector<glm::mat4> InverseBinds; // mesh space to joint space, per joint
+  std::vector<AnimationClip> Clips;
+
+  bool Animated() const { return !Joints.empty() && !Clips.empty(); }
+};
@@ -0,0 +1,526 @@
+#include "skinning.h"
+
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "src/logger.h"
+#include "src/profiler.h"
+#include "src/render_stats.h"
+#include "util.h"
+
+namespace {
+
+// Poses spread over every clip when looking for how far the vertices reach
+constexpr u32 kBoundsPoses = 16;
+constexpr Uint32 kThreads = 64; // skin.comp's local size
+// Validate's tolerance, relative to the palette's or the bounds' scale
+constexpr float kTolerance = 1e-4f;
+
+// skin.comp's input vertex (std430)
+struct GpuSkinVertex
+{
+  float position[4];
+  Uint32 joints[4];
+  float weights[4];
+};
+
+// Matches uSkin in skin.comp (std140)
+struct SkinParams
+{
+  Uint32 vertex_count;
+  Uint32 joint_count;
+  Uint32 poses;
+  Uint32 pad;
+};
+
+u32
+VertexCount(const GLTFLoader& loader)
+{
+  size_t count = 0;
+  for (const auto& mesh : loader.Meshes()) {
+    count += mesh.vertices_.size();
+  }
+  return static_cast<u32>(count);
+}
+
+// Largest difference between two matrices, relative to b's largest element
+float
+MatrixError(const glm::mat4& a, const glm::mat4& b)
+{
+  float scale = 1.f;
+  float error = 0.f;
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      scale = std::max(scale, std::abs(b[c][r]));
+      error = std::max(error, std::abs(a[c][r] - b[c][r]));
+    }
+  }
+  return error / scale;
+}
+
+} // namespace
+
+Skinning::Skinning(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+Skinning::~Skinning()
+{
+  const i64 joints = stats_.joints;
+  const i64 vertices = stats_.vertices;
+  if (vertices_ != nullptr) {
+    RenderStats::Allocated(GpuMemory::Geometry,
+                           -vertices * i64(sizeof(GpuSkinVertex)));
+  }
+  if (palette_buffer_ != nullptr && palette_upload_ != nullptr) {
+    // Init() counted them
+    const i64 bytes = i64(kMaxPoses) * joints * i64(sizeof(glm::mat4));
+    RenderStats::Allocated(GpuMemory::Geometry, -bytes);
+    RenderStats::Allocated(GpuMemory::Staging, -bytes);
+  }
+  RenderStats::Allocated(GpuMemory::Geometry,
+                         -i64(skinned_poses_) * vertices * 16);
+  auto* Device = device_;
+  RELEASE_IF(pipeline_, SDL_ReleaseGPUComputePipeline);
+  RELEASE_IF(vertices_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(palette_buffer_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(palette_upload_, SDL_ReleaseGPUTransferBuffer);
+  RELEASE_IF(skinned_, SDL_ReleaseGPUBuffer);
+}
+
+bool
+Skinning::Init(const GLTFLoader& loader,
+               const char* shader_path,
+               JobSystem& jobs)
+{
+  LOG_TRACE("Skinning::Init");
+  const Skeleton& skeleton = loader.Skin();
+  bool skinned = false;
+  for (const auto& mesh : loader.Meshes()) {
+    skinned = skinned || !mesh.skin_.empty();
+  }
+  bounds_ = loader.Bounds();
+  if (!skeleton.Animated() || !skinned) {
+    LOG_DEBUG("No animated skin, meshes stay in their rest pose");
+    return true;
+  }
+  skeleton_ = &skeleton;
+  stats_.joints = static_cast<u32>(skeleton.Joints.size());
+  stats_.vertices = VertexCount(loader);
+
+  pipeline_ = LoadComputePipeline(shader_path, device_);
+  if (pipeline_ == nullptr) {
+    LOG_ERROR("Couldn't load skinning compute shader at path {}", shader_path);
+    return false;
+  }
+  if (!UploadVertices(loader)) {
+    return false;
+  }
+
+  const Uint32 paletteSize =
+    kMaxPoses * stats_.joints * static_cast<Uint32>(sizeof(glm::mat4));
+  SDL_GPUBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    info.size = paletteSize;
+  }
+  palette_buffer_ = SDL_CreateGPUBuffer(device_, &info);
+  SDL_GPUTransferBufferCreateInfo trInfo{};
+  {
+    trInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    trInfo.size = paletteSize;
+  }
+  palette_upload_ = SDL_CreateGPUTransferBuffer(device_, &trInfo);
+  if (palette_buffer_ == nullptr || palette_upload_ == nullptr) {
+    LOG_ERROR("Couldn't create joint palette buffers: {}", GETERR);
+    return false;
+  }
+  RenderStats::Allocated(GpuMemory::Geometry, paletteSize);
+  RenderStats::Allocated(GpuMemory::Staging, paletteSize);
+
+  if (!ComputeBounds(loader, jobs)) {
+    return false;
+  }
+  active_ = true;
+  LOG_INFO("Skinning {} vertices with {} joints, {} clips",
+           stats_.vertices,
+           stats_.joints,
+           ClipCount());
+  return true;
+}
+
+u32
+Skinning::ClipCount() const
+{
+  return skeleton_ ? static_cast<u32>(skeleton_->Clips.size()) : 0;
+}
+
+const char*
+Skinning::ClipName(u32 clip) const
+{
+  return skeleton_->Clips[clip].Name.c_str();
+}
+
+bool
+Skinning::Update(const SkinningCfg& cfg, float time, JobSystem& jobs)
+{
+  if (!active_) {
+    return true;
+  }
+  PROFILE_ZONE("Skinning::Update");
+  const Uint64 start = SDL_GetTicksNS();
+  const u32 poses = std::clamp(cfg.poses, 1u, kMaxPoses);
+  const u32 clip = std::min(cfg.clip, ClipCount() - 1);
+  if (!Reserve(poses)) {
+    return false;
+  }
+  pose_.Build(*skeleton_, clip, poses, time, cfg.rate, jobs);
+  stats_.poses = poses;
+  stats_.cpu_ms = float(SDL_GetTicksNS() - start) / 1e6f;
+  return true;
+}
+
+void
+Skinning::Upload(SDL_GPUCopyPass* pass)
+{
+  const u32 joints = stats_.joints;
+  const u32 poses = pose_.Poses();
+  const Uint32 size =
+    poses * joints * static_cast<Uint32>(sizeof(glm::mat4));
+  auto* palettes = static_cast<glm::mat4*>(
+    SDL_MapGPUTransferBuffer(device_, palette_upload_, true));
+  if (palettes == nullptr) {
+    LOG_ERROR("Couldn't map joint palettes: {}", GETERR);
+    return;
+  }
+  // pose after pose, as skin.comp reads them
+  const auto& built = pose_.Palettes();
+  for (u32 k = 0; k < poses; ++k) {
+    for (u32 j = 0; j < joints; ++j) {
+      palettes[k * joints + j] = built[j * poses + k];
+    }
+  }
+  SDL_UnmapGPUTransferBuffer(device_, palette_upload_);
+
+  SDL_GPUTransferBufferLocation trLoc{ palette_upload_, 0 };
+  SDL_GPUBufferRegion reg{ palette_buffer_, 0, size };
+  SDL_UploadToGPUBuffer(pass, &trLoc, &reg, true);
+  RenderStats::Add(Counter::UploadBytes, size);
+}
+
+void
+Skinning::Dispatch(SDL_GPUCommandBuffer* cmdbuf)
+{
+  SkinParams params{};
+  params.vertex_count = stats_.vertices;
+  params.joint_count = stats_.joints;
+  params.poses = pose_.Poses();
+
+  // last frame's draws may still read the previous poses
+  SDL_GPUStorageBufferReadWriteBinding rw{};
+  rw.buffer = skinned_;
+  rw.cycle = true;
+
+  SDL_GPUComputePass* pass =
+    SDL_BeginGPUComputePass(cmdbuf, nullptr, 0, &rw, 1);
+  SDL_BindGPUComputePipeline(pass, pipeline_);
+  SDL_GPUBuffer* inputs[] = { vertices_, palette_buffer_ };
+  SDL_BindGPUComputeStorageBuffers(pass, 0, inputs, 2);
+  SDL_PushGPUComputeUniformData(cmdbuf, 0, &params, sizeof(params));
+  SDL_DispatchGPUCompute(
+    pass, (stats_.vertices + kThreads - 1) / kThreads, pose_.Poses(), 1);
+  SDL_EndGPUComputePass(pass);
+}
+
+const SkinningValidation&
+Skinning::Validate()
+{
+  LOG_TRACE("Skinning::Validate");
+  validation_ = SkinningValidation{};
+  const u32 poses = pose_.Poses();
+  if (!active_ || poses == 0) {
+    return validation_;
+  }
+  const u32 vertices = stats_.vertices;
+  const Uint32 inputSize =
+    vertices * static_cast<Uint32>(sizeof(GpuSkinVertex));
+  const Uint32 skinnedSize = poses * vertices * 16;
+
+  SDL_GPUTransferBufferCreateInfo trInfo{};
+  {
+    trInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+    trInfo.size = inputSize + skinnedSize;
+  }
+  SDL_GPUTransferBuffer* download =
+    SDL_CreateGPUTransferBuffer(device_, &trInfo);
+  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
+  if (download == nullptr || cmdbuf == nullptr) {
+    LOG_ERROR("Couldn't set up skinning validation: {}", GETERR);
+    if (cmdbuf != nullptr) {
+      SDL_CancelGPUCommandBuffer(cmdbuf);
+    }
+    if (download != nullptr) {
+      SDL_ReleaseGPUTransferBuffer(device_, download);
+    }
+    return validation_;
+  }
+
+  {
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
+    Upload(copyPass);
+    SDL_EndGPUCopyPass(copyPass);
+  }
+  Dispatch(cmdbuf);
+  {
+    // the inputs too, so the check skins what skin.comp read
+    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
+    SDL_GPUBufferRegion inputReg{ vertices_, 0, inputSize };
+    SDL_GPUTransferBufferLocation inputLoc{ download, 0 };
+    SDL_DownloadFromGPUBuffer(copyPass, &inputReg, &inputLoc);
+    SDL_GPUBufferRegion skinnedReg{ skinned_, 0, skinnedSize };
+    SDL_GPUTransferBufferLocation skinnedLoc{ download, inputSize };
+    SDL_DownloadFromGPUBuffer(copyPass, &skinnedReg, &skinnedLoc);
+    SDL_EndGPUCopyPass(copyPass);
+  }
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdbuf);
+  if (fence == nullptr) {
+    LOG_ERROR("Couldn't submit skinning validation: {}", GETERR);
+    SDL_ReleaseGPUTransferBuffer(device_, download);
+    return validation_;
+  }
+  SDL_WaitForGPUFences(device_, true, &fence, 1);
+  SDL_ReleaseGPUFence(device_, fence);
+
+  std::vector<GpuSkinVertex> input(vertices);
+  std::vector<glm::vec4> skinned(size_t(poses) * vertices);
+  {
+    auto* data = static_cast<const Uint8*>(
+      SDL_MapGPUTransferBuffer(device_, download, false));
+    if (data == nullptr) {
+      LOG_ERROR("Couldn't map skinning validation: {}", GETERR);
+      SDL_ReleaseGPUTransferBuffer(device_, download);
+      return validation_;
+    }
+    SDL_memcpy(input.data(), data, inputSize);
+    SDL_memcpy(skinned.data(), data + inputSize, skinnedSize);
+    SDL_UnmapGPUTransferBuffer(device_, download);
+  }
+  SDL_ReleaseGPUTransferBuffer(device_, download);
+
+  std::vector<glm::mat4> reference;
+  pose_.Reference(reference);
+  u32 mismatches = 0;
+  for (size_t i = 0; i < reference.size(); ++i) {
+    const float error = MatrixError(pose_.Palettes()[i], reference[i]);
+    validation_.palette_error = std::max(validation_.palette_error, error);
+    mismatches += !(error <= kTolerance); // NaNs too
+  }
+
+  // skin.comp's sum over the reference palettes
+  const u32 joints = stats_.joints;
+  const float radius = std::max(bounds_.Radius, 1e-6f);
+  for (u32 k = 0; k < poses; ++k) {
+    for (u32 v = 0; v < vertices; ++v) {
+      const GpuSkinVertex& in = input[v];
+      const glm::vec4 rest{
+        in.position[0], in.position[1], in.position[2], 1.f
+      };
+      const float total =
+        in.weights[0] + in.weights[1] + in.weights[2] + in.weights[3];
+      glm::vec3 expected{ rest };
+      if (total > 0.f) {
+        glm::mat4 m{ 0.f };
+        for (int i = 0; i < 4; ++i) {
+          // bad indices stay inside the palettes, and off the mark
+          const u32 joint = std::min(in.joints[i], joints - 1);
+          m += reference[size_t(joint) * poses + k] * in.weights[i];
+        }
+        expected = glm::vec3{ m * rest } / total;
+      }
+      const glm::vec3 gpu{ skinned[size_t(k) * vertices + v] };
+      const float error = glm::distance(gpu, expected) / radius;
+      validation_.vertex_error = std::max(validation_.vertex_error, error);
+      mismatches += !(error <= kTolerance);
+    }
+  }
+
+  validation_.ran = true;
+  validation_.mismatches = mismatches;
+  validation_.passed = mismatches == 0;
+  if (validation_.passed) {
+    LOG_INFO("Skinning matches CPU reference: {} vertices in {} poses",
+             vertices,
+             poses);
+  } else {
+    LOG_ERROR("Skinning differs from CPU reference: {} mismatches "
+              "(palettes {}, vertices {})",
+              mismatches,
+              validation_.palette_error,
+              validation_.vertex_error);
+  }
+  return validation_;
+}
+
+SkinningUniforms
+Skinning::Uniforms() const
+{
+  return SkinningUniforms{ stats_.vertices, pose_.Poses(), { 0, 0 } };
+}
+
+bool
+Skinning::UploadVertices(const GLTFLoader& loader)
+{
+  LOG_TRACE("Skinning::UploadVertices");
+  const Uint32 size =
+    stats_.vertices * static_cast<Uint32>(sizeof(GpuSkinVertex));
+  SDL_GPUBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    info.size = size;
+  }
+  SDL_GPUTransferBufferCreateInfo trInfo{};
+  {
+    trInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    trInfo.size = size;
+  }
+  vertices_ = SDL_CreateGPUBuffer(device_, &info);
+  SDL_GPUTransferBuffer* transferBuffer =
+    SDL_CreateGPUTransferBuffer(device_, &trInfo);
+  if (vertices_ == nullptr || transferBuffer == nullptr) {
+    LOG_ERROR("Couldn't create skin vertex buffers: {}", GETERR);
+    auto* Device = device_;
+    RELEASE_IF(vertices_, SDL_ReleaseGPUBuffer);
+    RELEASE_IF(transferBuffer, SDL_ReleaseGPUTransferBuffer);
+    return false;
+  }
+  RenderStats::Allocated(GpuMemory::Geometry, size);
+
+  auto* out = static_cast<GpuSkinVertex*>(
+    SDL_MapGPUTransferBuffer(device_, transferBuffer, false));
+  if (out == nullptr) {
+    LOG_ERROR("Couldn't map skin vertices: {}", GETERR);
+    SDL_ReleaseGPUTransferBuffer(device_, transferBuffer);
+    return false;
+  }
+  // unskinned meshes get no weights, skin.comp leaves them be
+  for (const auto& mesh : loader.Meshes()) {
+    for (size_t v = 0; v < mesh.vertices_.size(); ++v) {
+      GpuSkinVertex vertex{};
+      const float* pos = mesh.vertices_[v].pos;
+      vertex.position[0] = pos[0];
+      vertex.position[1] = pos[1];
+      vertex.position[2] = pos[2];
+      vertex.position[3] = 1.f;
+      if (!mesh.skin_.empty()) {
+        for (int i = 0; i < 4; ++i) {
+          vertex.joints[i] = mesh.skin_[v].Joints[i];
+          vertex.weights[i] = mesh.skin_[v].Weights[i];
+        }
+      }
+      *out++ = vertex;
+    }
+  }
+  SDL_UnmapGPUTransferBuffer(device_, transferBuffer);
+
+  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
+  if (cmdbuf == nullptr) {
+    LOG_ERROR("Couldn't acquire command buffer: {}", GETERR);
+    SDL_ReleaseGPUTransferBuffer(device_, transferBuffer);
+    return false;
+  }
+  SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
+  SDL_GPUTransferBufferLocation trLoc{ transferBuffer, 0 };
+  SDL_GPUBufferRegion reg{ vertices_, 0, size };
+  SDL_UploadToGPUBuffer(copyPass, &trLoc, &reg, false);
+  SDL_EndGPUCopyPass(copyPass);
+  const bool submitted = SDL_SubmitGPUCommandBuffer(cmdbuf);
+  SDL_ReleaseGPUTransferBuffer(device_, transferBuffer);
+  if (!submitted) {
+    LOG_ERROR("Couldn't submit skin vertex upload: {}", GETERR);
+    return false;
+  }
+  RenderStats::Add(Counter::UploadBytes, size);
+  return true;
+}
+
+// Skins every vertex on the CPU at a few poses of every clip. The bounds are
+// the box around all of them and the rest pose, the sphere the one around
+// that box.
+bool
+Skinning::ComputeBounds(const GLTFLoader& loader, JobSystem& jobs)
+{
+  LOG_TRACE("Skinning::ComputeBounds");
+  glm::vec3 min = bounds_.Min;
+  glm::vec3 max = bounds_.Max;
+  for (u32 c = 0; c < ClipCount(); ++c) {
+    pose_.Build(*skeleton_, c, kBoundsPoses, 0.f, 1.f, jobs);
+    for (const auto& mesh : loader.Meshes()) {
+      for (size_t v = 0; v < mesh.skin_.size(); ++v) {
+        const SkinWeights& skin = mesh.skin_[v];
+        const float total =
+          skin.Weights[0] + skin.Weights[1] + skin.Weights[2] +
+          skin.Weights[3];
+        if (!(total > 0.f)) {
+          continue; // in the rest pose's bounds already
+        }
+        const float* pos = mesh.vertices_[v].pos;
+        const glm::vec4 rest{ pos[0], pos[1], pos[2], 1.f };
+        for (u32 k = 0; k < kBoundsPoses; ++k) {
+          glm::vec3 p{ 0.f };
+          for (int i = 0; i < 4; ++i) {
+            const glm::mat4& m =
+              pose_.Palettes()[size_t(skin.Joints[i]) * kBoundsPoses + k];
+            p += glm::vec3{ m * rest } * skin.Weights[i];
+          }
+          p /= total;
+          min = glm::min(min, p);
+          max = glm::max(max, p);
+        }
+      }
+    }
+  }
+  bounds_.Min = min;
+  bounds_.Max = max;
+  bounds_.Center = (min + max) * .5f;
+  bounds_.Radius = glm::distance(min, max) * .5f;
+  LOG_DEBUG("Animated bounds: center ({}, {}, {}), radius {}",
+            bounds_.Center.x,
+            bounds_.Center.y,
+            bounds_.Center.z,
+            bounds_.Radius);
+  return true;
+}
+
+bool
+Skinning::Reserve(u32 poses)
+{
+  if (poses <= skinned_poses_ && skinned_ != nullptr) {
+    return true;
+  }
+  const u32 capacity = std::min(std::bit_ceil(poses), kMaxPoses);
+  const i64 pose_bytes = i64(stats_.vertices) * 16;
+
+  auto* Device = device_;
+  RELEASE_IF(skinned_, SDL_ReleaseGPUBuffer);
+  RenderStats::Allocated(GpuMemory::Geometry,
+                         -i64(skinned_poses_) * pose_bytes);
+  skinned_poses_ = 0;
+
+  SDL_GPUBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE |
+                 SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
+    info.size = static_cast<Uint32>(capacity * pose_bytes);
+  }
+  skinned_ = SDL_CreateGPUBuffer(device_, &info);
+  if (skinned_ == nullptr) {
+    LOG_ERROR("Couldn't create skinned vertex buffer: {}", GETERR);
+    return false;
+  }
+  skinned_poses_ = capacity;
+  RenderStats::Allocated(GpuMemory::Geometry, info.size);
+  return true;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "src/gltf_loader.h"
+#include "src/job_system.h"
+#include "src/pose_palettes.h"
+#include "types.h"
+
+struct SkinningCfg
+{
+  u32 poses{ 32 }; // distinct poses per frame, every instance picks one
+  u32 clip{ 0 };
+  float rate{ 1.f }; // playback speed
+};
+
+// Matches uSkinning in vert.vert (std140)
+struct SkinningUniforms
+{
+  Uint32 vertex_count;
+  Uint32 poses;
+  Uint32 pad[2];
+};
+
+struct SkinningStats
+{
+  u32 joints{ 0 };
+  u32 vertices{ 0 };
+  u32 poses{ 0 };
+  float cpu_ms{ 0.f }; // sampling and palettes, last Update
+};
+
+struct SkinningValidation
+{
+  bool ran{ false };
+  bool passed{ false };
+  float palette_error{ 0.f }; // largest, relative to the palette's scale
+  float vertex_error{ 0.f };  // largest, relative to the bounds' radius
+  u32 mismatches{ 0 };        // palettes and vertices past the tolerance
+};
+
+// Skeletal animation for instanced crowds. Every instance plays the same clip
+// offset by its swim phase, rounded to one of a few poses spread over the
+// clip. The CPU builds joint palettes for all poses at once (PosePalettes); a
+// compute pass then skins every vertex once per pose into a buffer the
+// scene's vertex shaders read by instance pose.
+// The cost follows the pose count, not the instance count.
+class Skinning
+{
+public:
+  static constexpr u32 kMaxPoses = PosePalettes::kMaxPoses;
+
+  explicit Skinning(SDL_GPUDevice* device);
+  ~Skinning();
+
+  Skinning(const Skinning&) = delete;
+  Skinning& operator=(const Skinning&) = delete;
+
+  // Skins the vertices of every mesh of `loader`, in the order they're drawn
+  // from. Succeeds and stays inactive when it has no animated skin.
+  bool Init(const GLTFLoader& loader,
+            const char* shader_path,
+            JobSystem& jobs);
+  bool Active() const { return active_; }
+  // Object space bounds of every mesh over every clip, rest pose included
+  const MeshBounds& Bounds() const { return bounds_; }
+  u32 ClipCount() const;
+  const char* ClipName(u32 clip) const;
+
+  // Samples the clip at `time` for every pose and builds their palettes.
+  // Grows the skinned vertex buffer, Skinned() may change.
+  bool Update(const SkinningCfg& cfg, float time, JobSystem& jobs);
+  // Records the palette upload of the last Update
+  void Upload(SDL_GPUCopyPass* pass);
+  // Records the skinning, after the copy pass with the upload
+  void Dispatch(SDL_GPUCommandBuffer* cmdbuf);
+
+  // Skins the poses of the last Update in its own submission, waits for it
+  // and compares the palettes and skin.comp's vertices with a plain CPU
+  // evaluation of the clip. Blocks, only meant for debugging.
+  const SkinningValidation& Validate();
+  const SkinningValidation& LastValidation() const { return validation_; }
+
+  SkinningUniforms Uniforms() const;
+  SDL_GPUBuffer* Skinned() const { return skinned_; }
+  const SkinningStats& Stats() const { return stats_; }
+
+private:
+  bool UploadVertices(const GLTFLoader& loader);
+  bool ComputeBounds(const GLTFLoader& loader, JobSystem& jobs);
+  bool Reserve(u32 poses);
+
+private:
+  SDL_GPUDevice* device_{};
+  const Skeleton* skeleton_{ nullptr };
+  bool active_{ false };
+  MeshBounds bounds_{};
+  SkinningStats stats_{};
+  SkinningValidation validation_{};
+
+  PosePalettes pose_;
+
+  SDL_GPUComputePipeline* pipeline_{ nullptr };
+  SDL_GPUBuffer* vertices_{ nullptr };
+  SDL_GPUBuffer* palette_buffer_{ nullptr };
+  SDL_GPUTransferBuffer* palette_upload_{ nullptr };
+  SDL_GPUBuffer* skinned_{ nullptr };
+  u32 skinned_poses_{ 0 }; // skinned_ capacity
+};
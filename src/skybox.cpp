@@ -1,5 +1,6 @@
 #include "skybox.h"
 #include "src/logger.h"
+#include "src/render_stats.h"
 #include "util.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_assert.h>
@@ -11,10 +12,16 @@
 #include <cstdio>
 #include <vector>
 
-Skybox::Skybox(const char* dir, SDL_Window* window, SDL_GPUDevice* device)
+Skybox::Skybox(const char* dir,
+               SDL_GPUTextureFormat color_format,
+               SDL_GPUTextureFormat depth_format,
+               SDL_GPUDevice* device,
+               PipelineRegistry& pipelines)
   : dir_{ dir }
   , device_{ device }
-  , window_{ window }
+  , color_format_{ color_format }
+  , depth_format_{ depth_format }
+  , pipelines_{ &pipelines }
 {
   if (!Init()) {
     LOG_ERROR("Skybox initialization failed");
@@ -24,13 +31,17 @@ Skybox::Skybox(const char* dir, SDL_Window* window, SDL_GPUDevice* device)
 Skybox::Skybox(const char* dir,
                const char* vert_path,
                const char* frag_path,
-               SDL_Window* window,
-               SDL_GPUDevice* device)
+               SDL_GPUTextureFormat color_format,
+               SDL_GPUTextureFormat depth_format,
+               SDL_GPUDevice* device,
+               PipelineRegistry& pipelines)
   : VertPath{ vert_path }
   , FragPath{ frag_path }
   , dir_{ dir }
   , device_{ device }
-  , window_{ window }
+  , color_format_{ color_format }
+  , depth_format_{ depth_format }
+  , pipelines_{ &pipelines }
 {
   if (!Init()) {
     LOG_ERROR("Skybox initialization failed");
@@ -44,9 +55,14 @@ Skybox::~Skybox()
   for (const auto tx : faces) {
     RELEASE_IF(tx, SDL_ReleaseGPUTexture)
   }
+  if (Cubemap != nullptr) {
+    RenderStats::Allocated(GpuMemory::Textures, -i64(cubemap_bytes_));
+  }
   RELEASE_IF(Cubemap, SDL_ReleaseGPUTexture);
   RELEASE_IF(CubemapSampler, SDL_ReleaseGPUSampler);
-  RELEASE_IF(Pipeline, SDL_ReleaseGPUGraphicsPipeline);
+  RenderStats::Allocated(GpuMemory::Geometry, -i64(geometry_bytes_));
+  RELEASE_IF(VertexBuffer, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(IndexBuffer, SDL_ReleaseGPUBuffer);
 }
 
 bool
@@ -100,23 +116,19 @@ bool
 Skybox::CreatePipeline()
 {
   LOG_TRACE("Skybox::CreatePipeline");
-  auto vert = LoadShader(VertPath, device_, 0, 2, 0, 0);
+  auto vert = pipelines_->Shader(VertPath);
   if (vert == nullptr) {
     LOG_ERROR("Couldn't load vertex shader at path {}", VertPath);
     return false;
   }
-  auto frag = LoadShader(FragPath, device_, 1, 1, 0, 0);
+  auto frag = pipelines_->Shader(FragPath);
   if (frag == nullptr) {
     LOG_ERROR("Couldn't load fragment shader at path {}", FragPath);
     return false;
   }
 
   SDL_GPUColorTargetDescription col_desc = {};
-  col_desc.format = SDL_GetGPUSwapchainTextureFormat(device_, window_);
-  if (col_desc.format == SDL_GPU_TEXTUREFORMAT_INVALID) {
-    LOG_ERROR("no swapchain format");
-    return false;
-  }
+  col_desc.format = color_format_;
 
   SDL_GPUVertexBufferDescription vert_desc{};
   {
@@ -146,28 +158,29 @@ Skybox::CreatePipeline()
       state.vertex_attributes = &vert_attr;
       state.num_vertex_attributes = 1;
     }
+    {
+      // at the far plane (see skybox.vert), only where nothing was drawn
+      auto& state = pipelineCreateInfo.depth_stencil_state;
+      state.compare_op = SDL_GPU_COMPAREOP_LESS_OR_EQUAL;
+      state.enable_depth_test = true;
+      state.enable_depth_write = false;
+    }
     {
       auto& state = pipelineCreateInfo.target_info;
       state.color_target_descriptions = &col_desc;
       state.num_color_targets = 1;
+      state.depth_stencil_format = depth_format_;
+      state.has_depth_stencil_target = true;
     }
   }
-  Pipeline = SDL_CreateGPUGraphicsPipeline(device_, &pipelineCreateInfo);
-
-  SDL_ReleaseGPUShader(device_, vert);
-  SDL_ReleaseGPUShader(device_, frag);
-
-  auto ret = Pipeline != nullptr;
-  if (ret) {
-    LOG_DEBUG("Created skybox pipeline");
-  } else {
-    LOG_ERROR("Couldn't create skybox pipeline: {}", GETERR);
-  }
-  return ret;
+  // compiled in the background, the sky is skipped until it's ready
+  Pipeline = pipelines_->Request(pipelineCreateInfo);
+  LOG_DEBUG("Requested skybox pipeline");
+  return true;
 }
 
 bool
-Skybox::SendVertexData() const
+Skybox::SendVertexData()
 {
   LOG_TRACE("Skybox::SendVertexData");
   Uint32 sz = (sizeof(PosVertex) * 24) + (sizeof(Uint16) * 36);
@@ -206,6 +219,9 @@ Skybox::SendVertexData() const
   SDL_ReleaseGPUTransferBuffer(device_, trBuf);
   auto ret = SDL_SubmitGPUCommandBuffer(cmdbuf);
   if (ret) {
+    RenderStats::Add(Counter::UploadBytes, sz);
+    RenderStats::Allocated(GpuMemory::Geometry, sz);
+    geometry_bytes_ = sz;
     LOG_DEBUG("Sent skybox vertex data to GPU");
   } else {
     LOG_ERROR("Couldn't submit command buffer for vertex transfer: {}", GETERR);
@@ -321,20 +337,27 @@ Skybox::LoadTextures()
   }
 
   SDL_ReleaseGPUTransferBuffer(device_, trBuf);
+  cubemap_bytes_ = info.size;
+  RenderStats::Add(Counter::UploadBytes, info.size);
+  RenderStats::Allocated(GpuMemory::Textures, info.size);
   LOG_DEBUG("Loaded skybox textures");
   return true;
 }
 
 void
-Skybox::Draw(SDL_GPURenderPass* pass) const
+Skybox::Enqueue(RenderQueue& queue) const
 {
-  static const SDL_GPUTextureSamplerBinding texBind{ Cubemap, CubemapSampler };
-  static const SDL_GPUBufferBinding vBufBind{ VertexBuffer, 0 };
-  static const SDL_GPUBufferBinding iBufBind{ IndexBuffer, 0 };
-
-  SDL_BindGPUGraphicsPipeline(pass, Pipeline);
-  SDL_BindGPUVertexBuffers(pass, 0, &vBufBind, 1);
-  SDL_BindGPUIndexBuffer(pass, &iBufBind, SDL_GPU_INDEXELEMENTSIZE_16BIT);
-  SDL_BindGPUFragmentSamplers(pass, 0, &texBind, 1);
-  SDL_DrawGPUIndexedPrimitives(pass, 36, 1, 0, 0, 0);
+  DrawCmd cmd{};
+  {
+    cmd.pipeline = pipelines_->Get(Pipeline);
+    cmd.vertex_buffer = { VertexBuffer, 0 };
+    cmd.index_buffer = { IndexBuffer, 0 };
+    cmd.index_size = SDL_GPU_INDEXELEMENTSIZE_16BIT;
+    cmd.sampler = { Cubemap, CubemapSampler };
+    cmd.num_indices = INDEX_COUNT;
+    cmd.num_instances = 1;
+  }
+  if (cmd.pipeline != nullptr) {
+    queue.Add(DrawPass::Sky, cmd, 0.f);
+  }
 }
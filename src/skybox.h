@@ -1,21 +1,29 @@
 #pragma once
 
+#include "src/pipeline_registry.h"
+#include "src/render_queue.h"
 #include "src/util.h"
 #include <SDL3/SDL_gpu.h>
 
 class Skybox
 {
 public:
-  explicit Skybox(const char* dir, SDL_Window* window, SDL_GPUDevice* device);
+  explicit Skybox(const char* dir,
+                  SDL_GPUTextureFormat color_format,
+                  SDL_GPUTextureFormat depth_format,
+                  SDL_GPUDevice* device,
+                  PipelineRegistry& pipelines);
   explicit Skybox(const char* dir,
                   const char* vert_path,
                   const char* frag_path,
-                  SDL_Window* window,
-                  SDL_GPUDevice* device);
+                  SDL_GPUTextureFormat color_format,
+                  SDL_GPUTextureFormat depth_format,
+                  SDL_GPUDevice* device,
+                  PipelineRegistry& pipelines);
   ~Skybox();
 
   bool IsLoaded() const { return loaded_; }
-  void Draw(SDL_GPURenderPass* pass) const;
+  void Enqueue(RenderQueue& queue) const;
 
 public:
   const char* VertPath = "resources/shaders/compiled/skybox.vert.spv";
@@ -25,19 +33,23 @@ public:
   SDL_GPUSampler* CubemapSampler{};
   SDL_GPUBuffer* VertexBuffer{};
   SDL_GPUBuffer* IndexBuffer{};
-  SDL_GPUGraphicsPipeline* Pipeline{ nullptr };
+  PipelineHandle Pipeline{ kNoPipeline };
 
 private:
   bool Init();
   bool CreatePipeline();
-  bool SendVertexData() const;
+  bool SendVertexData();
   bool LoadTextures();
 
 private:
   const char* dir_{};
   SDL_GPUDevice* device_{}; // needed for dtor
-  SDL_Window* window_{};    // needed swapchain format
+  SDL_GPUTextureFormat color_format_{}; // of the targets it's drawn to
+  SDL_GPUTextureFormat depth_format_{};
+  PipelineRegistry* pipelines_{};
   bool loaded_{ false };
+  u32 cubemap_bytes_{ 0 };  // reported to RenderStats
+  u32 geometry_bytes_{ 0 }; // same, vertices and indices
   const char* paths[6]{ "left.jpg",   "right.jpg", "top.jpg",
                         "bottom.jpg", "back.jpg",  "front.jpg" };
 
@@ -0,0 +1,194 @@
+#include "spirv_reflect.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr u32 kMagic = 0x07230203;
+
+enum Op : u32
+{
+  OpEntryPoint = 15,
+  OpExecutionMode = 16,
+  OpTypeImage = 25,
+  OpTypeSampler = 26,
+  OpTypeSampledImage = 27,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpConstant = 43,
+  OpVariable = 59,
+  OpDecorate = 71,
+};
+
+enum Decoration : u32
+{
+  Block = 2,
+  BufferBlock = 3,
+  DescriptorSet = 34,
+};
+
+enum StorageClass : u32
+{
+  UniformConstant = 0,
+  Uniform = 2,
+  StorageBuffer = 12,
+};
+
+constexpr u32 kExecutionModeLocalSize = 17;
+
+struct Type
+{
+  u32 op{ 0 };
+  u32 element{ 0 }; // arrays and pointers
+  u32 length{ 1 };  // arrays, runtime arrays count as one
+  u32 sampled{ 0 }; // images: 1 sampled, 2 storage
+};
+
+struct Variable
+{
+  u32 type;
+  u32 storage;
+};
+
+} // namespace
+
+bool
+ReflectSpirv(const void* code, size_t size, ShaderReflection& out)
+{
+  if (size % 4 != 0 || size < 20) {
+    return false;
+  }
+  std::vector<u32> words(size / 4);
+  std::memcpy(words.data(), code, size);
+  if (words[0] != kMagic) {
+    return false;
+  }
+
+  bool has_entry = false;
+  u32 entry_id = 0;
+  std::unordered_map<u32, Type> types;
+  std::unordered_map<u32, u32> constants;
+  std::unordered_map<u32, u32> sets;
+  std::unordered_map<u32, u32> block_kind; // struct id -> Block/BufferBlock
+  std::vector<std::pair<u32, Variable>> variables;
+
+  for (size_t i = 5; i < words.size();) {
+    const u32 count = words[i] >> 16;
+    const u32 op = words[i] & 0xffff;
+    if (count == 0 || i + count > words.size()) {
+      return false;
+    }
+    const u32* w = &words[i];
+    switch (op) {
+      case OpEntryPoint:
+        if (!has_entry) {
+          has_entry = true;
+          entry_id = w[2];
+          switch (w[1]) {
+            case 0:
+              out.stage = ShaderStage::Vertex;
+              break;
+            case 4:
+              out.stage = ShaderStage::Fragment;
+              break;
+            case 5:
+              out.stage = ShaderStage::Compute;
+              break;
+            default:
+              return false;
+          }
+        }
+        break;
+      case OpExecutionMode:
+        if (w[2] == kExecutionModeLocalSize && count >= 6 &&
+            w[1] == entry_id) {
+          out.threads[0] = w[3];
+          out.threads[1] = w[4];
+          out.threads[2] = w[5];
+        }
+        break;
+      case OpDecorate:
+        if (w[2] == DescriptorSet && count >= 4) {
+          sets[w[1]] = w[3];
+        } else if (w[2] == Block || w[2] == BufferBlock) {
+          block_kind[w[1]] = w[2];
+        }
+        break;
+      case OpTypeImage:
+        types[w[1]] = Type{ .op = op, .sampled = w[7] };
+        break;
+      case OpTypeSampler:
+      case OpTypeSampledImage:
+      case OpTypeStruct:
+        types[w[1]] = Type{ .op = op };
+        break;
+      case OpTypeArray:
+        types[w[1]] = Type{ .op = op, .element = w[2], .length = w[3] };
+        break;
+      case OpTypeRuntimeArray:
+        types[w[1]] = Type{ .op = op, .element = w[2] };
+        break;
+      case OpTypePointer:
+        types[w[1]] = Type{ .op = op, .element = w[3], .sampled = w[2] };
+        break;
+      case OpConstant:
+        if (count >= 4) {
+          constants[w[2]] = w[3];
+        }
+        break;
+      case OpVariable:
+        variables.push_back({ w[2], Variable{ w[1], w[3] } });
+        break;
+    }
+    i += count;
+  }
+  if (!has_entry) {
+    return false;
+  }
+
+  for (const auto& [id, var] : variables) {
+    if (var.storage != UniformConstant && var.storage != Uniform &&
+        var.storage != StorageBuffer) {
+      continue;
+    }
+    // pointer -> (arrays of) resource
+    u32 type_id = types[var.type].element;
+    u32 n = 1;
+    while (types[type_id].op == OpTypeArray ||
+           types[type_id].op == OpTypeRuntimeArray) {
+      const Type& arr = types[type_id];
+      if (arr.op == OpTypeArray) {
+        n *= constants.count(arr.length) ? constants[arr.length] : 1;
+      }
+      type_id = arr.element;
+    }
+    const Type& type = types[type_id];
+    const bool readwrite =
+      out.stage == ShaderStage::Compute && sets.count(id) && sets[id] == 1;
+
+    if (var.storage == UniformConstant) {
+      if (type.op == OpTypeSampledImage ||
+          (type.op == OpTypeImage && type.sampled == 1)) {
+        out.samplers += n;
+      } else if (type.op == OpTypeImage && type.sampled == 2) {
+        (readwrite ? out.readwrite_storage_textures : out.storage_textures) +=
+          n;
+      }
+    } else if (type.op == OpTypeStruct) {
+      // old style SSBOs are BufferBlock structs in the Uniform class
+      const bool ssbo = var.storage == StorageBuffer ||
+                        (block_kind.count(type_id) &&
+                         block_kind[type_id] == BufferBlock);
+      if (!ssbo) {
+        out.uniform_buffers += n;
+      } else {
+        (readwrite ? out.readwrite_storage_buffers : out.storage_buffers) += n;
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+#include "types.h"
+
+// No SDL here, the shader_embed build tool links this file too.
+enum class ShaderStage : u32
+{
+  Vertex,
+  Fragment,
+  Compute,
+};
+
+// Resource counts in SDL_GPUShaderCreateInfo / SDL_GPUComputePipelineCreateInfo
+// terms. Read-write storage only exists in compute shaders, where SDL wants
+// them in descriptor set 1.
+struct ShaderReflection
+{
+  ShaderStage stage{ ShaderStage::Vertex };
+  u32 samplers{ 0 };
+  u32 uniform_buffers{ 0 };
+  u32 storage_buffers{ 0 };
+  u32 storage_textures{ 0 };
+  u32 readwrite_storage_buffers{ 0 };
+  u32 readwrite_storage_textures{ 0 };
+  u32 threads[3]{ 1, 1, 1 }; // compute local size
+};
+
+// Reads the stage and resource counts of the first entry point of a SPIR-V
+// module. False if `code` isn't SPIR-V or its stage isn't supported.
+bool
+ReflectSpirv(const void* code, size_t size, ShaderReflection& out);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+
+#include "types.h"
+
+// Hands the latest value from one writer thread to one reader thread without
+// locks or waiting. Each side owns a slot, the third one is swapped between
+// them: the writer publishes by swapping its slot in, the reader picks it up
+// by swapping its own out. Values the reader never got to are overwritten.
+template<typename T>
+class TripleBuffer
+{
+public:
+  // Writer: fill Back(), then Publish() it.
+  T& Back() { return slots_[back_].value; }
+  void Publish()
+  {
+    const u8 old = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+    back_ = old & kIndex;
+  }
+
+  // Reader: the latest published value, or the one read last when nothing
+  // new was published. Valid until the next Read().
+  const T& Read()
+  {
+    if (middle_.load(std::memory_order_relaxed) & kFresh) {
+      const u8 old = middle_.exchange(front_, std::memory_order_acq_rel);
+      front_ = old & kIndex;
+    }
+    return slots_[front_].value;
+  }
+
+  // Every slot to `v`, while neither side is using the buffer.
+  void Reset(const T& v)
+  {
+    for (auto& slot : slots_) {
+      slot.value = v;
+    }
+    back_ = 0;
+    middle_.store(1, std::memory_order_release);
+    front_ = 2;
+  }
+
+private:
+  static constexpr u8 kIndex = 0x3;
+  static constexpr u8 kFresh = 0x4; // published, not read yet
+
+  // a cache line each, the two sides don't share writes
+  struct alignas(64) Slot
+  {
+    T value{};
+  };
+  Slot slots_[3];
+  alignas(64) u8 back_{ 0 }; // writer only
+  alignas(64) std::atomic<u8> middle_{ 1 };
+  alignas(64) u8 front_{ 2 }; // reader only
+};
@@ -4,55 +4,126 @@
 #include <SDL3/SDL.h>
 #include <SDL3_image/SDL_image.h>
 
+#include "src/shader_blobs.h"
+
+namespace {
+
+struct SpirvModule
+{
+  const Uint8* code{ nullptr };
+  size_t size{ 0 };
+  void* owned{ nullptr }; // SDL_free when loaded from disk
+  ShaderReflection reflection;
+};
+
+// The embedded blob when the build has one, else the file, reflected here.
+bool
+LoadSpirv(const char* path, SpirvModule& out)
+{
+  if (const ShaderBlob* blob = FindShaderBlob(path)) {
+    out.code = blob->code;
+    out.size = blob->size;
+    out.reflection = blob->reflection;
+    return true;
+  }
+  out.owned = SDL_LoadFile(path, &out.size);
+  if (out.owned == NULL) {
+    LOG_ERROR("Couldn't load shader code from path: {}", path);
+    return false;
+  }
+  out.code = static_cast<const Uint8*>(out.owned);
+  if (!ReflectSpirv(out.code, out.size, out.reflection)) {
+    LOG_ERROR("Couldn't reflect SPIR-V at path: {}", path);
+    SDL_free(out.owned);
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
 SDL_GPUShader*
-LoadShader(const char* path,
-           SDL_GPUDevice* device,
-           Uint32 samplerCount,
-           Uint32 uniformBufferCount,
-           Uint32 storageBufferCount,
-           Uint32 storageTextureCount)
+LoadShader(const char* path, SDL_GPUDevice* device)
 {
-  SDL_GPUShaderStage stage;
-  if (SDL_strstr(path, "vert")) {
-    stage = SDL_GPU_SHADERSTAGE_VERTEX;
-  } else if (SDL_strstr(path, "frag")) {
-    stage = SDL_GPU_SHADERSTAGE_FRAGMENT;
-  } else {
-    LOG_ERROR("Invalid shader stage!");
+  SpirvModule module;
+  if (!LoadSpirv(path, module)) {
     return NULL;
   }
-  size_t codeSize;
-  void* code = SDL_LoadFile(path, &codeSize);
-  if (code == NULL) {
-    LOG_ERROR("Couldn't load shader code from path: {}", path);
+  const ShaderReflection& r = module.reflection;
+  if (r.stage == ShaderStage::Compute) {
+    LOG_ERROR("Invalid shader stage!");
+    SDL_free(module.owned);
     return NULL;
   }
 
   SDL_GPUShaderCreateInfo shaderInfo = {
-    .code_size = codeSize,
-    .code = (Uint8*)code,
+    .code_size = module.size,
+    .code = module.code,
     .entrypoint = "main",
     .format = SDL_GPU_SHADERFORMAT_SPIRV,
-    .stage = stage,
-    .num_samplers = samplerCount,
-    .num_storage_textures = storageTextureCount,
-    .num_storage_buffers = storageBufferCount,
-    .num_uniform_buffers = uniformBufferCount,
+    .stage = r.stage == ShaderStage::Vertex ? SDL_GPU_SHADERSTAGE_VERTEX
+                                            : SDL_GPU_SHADERSTAGE_FRAGMENT,
+    .num_samplers = r.samplers,
+    .num_storage_textures = r.storage_textures,
+    .num_storage_buffers = r.storage_buffers,
+    .num_uniform_buffers = r.uniform_buffers,
     .props = 0,
   };
 
   SDL_GPUShader* shader = SDL_CreateGPUShader(device, &shaderInfo);
+  SDL_free(module.owned);
   if (shader == NULL) {
     LOG_ERROR("Failed to create shader: {}", GETERR);
-    SDL_free(code);
     return NULL;
   }
 
   LOG_DEBUG("Created shader from path: {}", path);
-  SDL_free(code);
   return shader;
 }
 
+SDL_GPUComputePipeline*
+LoadComputePipeline(const char* path, SDL_GPUDevice* device)
+{
+  SpirvModule module;
+  if (!LoadSpirv(path, module)) {
+    return NULL;
+  }
+  const ShaderReflection& r = module.reflection;
+  if (r.stage != ShaderStage::Compute) {
+    LOG_ERROR("Not a compute shader: {}", path);
+    SDL_free(module.owned);
+    return NULL;
+  }
+
+  SDL_GPUComputePipelineCreateInfo info = {};
+  {
+    info.code_size = module.size;
+    info.code = module.code;
+    info.entrypoint = "main";
+    info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    info.num_readonly_storage_textures = r.storage_textures;
+    info.num_readonly_storage_buffers = r.storage_buffers;
+    info.num_readwrite_storage_textures = r.readwrite_storage_textures;
+    info.num_readwrite_storage_buffers = r.readwrite_storage_buffers;
+    info.num_samplers = r.samplers;
+    info.num_uniform_buffers = r.uniform_buffers;
+    info.threadcount_x = r.threads[0];
+    info.threadcount_y = r.threads[1];
+    info.threadcount_z = r.threads[2];
+  }
+
+  SDL_GPUComputePipeline* pipeline =
+    SDL_CreateGPUComputePipeline(device, &info);
+  SDL_free(module.owned);
+  if (pipeline == NULL) {
+    LOG_ERROR("Failed to create compute pipeline: {}", GETERR);
+    return NULL;
+  }
+
+  LOG_DEBUG("Created compute pipeline from path: {}", path);
+  return pipeline;
+}
+
 SDL_Surface*
 LoadImage(const char* path)
 {
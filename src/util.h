@@ -25,13 +25,19 @@ struct PosUvVertex
 
 #define GETERR SDL_GetError()
 
+// The scene is drawn offscreen, scene pipelines target these formats whether
+// or not there's a swapchain.
+constexpr SDL_GPUTextureFormat kSceneColorFormat =
+  SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+constexpr SDL_GPUTextureFormat kSceneDepthFormat =
+  SDL_GPU_TEXTUREFORMAT_D16_UNORM;
+
+// Stage and resource counts come from SPIR-V reflection, see spirv_reflect.h.
 SDL_GPUShader*
-LoadShader(const char* path,
-           SDL_GPUDevice* device,
-           Uint32 samplerCount,
-           Uint32 uniformBufferCount,
-           Uint32 storageBufferCount,
-           Uint32 storageTextureCount);
+LoadShader(const char* path, SDL_GPUDevice* device);
 
 SDL_Surface*
 LoadImage(const char* path);
+
+SDL_GPUComputePipeline*
+LoadComputePipeline(const char* path, SDL_GPUDevice* device);
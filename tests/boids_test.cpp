@@ -0,0 +1,223 @@
+// Boids spatial hash: the parallel counting sort against std::stable_sort,
+// what every fish sees against a scan over all of them, and the same steps
+// taken with different worker counts coming out bit for bit the same.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "src/boids.h"
+#include "src/logger.h"
+#include "tests/check.h"
+
+namespace {
+
+// across the 1024 fish steering jobs, the 8192 fish sort chunks, the 8192
+// keys prefix sum jobs and the 16 chunks cap
+constexpr u32 kCounts[] = { 1,    3,     1023,  1025,  8191,
+                            8193, 16385, 40000, 140000 };
+constexpr u32 kSteps = 3;       // Updates per count
+constexpr u32 kSampled = 1500;  // fish scanned against all the others
+constexpr float kDensity = .5f; // fish per unit volume
+constexpr float kDt = 1.f / 60.f;
+// pairs this near the radius may go either way
+constexpr float kMargin = 1e-4f;
+constexpr float kTolerance = 1e-4f;
+
+std::mt19937 rng{ 1234 };
+
+float
+BoxSize(u32 count)
+{
+  return std::max(std::cbrt(float(count) / kDensity), 4.f);
+}
+
+// Order() must be the stable sort of the fish by key, CellStart() where
+// every key's run starts in it
+void
+CheckSort(const Boids& boids)
+{
+  const u32 count = boids.Count();
+  const std::vector<u32>& keys = boids.Keys();
+  CHECK(keys.size() == count && boids.Order().size() == count);
+  if (keys.size() != count) {
+    return;
+  }
+  std::vector<u32> order(count);
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+    return keys[a] < keys[b];
+  });
+  CHECK(order == boids.Order());
+
+  const std::vector<u32>& start = boids.CellStart();
+  CHECK(!start.empty() && start.back() == count);
+  for (u32 k = 0; k + 1 < start.size(); ++k) {
+    const auto first = std::lower_bound(
+      order.begin(), order.end(), k, [&](u32 i, u32 key) {
+        return keys[i] < key;
+      });
+    CHECK(start[k] == u32(first - order.begin()));
+  }
+}
+
+// Sums what `self` sees in `state` like Gather does, over every fish. Counts
+// the pairs within kMargin of the radius in `borderline`.
+BoidsNeighborhood
+Scan(const std::vector<BoidState>& state,
+     u32 self,
+     float radius2,
+     float separation2,
+     u32& borderline,
+     float& magnitude)
+{
+  BoidsNeighborhood n;
+  borderline = 0;
+  magnitude = 0.f;
+  const float* p = state[self].position;
+  for (const BoidState& other : state) {
+    const float dx = other.position[0] - p[0];
+    const float dy = other.position[1] - p[1];
+    const float dz = other.position[2] - p[2];
+    const float d2 = (dx * dx + dy * dy) + dz * dz;
+    if (std::fabs(d2 - radius2) <= kMargin * radius2 ||
+        std::fabs(d2 - separation2) <= kMargin * separation2) {
+      ++borderline;
+    }
+    if (d2 <= 0.f || d2 >= radius2) {
+      continue;
+    }
+    n.count += 1.f;
+    const float d[3] = { dx, dy, dz };
+    for (u32 axis = 0; axis < 3; ++axis) {
+      n.offset[axis] += d[axis];
+      n.velocity[axis] += other.velocity[axis];
+      magnitude += std::fabs(d[axis]) + std::fabs(other.velocity[axis]);
+    }
+    if (d2 < separation2) {
+      for (u32 axis = 0; axis < 3; ++axis) {
+        n.separation[axis] -= d[axis] / d2;
+        magnitude += std::fabs(d[axis] / d2);
+      }
+    }
+  }
+  return n;
+}
+
+bool
+Near(const float (&a)[3], const float (&b)[3], float tolerance)
+{
+  for (u32 axis = 0; axis < 3; ++axis) {
+    if (std::fabs(a[axis] - b[axis]) > tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// What sampled fish saw in the last Update against a scan of `before`, the
+// state that Update read
+void
+CheckNeighbors(const Boids& boids,
+               const BoidsCfg& cfg,
+               const std::vector<BoidState>& before)
+{
+  const u32 count = boids.Count();
+  const float radius2 = cfg.radius * cfg.radius;
+  const float separation2 =
+    std::min(cfg.separation_radius * cfg.separation_radius, radius2);
+  const u32 sampled = std::min(count, kSampled);
+  for (u32 k = 0; k < sampled; ++k) {
+    const u32 s = sampled == count ? k : u32(rng() % count);
+    const u32 self = boids.Order()[s];
+    u32 borderline = 0;
+    float magnitude = 0.f;
+    const BoidsNeighborhood expected =
+      Scan(before, self, radius2, separation2, borderline, magnitude);
+    const BoidsNeighborhood seen = boids.Neighbors(cfg, s);
+    if (borderline > 0) {
+      CHECK(std::fabs(seen.count - expected.count) <= float(borderline));
+      continue;
+    }
+    CHECK(seen.count == expected.count);
+    const float tolerance = kTolerance * (1.f + magnitude);
+    CHECK(Near(seen.offset, expected.offset, tolerance));
+    CHECK(Near(seen.velocity, expected.velocity, tolerance));
+    CHECK(Near(seen.separation, expected.separation, tolerance));
+  }
+}
+
+std::vector<BoidState>
+States(const Boids& boids)
+{
+  std::vector<BoidState> state(boids.Count());
+  for (u32 i = 0; i < boids.Count(); ++i) {
+    state[i] = boids.State(i);
+  }
+  return state;
+}
+
+void
+TestCount(u32 count, const BoidsCfg& cfg, JobSystem& jobs)
+{
+  const float size = BoxSize(count);
+  Boids boids;
+  boids.Resize(count, -.5f * size, size);
+  std::vector<InstanceData> out(count);
+  for (u32 step = 0; step < kSteps; ++step) {
+    const std::vector<BoidState> before = States(boids);
+    boids.Update(cfg, float(step) * kDt, kDt, jobs, out.data());
+    CheckSort(boids);
+    CheckNeighbors(boids, cfg, before);
+  }
+}
+
+// The sort and the steering split the same way whatever the thread count
+void
+TestDeterminism(const BoidsCfg& cfg)
+{
+  constexpr u32 kCount = 30000;
+  const float size = BoxSize(kCount);
+  JobSystem one{ 1 };
+  JobSystem four{ 4 };
+  Boids a;
+  Boids b;
+  a.Resize(kCount, -.5f * size, size);
+  b.Resize(kCount, -.5f * size, size);
+  std::vector<InstanceData> out_a(kCount);
+  std::vector<InstanceData> out_b(kCount);
+  for (u32 step = 0; step < 10; ++step) {
+    const float time = float(step) * kDt;
+    a.Update(cfg, time, kDt, one, out_a.data());
+    b.Update(cfg, time, kDt, four, out_b.data());
+  }
+  const std::vector<BoidState> state_a = States(a);
+  const std::vector<BoidState> state_b = States(b);
+  CHECK(std::memcmp(state_a.data(),
+                    state_b.data(),
+                    state_a.size() * sizeof(BoidState)) == 0);
+  CHECK(std::memcmp(out_a.data(),
+                    out_b.data(),
+                    out_a.size() * sizeof(InstanceData)) == 0);
+}
+
+} // namespace
+
+int
+main()
+{
+  Logger::Init();
+  JobSystem jobs;
+  BoidsCfg cfg;
+  cfg.radius = 1.5f;
+  for (u32 count : kCounts) {
+    const int before = Failures();
+    TestCount(count, cfg, jobs);
+    std::printf("%u fish: %s\n", count, Failures() == before ? "ok" : "FAILED");
+  }
+  TestDeterminism(cfg);
+  std::printf("boids: %s\n", Failures() == 0 ? "ok" : "FAILED");
+  return Failures() == 0 ? 0 : 1;
+}
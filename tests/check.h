@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdio>
+
+// Tests are plain executables run by ctest: CHECK reports a failed condition
+// and carries on, main fails when Failures() isn't 0.
+
+inline int&
+Failures()
+{
+  static int failures = 0;
+  return failures;
+}
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond);   \
+      ++Failures();                                                            \
+    }                                                                          \
+  } while (false)
@@ -0,0 +1,204 @@
+// EntityStore handles and chunk packing: stale handles stay dead once their
+// index is reused, and destroying entities keeps every archetype's chunks
+// packed, checked against a plain list of the alive entities through many
+// chunk boundaries.
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "src/entities.h"
+#include "src/logger.h"
+#include "tests/check.h"
+
+namespace {
+
+constexpr ComponentMask kMoving = MaskOf<TransformComponent,
+                                         RenderComponent,
+                                         VelocityComponent>();
+constexpr ComponentMask kStill = MaskOf<TransformComponent>();
+constexpr u32 kRounds = 40;
+
+std::mt19937 rng{ 1234 };
+
+// An alive entity and the tag written into its transform
+struct Alive
+{
+  Entity entity;
+  float tag;
+};
+
+void
+TestStaleHandle()
+{
+  EntityStore store;
+  const Entity first = store.Create(kMoving);
+  CHECK(store.Alive(first));
+  store.Get<TransformComponent>(first)->scale = 2.f;
+  store.Destroy(first);
+  CHECK(!store.Alive(first));
+  CHECK(store.Get<TransformComponent>(first) == nullptr);
+
+  // the index comes back with the next generation
+  const Entity second = store.Create(kMoving);
+  CHECK(second.index == first.index);
+  CHECK(second.generation != first.generation);
+  CHECK(!store.Alive(first));
+  CHECK(store.Get<TransformComponent>(first) == nullptr);
+  CHECK(store.Get<TransformComponent>(second) != nullptr);
+  // fresh components, not the destroyed entity's
+  CHECK(store.Get<TransformComponent>(second)->scale == 1.f);
+
+  // destroying through the stale handle leaves the new entity be
+  store.Destroy(first);
+  CHECK(store.Alive(second));
+  CHECK(store.Count() == 1);
+
+  store.Clear();
+  CHECK(!store.Alive(second));
+  CHECK(store.Count() == 0);
+  CHECK(store.Get<TransformComponent>(second) == nullptr);
+}
+
+// A ForEach over Ts visits every alive entity with them once, in Nth's
+// order, with its rows contiguous inside the chunk's bytes. Over a single
+// archetype every chunk is full but the last one.
+template<typename... Ts>
+void
+CheckChunks(EntityStore& store,
+            const std::vector<Alive>& alive,
+            bool single_archetype,
+            JobSystem& jobs)
+{
+  constexpr ComponentMask mask = MaskOf<TransformComponent, Ts...>();
+  const u32 count = store.Count(mask);
+  CHECK(count == alive.size());
+  struct Seen
+  {
+    u32 first;
+    u32 count;
+    std::uintptr_t lo;
+    std::uintptr_t hi;
+  };
+  std::vector<Entity> visited(count);
+  std::vector<Seen> chunks(count);
+  std::vector<u32> visits(count, 0);
+  store.ForEach<TransformComponent, Ts...>(
+    jobs,
+    [&](u32 first,
+        u32 n,
+        const Entity* entities,
+        TransformComponent* t,
+        Ts*...) {
+      for (u32 i = 0; i < n; ++i) {
+        visited[first + i] = entities[i];
+        ++visits[first + i];
+        // rows are contiguous, the way Get finds them, else fail the check
+        // on visits below
+        if (store.Get<TransformComponent>(entities[i]) != t + i) {
+          visits[first + i] = UINT32_MAX;
+        }
+      }
+      const auto lo = std::min(reinterpret_cast<std::uintptr_t>(entities),
+                               reinterpret_cast<std::uintptr_t>(t));
+      const auto hi =
+        std::max(reinterpret_cast<std::uintptr_t>(entities + n),
+                 reinterpret_cast<std::uintptr_t>(t + n));
+      chunks[first] = { first, n, lo, hi };
+    });
+  for (u32 i = 0; i < count; ++i) {
+    CHECK(visits[i] == 1);
+    CHECK(store.Nth(mask, i) == visited[i]);
+  }
+
+  std::vector<Seen> seen;
+  for (u32 i = 0; i < count; i += chunks[i].count) {
+    CHECK(chunks[i].first == i && chunks[i].count > 0);
+    if (chunks[i].count == 0) {
+      return;
+    }
+    CHECK(chunks[i].hi - chunks[i].lo <= EntityStore::kChunkBytes);
+    seen.push_back(chunks[i]);
+  }
+  if (single_archetype) {
+    for (u32 c = 0; c + 1 < seen.size(); ++c) {
+      CHECK(seen[c].count == seen[0].count);
+    }
+    if (!seen.empty()) {
+      CHECK(seen.back().count <= seen[0].count);
+    }
+  }
+
+  // the alive list and the visits hold the same entities, with their tags
+  std::vector<Entity> expected;
+  for (const auto& a : alive) {
+    expected.push_back(a.entity);
+    const TransformComponent* t = store.Get<TransformComponent>(a.entity);
+    CHECK(t != nullptr && t->position.x == a.tag);
+  }
+  auto by_index = [](const Entity& a, const Entity& b) {
+    return a.index < b.index;
+  };
+  std::sort(expected.begin(), expected.end(), by_index);
+  std::sort(visited.begin(), visited.end(), by_index);
+  CHECK(expected == visited);
+}
+
+// Creates and destroys in random batches around the chunk capacity, so
+// destroys move entities across chunk boundaries and empty whole chunks
+void
+TestPacking(JobSystem& jobs)
+{
+  EntityStore store;
+  std::vector<Alive> moving;
+  std::vector<Alive> still;
+  float next_tag = 0.f;
+  u32 most = 0;
+  for (u32 round = 0; round < kRounds; ++round) {
+    const bool grow = round % 4 != 3;
+    const u32 batch = std::uniform_int_distribution<u32>{ 1, 700 }(rng);
+    for (u32 i = 0; i < batch; ++i) {
+      auto& list = rng() % 4 == 0 ? still : moving;
+      if (grow || list.empty()) {
+        const Entity e = store.Create(&list == &still ? kStill : kMoving);
+        store.Get<TransformComponent>(e)->position.x = next_tag;
+        list.push_back({ e, next_tag });
+        next_tag += 1.f;
+      } else {
+        const u32 victim = u32(rng() % list.size());
+        const Entity e = list[victim].entity;
+        store.Destroy(e);
+        CHECK(!store.Alive(e));
+        list[victim] = list.back();
+        list.pop_back();
+      }
+    }
+    most = std::max(most, u32(moving.size()));
+    CHECK(store.Count() == moving.size() + still.size());
+    CheckChunks<RenderComponent, VelocityComponent>(store, moving, true, jobs);
+
+    // a transform alone matches both archetypes
+    std::vector<Alive> all = moving;
+    all.insert(all.end(), still.begin(), still.end());
+    CheckChunks<>(store, all, false, jobs);
+  }
+  // enough to have crossed a few 16 KiB chunks
+  const u32 per_chunk =
+    EntityStore::kChunkBytes /
+    (sizeof(Entity) + sizeof(TransformComponent) + sizeof(RenderComponent) +
+     sizeof(VelocityComponent));
+  CHECK(most > 3 * per_chunk);
+}
+
+} // namespace
+
+int
+main()
+{
+  Logger::Init();
+  JobSystem jobs;
+  TestStaleHandle();
+  TestPacking(jobs);
+  std::printf("entities: %s\n", Failures() == 0 ? "ok" : "FAILED");
+  return Failures() == 0 ? 0 : 1;
+}
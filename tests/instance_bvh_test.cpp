@@ -0,0 +1,241 @@
+// InstanceBvh culling and ray picks against a brute force search over all
+// instances, after the build and after refits of moving instances.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "src/camera.h"
+#include "src/instance_bvh.h"
+#include "src/logger.h"
+#include "tests/check.h"
+
+namespace {
+
+constexpr u32 kCounts[] = { 1, 2, 9, 100, 5000, 20000 };
+constexpr u32 kSteps = 8; // refits per count
+constexpr u32 kViews = 8; // frusta and rays per step
+// spheres this near a plane may go either way
+constexpr float kMargin = 1e-3f;
+constexpr float kTolerance = 1e-4f;
+// the mesh box under the model matrix, and the radius around it
+const glm::vec3 kBoxMin{ -1.f, -.5f, -.8f };
+const glm::vec3 kBoxMax{ 1.f, .5f, .8f };
+constexpr float kRadius = 1.4f;
+
+std::mt19937 rng{ 1234 };
+
+float
+Random(float lo, float hi)
+{
+  return std::uniform_real_distribution<float>{ lo, hi }(rng);
+}
+
+glm::vec3
+RandomPoint(float extent)
+{
+  return { Random(-extent, extent),
+           Random(-extent, extent),
+           Random(-extent, extent) };
+}
+
+void
+Randomize(InstanceData& inst, u32 id)
+{
+  const glm::vec3 p = RandomPoint(50.f);
+  inst.position[0] = p.x;
+  inst.position[1] = p.y;
+  inst.position[2] = p.z;
+  inst.scale = Random(.2f, 2.f);
+  std::normal_distribution<float> normal;
+  float length = 0.f;
+  for (float& q : inst.rotation) {
+    q = normal(rng);
+    length += q * q;
+  }
+  for (float& q : inst.rotation) {
+    q /= std::sqrt(length);
+  }
+  // the BVH never reads params, the culled copies carry their index in it
+  inst.params[3] = float(id);
+}
+
+// Small steps keep the topology worth refitting, big ones make it drift
+void
+Move(std::vector<InstanceData>& instances, float step)
+{
+  for (auto& inst : instances) {
+    for (float& x : inst.position) {
+      x += Random(-step, step);
+    }
+  }
+}
+
+// Indices of the instances whose sphere is inside all planes, and of those
+// within kMargin of one
+void
+CullBruteForce(const Frustum& frustum,
+               const std::vector<InstanceData>& instances,
+               std::vector<u32>& visible,
+               std::vector<u32>& borderline)
+{
+  visible.clear();
+  borderline.clear();
+  for (u32 i = 0; i < instances.size(); ++i) {
+    const float* p = instances[i].position;
+    const float r = kRadius * instances[i].scale;
+    float closest = INFINITY;
+    for (const auto& plane : frustum.Planes) {
+      closest = std::min(
+        closest,
+        plane.x * p[0] + plane.y * p[1] + plane.z * p[2] + plane.w + r);
+    }
+    if (closest >= 0.f) {
+      visible.push_back(i);
+    }
+    if (std::fabs(closest) <= kMargin) {
+      borderline.push_back(i);
+    }
+  }
+}
+
+// Entry t of the ray into the instance's box, negative when it misses. The
+// ray goes into the instance's space through the transposed rotation matrix,
+// in double.
+double
+RayInstance(const glm::vec3& origin,
+            const glm::vec3& dir,
+            const InstanceData& inst)
+{
+  const double x = inst.rotation[0], y = inst.rotation[1],
+               z = inst.rotation[2], w = inst.rotation[3];
+  // rows of the rotation matrix, i.e. columns of its inverse
+  const double m[3][3] = {
+    { 1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y) },
+    { 2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x) },
+    { 2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y) },
+  };
+  double o[3], d[3];
+  for (int k = 0; k < 3; ++k) {
+    o[k] = 0.;
+    d[k] = 0.;
+    for (int j = 0; j < 3; ++j) {
+      o[k] += m[j][k] * (double(origin[j]) - inst.position[j]);
+      d[k] += m[j][k] * dir[j];
+    }
+    o[k] /= inst.scale;
+    d[k] /= inst.scale;
+  }
+  double enter = 0.;
+  double exit = INFINITY;
+  for (int k = 0; k < 3; ++k) {
+    const double t0 = (kBoxMin[k] - o[k]) / d[k];
+    const double t1 = (kBoxMax[k] - o[k]) / d[k];
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+  }
+  return enter <= exit ? enter : -1.;
+}
+
+void
+TestCull(InstanceBvh& bvh,
+         const std::vector<InstanceData>& instances,
+         JobSystem& jobs)
+{
+  Camera camera{
+    Random(.5f, 1.5f), Random(.5f, 2.f), .1f, Random(20.f, 150.f)
+  };
+  camera.Position = RandomPoint(80.f);
+  camera.Target = RandomPoint(20.f);
+  camera.Update();
+  const Frustum& frustum = camera.ViewFrustum();
+
+  std::vector<InstanceData> out(instances.size());
+  const u32 count = bvh.Cull(frustum, instances.data(), jobs, out.data());
+  std::vector<u32> culled(count);
+  for (u32 i = 0; i < count; ++i) {
+    culled[i] = u32(out[i].params[3]);
+    CHECK(std::memcmp(&out[i], &instances[culled[i]], sizeof(out[i])) == 0);
+  }
+  std::sort(culled.begin(), culled.end());
+  CHECK(std::adjacent_find(culled.begin(), culled.end()) == culled.end());
+
+  std::vector<u32> visible, borderline;
+  CullBruteForce(frustum, instances, visible, borderline);
+  // the two may only disagree about spheres touching a plane
+  std::vector<u32> differ;
+  std::set_symmetric_difference(visible.begin(),
+                                visible.end(),
+                                culled.begin(),
+                                culled.end(),
+                                std::back_inserter(differ));
+  for (u32 i : differ) {
+    CHECK(std::binary_search(borderline.begin(), borderline.end(), i));
+  }
+}
+
+void
+TestRaycast(InstanceBvh& bvh, const std::vector<InstanceData>& instances)
+{
+  // aimed at an instance, so most rays hit something
+  const InstanceData& aim = instances[rng() % instances.size()];
+  const glm::vec3 origin = RandomPoint(80.f);
+  const glm::vec3 target{ aim.position[0], aim.position[1], aim.position[2] };
+  const glm::vec3 dir = target - origin + RandomPoint(1.f);
+  const BvhHit hit =
+    bvh.Raycast(origin, dir, instances.data(), kBoxMin, kBoxMax);
+
+  double best = INFINITY;
+  for (const auto& inst : instances) {
+    const double t = RayInstance(origin, dir, inst);
+    if (t >= 0. && t < best) {
+      best = t;
+    }
+  }
+  if (best == INFINITY) {
+    CHECK(hit.instance == BvhHit::kNone);
+    return;
+  }
+  CHECK(hit.instance < instances.size());
+  if (hit.instance >= instances.size()) {
+    return;
+  }
+  // a different instance only when it is hit as near, within rounding
+  const double tolerance = kTolerance * std::max(1., best);
+  CHECK(std::fabs(hit.t - best) <= tolerance);
+  CHECK(std::fabs(RayInstance(origin, dir, instances[hit.instance]) - best) <=
+        tolerance);
+}
+
+} // namespace
+
+int
+main()
+{
+  Logger::Init();
+  JobSystem jobs;
+  for (u32 count : kCounts) {
+    const int before = Failures();
+    std::vector<InstanceData> instances(count);
+    for (u32 i = 0; i < count; ++i) {
+      Randomize(instances[i], i);
+    }
+    InstanceBvh bvh;
+    for (u32 step = 0; step < kSteps; ++step) {
+      // the first Update builds, the others refit
+      bvh.Update(instances.data(), count, kRadius, jobs);
+      CHECK(bvh.Count() == count);
+      for (u32 view = 0; view < kViews; ++view) {
+        TestCull(bvh, instances, jobs);
+        TestRaycast(bvh, instances);
+      }
+      Move(instances, step % 2 == 0 ? .5f : 20.f);
+    }
+    std::printf("%u instances: %s\n",
+                count,
+                Failures() == before ? "ok" : "FAILED");
+  }
+  return Failures() == 0 ? 0 : 1;
+}
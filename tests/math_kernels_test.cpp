@@ -0,0 +1,191 @@
+// MathKernels against glm on every path the CPU runs, batch sizes on and off
+// the lane widths.
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <random>
+#include <vector>
+
+#include "src/logger.h"
+#include "src/math_kernels.h"
+#include "tests/check.h"
+
+namespace {
+
+constexpr float kTolerance = 1e-5f;
+constexpr u32 kCounts[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 100 };
+
+std::mt19937 rng{ 1234 };
+
+float
+Random(float lo, float hi)
+{
+  return std::uniform_real_distribution<float>{ lo, hi }(rng);
+}
+
+glm::mat4
+RandomMatrix()
+{
+  glm::mat4 m;
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      m[c][r] = Random(-10.f, 10.f);
+    }
+  }
+  return m;
+}
+
+// Every element within `tolerance` times b's largest one: sums of products
+// cancel, small results carry the rounding of the large terms
+bool
+NearMatrix(const glm::mat4& a, const glm::mat4& b, float tolerance)
+{
+  float largest = 1.f;
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      largest = std::fmax(largest, std::fabs(b[c][r]));
+    }
+  }
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      if (std::fabs(a[c][r] - b[c][r]) > tolerance * largest) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void
+TestComposeTrs(u32 count)
+{
+  std::vector<float> arrays[9];
+  for (int k = 0; k < 9; ++k) {
+    arrays[k].resize(count);
+    for (u32 i = 0; i < count; ++i) {
+      arrays[k][i] = k < 3   ? Random(-100.f, 100.f)
+                     : k < 6 ? Random(-glm::two_pi<float>(),
+                                      glm::two_pi<float>())
+                             : Random(.1f, 4.f);
+    }
+  }
+  const TrsArrays trs{
+    { arrays[0].data(), arrays[1].data(), arrays[2].data() },
+    { arrays[3].data(), arrays[4].data(), arrays[5].data() },
+    { arrays[6].data(), arrays[7].data(), arrays[8].data() },
+  };
+  // one past the batch, the tail must not write there
+  std::vector<glm::mat4> out(count + 1, glm::mat4{ 7.f });
+  MathKernels::ComposeTrs(trs, count, out.data());
+
+  for (u32 i = 0; i < count; ++i) {
+    glm::mat4 m = glm::translate(
+      glm::mat4{ 1.f }, { arrays[0][i], arrays[1][i], arrays[2][i] });
+    m = glm::rotate(m, arrays[4][i], { 0.f, 1.f, 0.f });
+    m = glm::rotate(m, arrays[3][i], { 1.f, 0.f, 0.f });
+    m = glm::rotate(m, arrays[5][i], { 0.f, 0.f, 1.f });
+    m = glm::scale(m, { arrays[6][i], arrays[7][i], arrays[8][i] });
+    CHECK(NearMatrix(out[i], m, kTolerance));
+  }
+  CHECK(out[count] == glm::mat4{ 7.f });
+}
+
+void
+TestMultiply(u32 count)
+{
+  std::vector<glm::mat4> a(count);
+  std::vector<glm::mat4> b(count);
+  for (u32 i = 0; i < count; ++i) {
+    a[i] = RandomMatrix();
+    b[i] = RandomMatrix();
+  }
+  const glm::mat4 single = RandomMatrix();
+  std::vector<glm::mat4> out(count + 1, glm::mat4{ 7.f });
+  std::vector<glm::mat4> out_single(count + 1, glm::mat4{ 7.f });
+  MathKernels::Multiply(a.data(), b.data(), count, out.data());
+  MathKernels::Multiply(single, b.data(), count, out_single.data());
+
+  for (u32 i = 0; i < count; ++i) {
+    CHECK(NearMatrix(out[i], a[i] * b[i], kTolerance));
+    CHECK(NearMatrix(out_single[i], single * b[i], kTolerance));
+  }
+  CHECK(out[count] == glm::mat4{ 7.f });
+  CHECK(out_single[count] == glm::mat4{ 7.f });
+
+  // in place, out aliasing b
+  std::vector<glm::mat4> in_place = b;
+  MathKernels::Multiply(a.data(), in_place.data(), count, in_place.data());
+  for (u32 i = 0; i < count; ++i) {
+    CHECK(NearMatrix(in_place[i], a[i] * b[i], kTolerance));
+  }
+}
+
+void
+TestTransformBounds(u32 count)
+{
+  const glm::vec3 min{ -1.f, -2.f, .5f };
+  const glm::vec3 max{ 3.f, 1.f, 2.f };
+  std::vector<glm::mat4> m(count);
+  for (u32 i = 0; i < count; ++i) {
+    m[i] = RandomMatrix();
+    m[i][0][3] = m[i][1][3] = m[i][2][3] = 0.f; // affine
+    m[i][3][3] = 1.f;
+  }
+  std::vector<glm::vec3> out_min(count + 1, glm::vec3{ 7.f });
+  std::vector<glm::vec3> out_max(count + 1, glm::vec3{ 7.f });
+  MathKernels::TransformBounds(
+    m.data(), count, min, max, out_min.data(), out_max.data());
+
+  for (u32 i = 0; i < count; ++i) {
+    // the box around all eight corners
+    glm::vec3 lo{ INFINITY };
+    glm::vec3 hi{ -INFINITY };
+    for (int corner = 0; corner < 8; ++corner) {
+      const glm::vec3 p{ corner & 1 ? max.x : min.x,
+                         corner & 2 ? max.y : min.y,
+                         corner & 4 ? max.z : min.z };
+      const glm::vec3 world{ m[i] * glm::vec4{ p, 1.f } };
+      lo = glm::min(lo, world);
+      hi = glm::max(hi, world);
+    }
+    float largest = 1.f;
+    for (int k = 0; k < 3; ++k) {
+      largest = std::fmax(largest, std::fmax(-lo[k], hi[k]));
+    }
+    for (int k = 0; k < 3; ++k) {
+      CHECK(std::fabs(out_min[i][k] - lo[k]) <= kTolerance * largest);
+      CHECK(std::fabs(out_max[i][k] - hi[k]) <= kTolerance * largest);
+    }
+  }
+  CHECK(out_min[count] == glm::vec3{ 7.f });
+  CHECK(out_max[count] == glm::vec3{ 7.f });
+}
+
+} // namespace
+
+int
+main()
+{
+  Logger::Init();
+  const SimdLevel levels[] = { SimdLevel::Scalar,
+                               SimdLevel::Sse4,
+                               SimdLevel::Avx2,
+                               SimdLevel::Avx512 };
+  for (SimdLevel level : levels) {
+    // a level the build or the CPU lacks falls back to one tested already
+    if (MathKernels::Limit(level) != level) {
+      std::printf("%s: not supported here\n", MathKernels::Name(level));
+      continue;
+    }
+    const int before = Failures();
+    for (u32 count : kCounts) {
+      TestComposeTrs(count);
+      TestMultiply(count);
+      TestTransformBounds(count);
+    }
+    std::printf("%s: %s\n",
+                MathKernels::Name(level),
+                Failures() == before ? "ok" : "FAILED");
+  }
+  return Failures() == 0 ? 0 : 1;
+}
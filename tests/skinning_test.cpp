@@ -0,0 +1,286 @@
+// PosePalettes against a pose by pose glm evaluation of a small synthetic
+// skeleton: linear and step channels whose keys start after the clip does and
+// end before it's over, a single key channel, and rotation keys on opposite
+// sides of the quaternion double cover.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <random>
+#include <vector>
+
+#include "src/logger.h"
+#include "src/pose_palettes.h"
+#include "tests/check.h"
+
+namespace {
+
+constexpr u32 kPoses[] = { 1, 3, 8, 33, 128, 500 };
+constexpr float kDuration = 2.f;
+// keys cover [kFirstKey, kLastKey] of it, the poses all of it
+constexpr float kFirstKey = .25f;
+constexpr float kLastKey = 1.6f;
+// relative to the palette's largest element
+constexpr float kTolerance = 1e-4f;
+
+std::mt19937 rng{ 1234 };
+
+float
+Random(float lo, float hi)
+{
+  return std::uniform_real_distribution<float>{ lo, hi }(rng);
+}
+
+glm::vec4
+RandomRotation()
+{
+  glm::vec4 q{ Random(-1.f, 1.f),
+               Random(-1.f, 1.f),
+               Random(-1.f, 1.f),
+               Random(-1.f, 1.f) };
+  return q / glm::length(q);
+}
+
+glm::vec4
+Value(AnimationTarget target)
+{
+  switch (target) {
+    case AnimationTarget::Translation:
+      return { Random(-1.f, 1.f), Random(-1.f, 1.f), Random(-1.f, 1.f), 0.f };
+    case AnimationTarget::Rotation:
+      return RandomRotation();
+    case AnimationTarget::Scale:
+      return { Random(.5f, 1.5f), Random(.5f, 1.5f), Random(.5f, 1.5f), 0.f };
+  }
+  return {};
+}
+
+AnimationChannel
+Channel(u32 node, AnimationTarget target, bool step, u32 keys)
+{
+  AnimationChannel c{ node, target, step, {}, {} };
+  for (u32 k = 0; k < keys; ++k) {
+    const float t = keys == 1 ? .9f
+                              : kFirstKey + (kLastKey - kFirstKey) *
+                                              float(k) / float(keys - 1);
+    c.Times.push_back(t);
+    c.Values.push_back(Value(target));
+  }
+  if (target == AnimationTarget::Rotation) {
+    // the same rotations, half of them from the other side
+    for (u32 k = 1; k < keys; k += 2) {
+      c.Values[k] = -c.Values[k];
+    }
+  }
+  return c;
+}
+
+// A chain with a branch: 0 -> 1 -> 2 -> 3, 1 -> 4 -> 5, 6 alone. Joints
+// skip a node and list them out of order.
+Skeleton
+MakeSkeleton()
+{
+  Skeleton s;
+  s.Parents = { Skeleton::kNoParent, 0, 1, 2, 1, 4, Skeleton::kNoParent };
+  for (size_t n = 0; n < s.Parents.size(); ++n) {
+    s.Rest.push_back(NodeTransform{
+      .Translation = glm::vec3{ Value(AnimationTarget::Translation) },
+      .Rotation = RandomRotation(),
+      .Scale = glm::vec3{ Value(AnimationTarget::Scale) },
+    });
+  }
+  s.Joints = { 3, 0, 5, 2, 6, 1 };
+  for (size_t j = 0; j < s.Joints.size(); ++j) {
+    glm::mat4 bind = glm::translate(glm::mat4{ 1.f },
+                                    glm::vec3{ Value(
+                                      AnimationTarget::Translation) });
+    const glm::vec4 q = RandomRotation();
+    bind = bind * glm::mat4_cast(glm::quat{ q.w, q.x, q.y, q.z });
+    s.InverseBinds.push_back(glm::inverse(bind));
+  }
+
+  AnimationClip clip{ "swim", kDuration, {} };
+  using enum AnimationTarget;
+  clip.Channels.push_back(Channel(0, Translation, false, 5));
+  clip.Channels.push_back(Channel(1, Rotation, false, 6));
+  clip.Channels.push_back(Channel(2, Rotation, true, 4));
+  clip.Channels.push_back(Channel(2, Translation, true, 3));
+  clip.Channels.push_back(Channel(4, Scale, false, 4));
+  clip.Channels.push_back(Channel(5, Scale, true, 5));
+  clip.Channels.push_back(Channel(5, Translation, false, 1));
+  // node 3 and 6 keep their rest pose
+  s.Clips.push_back(clip);
+
+  // a second clip reusing the nodes differently, for switching clips
+  AnimationClip turn{ "turn", kDuration * .5f, {} };
+  turn.Channels.push_back(Channel(3, Rotation, false, 3));
+  turn.Channels.push_back(Channel(6, Translation, true, 2));
+  s.Clips.push_back(turn);
+  return s;
+}
+
+// Before the first key the first one, after the last key the last one,
+// linear or held in between
+glm::vec4
+Sample(const AnimationChannel& c, float time)
+{
+  const size_t last = c.Times.size() - 1;
+  if (time <= c.Times[0]) {
+    return c.Values[0];
+  }
+  if (time >= c.Times[last]) {
+    return c.Values[last];
+  }
+  size_t key = 0;
+  while (c.Times[key + 1] <= time) {
+    ++key;
+  }
+  const glm::vec4 a = c.Values[key];
+  glm::vec4 b = c.Values[key + 1];
+  if (c.Step) {
+    return a;
+  }
+  const float alpha =
+    (time - c.Times[key]) / (c.Times[key + 1] - c.Times[key]);
+  if (c.Target != AnimationTarget::Rotation) {
+    return a + (b - a) * alpha;
+  }
+  // normalized lerp the short way round
+  if (glm::dot(a, b) < 0.f) {
+    b = -b;
+  }
+  return glm::normalize(a + (b - a) * alpha);
+}
+
+// Joint palettes of one pose, joint by joint
+std::vector<glm::mat4>
+Palettes(const Skeleton& s, const AnimationClip& clip, float time)
+{
+  std::vector<NodeTransform> pose = s.Rest;
+  for (const auto& c : clip.Channels) {
+    const glm::vec4 v = Sample(c, time);
+    switch (c.Target) {
+      case AnimationTarget::Translation:
+        pose[c.Node].Translation = glm::vec3{ v };
+        break;
+      case AnimationTarget::Rotation:
+        pose[c.Node].Rotation = v;
+        break;
+      case AnimationTarget::Scale:
+        pose[c.Node].Scale = glm::vec3{ v };
+        break;
+    }
+  }
+  std::vector<glm::mat4> world(pose.size());
+  for (size_t n = 0; n < pose.size(); ++n) {
+    const NodeTransform& t = pose[n];
+    const glm::quat q{
+      t.Rotation.w, t.Rotation.x, t.Rotation.y, t.Rotation.z
+    };
+    const glm::mat4 local = glm::translate(glm::mat4{ 1.f }, t.Translation) *
+                            glm::mat4_cast(q) *
+                            glm::scale(glm::mat4{ 1.f }, t.Scale);
+    world[n] = s.Parents[n] == Skeleton::kNoParent
+                 ? local
+                 : world[s.Parents[n]] * local;
+  }
+  std::vector<glm::mat4> out(s.Joints.size());
+  for (size_t j = 0; j < s.Joints.size(); ++j) {
+    out[j] = world[s.Joints[j]] * s.InverseBinds[j];
+  }
+  return out;
+}
+
+bool
+Near(const glm::mat4& a, const glm::mat4& b)
+{
+  float scale = 1.f;
+  float error = 0.f;
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      scale = std::max(scale, std::abs(b[c][r]));
+      error = std::max(error, std::abs(a[c][r] - b[c][r]));
+    }
+  }
+  return error <= kTolerance * scale;
+}
+
+void
+TestPoses(PosePalettes& palettes,
+          const Skeleton& s,
+          u32 clip,
+          u32 poses,
+          float time,
+          float rate,
+          JobSystem& jobs)
+{
+  palettes.Build(s, clip, poses, time, rate, jobs);
+  const u32 built = std::min(poses, PosePalettes::kMaxPoses);
+  const u32 joints = u32(s.Joints.size());
+  CHECK(palettes.Poses() == built);
+  CHECK(palettes.Times().size() == built);
+  CHECK(palettes.Palettes().size() == size_t(joints) * built);
+  if (palettes.Poses() != built ||
+      palettes.Palettes().size() != size_t(joints) * built) {
+    return;
+  }
+  std::vector<glm::mat4> reference;
+  palettes.Reference(reference);
+  CHECK(reference.size() == palettes.Palettes().size());
+
+  const AnimationClip& c = s.Clips[clip];
+  for (u32 k = 0; k < built; ++k) {
+    // spread over the clip, wrapped to it
+    const float t = std::fmod(
+      time * rate + c.Duration * float(k) / float(built), c.Duration);
+    const float expected_time = t < 0.f ? t + c.Duration : t;
+    const float pose_time = palettes.Times()[k];
+    CHECK(pose_time >= 0.f && pose_time < c.Duration);
+    // either side of the wrap is the same time
+    const float off = std::abs(pose_time - expected_time);
+    CHECK(std::min(off, c.Duration - off) <= 1e-5f * c.Duration);
+
+    // at the pose's own time, so rounding there doesn't count
+    const std::vector<glm::mat4> expected = Palettes(s, c, pose_time);
+    for (u32 j = 0; j < joints; ++j) {
+      const size_t i = size_t(j) * built + k;
+      CHECK(Near(palettes.Palettes()[i], expected[j]));
+      CHECK(i >= reference.size() || Near(reference[i], expected[j]));
+    }
+  }
+}
+
+} // namespace
+
+int
+main()
+{
+  Logger::Init();
+  JobSystem jobs;
+  const Skeleton skeleton = MakeSkeleton();
+  PosePalettes palettes;
+  for (u32 poses : kPoses) {
+    const int before = Failures();
+    // keys before, inside and after the poses' times, clip switches on the
+    // same palettes, and time running backwards
+    TestPoses(palettes, skeleton, 0, poses, 0.f, 1.f, jobs);
+    TestPoses(palettes, skeleton, 0, poses, 3.37f, 1.3f, jobs);
+    TestPoses(palettes, skeleton, 1, poses, .1f, 1.f, jobs);
+    TestPoses(palettes, skeleton, 0, poses, -.7f, 2.f, jobs);
+    for (u32 step = 0; step < 8; ++step) {
+      TestPoses(palettes,
+                skeleton,
+                0,
+                poses,
+                Random(-kDuration, 4.f * kDuration),
+                Random(.1f, 3.f),
+                jobs);
+    }
+    std::printf("%u poses: %s\n",
+                poses,
+                Failures() == before ? "ok" : "FAILED");
+  }
+  std::printf("skinning: %s\n", Failures() == 0 ? "ok" : "FAILED");
+  return Failures() == 0 ? 0 : 1;
+}
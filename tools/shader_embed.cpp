@@ -0,0 +1,104 @@
+// Build tool: reflects SPIR-V modules and writes them out as a C++ source
+// holding the kShaderBlobs table, see src/shader_blobs.h.
+//
+//   shader_embed <output.cpp> <module.spv>...
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "src/spirv_reflect.h"
+
+namespace {
+
+const char*
+StageName(ShaderStage stage)
+{
+  switch (stage) {
+    case ShaderStage::Vertex:
+      return "ShaderStage::Vertex";
+    case ShaderStage::Fragment:
+      return "ShaderStage::Fragment";
+    case ShaderStage::Compute:
+      return "ShaderStage::Compute";
+  }
+  return "";
+}
+
+std::string
+FileName(const std::string& path)
+{
+  const auto slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  if (argc < 3) {
+    std::fprintf(stderr, "usage: %s <output.cpp> <module.spv>...\n", argv[0]);
+    return 1;
+  }
+
+  std::string out;
+  out += "// Generated by shader_embed, do not edit.\n";
+  out += "#include \"src/shader_blobs.h\"\n\n";
+  out += "namespace {\n";
+
+  std::string table;
+  for (int i = 2; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    const std::vector<char> code{ std::istreambuf_iterator<char>(file),
+                                  std::istreambuf_iterator<char>() };
+    ShaderReflection r;
+    if (!file || !ReflectSpirv(code.data(), code.size(), r)) {
+      std::fprintf(stderr, "shader_embed: couldn't reflect %s\n", argv[i]);
+      return 1;
+    }
+
+    const std::string blob = "kBlob" + std::to_string(i - 2);
+    out += "alignas(4) const u8 " + blob + "[] = {";
+    for (size_t b = 0; b < code.size(); ++b) {
+      out += b % 16 == 0 ? "\n  " : " ";
+      out += std::to_string(static_cast<unsigned char>(code[b])) + ",";
+    }
+    out += "\n};\n";
+
+    char entry[512];
+    std::snprintf(entry,
+                  sizeof(entry),
+                  "  { \"%s\", %s, sizeof(%s), "
+                  "{ %s, %u, %u, %u, %u, %u, %u, { %u, %u, %u } } },\n",
+                  FileName(argv[i]).c_str(),
+                  blob.c_str(),
+                  blob.c_str(),
+                  StageName(r.stage),
+                  r.samplers,
+                  r.uniform_buffers,
+                  r.storage_buffers,
+                  r.storage_textures,
+                  r.readwrite_storage_buffers,
+                  r.readwrite_storage_textures,
+                  r.threads[0],
+                  r.threads[1],
+                  r.threads[2]);
+    table += entry;
+  }
+  out += "} // namespace\n\n";
+  out += "extern const ShaderBlob kShaderBlobs[];\n";
+  out += "extern const size_t kShaderBlobCount;\n\n";
+  out += "const ShaderBlob kShaderBlobs[] = {\n" + table + "};\n";
+  out += "const size_t kShaderBlobCount = " + std::to_string(argc - 2) + ";\n";
+
+  std::ofstream file(argv[1], std::ios::binary);
+  file << out;
+  if (!file) {
+    std::fprintf(stderr, "shader_embed: couldn't write %s\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}